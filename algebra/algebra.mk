@@ -6,9 +6,11 @@ $(eval $(call library,lapack_detect,lapack_detect.cc,))
 LIBALGEBRA_SOURCES := \
         least_squares.cc \
         irls.cc \
+        glz_solvers.cc \
         lapack.cc \
 	ilaenv.f \
         svd.cc \
+        randomized_svd.cc \
         matrix_ops.cc
 
 $(eval $(call add_sources,$(LIBALGEBRA_SOURCES)))
@@ -0,0 +1,520 @@
+/* glz_solvers.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   First order solvers for generalized linear models.
+*/
+
+#include "glz_solvers.h"
+#include "glz.h"
+#include "jml/arch/simd_vector.h"
+#include "jml/arch/exception.h"
+#include "jml/utils/string_functions.h"
+#include "jml/utils/worker_task.h"
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/random_number_generator.hpp>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+
+using namespace std;
+
+
+namespace ML {
+
+
+namespace {
+
+/* Negative log likelihood (up to a constant) of the target y given the
+   mean mu, and its derivative with respect to mu. */
+
+double example_loss(const Binomial_Dist<double> &, double y, double mu,
+                    double & dloss_dmu)
+{
+    mu = std::min(std::max(mu, 1e-10), 1.0 - 1e-10);
+    dloss_dmu = (mu - y) / (mu * (1.0 - mu));
+    return -(y * std::log(mu) + (1.0 - y) * std::log(1.0 - mu));
+}
+
+double example_loss(const Normal_Dist<double> &, double y, double mu,
+                    double & dloss_dmu)
+{
+    dloss_dmu = mu - y;
+    return 0.5 * (mu - y) * (mu - y);
+}
+
+/** Calculate the weighted loss of n of the examples in rows, adding its
+    gradient with respect to b to gradient (if it's not null) and the
+    weights of the examples to total_weight.  The baseline (which may be
+    empty) is added to the variables of every example.  If order isn't null
+    then the examples are order[0] ... order[n - 1], otherwise they are the
+    first n.  Only the non-zero variables of each example are looked at;
+    the baseline costs one dense dot product and update per call. */
+template<class Link, class Dist>
+double accum_loss(const Link & link, const Dist & dist,
+                  const distribution<double> & b,
+                  const distribution<double> & baseline,
+                  const IRLS_Sparse_Rows & rows,
+                  const int * order, int n,
+                  double * gradient, double & total_weight)
+{
+    int nv = b.size();
+
+    double eta0 = 0.0;
+    if (!baseline.empty())
+        eta0 = SIMD::vec_dotprod_dp(&baseline[0], &b[0], nv);
+
+    distribution<double> eta(n);
+    for (unsigned i = 0;  i < n;  ++i) {
+        int r = (order ? order[i] : i);
+        double total = eta0;
+        for (size_t j = rows.offsets[r];  j < rows.offsets[r + 1];  ++j)
+            total += b[rows.indexes[j]] * rows.values[j];
+        eta[i] = total;
+    }
+
+    // The link functions bound their arguments, so that these are finite
+    distribution<double> mu = link.inverse(eta);
+    distribution<double> deta_dmu = link.diff(mu);
+
+    double loss = 0.0, total_k = 0.0;
+    for (unsigned i = 0;  i < n;  ++i) {
+        int r = (order ? order[i] : i);
+        double w = rows.w[r];
+        if (w == 0.0) continue;
+
+        double dloss_dmu;
+        loss += w * example_loss(dist, rows.y[r], mu[i], dloss_dmu);
+        total_weight += w;
+
+        double k = w * dloss_dmu / deta_dmu[i];
+        if (!gradient || k == 0.0) continue;
+
+        for (size_t j = rows.offsets[r];  j < rows.offsets[r + 1];  ++j)
+            gradient[rows.indexes[j]] += k * rows.values[j];
+        total_k += k;
+    }
+
+    if (gradient && total_k != 0.0 && !baseline.empty())
+        SIMD::vec_add(gradient, total_k, &baseline[0], gradient, nv);
+
+    return loss;
+}
+
+/** Mean loss over all of the examples, and its gradient, in a parallel pass
+    over the chunks of the source. */
+template<class Link, class Dist>
+double loss_pass(const IRLS_Example_Source & source,
+                 const Link & link, const Dist & dist,
+                 const distribution<double> & b,
+                 const distribution<double> & baseline,
+                 distribution<double> & gradient,
+                 int chunk_size)
+{
+    int nv = source.variables();
+    size_t nx = source.examples();
+
+    size_t num_chunks = (nx + chunk_size - 1) / chunk_size;
+
+    // One set of sums per thread, added together in order at the end so
+    // that the result doesn't depend upon the scheduling
+    int num_blocks = std::min<size_t>(num_chunks, num_threads());
+    size_t chunks_per_block = (num_chunks + num_blocks - 1) / num_blocks;
+
+    vector<double> block_loss(num_blocks), block_weight(num_blocks);
+    vector<distribution<double> > block_gradient(num_blocks);
+
+    auto doBlock = [&] (int block)
+        {
+            distribution<double> grad(nv, 0.0);
+            double loss = 0.0, weight = 0.0;
+
+            IRLS_Sparse_Rows rows;
+
+            size_t c0 = block * chunks_per_block;
+            size_t c1 = std::min(num_chunks, c0 + chunks_per_block);
+
+            for (size_t c = c0;  c < c1;  ++c) {
+                size_t x0 = c * chunk_size;
+                int n = std::min<size_t>(chunk_size, nx - x0);
+                source.get_sparse(x0, n, rows);
+                loss += accum_loss(link, dist, b, baseline, rows, 0, n,
+                                   &grad[0], weight);
+            }
+
+            block_loss[block] = loss;
+            block_weight[block] = weight;
+            block_gradient[block].swap(grad);
+        };
+
+    run_in_parallel_blocked(0, num_blocks, doBlock);
+
+    double loss = 0.0, weight = 0.0;
+    gradient.clear();
+    gradient.resize(nv, 0.0);
+    for (unsigned i = 0;  i < num_blocks;  ++i) {
+        loss += block_loss[i];
+        weight += block_weight[i];
+        gradient += block_gradient[i];
+    }
+
+    if (weight == 0.0) {
+        gradient.fill(0.0);
+        return 0.0;
+    }
+
+    gradient /= weight;
+    return loss / weight;
+}
+
+void check_params(const IRLS_Example_Source & source,
+                  const GLZ_Solver_Params & params,
+                  const char * function)
+{
+    if (params.l1 < 0.0 || params.l2 < 0.0)
+        throw Exception(format("%s: regularization weights must not be "
+                               "negative", function));
+    if (params.chunk_size < 1)
+        throw Exception(format("%s: invalid chunk size", function));
+    if (params.unregularized >= source.variables())
+        throw Exception(format("%s: unregularized variable %d out of range",
+                               function, params.unregularized));
+}
+
+/** Value of the L1 penalty at b. */
+double l1_penalty(const distribution<double> & b,
+                  const GLZ_Solver_Params & params)
+{
+    if (params.l1 == 0.0) return 0.0;
+    double result = 0.0;
+    for (unsigned v = 0;  v < b.size();  ++v)
+        if (v != params.unregularized)
+            result += std::abs(b[v]);
+    return params.l1 * result;
+}
+
+/** The pseudo gradient of OWL-QN: the gradient of the objective including
+    the L1 penalty where it's differentiable, and the smallest element of its
+    subdifferential where it's not (at zero). */
+distribution<double>
+pseudo_gradient(const distribution<double> & b,
+                const distribution<double> & g,
+                const GLZ_Solver_Params & params)
+{
+    distribution<double> result = g;
+    if (params.l1 == 0.0) return result;
+
+    double l1 = params.l1;
+    for (unsigned v = 0;  v < b.size();  ++v) {
+        if (v == params.unregularized) continue;
+        if (b[v] > 0.0) result[v] = g[v] + l1;
+        else if (b[v] < 0.0) result[v] = g[v] - l1;
+        else if (g[v] + l1 < 0.0) result[v] = g[v] + l1;
+        else if (g[v] - l1 > 0.0) result[v] = g[v] - l1;
+        else result[v] = 0.0;
+    }
+    return result;
+}
+
+inline double sign(double x)
+{
+    return (x > 0.0) - (x < 0.0);
+}
+
+template<class Link, class Dist>
+distribution<double>
+lbfgs(const IRLS_Example_Source & source,
+      const Link & link, const Dist & dist,
+      const GLZ_Solver_Params & params)
+{
+    check_params(source, params, "glz_lbfgs()");
+
+    int nv = source.variables();
+    distribution<double> b(nv, 0.0);
+    if (source.examples() == 0 || nv == 0) return b;
+
+    distribution<double> baseline = source.baseline();
+
+    // Smooth part of the objective (the mean loss plus the L2 penalty), and
+    // its gradient
+    auto smooth = [&] (const distribution<double> & b,
+                       distribution<double> & g)
+        {
+            double f = loss_pass(source, link, dist, b, baseline, g,
+                                 params.chunk_size);
+            if (params.l2 == 0.0) return f;
+            for (unsigned v = 0;  v < nv;  ++v) {
+                if (v == params.unregularized) continue;
+                f += 0.5 * params.l2 * b[v] * b[v];
+                g[v] += params.l2 * b[v];
+            }
+            return f;
+        };
+
+    distribution<double> g;
+    double F = smooth(b, g) + l1_penalty(b, params);
+
+    // Most recent updates to b and to the gradient, oldest first
+    vector<distribution<double> > s_hist, y_hist;
+    vector<double> rho_hist;
+
+    for (int iter = 0;  iter < params.max_iter;  ++iter) {
+        distribution<double> pg = pseudo_gradient(b, g, params);
+        double pg_norm = pg.two_norm();
+        if (pg_norm == 0.0) break;
+
+        // Two loop recursion for the direction d = -H pg
+        int m = s_hist.size();
+        distribution<double> d = -pg;
+        vector<double> alpha(m);
+        for (int i = m - 1;  i >= 0;  --i) {
+            alpha[i] = rho_hist[i] * s_hist[i].dotprod(d);
+            d -= alpha[i] * y_hist[i];
+        }
+        if (m > 0)
+            d *= s_hist[m - 1].dotprod(y_hist[m - 1])
+                / y_hist[m - 1].dotprod(y_hist[m - 1]);
+        for (int i = 0;  i < m;  ++i) {
+            double beta = rho_hist[i] * y_hist[i].dotprod(d);
+            d += (alpha[i] - beta) * s_hist[i];
+        }
+
+        // Don't move any variable uphill with respect to the pseudo
+        // gradient
+        if (params.l1 != 0.0)
+            for (unsigned v = 0;  v < nv;  ++v)
+                if (d[v] * pg[v] >= 0.0) d[v] = 0.0;
+
+        if (!(d.dotprod(pg) < 0.0)) {
+            // Not a descent direction; start again from steepest descent
+            d = -pg;
+            s_hist.clear();  y_hist.clear();  rho_hist.clear();
+        }
+
+        // The orthant that the step has to stay within
+        distribution<double> orthant(nv);
+        for (unsigned v = 0;  v < nv;  ++v)
+            orthant[v] = (b[v] != 0.0 ? sign(b[v]) : -sign(pg[v]));
+
+        // Backtracking line search
+        double step = (s_hist.empty() ? 1.0 / pg_norm : 1.0);
+        distribution<double> b_new, g_new;
+        double F_new = F;
+        bool found = false;
+
+        for (unsigned attempt = 0;  attempt < 40 && !found;  ++attempt) {
+            b_new = b + step * d;
+            if (params.l1 != 0.0)
+                for (unsigned v = 0;  v < nv;  ++v)
+                    if (v != params.unregularized
+                        && b_new[v] * orthant[v] <= 0.0)
+                        b_new[v] = 0.0;
+
+            F_new = smooth(b_new, g_new) + l1_penalty(b_new, params);
+            found = (F_new <= F + 1e-4 * pg.dotprod(b_new - b));
+            step *= 0.5;
+        }
+
+        if (!found) break;
+
+        distribution<double> s = b_new - b, y = g_new - g;
+        double sy = s.dotprod(y);
+        if (sy > 0.0) {
+            s_hist.push_back(s);
+            y_hist.push_back(y);
+            rho_hist.push_back(1.0 / sy);
+            if (s_hist.size() > params.history) {
+                s_hist.erase(s_hist.begin());
+                y_hist.erase(y_hist.begin());
+                rho_hist.erase(rho_hist.begin());
+            }
+        }
+
+        double improvement = F - F_new;
+
+        b.swap(b_new);
+        g.swap(g_new);
+        F = F_new;
+
+        if (improvement <= params.tolerance * std::max(1.0, std::abs(F)))
+            break;
+    }
+
+    return b;
+}
+
+template<class Link, class Dist>
+distribution<double>
+sgd(const IRLS_Example_Source & source,
+    const Link & link, const Dist & dist,
+    const GLZ_Solver_Params & params)
+{
+    check_params(source, params, "glz_sgd()");
+    if (params.minibatch_size < 1)
+        throw Exception("glz_sgd(): invalid minibatch size");
+
+    int nv = source.variables();
+    size_t nx = source.examples();
+    int chunk_size = params.chunk_size;
+
+    distribution<double> b(nv, 0.0);
+    if (nx == 0 || nv == 0) return b;
+
+    distribution<double> baseline = source.baseline();
+
+    size_t num_chunks = (nx + chunk_size - 1) / chunk_size;
+    int num_shards = std::min<size_t>(num_chunks, num_threads());
+    size_t chunks_per_shard = (num_chunks + num_shards - 1) / num_shards;
+
+    vector<distribution<double> > shard_b(num_shards);
+
+    for (int epoch = 0;  epoch < params.epochs;  ++epoch) {
+        double rate = params.learning_rate / (1.0 + epoch);
+
+        auto doShard = [&] (int shard)
+            {
+                distribution<double> sb = b;
+
+                boost::mt19937 rng(params.seed + epoch * num_shards + shard);
+                boost::random_number_generator<boost::mt19937> rand(rng);
+
+                vector<size_t> chunks;
+                for (size_t c = shard * chunks_per_shard;
+                     c < std::min(num_chunks, (shard + 1) * chunks_per_shard);
+                     ++c)
+                    chunks.push_back(c);
+                std::random_shuffle(chunks.begin(), chunks.end(), rand);
+
+                IRLS_Sparse_Rows rows;
+                vector<int> order(chunk_size);
+                distribution<double> grad(nv);
+
+                for (unsigned i = 0;  i < chunks.size();  ++i) {
+                    size_t x0 = chunks[i] * chunk_size;
+                    int n = std::min<size_t>(chunk_size, nx - x0);
+                    source.get_sparse(x0, n, rows);
+
+                    std::iota(order.begin(), order.begin() + n, 0);
+                    std::random_shuffle(order.begin(), order.begin() + n,
+                                        rand);
+
+                    for (int i0 = 0;  i0 < n;  i0 += params.minibatch_size) {
+                        int nb = std::min(params.minibatch_size, n - i0);
+
+                        grad.fill(0.0);
+                        double weight = 0.0;
+                        accum_loss(link, dist, sb, baseline, rows,
+                                   &order[i0], nb, &grad[0], weight);
+                        if (weight == 0.0) continue;
+
+                        grad /= weight;
+
+                        for (unsigned v = 0;  v < nv;  ++v) {
+                            if (v == params.unregularized) {
+                                sb[v] -= rate * grad[v];
+                                continue;
+                            }
+
+                            double bv = sb[v]
+                                - rate * (grad[v] + params.l2 * sb[v]);
+
+                            // Proximal step for the L1 penalty
+                            double shrink = rate * params.l1;
+                            if (bv > shrink) bv -= shrink;
+                            else if (bv < -shrink) bv += shrink;
+                            else bv = 0.0;
+
+                            sb[v] = bv;
+                        }
+                    }
+                }
+
+                shard_b[shard].swap(sb);
+            };
+
+        run_in_parallel_blocked(0, num_shards, doShard);
+
+        b.fill(0.0);
+        for (unsigned i = 0;  i < num_shards;  ++i)
+            b += shard_b[i];
+        b /= num_shards;
+    }
+
+    return b;
+}
+
+} // file scope
+
+
+/*****************************************************************************/
+/* GLZ SOLVERS                                                               */
+/*****************************************************************************/
+
+distribution<double>
+glz_lbfgs(const IRLS_Example_Source & source,
+          Link_Function link_function,
+          const GLZ_Solver_Params & params)
+{
+    switch (link_function) {
+
+    case LOGIT:
+        return lbfgs(source, Logit_Link<double>(), Binomial_Dist<double>(),
+                     params);
+
+    case LOG:
+        return lbfgs(source, Logarithm_Link<double>(), Binomial_Dist<double>(),
+                     params);
+
+    case LINEAR:
+        return lbfgs(source, Linear_Link<double>(), Normal_Dist<double>(),
+                     params);
+
+    case PROBIT:
+        return lbfgs(source, Probit_Link<double>(), Binomial_Dist<double>(),
+                     params);
+
+    case COMP_LOG_LOG:
+        return lbfgs(source, Comp_Log_Log_Link<double>(),
+                     Binomial_Dist<double>(), params);
+
+    default:
+        throw Exception(format("glz_lbfgs(): function %d not implemented",
+                               link_function));
+    }
+}
+
+distribution<double>
+glz_sgd(const IRLS_Example_Source & source,
+        Link_Function link_function,
+        const GLZ_Solver_Params & params)
+{
+    switch (link_function) {
+
+    case LOGIT:
+        return sgd(source, Logit_Link<double>(), Binomial_Dist<double>(),
+                   params);
+
+    case LOG:
+        return sgd(source, Logarithm_Link<double>(), Binomial_Dist<double>(),
+                   params);
+
+    case LINEAR:
+        return sgd(source, Linear_Link<double>(), Normal_Dist<double>(),
+                   params);
+
+    case PROBIT:
+        return sgd(source, Probit_Link<double>(), Binomial_Dist<double>(),
+                   params);
+
+    case COMP_LOG_LOG:
+        return sgd(source, Comp_Log_Log_Link<double>(),
+                   Binomial_Dist<double>(), params);
+
+    default:
+        throw Exception(format("glz_sgd(): function %d not implemented",
+                               link_function));
+    }
+}
+
+} // namespace ML
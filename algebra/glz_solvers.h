@@ -0,0 +1,124 @@
+/* glz_solvers.h                                                   -*- C++ -*-
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   First order solvers for generalized linear models, with L1 and L2
+   regularization.
+*/
+
+#ifndef __algebra__glz_solvers_h__
+#define __algebra__glz_solvers_h__
+
+
+#include "irls.h"
+#include <stdint.h>
+
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* GLZ_SOLVER_PARAMS                                                         */
+/*****************************************************************************/
+
+/** Parameters for glz_lbfgs() and glz_sgd().  Both minimize the same
+    objective:
+
+    \f[
+        \frac{1}{\sum_i w_i} \sum_i w_i L(y_i, g^{-1}(\mathbf{x}_i^T \mathbf{b}))
+        + \frac{\lambda_2}{2} \|\mathbf{b}\|_2^2 + \lambda_1 \|\mathbf{b}\|_1
+    \f]
+
+    where L is the negative log likelihood of the distribution that goes with
+    the link function g (binomial, or normal for the linear link).
+*/
+struct GLZ_Solver_Params {
+    GLZ_Solver_Params()
+        : l1(0.0), l2(0.0), unregularized(-1), max_iter(200),
+          tolerance(1e-10), history(10), epochs(10), minibatch_size(256),
+          learning_rate(0.5), seed(1), chunk_size(4096)
+    {
+    }
+
+    /// Weight of the L1 penalty.  Any value over zero makes the solution
+    /// sparse.
+    double l1;
+
+    /// Weight of the L2 penalty
+    double l2;
+
+    /// Variable (normally the bias) that isn't penalized, or -1 for none
+    int unregularized;
+
+    /// L-BFGS: maximum number of iterations.  Each one costs at least one
+    /// pass over the examples.
+    int max_iter;
+
+    /// L-BFGS: stop once an iteration reduces the objective by less than
+    /// this proportion of it
+    double tolerance;
+
+    /// L-BFGS: number of updates kept to approximate the Hessian
+    int history;
+
+    /// SGD: number of passes over the examples
+    int epochs;
+
+    /// SGD: number of examples in each gradient step
+    int minibatch_size;
+
+    /// SGD: step size for the first epoch; it decays as 1 / (1 + epoch)
+    double learning_rate;
+
+    /// SGD: seed for the order of the examples
+    uint32_t seed;
+
+    /// Number of examples asked for from the source at once.  Each thread
+    /// holds the non-zero values of one chunk.
+    int chunk_size;
+};
+
+
+/*****************************************************************************/
+/* GLZ SOLVERS                                                               */
+/*****************************************************************************/
+
+/** Fit a generalized linear model by minimizing the regularized negative
+    log likelihood with L-BFGS, or with OWL-QN when params.l1 is non-zero:
+
+    G. Andrew, J. Gao.  Scalable training of L1-regularized log-linear
+    models.  ICML 2007.
+
+    Each function evaluation is a parallel pass over the chunks of the
+    source, which are read with IRLS_Example_Source::get_sparse().  The
+    solver keeps O(nv * history) values, each thread O(nv) for its gradient
+    and the non-zero values of its current chunk, so unlike
+    perform_irls_streaming() (which needs O(nv^2)) it works for models with
+    many variables as long as the examples are sparse.  Sources that only
+    implement get() are still read one dense example at a time.
+*/
+distribution<double>
+glz_lbfgs(const IRLS_Example_Source & source,
+          Link_Function link_function,
+          const GLZ_Solver_Params & params = GLZ_Solver_Params());
+
+/** Fit a generalized linear model with minibatch stochastic gradient
+    descent.  The L1 penalty is applied with a proximal (soft thresholding)
+    step after each gradient step.
+
+    The examples are split into one shard per thread.  Each epoch, every
+    shard runs SGD over its own examples in a random order, starting from
+    the current parameters, and the results are averaged (iterative
+    parameter mixing).  The result depends upon the number of threads, but
+    not on how they are scheduled.
+*/
+distribution<double>
+glz_sgd(const IRLS_Example_Source & source,
+        Link_Function link_function,
+        const GLZ_Solver_Params & params = GLZ_Solver_Params());
+
+
+} // namespace ML
+
+
+#endif /* __algebra__glz_solvers_h__ */
@@ -18,6 +18,7 @@
 #include "jml/boosting/config_impl.h"
 #include "jml/utils/string_functions.h"
 #include "jml/algebra/lapack.h"
+#include "jml/utils/worker_task.h"
 #include <boost/version.hpp>
 
 using namespace std;
@@ -569,6 +570,374 @@ perform_irls(const distribution<double> & correct,
                              ridge_regression);
 }
 
+
+/*****************************************************************************/
+/* STREAMING IRLS                                                            */
+/*****************************************************************************/
+
+IRLS_Example_Source::
+~IRLS_Example_Source()
+{
+}
+
+void
+IRLS_Example_Source::
+get_sparse(size_t first, size_t n, IRLS_Sparse_Rows & rows) const
+{
+    int nv = variables();
+
+    rows.clear();
+    rows.y.resize(n);
+    rows.w.resize(n);
+
+    distribution<double> x(nv);
+
+    for (unsigned i = 0;  i < n;  ++i) {
+        get(first + i, 1, &x[0], &rows.y[i], &rows.w[i]);
+        for (unsigned v = 0;  v < nv;  ++v) {
+            if (x[v] == 0.0) continue;
+            rows.indexes.push_back(v);
+            rows.values.push_back(x[v]);
+        }
+        rows.offsets.push_back(rows.indexes.size());
+    }
+}
+
+distribution<double>
+IRLS_Example_Source::
+baseline() const
+{
+    return distribution<double>();
+}
+
+namespace {
+
+/** Sums accumulated over one pass through the examples.  The matrices are
+    (nv x nv) and row major, with only the lower triangle filled in; they
+    are plain vectors so that the sums can be assigned. */
+struct IRLS_Sums {
+    IRLS_Sums(int nv, bool first)
+        : nv(nv), xTwx(nv * nv), xTwz(nv), xTx(first ? nv * nv : 0),
+          deviance(0.0), ysqr(0.0)
+    {
+    }
+
+    int nv;
+    distribution<double> xTwx;
+    distribution<double> xTwz;
+    distribution<double> xTx;   ///< Unweighted; first pass only
+    double deviance;            ///< Of the current parameters
+    double ysqr;                ///< Sum of squared targets
+
+    void add(const IRLS_Sums & other)
+    {
+        xTwx += other.xTwx;
+        xTwz += other.xTwz;
+        xTx += other.xTx;
+        deviance += other.deviance;
+        ysqr += other.ysqr;
+    }
+};
+
+/** Add w_r x_r x_r^T for each of the n rows x_r of x to the lower triangle
+    of the (nv x nv) matrix A.  The weights w can be null, meaning all
+    ones. */
+void accum_outer_products(double * A, int nv,
+                          const double * x, const double * w, int n)
+{
+    for (unsigned r = 0;  r < n;  ++r) {
+        const double * xr = x + (size_t)r * nv;
+        double wr = (w ? w[r] : 1.0);
+        if (wr == 0.0) continue;
+        for (unsigned v = 0;  v < nv;  ++v) {
+            double k = wr * xr[v];
+            double * Av = A + (size_t)v * nv;
+            if (k != 0.0)
+                SIMD::vec_add(Av, k, xr, Av, v + 1);
+        }
+    }
+}
+
+void check_finite(const distribution<double> & values, const char * what)
+{
+    for (unsigned i = 0;  i < values.size();  ++i)
+        if (!std::isfinite(values[i]))
+            throw Exception(format("%s[%d] = %f", what, i, values[i]));
+}
+
+/** One pass through the examples, accumulating the sums needed for the
+    next iteration.  If b is null then it's the first pass, and the initial
+    values of mu are estimated from the targets as in irls(). */
+template<class Link, class Dist>
+IRLS_Sums
+irls_pass(const IRLS_Example_Source & source,
+          const distribution<double> * b,
+          const Link & link, const Dist & dist, int chunk_size)
+{
+    int nv = source.variables();
+    size_t nx = source.examples();
+    bool first = !b;
+
+    size_t num_chunks = (nx + chunk_size - 1) / chunk_size;
+
+    // One set of sums per thread, added together in order at the end so
+    // that the result doesn't depend upon the scheduling
+    int num_blocks = std::min<size_t>(num_chunks, num_threads());
+    size_t chunks_per_block = (num_chunks + num_blocks - 1) / num_blocks;
+
+    vector<IRLS_Sums> block_sums(num_blocks, IRLS_Sums(nv, first));
+
+    auto doBlock = [&] (int block)
+        {
+            IRLS_Sums & sums = block_sums[block];
+            vector<double> x((size_t)chunk_size * nv);
+            distribution<double> y(chunk_size), w(chunk_size);
+
+            size_t c0 = block * chunks_per_block;
+            size_t c1 = std::min(num_chunks, c0 + chunks_per_block);
+
+            for (size_t c = c0;  c < c1;  ++c) {
+                size_t x0 = c * chunk_size;
+                int n = std::min<size_t>(chunk_size, nx - x0);
+
+                y.resize(n);
+                w.resize(n);
+                source.get(x0, n, &x[0], &y[0], &w[0]);
+
+                distribution<double> eta(n), mu;
+                if (first) {
+                    mu = (y + 0.5) / 2;
+                    eta = link.forward(mu);
+                    sums.ysqr += (y * y).total();
+                    accum_outer_products(&sums.xTx[0], nv, &x[0], 0, n);
+                }
+                else {
+                    for (unsigned r = 0;  r < n;  ++r)
+                        eta[r] = SIMD::vec_dotprod_dp(&x[(size_t)r * nv],
+                                                      &(*b)[0], nv);
+                    check_finite(eta, "eta");
+                    mu = link.inverse(eta);
+                    sums.deviance += dist.deviance(y, mu, w);
+                }
+                check_finite(mu, "mu");
+
+                distribution<double> deta_dmu = link.diff(mu);
+                check_finite(deta_dmu, "deta_dmu");
+                distribution<double> var = dist.variance(mu);
+                check_finite(var, "var");
+
+                distribution<double> fit_weights
+                    = w / (deta_dmu * deta_dmu * var);
+                check_finite(fit_weights, "fit_weights");
+
+                distribution<double> z = eta + (y - mu) * deta_dmu;
+
+                accum_outer_products(&sums.xTwx[0], nv, &x[0],
+                                     &fit_weights[0], n);
+                for (unsigned r = 0;  r < n;  ++r)
+                    SIMD::vec_add(&sums.xTwz[0], fit_weights[r] * z[r],
+                                  &x[(size_t)r * nv], &sums.xTwz[0], nv);
+            }
+        };
+
+    run_in_parallel_blocked(0, num_blocks, doBlock);
+
+    IRLS_Sums result(nv, first);
+    for (unsigned i = 0;  i < num_blocks;  ++i)
+        result.add(block_sums[i]);
+
+    return result;
+}
+
+/** Find the linearly independent variables from the lower triangle of
+    the (nv x nv) matrix X^T X.  A Cholesky factorization that always pivots on the largest
+    remaining diagonal element gives the same R factor as the column pivoted
+    QR factorization of X, so the same variables as in perform_irls_impl()
+    are kept (those with |R_kk| >= tolerance).  Returns the new location of
+    each variable, or -1 if it was removed. */
+vector<int>
+independent_variables(const distribution<double> & xTx, int nv,
+                      double tolerance)
+{
+    boost::multi_array<double, 2> G(boost::extents[nv][nv]);
+    for (unsigned i = 0;  i < nv;  ++i)
+        for (unsigned j = 0;  j <= i;  ++j)
+            G[i][j] = G[j][i] = xTx[i * nv + j];
+
+    vector<int> perm(nv);
+    for (unsigned i = 0;  i < nv;  ++i)
+        perm[i] = i;
+
+    vector<int> new_loc(nv, -1);
+
+    for (unsigned k = 0;  k < nv;  ++k) {
+        int p = k;
+        for (unsigned i = k + 1;  i < nv;  ++i)
+            if (G[i][i] > G[p][p]) p = i;
+
+        if (G[p][p] < tolerance * tolerance) break;
+
+        if (p != k) {
+            for (unsigned i = 0;  i < nv;  ++i)
+                std::swap(G[k][i], G[p][i]);
+            for (unsigned i = 0;  i < nv;  ++i)
+                std::swap(G[i][k], G[i][p]);
+            std::swap(perm[k], perm[p]);
+        }
+
+        new_loc[perm[k]] = k;
+
+        // Update the trailing part with the Schur complement
+        double r = sqrt(G[k][k]);
+        for (unsigned i = k + 1;  i < nv;  ++i)
+            G[i][k] /= r;
+        for (unsigned i = k + 1;  i < nv;  ++i) {
+            for (unsigned j = k + 1;  j <= i;  ++j) {
+                G[i][j] -= G[i][k] * G[j][k];
+                G[j][i] = G[i][j];
+            }
+        }
+    }
+
+    return new_loc;
+}
+
+/** Solve the symmetric positive definite system A x = b using a Cholesky
+    factorization, or by least squares if A turns out not to be positive
+    definite. */
+distribution<double>
+solve_normal_equations(const boost::multi_array<double, 2> & A,
+                       const distribution<double> & b)
+{
+    int n = b.size();
+    boost::multi_array<double, 2> R = A;
+
+    // A is symmetric, so the layout doesn't matter.  The output is upper
+    // triangular in column major order, ie R[j][i] = R_ij for i <= j.
+    int res = LAPack::potrf('U', n, R.data(), n);
+    if (res != 0)
+        return least_squares(A, b);
+
+    // Solve R^T y = b, then R x = y
+    distribution<double> x = b;
+    for (unsigned i = 0;  i < n;  ++i) {
+        double v = x[i];
+        for (unsigned j = 0;  j < i;  ++j)
+            v -= R[i][j] * x[j];
+        x[i] = v / R[i][i];
+    }
+    for (int i = n - 1;  i >= 0;  --i) {
+        double v = x[i];
+        for (unsigned j = i + 1;  j < n;  ++j)
+            v -= R[j][i] * x[j];
+        x[i] = v / R[i][i];
+    }
+
+    return x;
+}
+
+template<class Link, class Dist>
+distribution<double>
+irls_streaming(const IRLS_Example_Source & source,
+               const Link & link, const Dist & dist,
+               bool ridge_regression, int chunk_size)
+{
+    static const int max_iter = 20;           // from GLMlab
+    static const float tolerence = 5e-5;      // from GLMlab
+
+    int nv = source.variables();
+
+    if (chunk_size < 1)
+        throw Exception("perform_irls_streaming(): invalid chunk size");
+
+    distribution<double> b(nv, 0.0);
+    if (source.examples() == 0) return b;
+
+    IRLS_Sums sums = irls_pass(source, 0, link, dist, chunk_size);
+
+    vector<int> new_loc = independent_variables(sums.xTx, nv, 0.01);
+    vector<int> keep;
+    for (unsigned v = 0;  v < nv;  ++v)
+        if (new_loc[v] != -1) keep.push_back(v);
+    int nkeep = keep.size();
+
+    double rdev = sqrt(sums.ysqr), rdev2 = 0.0;
+
+    for (int iter = 0;  abs(rdev - rdev2) > tolerence && iter < max_iter;
+         ++iter) {
+
+        // Solve the reweighted problem over the independent variables
+        boost::multi_array<double, 2> A(boost::extents[nkeep][nkeep]);
+        distribution<double> rhs(nkeep);
+        for (unsigned i = 0;  i < nkeep;  ++i) {
+            rhs[i] = sums.xTwz[keep[i]];
+            for (unsigned j = 0;  j <= i;  ++j)
+                A[i][j] = A[j][i] = sums.xTwx[keep[i] * nv + keep[j]];
+        }
+
+        if (ridge_regression && nkeep > 0) {
+            double mean_diag = 0.0;
+            for (unsigned i = 0;  i < nkeep;  ++i)
+                mean_diag += A[i][i] / nkeep;
+            for (unsigned i = 0;  i < nkeep;  ++i)
+                A[i][i] += 1e-5 * mean_diag;
+        }
+
+        distribution<double> trained = solve_normal_equations(A, rhs);
+
+        for (unsigned i = 0;  i < nkeep;  ++i)
+            b[keep[i]] = trained[i];
+
+        sums = irls_pass(source, &b, link, dist, chunk_size);
+
+        rdev2 = rdev;
+        rdev = sums.deviance;
+    }
+
+    return b;
+}
+
+} // file scope
+
+distribution<double>
+perform_irls_streaming(const IRLS_Example_Source & source,
+                       Link_Function link_function,
+                       bool ridge_regression,
+                       int chunk_size)
+{
+    switch (link_function) {
+
+    case LOGIT:
+        return irls_streaming(source, Logit_Link<double>(),
+                              Binomial_Dist<double>(), ridge_regression,
+                              chunk_size);
+
+    case LOG:
+        return irls_streaming(source, Logarithm_Link<double>(),
+                              Binomial_Dist<double>(), ridge_regression,
+                              chunk_size);
+
+    case LINEAR:
+        return irls_streaming(source, Linear_Link<double>(),
+                              Normal_Dist<double>(), ridge_regression,
+                              chunk_size);
+
+    case PROBIT:
+        return irls_streaming(source, Probit_Link<double>(),
+                              Binomial_Dist<double>(), ridge_regression,
+                              chunk_size);
+
+    case COMP_LOG_LOG:
+        return irls_streaming(source, Comp_Log_Log_Link<double>(),
+                              Binomial_Dist<double>(), ridge_regression,
+                              chunk_size);
+
+    default:
+        throw Exception(format("perform_irls_streaming(): function %d "
+                               "not implemented", link_function));
+    }
+}
+
 distribution<double>
 irls_logit(const distribution<double> & correct,
            const boost::multi_array<double, 2> & outputs,
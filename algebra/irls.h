@@ -276,6 +276,92 @@ perform_irls(const distribution<double> & correct,
              bool ridge_regression = true);
 
 
+/*****************************************************************************/
+/* STREAMING IRLS                                                            */
+/*****************************************************************************/
+
+/** A chunk of examples whose variables are mostly zero.  Example i has
+    the values values[offsets[i]] ... values[offsets[i + 1] - 1] for the
+    variables with the same entries of indexes, and zero for the others,
+    plus the baseline of the source that it came from.
+*/
+struct IRLS_Sparse_Rows {
+    std::vector<int> indexes;
+    std::vector<double> values;
+    std::vector<size_t> offsets;
+    std::vector<double> y;       ///< Target value of each example
+    std::vector<double> w;       ///< Weight of each example
+
+    size_t size() const { return y.size(); }
+
+    void clear()
+    {
+        indexes.clear();
+        values.clear();
+        offsets.assign(1, 0);
+        y.clear();
+        w.clear();
+    }
+};
+
+/** Provides the examples for perform_irls_streaming(), so that the whole
+    matrix of variables never needs to be in memory at once.  The examples
+    are asked for in chunks, from several threads at once.
+*/
+struct IRLS_Example_Source {
+    virtual ~IRLS_Example_Source();
+
+    /** Number of variables (including any bias). */
+    virtual int variables() const = 0;
+
+    /** Number of examples. */
+    virtual size_t examples() const = 0;
+
+    /** Fill in the values of the variables (as an (n x variables()) row
+        major matrix), the target values and the weights of the examples
+        from first to first + n - 1. */
+    virtual void get(size_t first, size_t n,
+                     double * x, double * y, double * w) const = 0;
+
+    /** Replace the contents of rows with the examples from first to
+        first + n - 1, less the baseline.  The default asks for them one at
+        a time with get() and keeps the non-zero values; sources whose
+        examples are sparse should do better. */
+    virtual void get_sparse(size_t first, size_t n,
+                            IRLS_Sparse_Rows & rows) const;
+
+    /** Values that are added to the variables of every example from
+        get_sparse(), for when they are shifted (for example by centering)
+        so that they're no longer sparse.  Empty (the default) if there are
+        none. */
+    virtual distribution<double> baseline() const;
+};
+
+/** Same as perform_irls(), but the examples are read in parallel passes
+    over chunks of chunk_size examples and only \f$X^T W X\f$ and
+    \f$X^T W \mathbf{z}\f$ are accumulated, so memory use is O(nv^2) per
+    thread no matter how many examples there are.
+
+    The linearly dependent variables are found from \f$X^T X\f$ on the first
+    pass, using a pivoted Cholesky factorization that selects the same
+    variables as the pivoted QR of perform_irls(); their parameters are
+    zero.  The normal equations are solved with a Cholesky factorization,
+    falling back to least squares if they aren't positive definite.
+
+    Each iteration is one pass, plus one at the end to calculate the final
+    deviance.  Unlike perform_irls(), a linear link with uniform weights is
+    solved with the normal equations rather than directly, and
+    ridge_regression adds a fixed ridge of 1e-5 times the mean of the
+    diagonal of \f$X^T W X\f$ rather than choosing it by cross validation
+    (which needs the individual examples).
+*/
+distribution<double>
+perform_irls_streaming(const IRLS_Example_Source & source,
+                       Link_Function link_function,
+                       bool ridge_regression = true,
+                       int chunk_size = 4096);
+
+
 } // namespace ML
 
 
@@ -600,53 +600,10 @@ diag_mult(const boost::multi_array<Float, 2> & XT,
     size_t nx = XT.shape()[1];
     size_t nv = XT.shape()[0];
 
-    //cerr << "nx = " << nx << " nv = " << nv << endl;
-
     boost::multi_array<Float, 2> result(boost::extents[nv][nv]);
 
-    if (false) {
-        int chunk_size = 2048;  // ensure we fit in the cache
-        distribution<Float> Xid(chunk_size);
-
-        int x = 0;
-        while (x < nx) {
-            int nxc = std::min<size_t>(chunk_size, nx - x);
-
-            for (unsigned i = 0;  i < nv;  ++i) {
-                SIMD::vec_prod(&XT[i][x], &d[x], &Xid[0], nxc);
-            
-                for (unsigned j = 0;  j < nv;  ++j) {
-                    result[i][j] += SIMD::vec_dotprod_dp(&XT[j][x], &Xid[0], nxc);
-                    //result[i][j] += SIMD::vec_accum_prod3(&XT[i][x], &XT[j][x],
-                    //                                      &d[x], nxc);
-                    //for (unsigned x = 0;  x < nx;  ++x)
-                    //result[i][j] += XT[i][x] * XT[j][x] * d[x];
-                }
-            }
-
-            x += nxc;
-        }
-    } else {
-        auto doRow = [&] (int i)
-            {
-                int chunk_size = 2048;  // ensure we fit in the cache
-
-                int x = 0;
-                while (x < nx) {
-                    int nxc = std::min<size_t>(chunk_size, nx - x);
-                    distribution<Float> Xid(chunk_size);
-                    SIMD::vec_prod(&XT[i][x], &d[x], &Xid[0], nxc);
-            
-                    for (unsigned j = 0;  j < nv;  ++j) {
-                        result[i][j] += SIMD::vec_dotprod_dp(&XT[j][x], &Xid[0], nxc);
-                    }
-
-                    x += nxc;
-                }
-            };
-        
-        run_in_parallel_blocked(0, nv, doRow);
-    }
+    // The result is symmetric, so only half of it needs to be calculated
+    multiply_transposed_blocked(result, XT, XT, &d[0], true /* symmetric */);
 
     return result;
 }
@@ -681,9 +638,15 @@ diag_mult(const boost::multi_array<Float, 2> & X,
     size_t nv = X.shape()[0];
 
     distribution<Float> result(nv, 0.0);
-    for (unsigned v = 0;  v < nv;  ++v)
-        for (unsigned x = 0;  x < nx;  ++x)
-            result[v] += X[v][x] * d[x] * y[x];
+    if (nx == 0) return result;
+
+    auto doRows = [&] (int v0, int v1)
+        {
+            for (int v = v0;  v < v1;  ++v)
+                result[v] = SIMD::vec_accum_prod3(&X[v][0], &d[0], &y[0], nx);
+        };
+
+    run_in_blocks(nv, 3 * nx, doRows);
 
     return result;
 }
@@ -21,9 +21,36 @@
 */
 
 #include "matrix_ops.h"
+#include "jml/utils/worker_task.h"
 
 
-namespace Math {
+namespace ML {
 
-} // namespace Math
+void run_in_blocks(int n, double work_per_item,
+                   const boost::function<void (int, int)> & fn)
+{
+    if (n <= 0) return;
+
+    // Below this, the overhead of farming out the work is too high
+    static const double MIN_PARALLEL_WORK = 1000000.0;
+
+    if (n == 1 || n * work_per_item < MIN_PARALLEL_WORK) {
+        fn(0, n);
+        return;
+    }
+
+    // A few blocks per thread to even out the load
+    int num_blocks = std::min(n, num_threads() * 4);
+    int block_size = (n + num_blocks - 1) / num_blocks;
+    num_blocks = (n + block_size - 1) / block_size;
+
+    auto doBlock = [&] (int b)
+        {
+            fn(b * block_size, std::min(n, (b + 1) * block_size));
+        };
+
+    run_in_parallel_blocked(0, num_blocks, doBlock);
+}
+
+} // namespace ML
 
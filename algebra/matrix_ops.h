@@ -32,6 +32,7 @@
 #include "jml/arch/simd_vector.h"
 #include "jml/utils/string_functions.h"
 #include "jml/arch/cache.h"
+#include <boost/function.hpp>
 
 namespace boost {
 
@@ -52,13 +53,22 @@ operator << (std::ostream & stream, const boost::multi_array<Float, 2> & m)
 
 namespace ML {
 
-// Copy a chunk of a matrix transposed to another place
+/** Call fn(i0, i1) over a set of blocks that together cover [0, n).  The
+    blocks are run in parallel on the worker task if the total amount of
+    work, given as the approximate number of floating point operations per
+    item, is big enough to make it worthwhile; otherwise fn(0, n) is called
+    directly.  Used by all of the kernels below. */
+void run_in_blocks(int n, double work_per_item,
+                   const boost::function<void (int, int)> & fn);
+
+// Copy a chunk of a matrix transposed to another place, without using any
+// other threads
 template<typename Float>
-void copy_transposed(boost::multi_array<Float, 2> & A,
-                     int i0, int i1, int j0, int j1)
+void copy_transposed_serial(boost::multi_array<Float, 2> & A,
+                            int i0, int i1, int j0, int j1)
 {
     // How much cache will be needed to hold the input data?
-    size_t mem = (i1 - i0) * (j1 - j0) * sizeof(float);
+    size_t mem = (i1 - i0) * (j1 - j0) * sizeof(Float);
 
     // Fits in memory (with some allowance for loss): copy directly
     if (mem * 4 / 3 < l1_cache_size) {
@@ -80,10 +90,24 @@ void copy_transposed(boost::multi_array<Float, 2> & A,
 
     // TODO: try to ensure a power of 2
 
-    copy_transposed(A, i0, spliti, j0, splitj);
-    copy_transposed(A, i0, spliti, splitj, j1);
-    copy_transposed(A, spliti, i1, j0, splitj);
-    copy_transposed(A, spliti, i1, splitj, j1);
+    copy_transposed_serial(A, i0, spliti, j0, splitj);
+    copy_transposed_serial(A, i0, spliti, splitj, j1);
+    copy_transposed_serial(A, spliti, i1, j0, splitj);
+    copy_transposed_serial(A, spliti, i1, splitj, j1);
+}
+
+// Copy a chunk of a matrix transposed to another place.  The source and the
+// destination can't overlap, so strips of rows can be done in parallel.
+template<typename Float>
+void copy_transposed(boost::multi_array<Float, 2> & A,
+                     int i0, int i1, int j0, int j1)
+{
+    auto doStrip = [&] (int s0, int s1)
+        {
+            copy_transposed_serial(A, i0 + s0, i0 + s1, j0, j1);
+        };
+
+    run_in_blocks(i1 - i0, j1 - j0, doStrip);
 }
 
 // Copy everything above the diagonal below the diagonal of the given part
@@ -97,7 +121,7 @@ void copy_lower_to_upper(boost::multi_array<Float, 2> & A,
     int j1 = i1;
 
     // How much cache will be needed to hold the input data?
-    size_t mem = (i1 - i0) * (j1 - j0) * sizeof(float) / 2;
+    size_t mem = (i1 - i0) * (j1 - j0) * sizeof(Float) / 2;
 
     // Fits in memory (with some allowance for loss): copy directly
     if (mem * 4 / 3 < l1_cache_size) {
@@ -150,10 +174,27 @@ template<typename Float>
 boost::multi_array<Float, 2>
 transpose(const boost::multi_array<Float, 2> & A)
 {
-    boost::multi_array<Float, 2> X(boost::extents[A.shape()[1]][A.shape()[0]]);
-    for (unsigned i = 0;  i < A.shape()[0];  ++i)
-        for (unsigned j = 0;  j < A.shape()[1];  ++j)
-            X[j][i] = A[i][j];
+    int m = A.shape()[0], n = A.shape()[1];
+    boost::multi_array<Float, 2> X(boost::extents[n][m]);
+
+    // Square tiles so that both the reads and the writes stay in the cache
+    enum { TILE = 32 };
+
+    auto doTiles = [&] (int t0, int t1)
+        {
+            for (int i0 = t0 * TILE;  i0 < std::min(m, t1 * TILE);  i0 += TILE) {
+                int i1 = std::min(m, i0 + TILE);
+                for (int j0 = 0;  j0 < n;  j0 += TILE) {
+                    int j1 = std::min(n, j0 + TILE);
+                    for (int i = i0;  i < i1;  ++i)
+                        for (int j = j0;  j < j1;  ++j)
+                            X[j][i] = A[i][j];
+                }
+            }
+        };
+
+    run_in_blocks((m + TILE - 1) / TILE, (double)TILE * n, doTiles);
+
     return X;
 }
 
@@ -174,6 +215,91 @@ std::string print_size(const boost::multi_array<Float, 2> & array)
 }
 
 
+/*****************************************************************************/
+/* BLOCKED KERNEL                                                            */
+/*****************************************************************************/
+
+/** Calculates X = A diag(d) BT^T, ie X[i][j] = sum_k A[i][k] d[k] BT[j][k],
+    which underlies all of the matrix-matrix products.  d may be null, in
+    which case it's taken to be all ones.  If symmetric is true, the result
+    is known to be symmetric and only the lower triangle is calculated.
+
+    X is split into tiles of ROWS x COLS, which are shared between threads.
+    Within a tile the rows are done DEPTH values at a time, so that the
+    rows of A and BT for the tile stay in the cache while they are reused;
+    the sums are accumulated in double precision.
+*/
+template<typename FloatR, typename Float1, typename Float2>
+void multiply_transposed_blocked(boost::multi_array<FloatR, 2> & X,
+                                 const boost::multi_array<Float1, 2> & A,
+                                 const boost::multi_array<Float2, 2> & BT,
+                                 const Float1 * d = 0,
+                                 bool symmetric = false)
+{
+    int m = A.shape()[0], n = BT.shape()[0], k = A.shape()[1];
+
+    if (BT.shape()[1] != k)
+        throw ML::Exception("Incompatible matrix sizes");
+    if (X.shape()[0] != m || X.shape()[1] != n)
+        throw ML::Exception("multiply_transposed_blocked(): result has "
+                            "wrong shape");
+    if (symmetric && m != n)
+        throw ML::Exception("multiply_transposed_blocked(): symmetric result "
+                            "must be square");
+
+    enum { ROWS = 16, COLS = 64, DEPTH = 512 };
+
+    int row_tiles = (m + ROWS - 1) / ROWS;
+    int col_tiles = (n + COLS - 1) / COLS;
+
+    auto doTiles = [&] (int t0, int t1)
+        {
+            double accum[ROWS][COLS];
+            std::vector<Float1> scaled(d ? ROWS * DEPTH : 0);
+
+            for (int t = t0;  t < t1;  ++t) {
+                int i0 = (t / col_tiles) * ROWS, i1 = std::min(m, i0 + ROWS);
+                int j0 = (t % col_tiles) * COLS, j1 = std::min(n, j0 + COLS);
+
+                // Entirely above the diagonal
+                if (symmetric && j0 >= i1) continue;
+
+                for (int i = 0;  i < ROWS;  ++i)
+                    std::fill(accum[i], accum[i] + COLS, 0.0);
+
+                for (int k0 = 0;  k0 < k;  k0 += DEPTH) {
+                    int kc = std::min<int>(DEPTH, k - k0);
+
+                    for (int i = i0;  i < i1;  ++i) {
+                        const Float1 * Ai = &A[i][k0];
+                        if (d) {
+                            Float1 * s = &scaled[(i - i0) * DEPTH];
+                            SIMD::vec_prod(Ai, d + k0, s, kc);
+                            Ai = s;
+                        }
+
+                        int jend = symmetric ? std::min(j1, i + 1) : j1;
+                        double * acc = accum[i - i0] - j0;
+                        for (int j = j0;  j < jend;  ++j)
+                            acc[j] += SIMD::vec_dotprod_dp(Ai, &BT[j][k0], kc);
+                    }
+                }
+
+                for (int i = i0;  i < i1;  ++i) {
+                    int jend = symmetric ? std::min(j1, i + 1) : j1;
+                    for (int j = j0;  j < jend;  ++j) {
+                        X[i][j] = accum[i - i0][j - j0];
+                        // Nobody else writes above the diagonal
+                        if (symmetric) X[j][i] = X[i][j];
+                    }
+                }
+            }
+        };
+
+    run_in_blocks(row_tiles * col_tiles, (double)ROWS * COLS * k, doTiles);
+}
+
+
 /*****************************************************************************/
 /* MATRIX VECTOR                                                             */
 /*****************************************************************************/
@@ -285,19 +411,12 @@ multiply_r(const boost::multi_array<Float1, 2> & A,
         throw ML::Exception("Incompatible matrix sizes");
 
     boost::multi_array<FloatR, 2> X(boost::extents[A.shape()[0]][B.shape()[1]]);
-    Float2 bentries[A.shape()[1]];
-    for (unsigned j = 0;  j < B.shape()[1];  ++j) {
-        for (unsigned k = 0;  k < A.shape()[1];  ++k)
-            bentries[k] = B[k][j];
-
-        for (unsigned i = 0;  i < A.shape()[0];  ++i)
-            X[i][j] = SIMD::vec_dotprod_dp(&A[i][0], bentries, A.shape()[1]);
 
-        //for (unsigned i = 0;  i < A.shape()[0];  ++i)
-        //    for (unsigned k = 0;  k < A.shape()[1];  ++k)
-        //        X[i][j] += A[i][k] * B[k][j];
+    // Transposing B first makes everything unit stride, and costs much less
+    // than the product
+    boost::multi_array<Float2, 2> BT = transpose(B);
+    multiply_transposed_blocked(X, A, BT);
 
-    }
     return X;
 }
 
@@ -331,13 +450,9 @@ boost::multi_array<FloatR, 2>
 multiply_transposed(const boost::multi_array<Float, 2> & A)
 {
     int As0 = A.shape()[0];
-    int As1 = A.shape()[1];
 
     boost::multi_array<FloatR, 2> X(boost::extents[As0][As0]);
-    for (unsigned i = 0;  i < As0;  ++i) 
-        for (unsigned j = 0;  j <= i;  ++j)
-            X[i][j] = X[j][i] = SIMD::vec_dotprod_dp(&A[i][0], &A[j][0], As1);
-    
+    multiply_transposed_blocked(X, A, A, (const Float *)0, true /* symmetric */);
     return X;
 }
 
@@ -348,17 +463,12 @@ multiply_transposed(const boost::multi_array<Float1, 2> & A,
 {
     int As0 = A.shape()[0];
     int Bs0 = BT.shape()[0];
-    int As1 = A.shape()[1];
 
     if (A.shape()[1] != BT.shape()[1])
         throw ML::Exception("Incompatible matrix sizes");
 
     boost::multi_array<FloatR, 2> X(boost::extents[As0][Bs0]);
-    for (unsigned j = 0;  j < Bs0;  ++j) {
-        for (unsigned i = 0;  i < As0;  ++i)
-            X[i][j] = SIMD::vec_dotprod_dp(&A[i][0], &BT[j][0], As1);
-    }
-
+    multiply_transposed_blocked(X, A, BT);
     return X;
 }
 
@@ -391,8 +501,13 @@ add_r(const boost::multi_array<Float1, 2> & A,
     
     boost::multi_array<FloatR, 2> X(boost::extents[A.shape()[0]][A.shape()[1]]);
 
-    for (unsigned i = 0;  i < A.shape()[0];  ++i)
-        SIMD::vec_add(&A[i][0], &B[i][0], &X[i][0], A.shape()[1]);
+    auto doRows = [&] (int i0, int i1)
+        {
+            for (int i = i0;  i < i1;  ++i)
+                SIMD::vec_add(&A[i][0], &B[i][0], &X[i][0], A.shape()[1]);
+        };
+
+    run_in_blocks(A.shape()[0], A.shape()[1], doRows);
 
     return X;
 }
@@ -433,8 +548,13 @@ subtract_r(const boost::multi_array<Float1, 2> & A,
     
     boost::multi_array<FloatR, 2> X(boost::extents[A.shape()[0]][A.shape()[1]]);
 
-    for (unsigned i = 0;  i < A.shape()[0];  ++i)
-        SIMD::vec_minus(&A[i][0], &B[i][0], &X[i][0], A.shape()[1]);
+    auto doRows = [&] (int i0, int i1)
+        {
+            for (int i = i0;  i < i1;  ++i)
+                SIMD::vec_minus(&A[i][0], &B[i][0], &X[i][0], A.shape()[1]);
+        };
+
+    run_in_blocks(A.shape()[0], A.shape()[1], doRows);
     
     return X;
 }
@@ -0,0 +1,388 @@
+/* randomized_svd.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Randomized truncated singular value decomposition.
+*/
+
+#include "randomized_svd.h"
+#include "lapack.h"
+#include "matrix_ops.h"
+#include "jml/arch/simd_vector.h"
+#include "jml/arch/exception.h"
+#include "jml/utils/string_functions.h"
+#include "jml/utils/worker_task.h"
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <boost/function.hpp>
+#include <cmath>
+
+
+using namespace std;
+
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* SVD_ROW_SOURCE                                                            */
+/*****************************************************************************/
+
+SVD_Row_Source::
+~SVD_Row_Source()
+{
+}
+
+
+/*****************************************************************************/
+/* RANDOMIZED_SVD                                                            */
+/*****************************************************************************/
+
+namespace {
+
+typedef boost::multi_array<double, 2> Matrix;
+
+/** Size of the strip of G used at once by Range_Accumulator::add_block.
+    About half of a typical L2 cache. */
+enum { G_STRIP_BYTES = 128 * 1024 };
+
+typedef boost::variate_generator<boost::mt19937 &,
+                                 boost::normal_distribution<double> >
+    Gaussian;
+
+/** Make the columns of A orthonormal, using modified Gram-Schmidt twice
+    (which is enough to get orthogonality to machine precision).  Columns
+    that are linearly dependent on the previous ones are replaced by random
+    directions. */
+void orthonormalize_columns(Matrix & A, Gaussian & randn)
+{
+    int n = A.shape()[0], l = A.shape()[1];
+
+    for (unsigned j = 0;  j < l;  ++j) {
+        double norm_before = 0.0;
+        for (unsigned i = 0;  i < n;  ++i)
+            norm_before += A[i][j] * A[i][j];
+        norm_before = sqrt(norm_before);
+
+        for (unsigned attempt = 0;  ;  ++attempt) {
+            for (unsigned pass = 0;  pass < 2;  ++pass) {
+                for (unsigned k = 0;  k < j;  ++k) {
+                    double dot = 0.0;
+                    for (unsigned i = 0;  i < n;  ++i)
+                        dot += A[i][k] * A[i][j];
+                    for (unsigned i = 0;  i < n;  ++i)
+                        A[i][j] -= dot * A[i][k];
+                }
+            }
+
+            double norm = 0.0;
+            for (unsigned i = 0;  i < n;  ++i)
+                norm += A[i][j] * A[i][j];
+            norm = sqrt(norm);
+
+            if (norm > 1e-10 * norm_before && norm > 0.0) {
+                for (unsigned i = 0;  i < n;  ++i)
+                    A[i][j] /= norm;
+                break;
+            }
+
+            if (attempt == 10)
+                throw Exception("randomized_svd: couldn't orthonormalize");
+
+            // Linearly dependent; try a random direction instead
+            for (unsigned i = 0;  i < n;  ++i)
+                A[i][j] = randn();
+            norm_before = sqrt((double)n);
+        }
+    }
+}
+
+/** Accumulates, over blocks of the rows of A, the values needed to
+    orthonormalize Y = A G and project A onto it:
+
+        C = A^T Y      (n x l)
+        W = Y^T Y      (l x l)
+
+    The rows of Y are never stored, so memory use doesn't depend on the
+    number of rows of A.
+*/
+struct Range_Accumulator {
+    Range_Accumulator(const Matrix & G)
+        : G(G), n(G.shape()[0]), l(G.shape()[1]),
+          C(boost::extents[n][l]), W(boost::extents[l][l]), rows(0)
+    {
+    }
+
+    const Matrix & G;
+    int n, l;
+    Matrix C;
+    Matrix W;
+    size_t rows;
+    Matrix Y;   ///< Y for the current block; kept to avoid reallocation
+
+    /** Add the nr rows (each of them n wide) starting at A. */
+    template<typename Float>
+    void add_block(const Float * A, size_t nr)
+    {
+        if (Y.shape()[0] < nr)
+            Y.resize(boost::extents[nr][l]);
+        std::fill(Y.data(), Y.data() + nr * l, 0.0);
+
+        // G is used a strip of rows at a time, small enough to stay in the
+        // cache while it's reused for each row of A, which skips its zeros
+        int strip = std::max(1, int(G_STRIP_BYTES / (l * sizeof(double))));
+
+        // Y = A G, over the rows of the block
+        auto doRows = [&] (int r0, int r1)
+            {
+                for (int j0 = 0;  j0 < n;  j0 += strip) {
+                    int j1 = std::min(n, j0 + strip);
+                    for (int r = r0;  r < r1;  ++r) {
+                        const Float * row = A + (size_t)r * n;
+                        double * y = &Y[r][0];
+                        for (int j = j0;  j < j1;  ++j)
+                            if (row[j] != 0.0)
+                                SIMD::vec_add(y, (double)row[j], &G[j][0],
+                                              y, l);
+                    }
+                }
+            };
+
+        run_in_blocks(nr, (double)n * l, doRows);
+
+        // C += A^T Y, over the rows of C so that there are no conflicts.
+        // C is done a strip of rows at a time like G above, with A read
+        // along its rows rather than down its columns.
+        auto doColumns = [&] (int j0, int j1)
+            {
+                for (int s0 = j0;  s0 < j1;  s0 += strip) {
+                    int s1 = std::min(j1, s0 + strip);
+                    for (unsigned r = 0;  r < nr;  ++r) {
+                        const Float * row = A + (size_t)r * n;
+                        const double * y = &Y[r][0];
+                        for (int j = s0;  j < s1;  ++j)
+                            if (row[j] != 0.0)
+                                SIMD::vec_add(&C[j][0], (double)row[j], y,
+                                              &C[j][0], l);
+                    }
+                }
+            };
+
+        run_in_blocks(n, (double)nr * l, doColumns);
+
+        // W += Y^T Y
+        auto doGram = [&] (int i)
+            {
+                double * w = &W[i][0];
+                for (unsigned r = 0;  r < nr;  ++r)
+                    SIMD::vec_add(w, Y[r][i], &Y[r][0], w, l);
+            };
+
+        run_in_parallel_blocked(0, l, doGram);
+
+        rows += nr;
+    }
+};
+
+/** The result of the decomposition, in a form that can be applied to a
+    matrix of any size.  A = U diag(E) V^T, where U = A M. */
+struct Factorization {
+    distribution<double> E;
+    Matrix V;   ///< (n x k)
+    Matrix M;   ///< (n x k)
+};
+
+/** Finish off the decomposition from the accumulated values.  The
+    orthonormal basis of the range of A is Q = Y R^-1, where R^T R = W is
+    the Cholesky factorization.  A is then approximated by Q B, where
+    B^T = A^T Q = C R^-1 is small enough to decompose directly. */
+Factorization finish(const Range_Accumulator & acc, int k)
+{
+    const Matrix & G = acc.G;
+    int n = acc.n, l = acc.l;
+
+    // Cholesky factorization of W, with a tiny ridge in case A has a lower
+    // rank than l.  W is symmetric so the layout doesn't matter on input;
+    // the output is the upper triangular R in column major order, ie
+    // R[i][j] = WR[j][i] for i <= j.
+    Matrix WR = acc.W;
+    double trace = 0.0;
+    for (unsigned i = 0;  i < l;  ++i)
+        trace += WR[i][i];
+    double ridge = std::max(trace * 1e-12, 1e-300);
+    for (unsigned i = 0;  i < l;  ++i)
+        WR[i][i] += ridge;
+
+    int res = LAPack::potrf('U', l, WR.data(), l);
+    if (res != 0)
+        throw Exception(format("randomized_svd: potrf returned %d", res));
+
+    // Solve x R = b for the row vector x, in place
+    auto solve = [&] (double * x)
+        {
+            for (unsigned j = 0;  j < l;  ++j) {
+                double v = x[j];
+                for (unsigned i = 0;  i < j;  ++i)
+                    v -= x[i] * WR[j][i];
+                x[j] = v / WR[j][j];
+            }
+        };
+
+    // B^T = C R^-1.  In column major order, this is the (l x n) matrix B.
+    Matrix Bt = acc.C;
+    for (unsigned j = 0;  j < n;  ++j)
+        solve(&Bt[j][0]);
+
+    distribution<double> S(l);
+    Matrix Ub(boost::extents[l][l]);   // column major: Ub[c][i] = U_b(i, c)
+    Matrix Vb(boost::extents[n][l]);   // column major V_b^T, ie V_b
+
+    res = LAPack::gesdd("S", l, n, Bt.data(), l, &S[0],
+                        Ub.data(), l, Vb.data(), l);
+    if (res != 0)
+        throw Exception(format("randomized_svd: gesdd returned %d", res));
+
+    Factorization result;
+    result.E = distribution<double>(S.begin(), S.begin() + k);
+    result.V.resize(boost::extents[n][k]);
+    result.M.resize(boost::extents[n][k]);
+
+    // A = Q B = (Y R^-1 U_b) S V_b^T, so M = G R^-1 U_b
+    distribution<double> x(l);
+    for (unsigned j = 0;  j < n;  ++j) {
+        for (unsigned c = 0;  c < k;  ++c)
+            result.V[j][c] = Vb[j][c];
+
+        std::copy(&G[j][0], &G[j][0] + l, &x[0]);
+        solve(&x[0]);
+        for (unsigned c = 0;  c < k;  ++c)
+            result.M[j][c] = SIMD::vec_dotprod(&x[0], &Ub[c][0], l);
+    }
+
+    return result;
+}
+
+/** Perform the decomposition.  The pass function should add all of the rows
+    of A to the accumulator.  m is the number of rows of A, or -1 if it
+    isn't known. */
+Factorization
+randomized_svd_impl(ssize_t m, int n, int k,
+                    const Randomized_SVD_Params & params,
+                    const boost::function<void (Range_Accumulator &)> & pass)
+{
+    if (k < 0 || k > n || (m != -1 && k > m))
+        throw Exception(format("randomized_svd: can't calculate %d singular "
+                               "values of a matrix with %d columns", k, n));
+
+    int l = std::min(n, k + std::max(params.oversample, 0));
+    if (m != -1) l = std::min<ssize_t>(l, m);
+
+    boost::mt19937 rng(params.seed);
+    boost::normal_distribution<double> norm;
+    Gaussian randn(rng, norm);
+
+    Matrix G(boost::extents[n][l]);
+    for (unsigned i = 0;  i < n;  ++i)
+        for (unsigned j = 0;  j < l;  ++j)
+            G[i][j] = randn();
+    orthonormalize_columns(G, randn);
+
+    for (int iter = 0;  ;  ++iter) {
+        Range_Accumulator acc(G);
+        pass(acc);
+
+        if (m == -1 && k > acc.rows)
+            throw Exception(format("randomized_svd: can't calculate %d "
+                                   "singular values of a matrix with %zd "
+                                   "rows", k, acc.rows));
+
+        if (iter >= params.power_iterations)
+            return finish(acc, k);
+
+        // Subspace iteration: G = orth(A^T A G)
+        G = acc.C;
+        orthonormalize_columns(G, randn);
+    }
+}
+
+template<typename Float>
+boost::tuple<distribution<Float>, boost::multi_array<Float, 2>,
+             boost::multi_array<Float, 2> >
+randomized_svd_matrix(const boost::multi_array<Float, 2> & A, int k,
+                      const Randomized_SVD_Params & params)
+{
+    size_t m = A.shape()[0];
+    int n = A.shape()[1];
+    size_t block_size = std::max(params.block_size, 1);
+
+    auto pass = [&] (Range_Accumulator & acc)
+        {
+            for (size_t r = 0;  r < m;  r += block_size)
+                acc.add_block(&A[r][0], std::min(block_size, m - r));
+        };
+
+    Factorization f = randomized_svd_impl(m, n, k, params, pass);
+
+    distribution<Float> E(f.E.begin(), f.E.end());
+
+    boost::multi_array<Float, 2> V(boost::extents[n][k]);
+    std::copy(f.V.data(), f.V.data() + f.V.num_elements(), V.data());
+
+    // U = A M
+    boost::multi_array<Float, 2> U(boost::extents[m][k]);
+    auto doRow = [&] (int r)
+        {
+            double u[k];
+            std::fill(u, u + k, 0.0);
+            for (unsigned j = 0;  j < n;  ++j)
+                if (A[r][j] != 0.0)
+                    SIMD::vec_add(u, (double)A[r][j], &f.M[j][0], u, k);
+            std::copy(u, u + k, &U[r][0]);
+        };
+
+    run_in_parallel_blocked(0, (int)m, doRow);
+
+    return boost::make_tuple(E, U, V);
+}
+
+} // file scope
+
+boost::tuple<distribution<float>, boost::multi_array<float, 2>,
+             boost::multi_array<float, 2> >
+randomized_svd(const boost::multi_array<float, 2> & A, int k,
+               const Randomized_SVD_Params & params)
+{
+    return randomized_svd_matrix(A, k, params);
+}
+
+boost::tuple<distribution<double>, boost::multi_array<double, 2>,
+             boost::multi_array<double, 2> >
+randomized_svd(const boost::multi_array<double, 2> & A, int k,
+               const Randomized_SVD_Params & params)
+{
+    return randomized_svd_matrix(A, k, params);
+}
+
+std::pair<distribution<double>, boost::multi_array<double, 2> >
+randomized_svd(SVD_Row_Source & rows, int k,
+               const Randomized_SVD_Params & params)
+{
+    int n = rows.cols();
+    size_t block_size = std::max(params.block_size, 1);
+
+    vector<float> buffer(block_size * n);
+
+    auto pass = [&] (Range_Accumulator & acc)
+        {
+            rows.rewind();
+            while (size_t nr = rows.read(&buffer[0], block_size))
+                acc.add_block(&buffer[0], nr);
+        };
+
+    Factorization f = randomized_svd_impl(-1, n, k, params, pass);
+
+    return make_pair(f.E, f.V);
+}
+
+} // namespace ML
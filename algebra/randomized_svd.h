@@ -0,0 +1,117 @@
+/* randomized_svd.h                                                -*- C++ -*-
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Randomized truncated singular value decomposition.
+*/
+
+#ifndef __algebra__randomized_svd_h__
+#define __algebra__randomized_svd_h__
+
+
+#include "jml/stats/distribution.h"
+#include <boost/multi_array.hpp>
+#include <boost/tuple/tuple.hpp>
+#include <stdint.h>
+
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* RANDOMIZED_SVD_PARAMS                                                     */
+/*****************************************************************************/
+
+struct Randomized_SVD_Params {
+    Randomized_SVD_Params()
+        : oversample(10), power_iterations(2), block_size(4096), seed(1)
+    {
+    }
+
+    /// Number of extra directions in the random subspace over the number
+    /// of singular values wanted.  More gives better accuracy.
+    int oversample;
+
+    /// Number of subspace (power) iterations.  Each one costs another pass
+    /// over the matrix, but improves the accuracy a lot when the singular
+    /// values decay slowly.
+    int power_iterations;
+
+    /// Number of rows of the matrix processed at once
+    int block_size;
+
+    /// Seed for the random test matrix
+    uint32_t seed;
+};
+
+
+/*****************************************************************************/
+/* SVD_ROW_SOURCE                                                            */
+/*****************************************************************************/
+
+/** Provides the rows of a matrix which is too big to be held in memory,
+    for example by reading them from a file.  The matrix is read from
+    beginning to end power_iterations + 1 times.
+*/
+struct SVD_Row_Source {
+    virtual ~SVD_Row_Source();
+
+    /** Number of columns in the matrix. */
+    virtual int cols() const = 0;
+
+    /** Go back to the first row. */
+    virtual void rewind() = 0;
+
+    /** Read up to max_rows rows into the (max_rows x cols()) row major
+        buffer, returning the number that were read.  Zero means that there
+        are no more rows. */
+    virtual size_t read(float * rows, size_t max_rows) = 0;
+};
+
+
+/*****************************************************************************/
+/* RANDOMIZED_SVD                                                            */
+/*****************************************************************************/
+
+/** Calculates the first k singular values and vectors of the (m x n) matrix
+    A using the randomized range finder of
+
+    N. Halko, P.G. Martinsson, J.A. Tropp.  Finding structure with
+    randomness: probabilistic algorithms for constructing approximate matrix
+    decompositions.  SIAM Review 53(2):217-288, 2011.
+
+    with subspace iteration.  It takes O(mnk) time rather than O(mn^2) for
+    a full SVD, and the passes over A run in parallel.
+
+    \returns E      the k largest singular values, from highest to lowest
+    \returns U      the (m x k) matrix of left singular vectors
+    \returns V      the (n x k) matrix of right singular vectors
+
+    so that \f$A \approx U \Sigma V^T\f$.
+*/
+boost::tuple<distribution<float>, boost::multi_array<float, 2>,
+             boost::multi_array<float, 2> >
+randomized_svd(const boost::multi_array<float, 2> & A, int k,
+               const Randomized_SVD_Params & params
+                   = Randomized_SVD_Params());
+
+boost::tuple<distribution<double>, boost::multi_array<double, 2>,
+             boost::multi_array<double, 2> >
+randomized_svd(const boost::multi_array<double, 2> & A, int k,
+               const Randomized_SVD_Params & params
+                   = Randomized_SVD_Params());
+
+/** Same as above, but for a matrix whose rows are streamed from the given
+    source.  Only the singular values and the (n x k) right singular vectors
+    V are returned, as U has as many rows as the input; the left singular
+    vectors for a row a are given by \f$a V \Sigma^{-1}\f$.  Memory use is
+    O(nk) plus one block of rows.
+*/
+std::pair<distribution<double>, boost::multi_array<double, 2> >
+randomized_svd(SVD_Row_Source & rows, int k,
+               const Randomized_SVD_Params & params = Randomized_SVD_Params());
+
+} // namespace ML
+
+
+#endif /* __algebra__randomized_svd_h__ */
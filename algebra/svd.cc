@@ -6,9 +6,11 @@
    Singular value decomposition functions, implementation.
 */
 
+#include "svd.h"
+#include "randomized_svd.h"
+
 #if 0
 
-#include "svd.h"
 #include "eigenvalues.h"
 #include "jml/stats/distribution.h"
 #include "jml/stats/distribution_simd.h"
@@ -187,3 +189,29 @@ svd(const boost::multi_array<double, 2> & A, size_t nsv)
 } // namespace ML
 
 #endif
+
+
+namespace ML {
+
+/* The truncated versions are implemented with the randomized algorithm,
+   which is much faster when only a few singular values are needed. */
+
+boost::tuple<distribution<float>, boost::multi_array<float, 2>,
+             boost::multi_array<float, 2> >
+svd(const boost::multi_array<float, 2> & A, size_t nsv)
+{
+    Randomized_SVD_Params params;
+    params.power_iterations = 4;
+    return randomized_svd(A, nsv, params);
+}
+
+boost::tuple<distribution<double>, boost::multi_array<double, 2>,
+             boost::multi_array<double, 2> >
+svd(const boost::multi_array<double, 2> & A, size_t nsv)
+{
+    Randomized_SVD_Params params;
+    params.power_iterations = 4;
+    return randomized_svd(A, nsv, params);
+}
+
+} // namespace ML
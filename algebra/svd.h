@@ -75,7 +75,12 @@ boost::tuple<distribution<double>, boost::multi_array<double, 2>,
              boost::multi_array<double, 2> >
 svd(const boost::multi_array<double, 2> & A);
 
-/** Same as above, but calculates only the first \p n singular values.
+/** Same as above, but calculates only the first \p n singular values.  U has
+    a row for each row of A and V a row for each column of A, each with
+    \p n columns.  This uses randomized_svd() (in randomized_svd.h) with
+    four power iterations, which gives several significant figures for all
+    but the smallest of the values; call it directly for control over the
+    accuracy.
  */
 boost::tuple<distribution<float>, boost::multi_array<float, 2>,
              boost::multi_array<float, 2> >
@@ -0,0 +1,279 @@
+/* matrix_ops_test.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Test of the blocked matrix kernels against the simple loops that they
+   replaced, plus a benchmark of the two.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <iostream>
+
+#include "jml/algebra/matrix_ops.h"
+#include "jml/algebra/least_squares.h"
+#include "jml/arch/timers.h"
+
+using namespace ML;
+using namespace std;
+
+using boost::unit_test::test_suite;
+
+namespace {
+
+boost::mt19937 rng;
+
+template<typename Float>
+boost::multi_array<Float, 2>
+random_matrix(int m, int n)
+{
+    boost::uniform_real<double> dist(-1.0, 1.0);
+    boost::variate_generator<boost::mt19937 &, boost::uniform_real<double> >
+        rand(rng, dist);
+
+    boost::multi_array<Float, 2> A(boost::extents[m][n]);
+    for (unsigned i = 0;  i < m;  ++i)
+        for (unsigned j = 0;  j < n;  ++j)
+            A[i][j] = rand();
+    return A;
+}
+
+template<typename Float>
+distribution<Float>
+random_vector(int n)
+{
+    boost::uniform_real<double> dist(0.0, 1.0);
+    boost::variate_generator<boost::mt19937 &, boost::uniform_real<double> >
+        rand(rng, dist);
+
+    distribution<Float> result(n);
+    for (unsigned i = 0;  i < n;  ++i)
+        result[i] = rand();
+    return result;
+}
+
+/* The loops that were used before the blocked kernels. */
+
+template<typename FloatR, typename Float1, typename Float2>
+boost::multi_array<FloatR, 2>
+naive_multiply(const boost::multi_array<Float1, 2> & A,
+               const boost::multi_array<Float2, 2> & B)
+{
+    boost::multi_array<FloatR, 2> X(boost::extents[A.shape()[0]][B.shape()[1]]);
+    Float2 bentries[A.shape()[1]];
+    for (unsigned j = 0;  j < B.shape()[1];  ++j) {
+        for (unsigned k = 0;  k < A.shape()[1];  ++k)
+            bentries[k] = B[k][j];
+        for (unsigned i = 0;  i < A.shape()[0];  ++i)
+            X[i][j] = SIMD::vec_dotprod_dp(&A[i][0], bentries, A.shape()[1]);
+    }
+    return X;
+}
+
+template<typename Float>
+boost::multi_array<Float, 2>
+naive_diag_mult(const boost::multi_array<Float, 2> & XT,
+                const distribution<Float> & d)
+{
+    size_t nx = XT.shape()[1], nv = XT.shape()[0];
+    boost::multi_array<Float, 2> result(boost::extents[nv][nv]);
+
+    auto doRow = [&] (int i)
+        {
+            int chunk_size = 2048;
+
+            int x = 0;
+            while (x < nx) {
+                int nxc = std::min<size_t>(chunk_size, nx - x);
+                distribution<Float> Xid(chunk_size);
+                SIMD::vec_prod(&XT[i][x], &d[x], &Xid[0], nxc);
+                for (unsigned j = 0;  j < nv;  ++j)
+                    result[i][j] += SIMD::vec_dotprod_dp(&XT[j][x], &Xid[0], nxc);
+                x += nxc;
+            }
+        };
+
+    run_in_parallel_blocked(0, nv, doRow);
+
+    return result;
+}
+
+template<typename Float1, typename Float2>
+void check_close(const boost::multi_array<Float1, 2> & X,
+                 const boost::multi_array<Float2, 2> & Y,
+                 double tol)
+{
+    BOOST_REQUIRE_EQUAL(X.shape()[0], Y.shape()[0]);
+    BOOST_REQUIRE_EQUAL(X.shape()[1], Y.shape()[1]);
+
+    int errors = 0;
+    for (unsigned i = 0;  i < X.shape()[0];  ++i)
+        for (unsigned j = 0;  j < X.shape()[1];  ++j)
+            if (abs((double)X[i][j] - Y[i][j]) > tol && errors++ < 10)
+                BOOST_CHECK_SMALL((double)X[i][j] - Y[i][j], tol);
+    BOOST_CHECK_EQUAL(errors, 0);
+}
+
+template<typename FloatR, typename Float1, typename Float2>
+void do_test_multiply(int m, int k, int n)
+{
+    boost::multi_array<Float1, 2> A = random_matrix<Float1>(m, k);
+    boost::multi_array<Float2, 2> B = random_matrix<Float2>(k, n);
+
+    // Reference in double precision
+    boost::multi_array<double, 2> X(boost::extents[m][n]);
+    for (unsigned i = 0;  i < m;  ++i)
+        for (unsigned j = 0;  j < n;  ++j)
+            for (unsigned x = 0;  x < k;  ++x)
+                X[i][j] += (double)A[i][x] * B[x][j];
+
+    double tol = 1e-5 * (k + 1);
+    check_close(multiply_r<FloatR>(A, B), X, tol);
+
+    boost::multi_array<Float2, 2> BT = transpose(B);
+    check_close(multiply_transposed<FloatR, Float1, Float2>(A, BT), X, tol);
+
+    boost::multi_array<double, 2> AAT(boost::extents[m][m]);
+    for (unsigned i = 0;  i < m;  ++i)
+        for (unsigned j = 0;  j < m;  ++j)
+            for (unsigned x = 0;  x < k;  ++x)
+                AAT[i][j] += (double)A[i][x] * A[j][x];
+
+    check_close(multiply_transposed(A, A), AAT, tol);
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_transpose )
+{
+    // Sizes that aren't a multiple of the tile size
+    boost::multi_array<float, 2> A = random_matrix<float>(77, 130);
+    boost::multi_array<float, 2> AT = transpose(A);
+
+    BOOST_REQUIRE_EQUAL(AT.shape()[0], 130);
+    BOOST_REQUIRE_EQUAL(AT.shape()[1], 77);
+    for (unsigned i = 0;  i < 77;  ++i)
+        for (unsigned j = 0;  j < 130;  ++j)
+            BOOST_REQUIRE_EQUAL(AT[j][i], A[i][j]);
+
+    // Big enough to be done in parallel
+    boost::multi_array<double, 2> B = random_matrix<double>(1100, 1030);
+    check_close(transpose(transpose(B)), B, 0.0);
+}
+
+BOOST_AUTO_TEST_CASE( test_copy_lower_to_upper )
+{
+    for (int n = 1;  n < 300;  n += 37) {
+        boost::multi_array<double, 2> A = random_matrix<double>(n, n);
+        copy_lower_to_upper(A);
+
+        for (unsigned i = 0;  i < n;  ++i)
+            for (unsigned j = 0;  j < i;  ++j)
+                BOOST_REQUIRE_EQUAL(A[i][j], A[j][i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_multiply )
+{
+    do_test_multiply<float, float, float>(1, 1, 1);
+    do_test_multiply<float, float, float>(17, 3, 65);
+    do_test_multiply<double, double, double>(33, 1030, 70);
+    do_test_multiply<double, float, double>(80, 600, 17);
+    do_test_multiply<double, double, float>(20, 513, 129);
+    do_test_multiply<float, float, float>(150, 200, 140);
+}
+
+BOOST_AUTO_TEST_CASE( test_multiply_empty )
+{
+    boost::multi_array<float, 2> A(boost::extents[5][0]), B(boost::extents[0][3]);
+    boost::multi_array<float, 2> X = multiply(A, B);
+    BOOST_REQUIRE_EQUAL(X.shape()[0], 5);
+    BOOST_REQUIRE_EQUAL(X.shape()[1], 3);
+    for (unsigned i = 0;  i < 5;  ++i)
+        for (unsigned j = 0;  j < 3;  ++j)
+            BOOST_CHECK_EQUAL(X[i][j], 0.0);
+}
+
+BOOST_AUTO_TEST_CASE( test_add_subtract )
+{
+    boost::multi_array<float, 2> A = random_matrix<float>(300, 4000);
+    boost::multi_array<float, 2> B = random_matrix<float>(300, 4000);
+
+    boost::multi_array<float, 2> S = A + B, D = A - B;
+    for (unsigned i = 0;  i < 300;  ++i) {
+        for (unsigned j = 0;  j < 4000;  ++j) {
+            BOOST_REQUIRE_EQUAL(S[i][j], A[i][j] + B[i][j]);
+            BOOST_REQUIRE_EQUAL(D[i][j], A[i][j] - B[i][j]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_diag_mult )
+{
+    int nv = 70, nx = 3000;
+    boost::multi_array<double, 2> XT = random_matrix<double>(nv, nx);
+    distribution<double> d = random_vector<double>(nx);
+    distribution<double> y = random_vector<double>(nx);
+
+    boost::multi_array<double, 2> XTWX = diag_mult(XT, d);
+    check_close(XTWX, naive_diag_mult(XT, d), 1e-9);
+
+    // Exactly symmetric
+    for (unsigned i = 0;  i < nv;  ++i)
+        for (unsigned j = 0;  j < i;  ++j)
+            BOOST_REQUIRE_EQUAL(XTWX[i][j], XTWX[j][i]);
+
+    distribution<double> XTWy = diag_mult(XT, d, y);
+    for (unsigned v = 0;  v < nv;  ++v) {
+        double total = 0.0;
+        for (unsigned x = 0;  x < nx;  ++x)
+            total += XT[v][x] * d[x] * y[x];
+        BOOST_CHECK_SMALL(XTWy[v] - total, 1e-9);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( benchmark_matrix_ops )
+{
+    // Timings of the blocked kernels against the loops that they replaced.
+    // Nothing is checked except that the answers are the same.
+
+    {
+        int n = 800;
+        boost::multi_array<float, 2> A = random_matrix<float>(n, n);
+        boost::multi_array<float, 2> B = random_matrix<float>(n, n);
+
+        Timer t;
+        boost::multi_array<float, 2> X1 = naive_multiply<float>(A, B);
+        cerr << "multiply " << n << "x" << n << " naive:   " << t.elapsed()
+             << endl;
+        t.restart();
+        boost::multi_array<float, 2> X2 = multiply(A, B);
+        cerr << "multiply " << n << "x" << n << " blocked: " << t.elapsed()
+             << endl;
+
+        check_close(X1, X2, 1e-3);
+    }
+
+    {
+        int nv = 200, nx = 100000;
+        boost::multi_array<float, 2> XT = random_matrix<float>(nv, nx);
+        distribution<float> d = random_vector<float>(nx);
+
+        Timer t;
+        boost::multi_array<float, 2> X1 = naive_diag_mult(XT, d);
+        cerr << "diag_mult " << nv << "x" << nx << " naive:   "
+             << t.elapsed() << endl;
+        t.restart();
+        boost::multi_array<float, 2> X2 = diag_mult(XT, d);
+        cerr << "diag_mult " << nv << "x" << nx << " blocked: "
+             << t.elapsed() << endl;
+
+        check_close(X1, X2, 1e-2);
+    }
+}
@@ -0,0 +1,216 @@
+/* randomized_svd_test.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Test of the randomized SVD.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <vector>
+#include <iostream>
+
+#include "jml/algebra/randomized_svd.h"
+#include "jml/algebra/svd.h"
+#include "jml/algebra/lapack.h"
+#include "jml/arch/exception_handler.h"
+
+using namespace ML;
+using namespace std;
+
+using boost::unit_test::test_suite;
+
+namespace {
+
+/* An (m x n) matrix with quickly decaying singular values plus a little
+   noise. */
+template<typename Float>
+boost::multi_array<Float, 2>
+test_matrix(int m, int n, int rank)
+{
+    boost::mt19937 rng;
+    boost::normal_distribution<double> norm;
+    boost::variate_generator<boost::mt19937,
+                             boost::normal_distribution<double> >
+        randn(rng, norm);
+
+    boost::multi_array<double, 2> L(boost::extents[m][rank]);
+    boost::multi_array<double, 2> R(boost::extents[rank][n]);
+    for (unsigned i = 0;  i < m;  ++i)
+        for (unsigned j = 0;  j < rank;  ++j)
+            L[i][j] = randn() * pow(0.7, j);
+    for (unsigned i = 0;  i < rank;  ++i)
+        for (unsigned j = 0;  j < n;  ++j)
+            R[i][j] = randn();
+
+    boost::multi_array<Float, 2> A(boost::extents[m][n]);
+    for (unsigned i = 0;  i < m;  ++i) {
+        for (unsigned j = 0;  j < n;  ++j) {
+            double v = 0.001 * randn();
+            for (unsigned k = 0;  k < rank;  ++k)
+                v += L[i][k] * R[k][j];
+            A[i][j] = v;
+        }
+    }
+
+    return A;
+}
+
+template<typename Float>
+distribution<Float>
+exact_singular_values(boost::multi_array<Float, 2> A)
+{
+    int m = A.shape()[0], n = A.shape()[1];
+    distribution<Float> result(std::min(m, n));
+    int res = LAPack::gesdd("N", n, m, A.data(), n, &result[0], 0, 1, 0, 1);
+    BOOST_REQUIRE_EQUAL(res, 0);
+    return result;
+}
+
+template<typename Float>
+void check_orthonormal(const boost::multi_array<Float, 2> & Q, double tol)
+{
+    int n = Q.shape()[0], k = Q.shape()[1];
+    for (unsigned i = 0;  i < k;  ++i) {
+        for (unsigned j = 0;  j < k;  ++j) {
+            double dot = 0.0;
+            for (unsigned x = 0;  x < n;  ++x)
+                dot += Q[x][i] * Q[x][j];
+            BOOST_CHECK_SMALL(dot - (i == j), tol);
+        }
+    }
+}
+
+template<typename Float>
+void do_test_matrix(double tol)
+{
+    int m = 500, n = 120, k = 10;
+    boost::multi_array<Float, 2> A = test_matrix<Float>(m, n, 40);
+
+    distribution<Float> exact = exact_singular_values(A);
+
+    Randomized_SVD_Params params;
+    params.block_size = 64;  // several blocks
+
+    // boost::tie doesn't work as multi_array assignment needs the same shape
+    boost::tuple<distribution<Float>, boost::multi_array<Float, 2>,
+                 boost::multi_array<Float, 2> > result
+        = randomized_svd(A, k, params);
+    const distribution<Float> & E = result.template get<0>();
+    const boost::multi_array<Float, 2> & U = result.template get<1>();
+    const boost::multi_array<Float, 2> & V = result.template get<2>();
+
+    BOOST_REQUIRE_EQUAL(E.size(), k);
+    BOOST_REQUIRE_EQUAL(U.shape()[0], m);
+    BOOST_REQUIRE_EQUAL(U.shape()[1], k);
+    BOOST_REQUIRE_EQUAL(V.shape()[0], n);
+    BOOST_REQUIRE_EQUAL(V.shape()[1], k);
+
+    for (unsigned i = 0;  i < k;  ++i)
+        BOOST_CHECK_CLOSE(E[i], exact[i], 0.1 /* percent */);
+
+    check_orthonormal(U, tol);
+    check_orthonormal(V, tol);
+
+    // A v_i = s_i u_i
+    for (unsigned c = 0;  c < k;  ++c) {
+        for (unsigned i = 0;  i < m;  ++i) {
+            double Av = 0.0;
+            for (unsigned j = 0;  j < n;  ++j)
+                Av += A[i][j] * V[j][c];
+            BOOST_CHECK_SMALL(Av - E[c] * U[i][c], 0.01 * E[0]);
+        }
+    }
+}
+
+struct Test_Row_Source : public SVD_Row_Source {
+    Test_Row_Source(const boost::multi_array<float, 2> & A)
+        : A(A), pos(0)
+    {
+    }
+
+    const boost::multi_array<float, 2> & A;
+    size_t pos;
+
+    virtual int cols() const { return A.shape()[1]; }
+
+    virtual void rewind() { pos = 0; }
+
+    virtual size_t read(float * rows, size_t max_rows)
+    {
+        // Return fewer rows than asked for to check that it's handled
+        size_t nr = std::min<size_t>(A.shape()[0] - pos,
+                                     std::max<size_t>(max_rows / 3, 1));
+        if (nr == 0) return 0;
+        std::copy(&A[pos][0], &A[pos][0] + nr * A.shape()[1], rows);
+        pos += nr;
+        return nr;
+    }
+};
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_randomized_svd_float )
+{
+    do_test_matrix<float>(1e-4);
+}
+
+BOOST_AUTO_TEST_CASE( test_randomized_svd_double )
+{
+    do_test_matrix<double>(1e-7);
+}
+
+BOOST_AUTO_TEST_CASE( test_randomized_svd_streamed )
+{
+    int m = 400, n = 60, k = 8;
+    boost::multi_array<float, 2> A = test_matrix<float>(m, n, 20);
+
+    distribution<float> E = randomized_svd(A, k).get<0>();
+    boost::multi_array<float, 2> V = randomized_svd(A, k).get<2>();
+
+    Test_Row_Source source(A);
+    std::pair<distribution<double>, boost::multi_array<double, 2> > result
+        = randomized_svd(source, k);
+    const distribution<double> & E2 = result.first;
+    const boost::multi_array<double, 2> & V2 = result.second;
+
+    BOOST_REQUIRE_EQUAL(E2.size(), k);
+    BOOST_REQUIRE_EQUAL(V2.shape()[0], n);
+    BOOST_REQUIRE_EQUAL(V2.shape()[1], k);
+
+    check_orthonormal(V2, 1e-7);
+
+    for (unsigned c = 0;  c < k;  ++c) {
+        BOOST_CHECK_CLOSE(E2[c], E[c], 0.01);
+
+        // Same vectors, up to sign
+        double sign = V2[0][c] * V[0][c] < 0.0 ? -1.0 : 1.0;
+        for (unsigned j = 0;  j < n;  ++j)
+            BOOST_CHECK_SMALL(sign * V2[j][c] - V[j][c], 1e-3);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_truncated_svd )
+{
+    int m = 200, n = 300, k = 5;
+    boost::multi_array<double, 2> A = test_matrix<double>(m, n, 30);
+
+    distribution<double> exact = exact_singular_values(A);
+
+    distribution<double> E = svd(A, k).get<0>();
+
+    for (unsigned i = 0;  i < k;  ++i)
+        BOOST_CHECK_CLOSE(E[i], exact[i], 0.01);
+
+    // Too many singular values
+    {
+        JML_TRACE_EXCEPTIONS(false);
+        BOOST_CHECK_THROW(svd(A, m + 1), std::exception);
+    }
+}
@@ -21,6 +21,7 @@
 #include "jml/utils/guard.h"
 #include <boost/bind.hpp>
 #include "jml/utils/smart_ptr_utils.h"
+#include "jml/stats/distribution_expr.h"
 
 
 using namespace std;
@@ -167,11 +168,11 @@ struct Bag_Job {
             example_weights[rng(nx)] += 1.0;
 
         distribution<float> training_weights
-            = in_training * example_weights * info.training_ex_weights;
+            = lazy(in_training) * example_weights * info.training_ex_weights;
         training_weights.normalize();
 
         distribution<float> validate_weights
-            = not_training * example_weights * info.training_ex_weights;
+            = lazy(not_training) * example_weights * info.training_ex_weights;
         validate_weights.normalize();
 
         if (verbosity > 0)
@@ -14,6 +14,7 @@ LIBBOOSTING_SOURCES := \
         evaluation.cc \
         feature_info.cc \
         feature_set.cc \
+        feature_set_arena.cc \
         feature_space.cc \
         glz_classifier.cc \
         naive_bayes.cc \
@@ -55,7 +56,7 @@ LIBBOOSTING_SOURCES := \
 	label.cc \
 	buckets.cc
 
-LIBBOOSTING_LINK :=	utils db algebra arch judy ACE boost_regex boost_thread worker_task
+LIBBOOSTING_LINK :=	utils db algebra arch judy ACE boost_regex boost_thread worker_task stats
 
 #$(eval $(call set_compile_option,perceptron_generator.cc perceptron.cc,-ffast-math))
 
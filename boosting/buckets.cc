@@ -12,6 +12,7 @@
 #include "jml/utils/floating_point.h"
 #include "jml/utils/pair_utils.h"
 #include "jml/arch/exception.h"
+#include "jml/utils/worker_task.h"
 
 using namespace std;
 
@@ -211,6 +212,12 @@ void get_freqs(BucketFreqs & result, std::vector<float> values)
     result = BucketFreqs(freqs2.begin(), freqs2.end());
 } // namespace ML
 
+void get_freqs(BucketFreqs & result, const KLL_Sketch & sketch)
+{
+    vector<pair<float, double> > values = sketch.weighted_values();
+    result = BucketFreqs(values.begin(), values.end());
+}
+
 void bucket_dist(std::vector<float> & result,
                  const BucketFreqs & freqs,
                  size_t num_buckets)
@@ -246,5 +253,57 @@ Bucket_Info create_buckets(const std::vector<float> & values,
     return result;
 }
 
+Bucket_Info create_buckets_streaming(const std::vector<float> & values,
+                                     size_t num_buckets, int k)
+{
+    if (k == -1) k = std::max<int>(200, 8 * num_buckets);
+
+    size_t nx = values.size();
+    int num_blocks = std::max<size_t>(1, std::min<size_t>(nx / 65536 + 1,
+                                                          num_threads() * 4));
+    size_t block_size = (nx + num_blocks - 1) / num_blocks;
+
+    // One sketch per block, merged in order so that the result doesn't
+    // depend upon the scheduling
+    vector<KLL_Sketch> sketches;
+    for (int b = 0;  b < num_blocks;  ++b)
+        sketches.push_back(KLL_Sketch(k, b + 1));
+
+    auto sketchBlock = [&] (int b)
+        {
+            size_t x0 = std::min(nx, b * block_size);
+            size_t x1 = std::min(nx, x0 + block_size);
+            if (x1 > x0) sketches[b].add(&values[x0], x1 - x0);
+        };
+
+    run_in_parallel_blocked(0, num_blocks, sketchBlock);
+
+    for (int b = 1;  b < num_blocks;  ++b)
+        sketches[0].merge(sketches[b]);
+
+    BucketFreqs freqs;
+    get_freqs(freqs, sketches[0]);
+
+    Bucket_Info result;
+    bucket_dist(result.splits, freqs, num_buckets);
+
+    result.buckets.resize(nx);
+
+    auto assignBlock = [&] (int b)
+        {
+            size_t x0 = std::min(nx, b * block_size);
+            size_t x1 = std::min(nx, x0 + block_size);
+            for (size_t x = x0;  x < x1;  ++x)
+                result.buckets[x]
+                    = std::upper_bound(result.splits.begin(),
+                                       result.splits.end(), values[x])
+                    - result.splits.begin();
+        };
+
+    run_in_parallel_blocked(0, num_blocks, assignBlock);
+
+    return result;
+}
+
 } // namespace ML
 
@@ -9,6 +9,7 @@
 #define __jml__buckets_h__
 
 #include "jml/stats/sparse_distribution.h"
+#include "jml/stats/quantile_sketch.h"
 #include "jml/utils/sorted_vector.h"
 #include <stdint.h>
 
@@ -64,10 +65,26 @@ bucket_dist(const BucketFreqs & freqs, size_t num_buckets)
 
 void get_freqs(BucketFreqs & result, std::vector<float> values);
 
+/** Approximate frequency distribution of the values that were added to a
+    quantile sketch: each value that it retained, with the number of values
+    that it stands for.  Rare values may not be there at all. */
+void get_freqs(BucketFreqs & result, const KLL_Sketch & sketch);
+
 /** Create a set of buckets for the given set of values. */
 Bucket_Info create_buckets(const std::vector<float> & values,
                            size_t num_buckets);
 
+/** Create a set of buckets for the given set of values without sorting
+    them.  The split points are chosen by bucket_dist() from the
+    frequencies of a quantile sketch with the given k (by default, eight
+    times the number of buckets), which is built in one parallel pass over
+    the values.  The number of values in each bucket is then within about
+    1.7 / k of the total of that given by create_buckets(), but values that
+    are too rare to be in the sketch don't get a bucket of their own.
+*/
+Bucket_Info create_buckets_streaming(const std::vector<float> & values,
+                                     size_t num_buckets, int k = -1);
+
 
 } // namespace ML
 
@@ -20,7 +20,6 @@
 #include <boost/thread/tss.hpp>
 #include "jml/utils/exc_assert.h"
 #include "jml/math/xdiv.h"
-#include "jml/utils/filter_streams.h"
 
 
 using namespace std;
@@ -1048,24 +1047,27 @@ operator >> (DB::Store_Reader & store, Classifier & classifier)
     return store;
 }
 
+/* Plain files are memory mapped by the Store_Reader itself; compressed
+   files, URIs and stdin are read through a filter_istream. */
+
 void Classifier::load(const std::string & filename)
 {
-    filter_istream stream(filename);
-    Store_Reader store(stream);
+    Store_Reader store(filename);
     reconstitute(store);
 }
 
 void Classifier::
 load(const std::string & filename, std::shared_ptr<const Feature_Space> fs)
 {
-    filter_istream stream(filename);
     Store_Reader store(filename);
     reconstitute(store, fs);
 }
 
-void Classifier::save(const std::string & filename, bool write_fs) const
+void Classifier::save(const std::string & filename, bool write_fs,
+                      const std::string & compression,
+                      int compressionLevel) const
 {
-    Store_Writer store(filename);
+    Store_Writer store(filename, compression, compressionLevel);
     serialize(store, write_fs);
 }
 
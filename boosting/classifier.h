@@ -737,7 +737,12 @@ public:
     void load(const std::string & filename);
     void load(const std::string & filename,
               std::shared_ptr<const Feature_Space> fs);
-    void save(const std::string & filename, bool write_fs = true) const;
+
+    /** Save to the given filename.  The compression and its level are as
+        for filter_ostream; by default they come from the extension. */
+    void save(const std::string & filename, bool write_fs = true,
+              const std::string & compression = "",
+              int compressionLevel = -1) const;
 
     std::shared_ptr<Classifier_Impl> impl;
 };
@@ -140,9 +140,8 @@ create_mapping(const Dense_Feature_Space & other,
 
 #if 0
     cerr << "other mapping:" << endl;
-    for (map<string, int>::const_iterator it = other.names_bwd.begin();
-         it != other.names_bwd.end();  ++it)
-        cerr << it->first << " = " << it->second << endl;
+    for (unsigned i = 0;  i < other.names_fwd.size();  ++i)
+        cerr << other.names_fwd[i] << " = " << i << endl;
     cerr << endl;
 
     cerr << "create_mapping: this = " << print() << endl;
@@ -158,28 +157,27 @@ create_mapping(const Dense_Feature_Space & other,
 
     for (unsigned i = 0;  i < names_fwd.size();  ++i) {
         //cerr << "mapping feature " << names_fwd[i] << endl;
-        map<string, int>::const_iterator it
-            = other.names_bwd.find(names_fwd[i]);
-        if (it == other.names_bwd.end()
-            /*|| info_array[i] != other.info_array[it->second]*/) {
+        int j = other.feature_index(names_fwd[i]);
+        if (j == -1
+            /*|| info_array[i] != other.info_array[j]*/) {
             //cerr << "us = " << info_array[i].print()
-            //     << " them = " << other.info_array[it->second]
+            //     << " them = " << other.info_array[j]
             //     << endl;
             mapping.vars[i] = -1;
             continue;
         }
         else {
-            mapping.vars[i] = it->second;
+            mapping.vars[i] = j;
         }
         //cerr << "mapping[" << i << "] = " << mapping.back() << endl;
 
         //cerr << "us:   " << info_array[i].print() << endl;
-        //cerr << "them: " << other.info_array[it->second].print() << endl;
+        //cerr << "them: " << other.info_array[j].print() << endl;
 
         /* Map the values of categories. */
         if (info_array[i].categorical()) {
-            if (other.info_array[it->second].categorical()) {
-                if (other.info_array[it->second].type() != info_array[i].type())
+            if (other.info_array[j].categorical()) {
+                if (other.info_array[j].type() != info_array[i].type())
                     throw Exception("Dense_Feature_Space::map(): types not "
                                     "the same");
 
@@ -187,7 +185,7 @@ create_mapping(const Dense_Feature_Space & other,
                 //     << demangle(typeid(ci).name())
                 //     << " and "
                 //    
-                //     << demangle(typeid(*other.info_array[it->second]
+                //     << demangle(typeid(*other.info_array[j]
                 //                        .categorical()).name())
                 //     << endl;
 
@@ -196,7 +194,7 @@ create_mapping(const Dense_Feature_Space & other,
                     mapping.categories[i]
                         = make_sp(new Fixed_Categorical_Mapping
                                   (info_array[i].categorical(),
-                                   other.info_array[it->second].categorical()));
+                                   other.info_array[j].categorical()));
                 }
                 else if (info_array[i].type() == STRING) {
                     mapping.categories[i]
@@ -220,7 +218,7 @@ create_mapping(const Dense_Feature_Space & other,
 #endif
             }
         }
-        else if (other.info_array[it->second].categorical()) {
+        else if (other.info_array[j].categorical()) {
             mapping.clear();
             throw Exception("Mapping from categorical to non-categorical "
                             "for feature " + names_fwd[i]);
@@ -557,8 +555,14 @@ set_feature_names(const std::vector<std::string> & feature_names)
                                variable_count()));
     names_fwd = feature_names;
     names_bwd.clear();
-    for (unsigned i = 0;  i < variable_count();  ++i)
-        names_bwd[names_fwd[i]] = i;
+    names_index.clear();
+    for (unsigned i = 0;  i < variable_count();  ++i) {
+        /* The last of any duplicate names is the one that's found */
+        int id = names_bwd.intern(names_fwd[i]);
+        if (id == (int)names_index.size())
+            names_index.push_back(i);
+        else names_index[id] = i;
+    }
 }
 
 Feature
@@ -581,9 +585,9 @@ get_feature(const std::string & name) const
 
 int Dense_Feature_Space::feature_index(const std::string & name) const
 {
-    map<string, int>::const_iterator it = names_bwd.find(name);
-    if (it == names_bwd.end()) return -1;
-    return it->second;
+    int id = names_bwd.lookup(name);
+    if (id == -1) return -1;
+    return names_index[id];
 }
 
 int Dense_Feature_Space::
@@ -595,7 +599,8 @@ add_feature(const string & name, const Feature_Info & info)
         /* Doesn't exist.  We add it. */
         index = variable_count();
         names_fwd.push_back(name);
-        names_bwd[name] = index;
+        names_bwd.intern(name);
+        names_index.push_back(index);
         info_array.push_back(info);
         features_.push_back(Feature(index));
     }
@@ -884,8 +889,11 @@ struct Dense_Training_Data::Data_Source {
         if (data)
             return Parse_Context(filename, data, data_end);
         else {
+            // Decompress in the background while we parse
             stream.reset(new filter_istream(filename));
-            return Parse_Context(filename, *stream);
+            return Parse_Context(filename, *stream, 1, 1,
+                                 Parse_Context::DEFAULT_CHUNK_SIZE,
+                                 Parse_Context::DEFAULT_READAHEAD_CHUNKS);
         }
     }
 };
@@ -15,6 +15,7 @@
 #include "feature_space.h"
 #include "feature_info.h"
 #include "training_data.h"
+#include "jml/utils/string_interner.h"
 #include <boost/multi_array.hpp>
 #include <map>
 
@@ -248,7 +249,12 @@ public:
 
 protected:    
     std::vector<std::string> names_fwd;
-    std::map<std::string, int> names_bwd;
+
+    /* Looking up a feature by name doesn't lock, so it can be done from
+       many threads at once.  Adding features must still be done from one
+       thread. */
+    String_Interner names_bwd;
+    Append_Only_Array<int> names_index;  ///< Interned id to feature index
     std::vector<Mutable_Feature_Info> info_array;
     std::vector<Feature> features_;
 
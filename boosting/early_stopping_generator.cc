@@ -9,6 +9,7 @@
 #include "early_stopping_generator.h"
 #include "jml/arch/demangle.h"
 #include "jml/utils/sgi_numeric.h"
+#include "jml/stats/distribution_expr.h"
 
 
 using namespace std;
@@ -90,7 +91,7 @@ generate(Thread_Context & context,
         example_weights[rng(nx)] += 1.0;
     
     distribution<float> training_weights
-        = in_training * example_weights * ex_weights;
+        = lazy(in_training) * example_weights * ex_weights;
 
     //cerr << "in_training.total() = " << in_training.total() << endl;
     //cerr << "example_weights.total() = " << example_weights.total()
@@ -104,7 +105,7 @@ generate(Thread_Context & context,
     training_weights.normalize();
     
     distribution<float> validate_weights
-        = not_training * example_weights * ex_weights;
+        = lazy(not_training) * example_weights * ex_weights;
 
     if (validate_weights.total() == 0.0)
         throw Exception("validate weights were empty");
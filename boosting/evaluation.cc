@@ -8,6 +8,7 @@
 
 #include "evaluation.h"
 #include "training_data.h"
+#include "jml/stats/auc.h"
 
 
 using namespace std;
@@ -157,5 +158,38 @@ accuracy(const boost::multi_array<float, 2> & output,
     return result;
 }
 
+double
+auc(const boost::multi_array<float, 2> & output,
+    const Training_Data & data,
+    const Feature & label,
+    const distribution<float> & example_weights)
+{
+    size_t nx = output.shape()[0];
+    if (nx != data.example_count())
+        throw Exception("auc: data set and output size don't match");
+
+    if (!example_weights.empty() && example_weights.size() != nx)
+        throw Exception("auc: dataset and weight vector sizes don't match");
+
+    int nl = output.shape()[1];
+    if (nl < 1 || nl > 2)
+        throw Exception("auc: only binary classifiers are supported");
+
+    vector<AUC_Entry> entries;
+    entries.reserve(nx);
+
+    for (unsigned i = 0;  i < nx;  ++i) {
+        std::pair<Feature_Set::const_iterator, Feature_Set::const_iterator>
+            range = data[i].find(label);
+        if (range.second - range.first != 1) continue;
+
+        float w = (example_weights.empty() ? 1.0 : example_weights[i]);
+        entries.push_back(AUC_Entry(output[i][nl - 1],
+                                    range.first.value() == 1.0, w));
+    }
+
+    return 1.0 - do_calc_auc(entries);
+}
+
 } // namespace ML
 
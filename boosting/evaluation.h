@@ -157,6 +157,29 @@ float accuracy(const boost::multi_array<float, 2> & output,
                const distribution<float> & example_weights
                    = UNIFORM_WEIGHTS);
 
+/** Calculate the area under the ROC curve of a binary classifier over a
+    training set, using a set of already cached predictions.  The model
+    output is that for label 1 (or the only output of a classifier with
+    one), and the examples with label 1 are the positive ones.
+
+    \param output             the output of the classifier for each of the
+                              examples in \p data.
+    \param data               the training data used to calculate the
+                              AUC over.
+    \param example_weights    a weighting of the examples.  Examples with a
+                              weight of zero are skipped; the others all
+                              count the same.
+    \returns                  the probability that a positive example has a
+                              higher output than a negative one.
+
+    The exact AUC is calculated with do_calc_auc(), which sorts in parallel.
+    Examples without the label are skipped.
+*/
+double auc(const boost::multi_array<float, 2> & output,
+           const Training_Data & data,
+           const Feature & label,
+           const distribution<float> & example_weights = UNIFORM_WEIGHTS);
+
 } // namespace ML
 
 
@@ -604,29 +604,26 @@ freeze()
 
 Fixed_Categorical_Info::
 Fixed_Categorical_Info()
-    : is_mutable(false)
 {
 }
 
 Fixed_Categorical_Info::
 Fixed_Categorical_Info(unsigned num)
-    : is_mutable(false)
 {
     for (unsigned i = 0;  i < num;  ++i)
-        print_.push_back(format("VAL%d", i));
-    make_parse_from_print();
+        names_.append(format("VAL%d", i));
 }
 
 Fixed_Categorical_Info::
 Fixed_Categorical_Info(const std::vector<std::string> & names)
-    : is_mutable(false), print_(names)
 {
-    make_parse_from_print();
+    /* The last of any duplicate names is the one that's found */
+    for (unsigned i = 0;  i < names.size();  ++i)
+        names_.append(names[i]);
 }
 
 Fixed_Categorical_Info::
 Fixed_Categorical_Info(DB::Store_Reader & store)
-    : is_mutable(false)
 {
     reconstitute(store);
 }
@@ -658,43 +655,30 @@ string
 Fixed_Categorical_Info::
 print() const
 {
-    Guard guard(lock, 0, 0);  // guard that doesn't acquire the lock
-    if (is_mutable) guard.acquire();
-
-    string result = format("%zd", print_.size());
-    for (unsigned i = 0;  i < print_.size();  ++i)
-        result += "," + escape_categorical_info(print_[i]);
+    size_t n = names_.size();
+    string result = format("%zd", n);
+    for (unsigned i = 0;  i < n;  ++i)
+        result += "," + escape_categorical_info(names_[i]);
     return result;
 }
 
 std::string Fixed_Categorical_Info::print(int value) const
 {
-    Guard guard(lock, 0, 0);  // guard that doesn't acquire the lock
-    if (is_mutable) guard.acquire();
-
-    if (value < 0 || value >= print_.size()) {
+    if (value < 0 || value >= names_.size()) {
         cerr << "value = " << value << endl;
-        cerr << "size  = " << print_.size() << endl;
+        cerr << "size  = " << names_.size() << endl;
         //throw Exception("Fixed_Categorical_Info::print(): out of range");
         cout << "Fixed_Categorical_Info::print(): out of range" << endl;
         return "";
-        //return format("invalid(%d, size %zd)", value, print_.size());
+        //return format("invalid(%d, size %zd)", value, names_.size());
     }
 
-    return print_.at(value);
+    return names_[value];
 }
 
 int Fixed_Categorical_Info::lookup(const std::string & name) const
 {
-    Guard guard(lock, 0, 0);  // guard that doesn't acquire the lock
-    if (is_mutable) guard.acquire();
-
-    /* Get the value of the category */
-    std::hash_map<std::string, int>::const_iterator it = parse_.find(name);
-
-    if (it == parse_.end()) return -1;
-    
-    return it->second;
+    return names_.lookup(name);
 }
 
 
@@ -703,18 +687,12 @@ compact_size_t FIXED_CI_VERSION(0);
 
 void Fixed_Categorical_Info::serialize(DB::Store_Writer & store) const
 {
-    Guard guard(lock, 0, 0);  // guard that doesn't acquire the lock
-    if (is_mutable) guard.acquire();
-
     store << FIXED_CI_VERSION << string("FIXED_CI");
-    store << print_;
+    store << names_.strings();
 }
 
 void Fixed_Categorical_Info::reconstitute(DB::Store_Reader & store)
 {
-    Guard guard(lock, 0, 0);  // guard that doesn't acquire the lock
-    if (is_mutable) guard.acquire();
-
     compact_size_t version(store);
 
     if (version == 0) {
@@ -723,8 +701,11 @@ void Fixed_Categorical_Info::reconstitute(DB::Store_Reader & store)
         if (name != "FIXED_CI")
             throw Exception("Fixed_Categorical_Info: reconstituting unknown "
                             "name");
-        store >> print_;
-        make_parse_from_print();
+        vector<string> names;
+        store >> names;
+        names_.clear();
+        for (unsigned i = 0;  i < names.size();  ++i)
+            names_.append(names[i]);
     }
     else throw Exception("Fixed_Categorical_Info: reconstituting unknown "
                          "version");
@@ -737,20 +718,7 @@ std::string Fixed_Categorical_Info::class_id() const
 
 unsigned Fixed_Categorical_Info::count() const
 {
-    Guard guard(lock, 0, 0);  // guard that doesn't acquire the lock
-    if (is_mutable) guard.acquire();
-
-    return print_.size();
-}
-
-void Fixed_Categorical_Info::make_parse_from_print()
-{
-    Guard guard(lock, 0, 0);  // guard that doesn't acquire the lock
-    if (is_mutable) guard.acquire();
-
-    parse_.clear();
-    for (unsigned i = 0;  i < print_.size();  ++i)
-        parse_[print_[i]] = i;
+    return names_.size();
 }
 
 void
@@ -768,21 +736,18 @@ Mutable_Categorical_Info::
 Mutable_Categorical_Info()
     : Fixed_Categorical_Info(0), frozen(false)
 {
-    is_mutable = true;
 }
 
 Mutable_Categorical_Info::
 Mutable_Categorical_Info(const std::vector<std::string> & names)
     : Fixed_Categorical_Info(names), frozen(false)
 {
-    is_mutable = true;
 }
 
 Mutable_Categorical_Info::
 Mutable_Categorical_Info(unsigned num)
     : Fixed_Categorical_Info(num), frozen(false)
 {
-    is_mutable = true;
 }
 
 Mutable_Categorical_Info::
@@ -790,7 +755,6 @@ Mutable_Categorical_Info(DB::Store_Reader & store)
     : Fixed_Categorical_Info(0), frozen(false)
 {
     reconstitute(store);
-    is_mutable = true;
 }
 
 Mutable_Categorical_Info::
@@ -801,8 +765,6 @@ Mutable_Categorical_Info(const Categorical_Info & other)
 
     for (unsigned i = 0;  i < cnt;  ++i)
         parse_or_add(other.print(i));
-
-    is_mutable = true;
 }
 
 int
@@ -813,25 +775,14 @@ parse_or_add(const std::string & name) const
         throw Exception("Mutable_Categorical_Info::parse_or_add(): "
                         "frozen");
 
-    Guard guard(lock);
-
-    /* Get the value of the category */
-    std::hash_map<std::string, int>::const_iterator it = parse_.find(name);
-    
-    /* Get or insert the name */
-    if (it == parse_.end()) {
-        it = parse_.insert(std::make_pair(name, parse_.size())).first;
-        print_.push_back(name);
-    }
-    
-    return it->second;
+    /* Get or insert the name; only a new name locks */
+    return names_.intern(name);
 }
 
 int
 Mutable_Categorical_Info::
 lookup(const std::string & name) const
 {
-    Guard guard(lock);
     if (!frozen) return parse_or_add(name);
     else return Fixed_Categorical_Info::lookup(name);
 }
@@ -841,12 +792,9 @@ Mutable_Categorical_Info::
 freeze()
 {
     //cerr << "freezing Mutable_Categorical_Info with values "
-    //     << print_ << endl;
+    //     << names_.strings() << endl;
 
-    if (frozen) return;
-    Guard guard(lock);
     frozen = true;
-    is_mutable = false;
 }
 
 
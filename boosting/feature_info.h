@@ -13,9 +13,11 @@
 #include "config.h"
 #include <vector>
 #include <string>
+#include <atomic>
 #include "jml/db/persistent.h"
 #include "feature_set.h"
 #include "jml/utils/hash_map.h"
+#include "jml/utils/string_interner.h"
 #include "jml/arch/threads.h"
 
 namespace ML {
@@ -316,13 +318,9 @@ public:
     virtual void freeze();
 
 protected:
-    /* Note that these are only considered mutable, and the lock used, if the
-       field is_mutable is set to true. */
-    bool is_mutable;
-    mutable Lock lock;
-    mutable std::hash_map<std::string, int> parse_;
-    mutable std::vector<std::string> print_;
-    void make_parse_from_print();
+    /* Looking up a category, or its name, never locks, so a mutable one can
+       be shared by all of the threads parsing a dataset. */
+    mutable String_Interner names_;
 };
 
 
@@ -355,7 +353,8 @@ public:
 
     virtual void freeze();
 
-    bool frozen;
+    /** Set by freeze(), which can race with lookups on parsing threads. */
+    std::atomic<bool> frozen;
 };
 
 
@@ -0,0 +1,114 @@
+/* feature_set_arena.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Implementation of the feature set arena.
+*/
+
+#include "feature_set_arena.h"
+#include <stdlib.h>
+#include <algorithm>
+#include <new>
+
+
+using namespace std;
+
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* PACKED_FEATURE_SET                                                        */
+/*****************************************************************************/
+
+Mutable_Feature_Set *
+Packed_Feature_Set::
+make_copy() const
+{
+    return new Mutable_Feature_Set(data_, data_ + size_);
+}
+
+
+/*****************************************************************************/
+/* FEATURE_SET_ARENA                                                         */
+/*****************************************************************************/
+
+namespace {
+
+enum { ALIGNMENT = 16 };
+
+inline size_t align_up(size_t bytes)
+{
+    return (bytes + ALIGNMENT - 1) & ~size_t(ALIGNMENT - 1);
+}
+
+} // file scope
+
+Feature_Set_Arena::
+Feature_Set_Arena(size_t slab_size)
+    : slab_size_(slab_size), current_(0), end_(0), memusage_(0)
+{
+}
+
+Feature_Set_Arena::
+~Feature_Set_Arena()
+{
+    for (unsigned i = 0;  i < slabs_.size();  ++i)
+        free(slabs_[i]);
+}
+
+void *
+Feature_Set_Arena::
+allocate(size_t bytes)
+{
+    bytes = align_up(bytes);
+
+    if (bytes > size_t(end_ - current_)) {
+        // Something too big for a slab gets one of its own, so that we
+        // don't waste what's left of the current one
+        size_t size = std::max<size_t>(bytes, slab_size_);
+        char * slab = (char *)malloc(size);
+        if (!slab) throw std::bad_alloc();
+        slabs_.push_back(slab);
+        memusage_ += size;
+
+        if (size > slab_size_) return slab;
+
+        current_ = slab;
+        end_ = slab + size;
+    }
+
+    void * result = current_;
+    current_ += bytes;
+    return result;
+}
+
+Packed_Feature_Set *
+Feature_Set_Arena::
+add(const Feature_Set & features)
+{
+    typedef Packed_Feature_Set::value_type value_type;
+
+    const Feature * feat;
+    const float * val;
+    int feat_stride, val_stride;
+    size_t size;
+    boost::tie(feat, val, feat_stride, val_stride, size)
+        = features.get_data(true /* need_sorted */);
+
+    // The data goes straight after the object, so that they share cache
+    // lines
+    size_t header = align_up(sizeof(Packed_Feature_Set));
+    char * mem = (char *)allocate(header + size * sizeof(value_type));
+    value_type * data = (value_type *)(mem + header);
+
+    for (size_t i = 0;  i < size;  ++i) {
+        new (&data[i]) value_type(*feat, *val);
+        feat = (const Feature *)((const char *)feat + feat_stride);
+        val = (const float *)((const char *)val + val_stride);
+    }
+
+    return new (mem) Packed_Feature_Set(data, size);
+}
+
+} // namespace ML
@@ -0,0 +1,102 @@
+/* feature_set_arena.h                                             -*- C++ -*-
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Feature sets carved out of large slabs of memory, for holding the
+   examples of a dataset.
+*/
+
+#ifndef __boosting__feature_set_arena_h__
+#define __boosting__feature_set_arena_h__
+
+#include "feature_set.h"
+#include <vector>
+
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* PACKED_FEATURE_SET                                                        */
+/*****************************************************************************/
+
+/** An immutable, sorted feature set whose data lives elsewhere (normally
+    directly after it in a Feature_Set_Arena).  It owns nothing, so it never
+    needs to be destroyed.
+*/
+
+class Packed_Feature_Set : public Feature_Set {
+public:
+    typedef std::pair<Feature, float> value_type;
+
+    Packed_Feature_Set(const value_type * data, size_t size)
+        : data_(data), size_(size)
+    {
+    }
+
+    virtual boost::tuple<const Feature *, const float *, int, int, size_t>
+    get_data(bool need_sorted = false) const
+    {
+        return boost::make_tuple(&data_[0].first, &data_[0].second,
+                                 sizeof(value_type), sizeof(value_type),
+                                 size_);
+    }
+
+    virtual size_t size() const { return size_; }
+
+    /** Always sorted already. */
+    virtual void sort() {}
+
+    /** Copies are ordinary Mutable_Feature_Sets, so they can be modified. */
+    virtual Mutable_Feature_Set * make_copy() const;
+
+private:
+    const value_type * data_;
+    size_t size_;
+};
+
+
+/*****************************************************************************/
+/* FEATURE_SET_ARENA                                                         */
+/*****************************************************************************/
+
+/** Holds packed copies of feature sets in large slabs, which are all freed
+    at once when the arena is destroyed.  This avoids the two small
+    allocations (and their overhead and fragmentation) that each example
+    loaded into a dataset would otherwise cost.
+
+    Not thread safe.
+*/
+
+class Feature_Set_Arena {
+public:
+    enum { DEFAULT_SLAB_SIZE = 1024 * 1024 };
+
+    Feature_Set_Arena(size_t slab_size = DEFAULT_SLAB_SIZE);
+    ~Feature_Set_Arena();
+
+    /** Add a sorted copy of the given feature set.  It lives as long as the
+        arena. */
+    Packed_Feature_Set * add(const Feature_Set & features);
+
+    /** Return memory for the given number of bytes, aligned to hold
+        anything. */
+    void * allocate(size_t bytes);
+
+    /** Bytes held in slabs. */
+    size_t memusage() const { return memusage_; }
+
+private:
+    Feature_Set_Arena(const Feature_Set_Arena &);
+    void operator = (const Feature_Set_Arena &);
+
+    size_t slab_size_;
+    std::vector<char *> slabs_;
+    char * current_;
+    char * end_;
+    size_t memusage_;
+};
+
+} // namespace ML
+
+#endif /* __boosting__feature_set_arena_h__ */
@@ -361,7 +361,7 @@ std::string GLZ_Classifier::summary() const
 namespace {
 
 static const std::string GLZ_CLASSIFIER_MAGIC = "GLZ_CLASSIFIER";
-static const compact_size_t GLZ_CLASSIFIER_VERSION = 3;
+static const compact_size_t GLZ_CLASSIFIER_VERSION = 4;
 
 } // file scope
 
@@ -392,9 +392,9 @@ reconstitute(DB::Store_Reader & store)
     if (magic != GLZ_CLASSIFIER_MAGIC)
         throw Exception("Attempt to reconstitute \"" + magic
                                 + "\" with boosted stumps reconstitutor");
-    if (version != GLZ_CLASSIFIER_VERSION)
+    if (version < 3 || version > GLZ_CLASSIFIER_VERSION)
         throw Exception(format("Attemp to reconstitute GLZ classifier "
-                               "version %zd, only %zd supported",
+                               "version %zd, only 3 to %zd supported",
                                version.size_,
                                GLZ_CLASSIFIER_VERSION.size_));
 
@@ -407,7 +407,16 @@ reconstitute(DB::Store_Reader & store)
         feature_space()->reconstitute(store, predicted_);
     
     int add_bias_;  store >> add_bias_;  add_bias = add_bias_;
-    store >> weights >> link;
+    if (version < 4) {
+        // Weights were plain vectors before they could be mapped
+        vector<distribution<float> > old_weights;
+        store >> old_weights;
+        weights.clear();
+        for (unsigned l = 0;  l < old_weights.size();  ++l)
+            weights.push_back(DB::Mapped_Array<float>(old_weights[l]));
+    }
+    else store >> weights;
+    store >> link;
     
     compact_size_t nf(store);
     features.resize(nf);
@@ -12,6 +12,7 @@
 
 #include "jml/boosting/classifier.h"
 #include "jml/algebra/irls.h"
+#include "jml/db/mapped_array.h"
 
 
 namespace ML {
@@ -51,8 +52,10 @@ public:
     bool add_bias;
 
     /** Parameters.  For each label we have a vector of input parameters,
-        one for each of the features. */
-    std::vector<distribution<float> > weights;
+        one for each of the features (plus the bias).  They're read only, so
+        that a classifier loaded from an uncompressed file uses them in
+        place from the memory mapped file (see DB::Mapped_Array). */
+    std::vector<DB::Mapped_Array<float> > weights;
 
     /** Importance.  Same as weights, but gives only the amount by which the
         un-normalized parameter was weighted. */
@@ -15,7 +15,10 @@
 #include "jml/utils/smart_ptr_utils.h"
 #include "jml/algebra/matrix_ops.h"
 #include "jml/algebra/lapack.h"
+#include "jml/algebra/glz_solvers.h"
+#include "jml/stats/moments.h"
 #include "jml/arch/timers.h"
+#include "jml/utils/worker_task.h"
 
 using namespace std;
 
@@ -23,6 +26,256 @@ using namespace std;
 namespace ML {
 
 
+namespace {
+
+/** Provides the examples of a training set, decoded and normalized as for
+    the dense matrix of train_weighted(), to the streaming solvers.  The
+    first order solvers read them with get_sparse(), which only looks at the
+    features that are present in each example; the normalization is then
+    split into a scale, applied to the non-zero values, and a baseline. */
+struct GLZ_Example_Source : public IRLS_Example_Source {
+    GLZ_Example_Source(const Training_Data & data,
+                       const boost::multi_array<float, 2> & weights,
+                       const GLZ_Classifier & classifier,
+                       const vector<int> & example_nums)
+        : data(data), weights(weights), classifier(classifier),
+          labels(data.index().labels(classifier.predicted())),
+          example_nums(example_nums),
+          nv(classifier.features.size() + classifier.add_bias),
+          means(nv, 0.0), stds(nv, 1.0), label(0)
+    {
+        for (unsigned i = 0;  i < classifier.features.size();  ++i)
+            specs.push_back(make_pair(classifier.features[i].feature, i));
+        std::sort(specs.begin(), specs.end());
+    }
+
+    const Training_Data & data;
+    const boost::multi_array<float, 2> & weights;
+    const GLZ_Classifier & classifier;
+    const vector<Label> & labels;
+    vector<int> example_nums;    ///< Those with a non-zero weight
+    int nv;
+    distribution<double> means, stds;
+    int label;                   ///< Label being trained
+
+    /// Variables of each feature, sorted by feature
+    vector<pair<Feature, int> > specs;
+
+    virtual int variables() const
+    {
+        return nv;
+    }
+
+    virtual size_t examples() const
+    {
+        return example_nums.size();
+    }
+
+    void decode(int x, double * values) const
+    {
+        distribution<float> decoded = classifier.decode(data[x]);
+        if (classifier.add_bias) decoded.push_back(1.0);
+
+        for (unsigned v = 0;  v < nv;  ++v) {
+            double value = decoded[v];
+            if (!isfinite(value)) value = 0.0;
+            values[v] = (value - means[v]) * (1.0 / stds[v]);
+        }
+    }
+
+    /** Append the non-zero decoded values of example x (before it's
+        normalized) to indexes and values.  Gives the same values as
+        GLZ_Classifier::decode(), but only looks at the features that are
+        present. */
+    void decode_sparse(int x, vector<int> & indexes,
+                       vector<double> & values) const
+    {
+        const Feature_Set & fs = data[x];
+        for (Feature_Set::const_iterator it = fs.begin(), end = fs.end();
+             it != end;  ++it) {
+            float value = it.value();
+            if (isnan(value)) continue;
+
+            vector<pair<Feature, int> >::const_iterator first
+                = std::lower_bound(specs.begin(), specs.end(),
+                                   make_pair(it.feature(), -1));
+
+            for (;  first != specs.end() && first->first == it.feature();
+                 ++first) {
+                int v = first->second;
+                double decoded = value;
+                if (classifier.features[v].type
+                    == GLZ_Classifier::Feature_Spec::PRESENCE)
+                    decoded = 1.0;
+                else if (!isfinite(value))
+                    throw Exception("GLZ_Classifier: feature "
+                                    + classifier.feature_space()
+                                          ->print(it.feature())
+                                    + " is not finite");
+                if (decoded == 0.0) continue;
+                indexes.push_back(v);
+                values.push_back(decoded);
+            }
+        }
+
+        if (classifier.add_bias) {
+            indexes.push_back(nv - 1);
+            values.push_back(1.0);
+        }
+    }
+
+    virtual void get(size_t first, size_t n,
+                     double * x, double * y, double * w) const
+    {
+        for (unsigned i = 0;  i < n;  ++i) {
+            int ex = example_nums[first + i];
+            decode(ex, x + (size_t)i * nv);
+            y[i] = target(ex);
+            w[i] = weight(ex);
+        }
+    }
+
+    virtual void get_sparse(size_t first, size_t n,
+                            IRLS_Sparse_Rows & rows) const
+    {
+        rows.clear();
+        rows.y.resize(n);
+        rows.w.resize(n);
+
+        for (unsigned i = 0;  i < n;  ++i) {
+            int ex = example_nums[first + i];
+            size_t start = rows.indexes.size();
+            decode_sparse(ex, rows.indexes, rows.values);
+            for (size_t j = start;  j < rows.indexes.size();  ++j)
+                rows.values[j] *= 1.0 / stds[rows.indexes[j]];
+            rows.offsets.push_back(rows.indexes.size());
+            rows.y[i] = target(ex);
+            rows.w[i] = weight(ex);
+        }
+    }
+
+    virtual distribution<double> baseline() const
+    {
+        if (means.two_norm() == 0.0) return distribution<double>();
+        return -means / stds;
+    }
+
+    double target(int ex) const
+    {
+        if (classifier.label_count() == 1) return labels[ex].value();
+        return (double)(labels[ex] == label);
+    }
+
+    double weight(int ex) const
+    {
+        return weights[ex][weights.shape()[1] == 1 ? 0 : label];
+    }
+
+    /** Set up the means and standard deviations to normalize the
+        variables, in a parallel pass over the data.  Only the non-zero
+        values are visited; the zeros are added in at the end. */
+    void calc_normalization()
+    {
+        means.clear();  means.resize(nv, 0.0);
+        stds.clear();  stds.resize(nv, 1.0);
+
+        size_t nx = example_nums.size();
+        if (nx == 0) return;
+
+        int num_blocks = std::min<size_t>(nx, num_threads() * 4);
+        size_t block_size = (nx + num_blocks - 1) / num_blocks;
+
+        // Moments of the non-zero values of each variable over each block
+        vector<vector<Moments> > block_moments(num_blocks);
+
+        auto doBlock = [&] (int b)
+            {
+                vector<Moments> moments(nv);
+                vector<int> indexes;
+                vector<double> values;
+
+                size_t x0 = b * block_size;
+                size_t x1 = std::min(nx, x0 + block_size);
+
+                for (size_t x = x0;  x < x1;  ++x) {
+                    indexes.clear();
+                    values.clear();
+                    decode_sparse(example_nums[x], indexes, values);
+                    for (unsigned j = 0;  j < indexes.size();  ++j)
+                        moments[indexes[j]].add(values[j]);
+                }
+
+                block_moments[b].swap(moments);
+            };
+
+        run_in_parallel_blocked(0, num_blocks, doBlock);
+
+        // Combine the blocks in order
+        vector<Moments> moments(nv);
+        for (unsigned b = 0;  b < num_blocks;  ++b)
+            for (unsigned v = 0;  v < nv;  ++v)
+                moments[v].merge(block_moments[b][v]);
+
+        for (unsigned v = 0;  v < nv;  ++v) {
+            Moments zeros;
+            zeros.count = nx - moments[v].count;
+            if (zeros.count > 0.0) {
+                zeros.min_value = zeros.max_value = 0.0;
+                moments[v].merge(zeros);
+            }
+
+            double std = moments[v].std_dev();
+
+            if (std == 0.0 && moments[v].mean == 1.0) {
+                // bias column
+                means[v] = 0.0;
+                stds[v] = 1.0;
+            }
+            else {
+                means[v] = moments[v].mean;
+                stds[v] = (std == 0.0 ? 1.0 : std);
+            }
+        }
+    }
+};
+
+/** Set the weights of the classifier from those trained for each label over
+    the normalized variables. */
+void set_weights(GLZ_Classifier & result,
+                 const vector<distribution<double> > & trained_by_label,
+                 const distribution<double> & means,
+                 const distribution<double> & stds,
+                 bool add_bias, int nl)
+{
+    result.weights.clear();
+
+    for (unsigned l = 0;  l < trained_by_label.size();  ++l) {
+        distribution<double> trained = trained_by_label[l] / stds;
+
+        double extra_bias = - (trained.dotprod(means));
+
+        if (extra_bias != 0.0) {
+            if (!add_bias)
+                throw Exception("extra bias but nowhere to put it");
+            trained.back() += extra_bias;
+        }
+
+        result.weights.push_back
+            (DB::Mapped_Array<float>(trained.cast<float>()));
+    }
+
+    if (nl == 2) {
+        // weights for second label are the mirror of those of the first
+        // label
+        distribution<float> mirrored(result.weights.front().begin(),
+                                     result.weights.front().end());
+        result.weights.push_back(DB::Mapped_Array<float>(-1.0F * mirrored));
+    }
+}
+
+} // file scope
+
+
 /*****************************************************************************/
 /* GLZ_CLASSIFIER_GENERATOR                                                  */
 /*****************************************************************************/
@@ -49,6 +302,19 @@ configure(const Configuration & config)
     config.find(normalize, "normalize");
     config.find(ridge_regression, "ridge_regression");
     config.find(feature_proportion, "feature_proportion");
+    config.find(streaming, "streaming");
+    config.find(solver, "solver");
+    config.find(l1, "l1");
+    config.find(l2, "l2");
+    config.find(max_iterations, "max_iterations");
+    config.find(epochs, "epochs");
+    config.find(minibatch_size, "minibatch_size");
+    config.find(learning_rate, "learning_rate");
+    config.find(chunk_size, "chunk_size");
+
+    if (solver != "irls" && solver != "lbfgs" && solver != "sgd")
+        throw Exception("GLZ_Classifier_Generator: unknown solver '"
+                        + solver + "'; expected irls, lbfgs or sgd");
 }
 
 void
@@ -62,6 +328,15 @@ defaults()
     normalize = true;
     ridge_regression = true;
     feature_proportion = 1.0;
+    streaming = false;
+    solver = "irls";
+    l1 = 0.0;
+    l2 = 0.0;
+    max_iterations = 200;
+    epochs = 10;
+    minibatch_size = 256;
+    learning_rate = 0.5;
+    chunk_size = 4096;
 }
 
 Config_Options
@@ -75,7 +350,30 @@ options() const
         .add("decode", do_decode,
              "run the decoder (link function) after classification?")
         .add("link_function", link_function,
-             "which link function to use for the output function");
+             "which link function to use for the output function")
+        .add("streaming", streaming,
+             "train with passes over the data instead of a dense copy of it "
+             "(for when there are too many examples to fit in memory)")
+        .add("solver", solver, "irls|lbfgs|sgd",
+             "irls (exact), lbfgs or sgd; the last two always stream and "
+             "are for models with too many features for irls")
+        .add("l1", l1, "N>=0",
+             "weight of the L1 penalty on the normalized weights (lbfgs "
+             "and sgd only)")
+        .add("l2", l2, "N>=0",
+             "weight of the L2 penalty on the normalized weights (lbfgs "
+             "and sgd only)")
+        .add("max_iterations", max_iterations, "N>=1",
+             "maximum number of iterations for lbfgs")
+        .add("epochs", epochs, "N>=1",
+             "number of passes over the data for sgd")
+        .add("minibatch_size", minibatch_size, "N>=1",
+             "number of examples in each step of sgd")
+        .add("learning_rate", learning_rate, "N>0",
+             "initial step size for sgd")
+        .add("chunk_size", chunk_size, "N>=1",
+             "number of examples read at once by each thread when training "
+             "with passes over the data");
 
     return result;
 }
@@ -208,6 +506,11 @@ train_weighted(Thread_Context & thread_context,
         }
     }
     
+    if (streaming || solver != "irls") {
+        train_streaming(data, weights, result);
+        return 0.0;
+    }
+
     size_t nl = result.label_count();        // Number of labels
     bool regression_problem = (nl == 1);
     size_t nx = data.example_count();        // Number of examples
@@ -326,45 +629,77 @@ train_weighted(Thread_Context & thread_context,
     if (nl == 2) nlr = 1;
         
     /* Perform a GLZ for each label. */
-    result.weights.clear();
-    double extra_bias = 0.0;
+    vector<distribution<double> > trained;
     for (unsigned l = 0;  l < nlr;  ++l) {
         //cerr << "l = " << l << "  correct[l] = " << correct[l]
         //     << " w = " << w[l] << endl;
             
-        distribution<double> trained
-            = perform_irls(correct[l], dense_data, w[l], link_function,
-                           ridge_regression);
-
-        trained /= stds;
-        extra_bias = - (trained.dotprod(means));
-
-        if (extra_bias != 0.0) {
-            if (!add_bias)
-                throw Exception("extra bias but nowhere to put it");
-            trained.back() += extra_bias;
-        }
-        
-        //cerr << "l = " << l <<"  param = " << param << endl;
-            
-        result.weights.push_back(trained.cast<float>());
+        trained.push_back(perform_irls(correct[l], dense_data, w[l],
+                                       link_function, ridge_regression));
     }
 
+    set_weights(result, trained, means, stds, add_bias, nl);
+
     cerr << "irls: " << t.elapsed() << endl;
     t.restart();
         
-    if (nl == 2) {
-        // weights for second label are the mirror of those of the first
-        // label
-        result.weights.push_back(-1.0F * result.weights.front());
-    }
-
     //cerr << "glz_classifier: irls time " << t.elapsed() << "s" << endl;
     
     return 0.0;
 }
 
 
+void
+GLZ_Classifier_Generator::
+train_streaming(const Training_Data & data,
+                const boost::multi_array<float, 2> & weights,
+                GLZ_Classifier & result) const
+{
+    size_t nx = data.example_count();
+
+    vector<int> example_nums;
+    for (unsigned x = 0;  x < nx;  ++x) {
+        double total_weight = 0.0;
+        for (unsigned l = 0;  l < weights.shape()[1];  ++l)
+            total_weight += weights[x][l];
+        if (total_weight != 0.0)
+            example_nums.push_back(x);
+    }
+
+    GLZ_Example_Source source(data, weights, result, example_nums);
+
+    if (normalize)
+        source.calc_normalization();
+
+    GLZ_Solver_Params params;
+    params.l1 = l1;
+    params.l2 = l2;
+    params.unregularized = (add_bias ? source.variables() - 1 : -1);
+    params.max_iter = max_iterations;
+    params.epochs = epochs;
+    params.minibatch_size = minibatch_size;
+    params.learning_rate = learning_rate;
+    params.chunk_size = chunk_size;
+
+    int nl = result.label_count();
+    int nlr = (nl == 2 ? 1 : nl);
+
+    vector<distribution<double> > trained;
+    for (unsigned l = 0;  l < nlr;  ++l) {
+        source.label = l;
+        if (solver == "lbfgs")
+            trained.push_back(glz_lbfgs(source, link_function, params));
+        else if (solver == "sgd")
+            trained.push_back(glz_sgd(source, link_function, params));
+        else trained.push_back(perform_irls_streaming(source, link_function,
+                                                      ridge_regression,
+                                                      chunk_size));
+    }
+
+    set_weights(result, trained, source.means, source.stds, add_bias, nl);
+}
+
+
 /*****************************************************************************/
 /* REGISTRATION                                                              */
 /*****************************************************************************/
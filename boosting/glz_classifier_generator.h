@@ -63,6 +63,15 @@ public:
     bool ridge_regression;
     Link_Function link_function;
     float feature_proportion;
+    bool streaming;
+    std::string solver;
+    float l1;
+    float l2;
+    int max_iterations;
+    int epochs;
+    int minibatch_size;
+    float learning_rate;
+    int chunk_size;
 
     /* Once init has been called, we clone our potential models from this
        one. */
@@ -74,6 +83,14 @@ public:
                          const boost::multi_array<float, 2> & weights,
                          const std::vector<Feature> & features,
                          GLZ_Classifier & result) const;
+
+    /** Train the weights of result, whose features have already been
+        chosen, with passes over the training data rather than by building
+        a dense matrix of it.  Used when streaming is set or the solver is
+        lbfgs or sgd. */
+    void train_streaming(const Training_Data & data,
+                         const boost::multi_array<float, 2> & weights,
+                         GLZ_Classifier & result) const;
 };
 
 
@@ -103,13 +103,14 @@ public:
                             + ": Attempt to serialize unregistered class "
                             + classid);
 
-        DB::Nested_Writer writer;
-        obj->serialize(writer);
-
         store << classid << DB::compact_size_t(VERSION);
 
-        /* Write out the contents. */
-        store << writer;
+        /* Write out the contents.  They're written in place, so that any
+           aligned sections in them (see DB::Mapped_Array) can be used
+           straight from a memory mapped file. */
+        DB::Nested_Writer writer(store);
+        obj->serialize(writer);
+        writer.write_in_place(store);
     }
 
     static std::string entry_list()
@@ -11,6 +11,7 @@
 #include "jml/utils/parse_context.h"
 #include "jml/utils/file_functions.h"
 #include <boost/utility.hpp>
+#include <mutex>
 #include "config_impl.h"
 
 
@@ -50,7 +51,7 @@ set_info(const Feature & feature, const Feature_Info & info)
         throw Exception("attempt to set feature info for missing feature");
     //cerr << this << endl;
     //cerr << "setting info for feature " << feature << endl;
-    //cerr << "string_lookup.size() = " << string_lookup.size() << endl;
+    //cerr << "names.size() = " << names.size() << endl;
     Mutable_Feature_Info & infoa = info_array.at(feature.type());
     infoa = info;
 }
@@ -163,37 +164,40 @@ make_feature(const std::string & name, const Feature_Info & info)
 {
     //cerr << "make_feature(\"" << name << "\")" << endl;
 
-    string_lookup_type::const_iterator it = string_lookup.find(name);
-    if (it == string_lookup.end()) {
-        string_lookup[name] = info_array.size();
-        info_array.push_back(info);
-        name_array.push_back(name);
-        return Feature(info_array.size() - 1);
-    }
+    int id = names.lookup(name);
+    if (id != -1) return Feature(id);
+
+    std::lock_guard<Spinlock> guard(lock);
 
-    return Feature(it->second);
+    id = names.lookup(name);
+    if (id != -1) return Feature(id);
+
+    /* The info goes in first, so that it's there for anyone who finds the
+       name. */
+    info_array.push_back(info);
+    return Feature(names.intern(name));
 }
 
 std::string Sparse_Feature_Space::get_name(const Feature & feature) const
 {
     int id = feature.type();
-    if (id < 0 || id >= name_array.size())
+    if (id < 0 || id >= names.size())
         throw Exception("Feature with unknown ID " + ostream_format(id)
                         + " requested from Sparse_Feature_Space: "
                         + feature.print());
 
-    return name_array[id];
+    return names[id];
 }
 
 Feature Sparse_Feature_Space::get_feature(const std::string & name) const
 {
-    string_lookup_type::const_iterator it = string_lookup.find(name);
-    if (it == string_lookup.end()) {
+    int id = names.lookup(name);
+    if (id == -1) {
         return const_cast<Sparse_Feature_Space *>(this)->make_feature(name);
         //throw Exception("Feature with name " + name + " not found in "
         //                "Sparse_Feature_Space");
     }
-    return Feature(it->second);
+    return Feature(id);
 }
 
 
@@ -342,6 +346,9 @@ init(const std::vector<std::string> & filenames,
        reparse the array.  We keep on going until we are right about which
        are categorical. */
     bool guessed_wrong = false;
+
+    /* Each line is parsed into this, then copied into the arena. */
+    Mutable_Feature_Set features;
     
     /* Keep on going until we get all the categorical values correct. */
     do {
@@ -361,8 +368,7 @@ init(const std::vector<std::string> & filenames,
             c.skip_line();
             
             while (c) {
-                std::shared_ptr<Mutable_Feature_Set>
-                    features(new Mutable_Feature_Set());
+                features.clear();
                 
                 try {
                     c.skip_whitespace();
@@ -374,7 +380,7 @@ init(const std::vector<std::string> & filenames,
                     
                     /* Allow a label to be specified, with the implicit feature
                        name "LABEL", in the first position. */
-                    if (match_label(c, *features, *feature_space))
+                    if (match_label(c, features, *feature_space))
                         c.skip_whitespace();
                     
                     while (!c.match_eol()) {
@@ -384,7 +390,7 @@ init(const std::vector<std::string> & filenames,
                             break;
                         }
                         else {
-                            expect_feature(c, *features, *feature_space,
+                            expect_feature(c, features, *feature_space,
                                            guessed_wrong);
                             c.skip_whitespace();
                         }
@@ -396,9 +402,9 @@ init(const std::vector<std::string> & filenames,
                     c.skip_line();
                 }
 
-                //cerr << "features are " << feature_space->print(*features) << endl;
+                //cerr << "features are " << feature_space->print(features) << endl;
                 
-                add_example(features);
+                add_example_copy(features);
             }
         }
 
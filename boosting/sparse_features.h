@@ -14,6 +14,7 @@
 #include "training_data.h"
 #include <map>
 #include "jml/utils/hash_map.h"
+#include "jml/utils/string_interner.h"
 #include <string>
 
 
@@ -80,11 +81,12 @@ public:
     using Feature_Space::parse;
 
 protected:    
-    typedef std::hash_map<std::string, int> string_lookup_type;
-    mutable string_lookup_type string_lookup;
-
-    mutable std::vector<Mutable_Feature_Info> info_array;
-    mutable std::vector<std::string> name_array;
+    /* Features that already exist are found without locking, so that
+       many threads can parse into the same feature space.  Only adding a
+       feature takes the lock. */
+    mutable String_Interner names;
+    mutable Append_Only_Array<Mutable_Feature_Info> info_array;
+    Spinlock lock;
 
     /** Return the name of the given feature.  Throws if the feature is
         unknown. */
@@ -5,6 +5,9 @@ $(eval $(call test,decision_tree_unlimited_depth_test,boosting utils arch worker
 $(eval $(call test,glz_classifier_test,boosting utils arch worker_task,boost))
 $(eval $(call test,probabilizer_test,boosting utils arch,boost))
 $(eval $(call test,feature_info_test,boosting utils arch,boost))
+$(eval $(call test,feature_set_arena_test,boosting utils arch,boost))
+$(eval $(call test,training_data_serialization_test,boosting utils arch worker_task,boost))
+$(eval $(call test,buckets_test,boosting utils arch worker_task,boost))
 
 $(eval $(call program,dataset_nan_test,boosting utils arch boosting_tools))
 
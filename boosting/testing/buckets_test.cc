@@ -0,0 +1,104 @@
+/* buckets_test.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Test that streaming buckets are close to the sort-based ones.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <algorithm>
+#include <vector>
+#include <iostream>
+
+#include "jml/boosting/buckets.h"
+
+using namespace ML;
+using namespace std;
+
+using boost::unit_test::test_suite;
+
+/* Number of values in each bucket, as a fraction of all of them. */
+vector<double> occupancy(const Bucket_Info & info)
+{
+    vector<double> result(info.splits.size() + 1);
+    for (unsigned i = 0;  i < info.buckets.size();  ++i)
+        result.at(info.buckets[i]) += 1.0 / info.buckets.size();
+    return result;
+}
+
+void check_consistent(const Bucket_Info & info, const vector<float> & values)
+{
+    BOOST_REQUIRE_EQUAL(info.buckets.size(), values.size());
+    for (unsigned i = 0;  i < values.size();  ++i)
+        BOOST_REQUIRE_EQUAL(info.buckets[i],
+                            std::upper_bound(info.splits.begin(),
+                                             info.splits.end(), values[i])
+                            - info.splits.begin());
+}
+
+BOOST_AUTO_TEST_CASE( test_streaming_buckets_continuous )
+{
+    boost::mt19937 rng;
+    boost::normal_distribution<float> normal;
+    boost::variate_generator<boost::mt19937 &,
+                             boost::normal_distribution<float> >
+        gen(rng, normal);
+
+    // Mostly continuous, with one heavily repeated value as for a default
+    vector<float> values;
+    for (unsigned i = 0;  i < 500000;  ++i)
+        values.push_back(i % 10 == 0 ? 0.0 : gen());
+
+    size_t num_buckets = 100;
+    Bucket_Info exact = create_buckets(values, num_buckets);
+    Bucket_Info streaming = create_buckets_streaming(values, num_buckets);
+
+    check_consistent(streaming, values);
+
+    vector<double> exact_occ = occupancy(exact);
+    vector<double> streaming_occ = occupancy(streaming);
+
+    cerr << "exact: " << exact_occ.size() << " buckets, largest "
+         << *std::max_element(exact_occ.begin(), exact_occ.end())
+         << "; streaming: " << streaming_occ.size() << " buckets, largest "
+         << *std::max_element(streaming_occ.begin(), streaming_occ.end())
+         << endl;
+
+    // About as many buckets, and none much fuller than the fullest exact
+    // one (which holds the repeated value)
+    BOOST_CHECK_LE(streaming_occ.size(), num_buckets + 1);
+    BOOST_CHECK_GE(streaming_occ.size(), exact_occ.size() * 9 / 10);
+    BOOST_CHECK_LE(*std::max_element(streaming_occ.begin(),
+                                     streaming_occ.end()),
+                   *std::max_element(exact_occ.begin(), exact_occ.end())
+                   + 0.01);
+
+    // The continuous part is spread about as evenly
+    double ideal = 0.9 / num_buckets;
+    int uneven = 0;
+    for (unsigned i = 0;  i < streaming_occ.size();  ++i)
+        if (streaming_occ[i] < 0.05 && streaming_occ[i] > 3 * ideal)
+            ++uneven;
+    BOOST_CHECK_EQUAL(uneven, 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_streaming_buckets_categorical )
+{
+    // With fewer distinct values than buckets, both give each its own
+    vector<float> values;
+    for (unsigned i = 0;  i < 100000;  ++i)
+        values.push_back((i * 7919) % 13);
+
+    Bucket_Info exact = create_buckets(values, 50);
+    Bucket_Info streaming = create_buckets_streaming(values, 50);
+
+    check_consistent(streaming, values);
+    BOOST_CHECK(streaming.splits == exact.splits);
+    BOOST_CHECK(streaming.buckets == exact.buckets);
+}
@@ -16,6 +16,7 @@
 #include <vector>
 #include <stdint.h>
 #include <iostream>
+#include <sstream>
 
 #include "jml/boosting/dense_features.h"
 #include "jml/boosting/feature_info.h"
@@ -43,3 +44,37 @@ BOOST_AUTO_TEST_CASE( test_glz_classifier_test )
     BOOST_CHECK_EQUAL(info.categorical()->print(0), "Male");
     BOOST_CHECK_EQUAL(info.categorical()->print(1), "Female");
 }
+
+BOOST_AUTO_TEST_CASE( test_categorical_info_duplicate_names )
+{
+    vector<string> names = { "a", "b", "a", "c", "b" };
+
+    /* The last of any duplicate names is the one that's found, both when
+       constructed and after a round trip through a store. */
+    Fixed_Categorical_Info info(names);
+    BOOST_CHECK_EQUAL(info.count(), 5);
+    BOOST_CHECK_EQUAL(info.lookup("a"), 2);
+    BOOST_CHECK_EQUAL(info.lookup("b"), 4);
+    BOOST_CHECK_EQUAL(info.lookup("c"), 3);
+    BOOST_CHECK_EQUAL(info.print(0), "a");
+
+    std::ostringstream os;
+    {
+        DB::Store_Writer store(os);
+        info.serialize(store);
+    }
+
+    std::istringstream is(os.str());
+    DB::Store_Reader store(is);
+    Fixed_Categorical_Info info2(store);
+    BOOST_CHECK_EQUAL(info2.count(), 5);
+    BOOST_CHECK_EQUAL(info2.lookup("a"), 2);
+    BOOST_CHECK_EQUAL(info2.lookup("b"), 4);
+
+    Mutable_Categorical_Info minfo(names);
+    BOOST_CHECK_EQUAL(minfo.parse_or_add("a"), 2);
+    BOOST_CHECK_EQUAL(minfo.parse_or_add("d"), 5);
+    minfo.freeze();
+    BOOST_CHECK_EQUAL(minfo.lookup("b"), 4);
+    BOOST_CHECK_EQUAL(minfo.lookup("e"), -1);
+}
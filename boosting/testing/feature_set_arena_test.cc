@@ -0,0 +1,90 @@
+/* feature_set_arena_test.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Test of datasets whose examples live in a Feature_Set_Arena.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <vector>
+#include <iostream>
+
+#include "jml/boosting/feature_set_arena.h"
+#include "jml/boosting/sparse_features.h"
+#include "jml/boosting/training_data.h"
+
+using namespace ML;
+using namespace std;
+
+using boost::unit_test::test_suite;
+
+BOOST_AUTO_TEST_CASE( test_arena )
+{
+    // A small slab, so that we cover going onto new slabs and examples
+    // too big for one
+    Feature_Set_Arena arena(1024);
+
+    vector<Packed_Feature_Set *> packed;
+    Mutable_Feature_Set features;
+
+    for (unsigned i = 0;  i < 1000;  ++i) {
+        features.clear();
+        for (int j = i % 200;  j >= 0;  --j)
+            features.add(Feature(j), i * 1000 + j);
+        packed.push_back(arena.add(features));
+    }
+
+    BOOST_CHECK(arena.memusage() >= 1000 * sizeof(Packed_Feature_Set));
+
+    for (unsigned i = 0;  i < 1000;  ++i) {
+        const Feature_Set & fs = *packed[i];
+        BOOST_REQUIRE_EQUAL(fs.size(), i % 200 + 1);
+        for (unsigned j = 0;  j <= i % 200;  ++j) {
+            // Sorted on the way in
+            BOOST_REQUIRE_EQUAL(fs[j].first, Feature(j));
+            BOOST_REQUIRE_EQUAL(fs[j].second, i * 1000 + j);
+        }
+        BOOST_CHECK_EQUAL(fs[Feature(0)], i * 1000);
+    }
+
+    // Empty ones are fine too
+    features.clear();
+    BOOST_CHECK_EQUAL(arena.add(features)->size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_training_data_arena )
+{
+    std::shared_ptr<Sparse_Feature_Space> fs(new Sparse_Feature_Space());
+    Feature a = fs->make_feature("a"), b = fs->make_feature("b");
+
+    Training_Data data(fs);
+
+    Mutable_Feature_Set features;
+    for (unsigned i = 0;  i < 100;  ++i) {
+        features.clear();
+        features.add(b, i);
+        features.add(a, -1.0 * i);
+        BOOST_CHECK_EQUAL(data.add_example_copy(features), i);
+    }
+
+    BOOST_REQUIRE_EQUAL(data.example_count(), 100);
+    BOOST_CHECK_EQUAL(data[10][a], -10.0);
+    BOOST_CHECK_EQUAL(data[10][b], 10.0);
+
+    // Modifying an example turns it into a normal one
+    BOOST_CHECK_EQUAL(data.modify_feature(10, b, 3.0), 10.0);
+    BOOST_CHECK_EQUAL(data[10][b], 3.0);
+    BOOST_CHECK_EQUAL(data[11][b], 11.0);
+
+    // Examples that are shared keep the arena alive
+    std::shared_ptr<Feature_Set> kept = data.share(20);
+    Training_Data copy(data);
+    data.clear();
+    BOOST_CHECK_EQUAL(data.example_count(), 0);
+    BOOST_CHECK_EQUAL((*kept)[a], -20.0);
+    BOOST_CHECK_EQUAL(copy.example_count(), 100);
+    BOOST_CHECK_EQUAL(copy[99][b], 99.0);
+}
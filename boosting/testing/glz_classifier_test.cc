@@ -13,6 +13,10 @@
 #include <boost/thread.hpp>
 #include <boost/thread/barrier.hpp>
 #include <boost/bind.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include <boost/random/uniform_01.hpp>
+#include <boost/random/variate_generator.hpp>
 #include <vector>
 #include <stdint.h>
 #include <iostream>
@@ -24,7 +28,10 @@
 #include "jml/boosting/training_index.h"
 #include "jml/utils/smart_ptr_utils.h"
 #include "jml/utils/vector_utils.h"
+#include "jml/utils/string_functions.h"
+#include "jml/utils/file_functions.h"
 #include "jml/arch/exception_handler.h"
+#include <unistd.h>
 
 using namespace ML;
 using namespace std;
@@ -236,6 +243,364 @@ BOOST_AUTO_TEST_CASE( test_glz_classifier_missing2 )
     BOOST_CHECK(info);
 }
 
+BOOST_AUTO_TEST_CASE( test_glz_classifier_streaming )
+{
+    /* Noisy labels from a logistic model, with one feature that's an exact
+       copy of another and one that's sometimes missing.  Training with
+       passes over the data should give the same model as the dense
+       matrix. */
+
+    Dense_Feature_Space fs;
+    fs.add_feature("LABEL", Feature_Info(BOOLEAN, false, true));
+    fs.add_feature("feature1", REAL);
+    fs.add_feature("feature2", REAL);
+    fs.add_feature("feature1copy", REAL);
+    fs.add_feature("feature3", REAL);
+
+    std::shared_ptr<Dense_Feature_Space> fsp(make_unowned_sp(fs));
+
+    Training_Data data(fsp);
+
+    float NaN = std::numeric_limits<float>::quiet_NaN();
+
+    boost::mt19937 rng;
+    boost::normal_distribution<double> norm;
+    boost::variate_generator<boost::mt19937 &,
+                             boost::normal_distribution<double> >
+        randn(rng, norm);
+    boost::uniform_01<boost::mt19937 &> rand01(rng);
+
+    int nx = 10000;
+
+    for (unsigned i = 0;  i < nx;  ++i) {
+        double f1 = randn(), f2 = 3.0 + randn(), f3 = randn();
+        double eta = 0.5 + 1.5 * f1 - 0.7 * (f2 - 3.0);
+        if (i % 4 == 0) f3 = NaN;
+        else eta += 0.3 * f3;
+
+        bool label = rand01() < 1.0 / (1.0 + exp(-eta));
+
+        distribution<float> features;
+        features.push_back(label);
+        features.push_back(f1);
+        features.push_back(f2);
+        features.push_back(f1);
+        features.push_back(f3);
+
+        data.add_example(fs.encode(features));
+    }
+
+    vector<Feature> features = fs.features();
+    features.erase(features.begin(), features.begin() + 1);
+
+    distribution<float> training_weights(nx, 1);
+
+    Thread_Context context;
+
+    auto train = [&] (bool streaming, const std::string & link)
+        {
+            Configuration config;
+            config.parse_string(config_options, "inbuilt config file");
+            config["streaming"] = (streaming ? "true" : "false");
+            // The ridge is chosen differently when streaming
+            config["ridge_regression"] = "false";
+            config["link_function"] = link;
+
+            GLZ_Classifier_Generator generator;
+            generator.configure(config);
+            generator.init(fsp, fs.features()[0]);
+
+            return generator.generate(context, data, training_weights,
+                                      features);
+        };
+
+    const char * links[2] = { "logit", "linear" };
+
+    for (unsigned i = 0;  i < 2;  ++i) {
+        std::string link = links[i];
+        std::shared_ptr<Classifier_Impl> dense = train(false, link);
+        std::shared_ptr<Classifier_Impl> streamed = train(true, link);
+
+        BOOST_CHECK_EQUAL(streamed->accuracy(data).first,
+                          dense->accuracy(data).first);
+
+        double max_diff = 0.0;
+        for (unsigned x = 0;  x < nx;  ++x)
+            max_diff = std::max<double>(max_diff,
+                                        abs(dense->predict(0, data[x])
+                                            - streamed->predict(0, data[x])));
+
+        cerr << "link " << link
+             << " max difference " << max_diff << endl;
+        BOOST_CHECK_SMALL(max_diff, 1e-4);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_glz_classifier_solvers )
+{
+    /* Labels from a logistic model plus a feature that's pure noise.
+       Without regularization L-BFGS should find the same model as IRLS and
+       SGD one close to it; with an L1 penalty the weight of the noise
+       feature should be exactly zero. */
+
+    Dense_Feature_Space fs;
+    fs.add_feature("LABEL", Feature_Info(BOOLEAN, false, true));
+    fs.add_feature("feature1", REAL);
+    fs.add_feature("feature2", REAL);
+    fs.add_feature("noise", REAL);
+
+    std::shared_ptr<Dense_Feature_Space> fsp(make_unowned_sp(fs));
+
+    Training_Data data(fsp);
+
+    boost::mt19937 rng;
+    boost::normal_distribution<double> norm;
+    boost::variate_generator<boost::mt19937 &,
+                             boost::normal_distribution<double> >
+        randn(rng, norm);
+    boost::uniform_01<boost::mt19937 &> rand01(rng);
+
+    int nx = 10000;
+
+    for (unsigned i = 0;  i < nx;  ++i) {
+        double f1 = randn(), f2 = 3.0 + randn(), noise = randn();
+        double eta = 0.5 + 1.5 * f1 - 0.7 * (f2 - 3.0);
+        bool label = rand01() < 1.0 / (1.0 + exp(-eta));
+
+        distribution<float> features;
+        features.push_back(label);
+        features.push_back(f1);
+        features.push_back(f2);
+        features.push_back(noise);
+
+        data.add_example(fs.encode(features));
+    }
+
+    vector<Feature> features = fs.features();
+    features.erase(features.begin(), features.begin() + 1);
+
+    distribution<float> training_weights(nx, 1);
+
+    Thread_Context context;
+
+    auto train = [&] (const std::string & solver, const std::string & link,
+                      float l1)
+        {
+            Configuration config;
+            config.parse_string(config_options, "inbuilt config file");
+            config["solver"] = solver;
+            config["ridge_regression"] = "false";
+            config["link_function"] = link;
+            config["l1"] = format("%f", l1);
+
+            GLZ_Classifier_Generator generator;
+            generator.configure(config);
+            generator.init(fsp, fs.features()[0]);
+
+            return generator.generate(context, data, training_weights,
+                                      features);
+        };
+
+    auto max_difference = [&] (const Classifier_Impl & c1,
+                               const Classifier_Impl & c2)
+        {
+            double result = 0.0;
+            for (unsigned x = 0;  x < nx;  ++x)
+                result = std::max<double>(result,
+                                          abs(c1.predict(0, data[x])
+                                              - c2.predict(0, data[x])));
+            return result;
+        };
+
+    const char * links[2] = { "logit", "linear" };
+
+    for (unsigned i = 0;  i < 2;  ++i) {
+        std::string link = links[i];
+        std::shared_ptr<Classifier_Impl> irls = train("irls", link, 0.0);
+        std::shared_ptr<Classifier_Impl> lbfgs = train("lbfgs", link, 0.0);
+        std::shared_ptr<Classifier_Impl> sgd = train("sgd", link, 0.0);
+
+        double lbfgs_diff = max_difference(*irls, *lbfgs);
+        double sgd_diff = max_difference(*irls, *sgd);
+
+        cerr << "link " << link << " lbfgs max difference " << lbfgs_diff
+             << " sgd max difference " << sgd_diff << endl;
+
+        BOOST_CHECK_SMALL(lbfgs_diff, 1e-3);
+        BOOST_CHECK_SMALL(sgd_diff, 0.05);
+
+        BOOST_CHECK_CLOSE(lbfgs->accuracy(data).first,
+                          irls->accuracy(data).first, 0.5 /* percent */);
+        BOOST_CHECK_CLOSE(sgd->accuracy(data).first,
+                          irls->accuracy(data).first, 1.0 /* percent */);
+    }
+
+    // Sparse model from each of the L1 regularized solvers
+    const char * solvers[2] = { "lbfgs", "sgd" };
+    for (unsigned i = 0;  i < 2;  ++i) {
+        std::shared_ptr<Classifier_Impl> classifier
+            = train(solvers[i], "logit", 0.02);
+        const GLZ_Classifier & glz
+            = dynamic_cast<const GLZ_Classifier &>(*classifier);
+
+        BOOST_REQUIRE_EQUAL(glz.features.size(), 3);
+        BOOST_CHECK_EQUAL(glz.features[2].feature, features[2]);
+
+        cerr << solvers[i] << " weights "
+             << distribution<float>(glz.weights[0].begin(),
+                                    glz.weights[0].end()) << endl;
+
+        BOOST_CHECK_EQUAL(glz.weights[0][2], 0.0);
+        BOOST_CHECK(glz.weights[0][0] != 0.0);
+        BOOST_CHECK(glz.weights[0][1] != 0.0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_glz_classifier_sparse_chunks )
+{
+    /* A feature that's missing for most of the examples, so that it's
+       decoded into both a value and a presence variable.  L-BFGS reads the
+       examples as sparse rows, and should find the same model as the dense
+       IRLS whatever the chunk size. */
+
+    Dense_Feature_Space fs;
+    fs.add_feature("LABEL", Feature_Info(BOOLEAN, false, true));
+    fs.add_feature("feature1", REAL);
+    fs.add_feature("rare", REAL);
+
+    std::shared_ptr<Dense_Feature_Space> fsp(make_unowned_sp(fs));
+
+    Training_Data data(fsp);
+
+    float NaN = std::numeric_limits<float>::quiet_NaN();
+
+    boost::mt19937 rng;
+    boost::normal_distribution<double> norm;
+    boost::variate_generator<boost::mt19937 &,
+                             boost::normal_distribution<double> >
+        randn(rng, norm);
+    boost::uniform_01<boost::mt19937 &> rand01(rng);
+
+    int nx = 5000;
+
+    for (unsigned i = 0;  i < nx;  ++i) {
+        double f1 = randn(), rare = NaN;
+        double eta = 0.2 + f1;
+        if (i % 5 == 0) {
+            rare = 1.0 + randn();
+            eta += 0.5 - 0.8 * rare;
+        }
+
+        bool label = rand01() < 1.0 / (1.0 + exp(-eta));
+
+        distribution<float> features;
+        features.push_back(label);
+        features.push_back(f1);
+        features.push_back(rare);
+
+        data.add_example(fs.encode(features));
+    }
+
+    vector<Feature> features = fs.features();
+    features.erase(features.begin(), features.begin() + 1);
+
+    distribution<float> training_weights(nx, 1);
+
+    Thread_Context context;
+
+    auto train = [&] (const std::string & solver, int chunk_size)
+        {
+            Configuration config;
+            config.parse_string(config_options, "inbuilt config file");
+            config["solver"] = solver;
+            config["ridge_regression"] = "false";
+            config["chunk_size"] = format("%d", chunk_size);
+
+            GLZ_Classifier_Generator generator;
+            generator.configure(config);
+            generator.init(fsp, fs.features()[0]);
+
+            return generator.generate(context, data, training_weights,
+                                      features);
+        };
+
+    std::shared_ptr<Classifier_Impl> irls = train("irls", 4096);
+
+    int chunk_sizes[2] = { 4096, 7 };
+    for (unsigned i = 0;  i < 2;  ++i) {
+        std::shared_ptr<Classifier_Impl> lbfgs
+            = train("lbfgs", chunk_sizes[i]);
+
+        const GLZ_Classifier & glz
+            = dynamic_cast<const GLZ_Classifier &>(*lbfgs);
+        BOOST_CHECK_EQUAL(glz.features.size(), 3);
+
+        double max_diff = 0.0;
+        for (unsigned x = 0;  x < nx;  ++x)
+            max_diff = std::max<double>(max_diff,
+                                        abs(irls->predict(0, data[x])
+                                            - lbfgs->predict(0, data[x])));
+
+        cerr << "chunk size " << chunk_sizes[i]
+             << " max difference " << max_diff << endl;
+        BOOST_CHECK_SMALL(max_diff, 1e-3);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_glz_classifier_mapped )
+{
+    /* A classifier loaded from an uncompressed file uses its weights in
+       place from the mapped file; from a compressed one they're copied. */
+
+    int nf = 1000;
+
+    Dense_Feature_Space fs;
+    fs.add_feature("LABEL", Feature_Info(BOOLEAN, false, true));
+    for (unsigned i = 0;  i < nf;  ++i)
+        fs.add_feature(format("feature%d", i), REAL);
+
+    std::shared_ptr<Dense_Feature_Space> fsp(make_unowned_sp(fs));
+
+    GLZ_Classifier glz(fsp, fs.features()[0]);
+    distribution<float> label_weights(nf + 1);
+    for (unsigned i = 0;  i < nf;  ++i) {
+        glz.features.push_back(GLZ_Classifier::Feature_Spec
+                               (fs.features()[i + 1]));
+        label_weights[i] = (i % 7) * 0.001 - 0.003;
+    }
+    label_weights[nf] = 0.25;
+    glz.weights.push_back(DB::Mapped_Array<float>(label_weights));
+    glz.weights.push_back(DB::Mapped_Array<float>(-1.0F * label_weights));
+    BOOST_CHECK(!glz.weights[0].mapped());
+
+    distribution<float> values(nf + 1);
+    for (unsigned i = 1;  i <= nf;  ++i)
+        values[i] = (i % 3) - 1.0;
+    std::shared_ptr<Mutable_Feature_Set> example = fs.encode(values);
+
+    string filename = format("/tmp/glz_classifier_test.%d", getpid());
+
+    const char * extensions[2] = { "", ".gz" };
+    for (unsigned i = 0;  i < 2;  ++i) {
+        string file = filename + extensions[i];
+        Classifier(glz).save(file);
+
+        Classifier loaded;
+        loaded.load(file, fsp);
+        delete_file(file);
+
+        const GLZ_Classifier & loaded_glz
+            = dynamic_cast<const GLZ_Classifier &>(*loaded.impl);
+
+        BOOST_REQUIRE_EQUAL(loaded_glz.weights.size(), 2);
+        BOOST_CHECK_EQUAL(loaded_glz.weights[0].mapped(), i == 0);
+        BOOST_CHECK(std::equal(label_weights.begin(), label_weights.end(),
+                               loaded_glz.weights[0].begin()));
+        BOOST_CHECK_EQUAL(loaded.predict(1, *example),
+                          glz.predict(1, *example));
+    }
+}
+
 #define do_decode(val, type)                           \
     classifier.decode_value(val, \
                             GLZ_Classifier::Feature_Spec(Feature(1),    \
@@ -0,0 +1,102 @@
+/* training_data_serialization_test.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Test of saving and loading training data in row and column formats.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <vector>
+#include <sstream>
+#include <cmath>
+
+#include "jml/boosting/sparse_features.h"
+#include "jml/boosting/training_data.h"
+#include "jml/db/persistent.h"
+
+using namespace ML;
+using namespace ML::DB;
+using namespace std;
+
+using boost::unit_test::test_suite;
+
+string save(const Training_Data & data, Training_Data::Storage_Format format)
+{
+    ostringstream stream;
+    {
+        Store_Writer store(stream);
+        data.serialize(store, format);
+    }
+    return stream.str();
+}
+
+void check_equal(const Training_Data & data1, const Training_Data & data2)
+{
+    BOOST_REQUIRE_EQUAL(data1.example_count(), data2.example_count());
+    for (unsigned x = 0;  x < data1.example_count();  ++x) {
+        const Feature_Set & fs1 = data1[x], & fs2 = data2[x];
+        BOOST_REQUIRE_EQUAL(fs1.size(), fs2.size());
+        for (unsigned i = 0;  i < fs1.size();  ++i) {
+            BOOST_REQUIRE_EQUAL(fs1[i].first, fs2[i].first);
+            float v1 = fs1[i].second, v2 = fs2[i].second;
+            if (std::isnan(v1)) BOOST_REQUIRE(std::isnan(v2));
+            else {
+                BOOST_REQUIRE_EQUAL(v1, v2);
+                BOOST_REQUIRE_EQUAL(std::signbit(v1), std::signbit(v2));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_column_format )
+{
+    std::shared_ptr<Sparse_Feature_Space> fs(new Sparse_Feature_Space());
+    Feature label = fs->make_feature("label");     // constant
+    Feature count = fs->make_feature("count");     // small integers
+    Feature id = fs->make_feature("id");           // large integers
+    Feature score = fs->make_feature("score");     // floats with NaNs
+    Feature rare = fs->make_feature("rare");       // -0.0, repeated in rows
+
+    Training_Data data(fs);
+    Mutable_Feature_Set features;
+    for (unsigned i = 0;  i < 2000;  ++i) {
+        features.clear();
+        if (i % 100 == 7) {
+            // Leave it empty
+            data.add_example_copy(features);
+            continue;
+        }
+        features.add(label, 1.0);
+        features.add(count, i % 13);
+        features.add(id, i * 1000);
+        features.add(score, i % 5 == 0 ? NAN : i * 0.37);
+        if (i % 97 == 0) {
+            features.add(rare, -0.0);
+            features.add(rare, 3.5);
+        }
+        data.add_example_copy(features);
+    }
+
+    string rows = save(data, Training_Data::ROW_FORMAT);
+    string columns = save(data, Training_Data::COLUMN_FORMAT);
+    BOOST_CHECK_LT(columns.size(), rows.size() / 2);
+
+    for (int format = 0;  format < 2;  ++format) {
+        const string & saved = format == 0 ? rows : columns;
+        Store_Reader store(saved.c_str(), saved.size());
+        Training_Data loaded(fs);
+        loaded.reconstitute(store);
+        check_equal(data, loaded);
+    }
+
+    // An empty dataset makes it through too
+    Training_Data empty(fs);
+    string saved = save(empty, Training_Data::COLUMN_FORMAT);
+    Store_Reader store(saved.c_str(), saved.size());
+    Training_Data loaded(fs);
+    loaded.reconstitute(store);
+    BOOST_CHECK_EQUAL(loaded.example_count(), 0);
+}
@@ -9,6 +9,7 @@
 #include "config_impl.h"
 #include "training_data.h"
 #include "training_index.h"
+#include "feature_set_arena.h"
 #include "jml/utils/file_functions.h"
 #include "jml/utils/pair_utils.h"
 #include "jml/utils/filter_streams.h"
@@ -16,8 +17,13 @@
 #include "jml/utils/sgi_numeric.h"
 #include <boost/progress.hpp>
 #include "jml/db/persistent.h"
+#include "jml/db/nested_archive.h"
 #include "jml/utils/hash_map.h"
 #include "jml/arch/demangle.h"
+#include "jml/utils/worker_task.h"
+#include <numeric>
+#include <limits>
+#include <cmath>
 
 
 using namespace std;
@@ -64,6 +70,7 @@ init(std::shared_ptr<const Feature_Space> feature_space)
 void Training_Data::clear()
 {
     data_.clear();
+    arena_.reset();
     index_.reset();
     dirty_ = false;
 }
@@ -71,6 +78,7 @@ void Training_Data::clear()
 void Training_Data::swap(Training_Data & other)
 {
     std::swap(data_, other.data_);
+    std::swap(arena_, other.arena_);
     std::swap(index_, other.index_);
     std::swap(feature_space_, other.feature_space_);
     std::swap(dirty_, other.dirty_);
@@ -97,22 +105,33 @@ void Training_Data::dump(std::ostream & stream) const
     }
 }
 
-void Training_Data::serialize(DB::Store_Writer & store) const
+void Training_Data::serialize(DB::Store_Writer & store,
+                              Storage_Format format) const
 {
     store << string("TRAINING_DATA");  // tag
-    store << compact_size_t(1);  // version
-    store << compact_size_t(data_.size());
 
-    for (unsigned i = 0;  i < data_.size();  ++i)
-        feature_space()->serialize(store, *data_[i]);
+    if (format == COLUMN_FORMAT) {
+        store << compact_size_t(2);  // version
+        serialize_columns(store);
+    }
+    else {
+        store << compact_size_t(1);  // version
+        store << compact_size_t(data_.size());
+
+        for (unsigned i = 0;  i < data_.size();  ++i)
+            feature_space()->serialize(store, *data_[i]);
+    }
 
     store << compact_size_t(12345);  // ending marker
 }
 
-void Training_Data::save(const std::string & filename) const
+void Training_Data::save(const std::string & filename,
+                         const std::string & compression,
+                         int compressionLevel,
+                         Storage_Format format) const
 {
-    Store_Writer store(filename);
-    serialize(store);
+    Store_Writer store(filename, compression, compressionLevel);
+    serialize(store, format);
 }
     
 void Training_Data::reconstitute(DB::Store_Reader & store)
@@ -134,19 +153,339 @@ void Training_Data::reconstitute(DB::Store_Reader & store)
             feature_space()->reconstitute(store, ex);
             add_example(ex);
         }
-        
-        compact_size_t marker(store);
-        if (marker != 12345)
-            throw Exception("Training_Data::reconstitue(): end marker invalid "
-                            "or not found");
         break;
     }
+
+    case 2:
+        clear();
+        reconstitute_columns(store);
+        break;
         
     default:
         throw Exception("Training_Data::reconstitute(): unknown version");
     }
+
+    compact_size_t marker(store);
+    if (marker != 12345)
+        throw Exception("Training_Data::reconstitue(): end marker invalid "
+                        "or not found");
 }
     
+namespace {
+
+/* In the column format, the examples are written one feature at a time.
+   After the number of examples, the features that occur are listed in
+   order, and then each has a nested section with its occurrences:
+
+   compact_size_t    number of occurrences
+   char              how the examples they're in are written:
+                     - ROWS_DELTA: the gap from the previous one, as a
+                       compact_size_t (0 for another value in the same one)
+                     - ROWS_BITMAP: a bit per example
+   char              whether a bitmap of the occurrences that are missing
+                     (NaN) follows
+   char              how the values of the others are written: a single
+                     VALUES_CONSTANT, or an array of VALUES_UINT8,
+                     VALUES_UINT16 or VALUES_FLOAT
+*/
+
+enum {
+    ROWS_DELTA = 0,
+    ROWS_BITMAP = 1
+};
+
+enum {
+    VALUES_CONSTANT = 0,
+    VALUES_UINT8 = 1,
+    VALUES_UINT16 = 2,
+    VALUES_FLOAT = 3
+};
+
+/** All occurrences of a feature, in example order. */
+struct Column {
+    Feature feature;
+    std::vector<unsigned> rows;
+    std::vector<float> values;
+
+    bool operator < (const Column & other) const
+    {
+        return feature < other.feature;
+    }
+};
+
+typedef std::vector<unsigned char> Bitmap;
+
+inline bool get_bit(const Bitmap & bits, size_t i)
+{
+    return bits[i / 8] & (1 << (i % 8));
+}
+
+inline void set_bit(Bitmap & bits, size_t i)
+{
+    bits[i / 8] |= 1 << (i % 8);
+}
+
+/** Does the value make it through the integer type unchanged?  -0.0
+    doesn't. */
+template<typename Int>
+bool fits(float value)
+{
+    return value >= 0 && !std::signbit(value)
+        && value <= std::numeric_limits<Int>::max()
+        && Int(value) == value;
+}
+
+template<typename Int>
+void save_quantized(DB::Store_Writer & store, const std::vector<float> & values)
+{
+    std::vector<Int> quantized(values.begin(), values.end());
+    store.save_array(quantized.data(), quantized.size());
+}
+
+template<typename Int>
+void load_quantized(DB::Store_Reader & store, std::vector<float> & values)
+{
+    std::vector<Int> quantized(values.size());
+    store.load_array(quantized.data(), quantized.size());
+    std::copy(quantized.begin(), quantized.end(), values.begin());
+}
+
+void encode_column(DB::Store_Writer & store, const Column & column,
+                   size_t num_rows)
+{
+    size_t n = column.rows.size();
+    store << compact_size_t(n);
+
+    bool repeats = false;
+    for (size_t i = 1;  i < n && !repeats;  ++i)
+        repeats = column.rows[i] == column.rows[i - 1];
+
+    // A bitmap costs a bit per example, a gap at least a byte per occurrence
+    if (!repeats && num_rows / 8 < n) {
+        store << (char)ROWS_BITMAP;
+        Bitmap rows((num_rows + 7) / 8);
+        for (size_t i = 0;  i < n;  ++i)
+            set_bit(rows, column.rows[i]);
+        store.save_array(rows.data(), rows.size());
+    }
+    else {
+        store << (char)ROWS_DELTA;
+        unsigned last = 0;
+        for (size_t i = 0;  i < n;  ++i) {
+            store << compact_size_t(column.rows[i] - last);
+            last = column.rows[i];
+        }
+    }
+
+    Bitmap missing((n + 7) / 8);
+    std::vector<float> values;
+    values.reserve(n);
+    for (size_t i = 0;  i < n;  ++i) {
+        if (std::isnan(column.values[i])) set_bit(missing, i);
+        else values.push_back(column.values[i]);
+    }
+
+    bool has_missing = values.size() != n;
+    store << (char)has_missing;
+    if (has_missing)
+        store.save_array(missing.data(), missing.size());
+
+    bool constant = !values.empty(), is_uint8 = true, is_uint16 = true;
+    for (size_t i = 0;  i < values.size();  ++i) {
+        constant = constant && values[i] == values[0]
+            && std::signbit(values[i]) == std::signbit(values[0]);
+        is_uint8 = is_uint8 && fits<uint8_t>(values[i]);
+        is_uint16 = is_uint16 && fits<uint16_t>(values[i]);
+    }
+
+    if (constant)
+        store << (char)VALUES_CONSTANT << values[0];
+    else if (is_uint8) {
+        store << (char)VALUES_UINT8;
+        save_quantized<uint8_t>(store, values);
+    }
+    else if (is_uint16) {
+        store << (char)VALUES_UINT16;
+        save_quantized<uint16_t>(store, values);
+    }
+    else {
+        store << (char)VALUES_FLOAT;
+        store.save_array(values.data(), values.size());
+    }
+}
+
+void decode_column(DB::Store_Reader & store, Column & column,
+                   size_t num_rows)
+{
+    compact_size_t n(store);
+
+    char row_encoding;
+    store >> row_encoding;
+
+    column.rows.resize(n);
+    if (row_encoding == ROWS_BITMAP) {
+        Bitmap rows((num_rows + 7) / 8);
+        store.load_array(rows.data(), rows.size());
+        size_t i = 0;
+        for (size_t row = 0;  row < num_rows && i < n;  ++row)
+            if (get_bit(rows, row)) column.rows[i++] = row;
+        if (i != n)
+            throw Exception("Training_Data::reconstitute(): column has %zd "
+                            "examples in its bitmap; expected %zd",
+                            i, (size_t)n);
+    }
+    else if (row_encoding == ROWS_DELTA) {
+        size_t row = 0;
+        for (size_t i = 0;  i < n;  ++i) {
+            compact_size_t gap(store);
+            row += gap;
+            if (row >= num_rows)
+                throw Exception("Training_Data::reconstitute(): column "
+                                "refers to example %zd of %zd",
+                                row, num_rows);
+            column.rows[i] = row;
+        }
+    }
+    else throw Exception("Training_Data::reconstitute(): unknown row "
+                         "encoding %d", (int)row_encoding);
+
+    char has_missing;
+    store >> has_missing;
+
+    Bitmap missing;
+    size_t num_values = n;
+    if (has_missing) {
+        missing.resize((n + 7) / 8);
+        store.load_array(missing.data(), missing.size());
+        for (size_t i = 0;  i < n;  ++i)
+            num_values -= get_bit(missing, i);
+    }
+
+    char value_encoding;
+    store >> value_encoding;
+
+    std::vector<float> values(num_values);
+    switch (value_encoding) {
+    case VALUES_CONSTANT: {
+        float value;
+        store >> value;
+        std::fill(values.begin(), values.end(), value);
+        break;
+    }
+    case VALUES_UINT8:   load_quantized<uint8_t>(store, values);  break;
+    case VALUES_UINT16:  load_quantized<uint16_t>(store, values);  break;
+    case VALUES_FLOAT:
+        store.load_array(values.data(), values.size());
+        break;
+    default:
+        throw Exception("Training_Data::reconstitute(): unknown value "
+                        "encoding %d", (int)value_encoding);
+    }
+
+    column.values.resize(n);
+    for (size_t i = 0, j = 0;  i < n;  ++i)
+        column.values[i] = (has_missing && get_bit(missing, i)
+                            ? NAN : values[j++]);
+}
+
+} // file scope
+
+void
+Training_Data::
+serialize_columns(DB::Store_Writer & store) const
+{
+    /* Gather up the occurrences of each feature. */
+    vector<Column> columns;
+    std::hash_map<Feature, int> column_of;
+
+    for (unsigned x = 0;  x < data_.size();  ++x) {
+        const Feature_Set & example = *data_[x];
+        for (Feature_Set::const_iterator it = example.begin(),
+                 end = example.end();  it != end;  ++it) {
+            Feature feature = (*it).first;
+            std::hash_map<Feature, int>::const_iterator found
+                = column_of.find(feature);
+            if (found == column_of.end()) {
+                found = column_of.insert(make_pair(feature, columns.size()))
+                    .first;
+                columns.push_back(Column());
+                columns.back().feature = feature;
+            }
+
+            Column & column = columns[found->second];
+            column.rows.push_back(x);
+            column.values.push_back((*it).second);
+        }
+    }
+
+    /* In feature order, so that the examples come back out sorted. */
+    std::sort(columns.begin(), columns.end());
+
+    store << compact_size_t(data_.size()) << compact_size_t(columns.size());
+    for (unsigned i = 0;  i < columns.size();  ++i)
+        feature_space()->serialize(store, columns[i].feature);
+
+    /* Each column goes in its own section, so that they can be encoded and
+       decoded in parallel. */
+    vector<std::shared_ptr<Nested_Writer> > sections(columns.size());
+
+    auto encode = [&] (int i)
+        {
+            sections[i].reset(new Nested_Writer());
+            encode_column(*sections[i], columns[i], data_.size());
+        };
+
+    run_in_parallel(0, columns.size(), encode);
+
+    for (unsigned i = 0;  i < sections.size();  ++i)
+        store << *sections[i];
+}
+
+void
+Training_Data::
+reconstitute_columns(DB::Store_Reader & store)
+{
+    compact_size_t num_rows(store), num_columns(store);
+
+    vector<Column> columns(num_columns);
+    for (unsigned i = 0;  i < columns.size();  ++i)
+        feature_space()->reconstitute(store, columns[i].feature);
+
+    vector<string> sections(columns.size());
+    for (unsigned i = 0;  i < sections.size();  ++i)
+        store >> sections[i];
+
+    auto decode = [&] (int i)
+        {
+            Store_Reader section(sections[i].c_str(), sections[i].size());
+            decode_column(section, columns[i], num_rows);
+            string().swap(sections[i]);
+        };
+
+    run_in_parallel(0, columns.size(), decode);
+
+    /* Put the examples back together.  Going through the columns in order
+       leaves each of them sorted. */
+    vector<size_t> offsets(num_rows + 1);
+    for (unsigned i = 0;  i < columns.size();  ++i)
+        for (unsigned j = 0;  j < columns[i].rows.size();  ++j)
+            ++offsets[columns[i].rows[j] + 1];
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    vector<pair<Feature, float> > entries(offsets.back());
+    vector<size_t> pos(offsets.begin(), offsets.end() - 1);
+    for (unsigned i = 0;  i < columns.size();  ++i) {
+        const Column & column = columns[i];
+        for (unsigned j = 0;  j < column.rows.size();  ++j)
+            entries[pos[column.rows[j]]++]
+                = make_pair(column.feature, column.values[j]);
+    }
+
+    for (unsigned x = 0;  x < num_rows;  ++x)
+        add_example_copy(Packed_Feature_Set(entries.data() + offsets[x],
+                                            offsets[x + 1] - offsets[x]));
+}
+
 void Training_Data::load(const std::string & filename)
 {
     Store_Reader store(filename);
@@ -193,6 +532,22 @@ add_example(const std::shared_ptr<Feature_Set> & example)
     return example_num;
 }
 
+int Training_Data::
+add_example_copy(const Feature_Set & example)
+{
+    if (!arena_) arena_.reset(new Feature_Set_Arena());
+
+    /* Shares the arena's reference count, so nothing else is allocated. */
+    std::shared_ptr<Feature_Set> packed(arena_, arena_->add(example));
+
+    int example_num = data_.size();
+    data_.push_back(packed);
+
+    dirty_ = true;
+
+    return example_num;
+}
+
 size_t Training_Data::
 label_count(const Feature & predicted) const
 {
@@ -25,6 +25,7 @@ namespace ML {
 
 
 class Dataset_Index;
+class Feature_Set_Arena;
 
 
 /*****************************************************************************/
@@ -85,11 +86,24 @@ public:
     
     void dump(std::ostream & stream) const;
 
-    /** Serialize to the given store. */
-    void serialize(DB::Store_Writer & store) const;
-
-    /** Save to the given filename. */
-    void save(const std::string & filename) const;
+    /** How serialize() lays out the examples. */
+    enum Storage_Format {
+        ROW_FORMAT,     ///< Each example in turn; readable by old versions
+        COLUMN_FORMAT   ///< Each feature in turn; smaller, loads in parallel
+    };
+
+    /** Serialize to the given store.  Both formats are read back by
+        reconstitute(). */
+    void serialize(DB::Store_Writer & store,
+                   Storage_Format format = ROW_FORMAT) const;
+
+    /** Save to the given filename.  The compression (eg "zstd" or "lz4",
+        which are much faster to read back than "gz") and its level are
+        as for filter_ostream; by default they come from the extension. */
+    void save(const std::string & filename,
+              const std::string & compression = "",
+              int compressionLevel = -1,
+              Storage_Format format = ROW_FORMAT) const;
     
     /** Reconstitute from the given store. */
     void reconstitute(DB::Store_Reader & store);
@@ -155,6 +169,16 @@ public:
     */
     int add_example(const std::shared_ptr<Feature_Set> & example);
 
+    /** Add a copy of the given example, packed into slabs of memory that
+        belong to this dataset rather than into allocations of its own.
+        This is the one to use for loading lots of examples, as the same
+        Mutable_Feature_Set can be reused to parse each of them.  The slabs
+        are freed by clear() (or once nothing shares the examples).
+
+        Returns the example number of this example.
+    */
+    int add_example_copy(const Feature_Set & example);
+
     /** Fix up any grouping features.  We ensure that they are strictly
         increasing.  Makes sure that they all exceed the given offset. */
     virtual void
@@ -218,6 +242,10 @@ protected:
     typedef std::vector<std::shared_ptr<Feature_Set> > data_type;
     data_type data_;
 
+    /** Slabs holding the examples added with add_example_copy().  Each of
+        those shares ownership of it. */
+    std::shared_ptr<Feature_Set_Arena> arena_;
+
     mutable Lock index_lock;
     mutable std::shared_ptr<Dataset_Index> index_;
 
@@ -235,6 +263,9 @@ protected:
     }
 
     const Dataset_Index & generate_index() const;
+
+    void serialize_columns(DB::Store_Writer & store) const;
+    void reconstitute_columns(DB::Store_Reader & store);
 };
 
 
@@ -15,11 +15,20 @@
 #include "jml/utils/pair_utils.h"
 #include <boost/timer.hpp>
 #include "jml/utils/exc_assert.h"
+#include "jml/utils/environment.h"
 
 using namespace std;
 
 namespace ML {
 
+namespace {
+
+/** Choose the bucket splits from a quantile sketch of the values rather than
+    from their exact frequencies, which needs them to be sorted. */
+Env_Option<bool> streaming_buckets("JML_STREAMING_BUCKETS", false);
+
+} // file scope
+
 
 /*****************************************************************************/
 /* DATASET_INDEX::INDEX_ENTRY                                                */
@@ -750,6 +759,15 @@ buckets(size_t num_buckets)
 
     //cerr << "buckets(" << num_buckets << ")" << endl;
 
+    if (streaming_buckets && !has_freqs) {
+        Guard guard(lock);
+        if (!bucket_info.count(num_buckets))
+            bucket_info[num_buckets]
+                = create_buckets_streaming(get_values(BY_EXAMPLE),
+                                           num_buckets);
+        return bucket_info[num_buckets];
+    }
+
     const Freqs & freqs = get_freqs();
     if (freqs.size() < num_buckets)
         num_buckets = freqs.size();
@@ -249,6 +249,11 @@ struct Dataset_Index::Index_Entry {
            regions of the range where there are lots of examples tend to have
            buckets closer together, and outliers tend to be clustered together
            (rather than be in buckets all by themselves).
+
+           With JML_STREAMING_BUCKETS set in the environment, the regions
+           are chosen with create_buckets_streaming() (a quantile sketch
+           built in one parallel pass) instead of from the exact frequencies
+           of the sorted values, unless those have already been calculated.
     */
 
     const Bucket_Info & create_buckets(size_t num_buckets);
@@ -26,7 +26,12 @@
 #include "jml/utils/exc_assert.h"
 #include "persistent.h"
 #include <stdint.h>
+#include <string.h>
 #include <iomanip>
+#include <type_traits>
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
 
 
 using namespace std;
@@ -113,6 +118,21 @@ void encode_compact(Store_Writer & store, unsigned long long val)
     //    throw Exception("offsets are wrong");
 }
 
+void encode_compact_fixed(Store_Writer & store, unsigned long long val)
+{
+    char buf[9];
+
+    /* All of the bits of the marker are set, and the value is in the
+       other eight bytes. */
+    buf[0] = 0xff;
+    for (int i = 8;  i > 0;  --i) {
+        buf[i] = val & 0xff;
+        val >>= 8;
+    }
+
+    store.save_binary(buf, 9);
+}
+
 void encode_compact(char * & first, char * last, unsigned long long val)
 {
     /* Length depends upon highest bit / 7 */
@@ -345,6 +365,283 @@ std::ostream & operator << (std::ostream & stream, const compact_int_t & s)
 }
 
 
+/*****************************************************************************/
+/* BULK ENCODING                                                             */
+/*****************************************************************************/
+
+/* The length of each value is in the leading one bits of its first byte,
+   so we can load 8 bytes at once and shift and mask the value out of them
+   without looping over its bytes.  That needs slack at the end of the
+   buffer, so the last few values go the slow way.
+
+   Most of the values in an archive (lengths, ids, counts) are small, so
+   runs of single byte values (with the top bit clear) are found 16 bytes
+   at a time with SSE2 and widened without looking at them one by one.
+*/
+
+namespace {
+
+enum {
+    SLACK = 16,        ///< Bytes needed after a value to use the fast path
+    BLOCK_SIZE = 512   ///< Values to buffer when going to or from a store
+};
+
+JML_ALWAYS_INLINE uint64_t load_big_endian(const char * p)
+{
+    uint64_t result;
+    memcpy(&result, p, 8);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    result = __builtin_bswap64(result);
+#endif
+    return result;
+}
+
+JML_ALWAYS_INLINE void store_big_endian(char * p, uint64_t val)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    val = __builtin_bswap64(val);
+#endif
+    memcpy(p, &val, 8);
+}
+
+/** Encode a value.  There must be 9 bytes of space. */
+JML_ALWAYS_INLINE void encode_fast(char * & out, uint64_t val)
+{
+    if (val < 128) {
+        *out++ = val;
+        return;
+    }
+
+    int idx = std::min(highest_bit(val) / 7, 8);
+    if (idx == 8) {
+        *out = 0xff;
+        store_big_endian(out + 1, val);
+        out += 9;
+        return;
+    }
+
+    int len = idx + 1;
+    uint64_t indicator = (uint8_t)~((1 << (8 - idx)) - 1);
+    store_big_endian(out, val << (64 - 8 * len) | indicator << 56);
+    out += len;
+}
+
+/** Decode a value.  There must be 9 bytes available. */
+JML_ALWAYS_INLINE uint64_t decode_fast(const char * & first)
+{
+    uint8_t marker = *first;
+    if (marker == 0xff) {
+        uint64_t result = load_big_endian(first + 1);
+        first += 9;
+        return result;
+    }
+
+    int len = __builtin_clz(~(uint32_t)marker << 24) + 1;
+    uint64_t result = (load_big_endian(first) >> (64 - 8 * len))
+        & ((1ULL << (7 * len)) - 1);
+    first += len;
+    return result;
+}
+
+/** Decode as many of the n values as are complete in the given range,
+    returning how many that was. */
+size_t decode_available(const char * & first, const char * last,
+                        uint64_t * values, size_t n)
+{
+    size_t i = 0;
+
+    while (i < n && last - first >= SLACK) {
+#if defined(__SSE2__)
+        __m128i bytes = _mm_loadu_si128((const __m128i *)first);
+        unsigned multibyte = _mm_movemask_epi8(bytes);
+
+        if (multibyte == 0 && n - i >= 16) {
+            __m128i zero = _mm_setzero_si128();
+            __m128i lo16 = _mm_unpacklo_epi8(bytes, zero);
+            __m128i hi16 = _mm_unpackhi_epi8(bytes, zero);
+            __m128i words[4] = {
+                _mm_unpacklo_epi16(lo16, zero), _mm_unpackhi_epi16(lo16, zero),
+                _mm_unpacklo_epi16(hi16, zero), _mm_unpackhi_epi16(hi16, zero)
+            };
+            __m128i * out = (__m128i *)(values + i);
+            for (unsigned j = 0;  j < 4;  ++j) {
+                _mm_storeu_si128(out + 2 * j,
+                                 _mm_unpacklo_epi32(words[j], zero));
+                _mm_storeu_si128(out + 2 * j + 1,
+                                 _mm_unpackhi_epi32(words[j], zero));
+            }
+            first += 16;
+            i += 16;
+            continue;
+        }
+
+        if (!(multibyte & 1)) {
+            size_t run = std::min<size_t>(multibyte
+                                          ? __builtin_ctz(multibyte) : 16,
+                                          n - i);
+            for (size_t j = 0;  j < run;  ++j)
+                values[i + j] = (uint8_t)first[j];
+            first += run;
+            i += run;
+            continue;
+        }
+#endif
+        values[i++] = decode_fast(first);
+    }
+
+    for (;  i < n && first < last;  ++i) {
+        if (last - first < compact_decode_length(*first))
+            break;
+        values[i] = decode_compact(first, last);
+    }
+
+    return i;
+}
+
+template<typename T>
+JML_ALWAYS_INLINE uint64_t to_compact(T val)
+{
+    return std::is_signed<T>::value ? encodeSign(val) : val;
+}
+
+template<typename T>
+JML_ALWAYS_INLINE T from_compact(uint64_t val)
+{
+    return std::is_signed<T>::value ? decodeSign(val) : val;
+}
+
+template<typename T>
+void encode_range(char * & first, char * last, const T * values, size_t n)
+{
+    size_t i = 0;
+    for (;  i < n && last - first >= SLACK;  ++i)
+        encode_fast(first, to_compact(values[i]));
+
+    for (;  i < n;  ++i) {
+        char buf[SLACK];
+        char * end = buf;
+        encode_fast(end, to_compact(values[i]));
+        if (end - buf > last - first)
+            throw Exception("not enough space to encode compact_size_t");
+        memcpy(first, buf, end - buf);
+        first += end - buf;
+    }
+}
+
+template<typename T>
+void encode_store(Store_Writer & store, const T * values, size_t n)
+{
+    char buf[BLOCK_SIZE * 9 + SLACK];
+    for (size_t i0 = 0;  i0 < n;  i0 += BLOCK_SIZE) {
+        size_t nb = std::min<size_t>(BLOCK_SIZE, n - i0);
+        char * end = buf;
+        encode_range(end, buf + sizeof(buf), values + i0, nb);
+        store.save_binary(buf, end - buf);
+    }
+}
+
+template<typename T>
+void decode_store(Store_Reader & store, T * values, size_t n)
+{
+    uint64_t block[BLOCK_SIZE];
+    for (size_t i = 0;  i < n;  /* no inc */) {
+        size_t nb = std::min<size_t>(BLOCK_SIZE, n - i);
+        store.try_to_have(nb + SLACK);
+
+        const char * first = store.pos();
+        size_t done = decode_available(first, store.end(), block, nb);
+        if (done == 0) {
+            // Straddles the end of what's buffered, or isn't there
+            block[0] = decode_compact(store);
+            done = 1;
+        }
+        else store.skip(first - store.pos());
+
+        for (size_t j = 0;  j < done;  ++j)
+            values[i + j] = from_compact<T>(block[j]);
+        i += done;
+    }
+}
+
+} // file scope
+
+void encode_compact_array(char * & first, char * last,
+                          const uint64_t * values, size_t n)
+{
+    encode_range(first, last, values, n);
+}
+
+void encode_signed_compact_array(char * & first, char * last,
+                                 const int64_t * values, size_t n)
+{
+    encode_range(first, last, values, n);
+}
+
+void decode_compact_array(const char * & first, const char * last,
+                          uint64_t * values, size_t n)
+{
+    const char * p = first;
+    if (decode_available(p, last, values, n) != n)
+        throw Exception("not enough bytes to decode compact_size_t");
+    first = p;
+}
+
+void decode_signed_compact_array(const char * & first, const char * last,
+                                 int64_t * values, size_t n)
+{
+    decode_compact_array(first, last, (uint64_t *)values, n);
+    for (size_t i = 0;  i < n;  ++i)
+        values[i] = decodeSign(values[i]);
+}
+
+void encode_compact_array(Store_Writer & store,
+                          const unsigned long * values, size_t n)
+{
+    encode_store(store, values, n);
+}
+
+void encode_compact_array(Store_Writer & store,
+                          const unsigned long long * values, size_t n)
+{
+    encode_store(store, values, n);
+}
+
+void encode_compact_array(Store_Writer & store,
+                          const signed long * values, size_t n)
+{
+    encode_store(store, values, n);
+}
+
+void encode_compact_array(Store_Writer & store,
+                          const signed long long * values, size_t n)
+{
+    encode_store(store, values, n);
+}
+
+void decode_compact_array(Store_Reader & store,
+                          unsigned long * values, size_t n)
+{
+    decode_store(store, values, n);
+}
+
+void decode_compact_array(Store_Reader & store,
+                          unsigned long long * values, size_t n)
+{
+    decode_store(store, values, n);
+}
+
+void decode_compact_array(Store_Reader & store,
+                          signed long * values, size_t n)
+{
+    decode_store(store, values, n);
+}
+
+void decode_compact_array(Store_Reader & store,
+                          signed long long * values, size_t n)
+{
+    decode_store(store, values, n);
+}
+
 
 } // namespace DB
 } // namespace ML
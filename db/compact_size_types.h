@@ -39,6 +39,11 @@ int compact_encode_length(unsigned long long val);
 void encode_compact(Store_Writer & store, unsigned long long val);
 void encode_compact(char * & first, char * last, unsigned long long val);
 
+/** Encode in the longest (9 character) form whatever the value, for when
+    the size of the encoding has to be known before the value.  It's read
+    back by decode_compact() like any other. */
+void encode_compact_fixed(Store_Writer & store, unsigned long long val);
+
 /** Return the number of characters that need to be available in order to
     read the entire compact_size_t, given the first character.
 */
@@ -102,6 +107,49 @@ std::ostream & operator << (std::ostream & stream, const compact_int_t & s);
 IMPL_SERIALIZE_RECONSTITUTE(compact_int_t);
 
 
+/*****************************************************************************/
+/* BULK ENCODING                                                             */
+/*****************************************************************************/
+
+/* These encode and decode arrays of values, giving exactly the same bytes
+   as doing them one at a time, only much faster.
+*/
+
+/** Encode the n values into the given range, throwing if there isn't
+    enough space.  Up to 9 bytes per value are needed. */
+void encode_compact_array(char * & first, char * last,
+                          const uint64_t * values, size_t n);
+void encode_signed_compact_array(char * & first, char * last,
+                                 const int64_t * values, size_t n);
+
+/** Decode n values from the given range, throwing if it doesn't contain
+    them all. */
+void decode_compact_array(const char * & first, const char * last,
+                          uint64_t * values, size_t n);
+void decode_signed_compact_array(const char * & first, const char * last,
+                                 int64_t * values, size_t n);
+
+/** Write the n values to, or read them from, an archive.  The signed types
+    are compact_int_t. */
+void encode_compact_array(Store_Writer & store,
+                          const unsigned long * values, size_t n);
+void encode_compact_array(Store_Writer & store,
+                          const unsigned long long * values, size_t n);
+void encode_compact_array(Store_Writer & store,
+                          const signed long * values, size_t n);
+void encode_compact_array(Store_Writer & store,
+                          const signed long long * values, size_t n);
+
+void decode_compact_array(Store_Reader & store,
+                          unsigned long * values, size_t n);
+void decode_compact_array(Store_Reader & store,
+                          unsigned long long * values, size_t n);
+void decode_compact_array(Store_Reader & store,
+                          signed long * values, size_t n);
+void decode_compact_array(Store_Reader & store,
+                          signed long long * values, size_t n);
+
+
 } // namespace DB
 } // namespace ML
 
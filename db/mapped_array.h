@@ -0,0 +1,178 @@
+/* mapped_array.h                                                  -*- C++ -*-
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Read-only array that can be used in place from a memory mapped archive.
+*/
+
+#ifndef __db__mapped_array_h__
+#define __db__mapped_array_h__
+
+
+#include "persistent.h"
+#include "serialization_order.h"
+#include <boost/static_assert.hpp>
+#include <memory>
+#include <vector>
+
+
+namespace ML {
+namespace DB {
+
+
+/*****************************************************************************/
+/* MAPPED_ARRAY                                                              */
+/*****************************************************************************/
+
+/** A read-only array of fixed size values (see Fixed_Size_Serialization)
+    that can be loaded without copying.  The weights of GLZ_Classifier are
+    stored this way.
+
+    It's serialized as an aligned section:
+
+        char version (1)
+        compact_size_t number of elements
+        char size of each element
+        padding to a 64 byte boundary (see save_padding())
+        the elements, in serialization order
+
+    When it's reconstituted from a Store_Reader that reads a file through a
+    File_Read_Buffer (as Store_Reader(filename) does for uncompressed
+    files), and serialization order is the native order, the array points
+    straight into the memory mapped file instead of being copied.  The
+    mapping is shared, so every process that loads the same file uses the
+    same physical pages, and nothing is read until it is used.  The
+    mapping stays alive for as long as any array (or copy of one) that
+    points into it.  The file mustn't be modified in place while it's
+    mapped; replace it with a rename instead.
+
+    Otherwise (a compressed file or a stream), the values are copied into
+    memory owned by the array, as they are when it's constructed from
+    values.
+*/
+template<typename T>
+class Mapped_Array {
+    BOOST_STATIC_ASSERT(Fixed_Size_Serialization<T>::value);
+
+public:
+    typedef T value_type;
+    typedef const T * const_iterator;
+    typedef const T * iterator;
+
+    enum { ALIGNMENT = 64 };
+
+    Mapped_Array()
+        : data_(0), size_(0)
+    {
+    }
+
+    template<class Iterator>
+    Mapped_Array(Iterator first, Iterator last)
+        : owned_(first, last)
+    {
+        point_to_owned();
+    }
+
+    explicit Mapped_Array(const std::vector<T> & values)
+        : owned_(values)
+    {
+        point_to_owned();
+    }
+
+    Mapped_Array(const Mapped_Array & other)
+        : owned_(other.owned_), owner_(other.owner_)
+    {
+        if (owner_) {
+            data_ = other.data_;
+            size_ = other.size_;
+        }
+        else point_to_owned();
+    }
+
+    Mapped_Array & operator = (const Mapped_Array & other)
+    {
+        Mapped_Array new_me(other);
+        swap(new_me);
+        return *this;
+    }
+
+    void swap(Mapped_Array & other)
+    {
+        // Swapping the vectors doesn't move their memory
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        owned_.swap(other.owned_);
+        owner_.swap(other.owner_);
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    const T * data() const { return data_; }
+    const T * begin() const { return data_; }
+    const T * end() const { return data_ + size_; }
+
+    const T & operator [] (size_t i) const { return data_[i]; }
+
+    /** Does the array point into a memory mapped file? */
+    bool mapped() const { return !!owner_; }
+
+    void serialize(Store_Writer & store) const
+    {
+        store << (char)1 << compact_size_t(size_) << (char)sizeof(T);
+        store.save_padding(ALIGNMENT);
+        store.save_array(data_, size_);
+    }
+
+    void reconstitute(Store_Reader & store)
+    {
+        char version;
+        store >> version;
+        if (version != 1)
+            throw Exception("Mapped_Array: unknown version");
+
+        compact_size_t size(store);
+        char element_size;
+        store >> element_size;
+        if (element_size != sizeof(T))
+            throw Exception("Mapped_Array: wrong element size");
+        store.skip_padding();
+
+        Mapped_Array new_me;
+
+        const char * mem = 0;
+        if (JML_NATIVE_IS_SERIALIZATION_ORDER && size > 0)
+            mem = store.borrow(size * sizeof(T), alignof(T), new_me.owner_);
+
+        if (mem) {
+            new_me.data_ = reinterpret_cast<const T *>(mem);
+            new_me.size_ = size;
+        }
+        else {
+            new_me.owned_.resize(size);
+            if (size > 0) store.load_array(&new_me.owned_[0], size);
+            new_me.point_to_owned();
+        }
+
+        swap(new_me);
+    }
+
+private:
+    const T * data_;
+    size_t size_;
+    std::vector<T> owned_;                ///< Values if we own them
+    std::shared_ptr<const void> owner_;   ///< Keeps the mapping alive
+
+    void point_to_owned()
+    {
+        data_ = (owned_.empty() ? 0 : &owned_[0]);
+        size_ = owned_.size();
+    }
+};
+
+
+} // namespace DB
+} // namespace ML
+
+
+#endif /* __db__mapped_array_h__ */
@@ -46,5 +46,23 @@ Nested_Writer::Nested_Writer()
     open(stream);
 }
 
+Nested_Writer::Nested_Writer(const Store_Writer & store)
+{
+    open(stream);
+    set_offset(store.offset() + 9 /* length from encode_compact_fixed() */);
+}
+
+void
+Nested_Writer::
+write_in_place(Store_Writer & store) const
+{
+    std::string contents = stream.str();
+    if (store.offset() + 9 != offset() - contents.size())
+        throw Exception("Nested_Writer::write_in_place(): store has been "
+                        "written to");
+    encode_compact_fixed(store, contents.size());
+    store.save_binary(contents.c_str(), contents.size());
+}
+
 } // namespace DB
 } // namespace ML
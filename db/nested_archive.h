@@ -68,11 +68,22 @@ class Nested_Writer : public Store_Writer {
 public:
     Nested_Writer();
 
+    /** Writer whose contents will be written to the given store, at its
+        current offset, with write_in_place().  The offsets within it are
+        those that the contents will have in the store, so that the
+        padding from save_padding() gives the same alignment there. */
+    explicit Nested_Writer(const Store_Writer & store);
+
     template<class Archive>
     void serialize(Archive & archive) const
     {
         archive << stream.str();
     }
+
+    /** Write the contents to the store that was given to the constructor,
+        which mustn't have been written to since.  It's read back in the
+        same way as serialize(), but the length takes a fixed size. */
+    void write_in_place(Store_Writer & store) const;
     
 private:
     std::ostringstream stream;
@@ -45,6 +45,12 @@ struct Binary_Input::Source {
     }
 
     virtual size_t more(Binary_Input & input, size_t amount) = 0;
+
+    /** Object that keeps the memory of the input valid, if there is one. */
+    virtual std::shared_ptr<const void> owner() const
+    {
+        return std::shared_ptr<const void>();
+    }
 };
 
 struct Binary_Input::Buffer_Source
@@ -76,6 +82,11 @@ struct Binary_Input::Buffer_Source
         return input.avail();  // we can never get more after this
     }
 
+    virtual std::shared_ptr<const void> owner() const
+    {
+        return region;
+    }
+
     std::shared_ptr<File_Read_Buffer::Region> region;
 };
 
@@ -234,17 +245,13 @@ void Binary_Input::open(const File_Read_Buffer & buf)
     source->more(*this, 0);
 }
 
-bool endsWith(const std::string & str, const std::string & val)
-{
-    return val.size() <= str.size()
-        && str.rfind(val) == str.size() - val.size();
-}
-
 void Binary_Input::open(const std::string & filename)
 {
-    if (endsWith(filename, ".gz")
-        || endsWith(filename, ".bz2")
-        || endsWith(filename, ".xz")) {
+    // Compressed files, URIs and stdin go through a filter_istream; plain
+    // files are memory mapped
+    if (compressionFromFilename(filename) != ""
+        || filename == "-"
+        || filename.find("://") != string::npos) {
         source.reset(new Stream_Source(new filter_istream(filename)));
         offset_ = 0;
         pos_ = end_ = 0;
@@ -274,6 +281,24 @@ void Binary_Input::open(const char * c, size_t sz)
     source.reset(new No_Source());
 }
 
+const char *
+Binary_Input::
+borrow(size_t size, size_t alignment, std::shared_ptr<const void> & owner)
+{
+    std::shared_ptr<const void> region = source->owner();
+    if (!region) return 0;
+
+    must_have(size);
+
+    const char * result = pos();
+    if (alignment > 1 && (size_t)result % alignment != 0)
+        return 0;
+
+    skip(size);
+    owner = region;
+    return result;
+}
+
 void Binary_Input::make_avail(size_t min_avail)
 {
     size_t avail = source->more(*this, min_avail);
@@ -301,6 +326,26 @@ portable_bin_iarchive::portable_bin_iarchive()
 {
 }
 
+void
+portable_bin_iarchive::
+load_binary_chunked(void * address, size_t size)
+{
+    enum { CHUNK_SIZE = 65536 };
+
+    char * out = reinterpret_cast<char *>(address);
+
+    while (size > 0) {
+        if (avail() == 0)
+            must_have(std::min<size_t>(size, CHUNK_SIZE));
+
+        size_t n = std::min(size, avail());
+        std::copy(pos(), pos() + n, out);
+        skip(n);
+        out += n;
+        size -= n;
+    }
+}
+
 portable_bin_iarchive::portable_bin_iarchive(const File_Read_Buffer & buf)
     : Binary_Input(buf)
 {
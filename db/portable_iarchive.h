@@ -106,6 +106,15 @@ public:
 
     size_t offset() const { return offset_; }
 
+    /** If the input is a File_Read_Buffer (normally a memory mapped file),
+        return a pointer to the next size bytes and skip over them.  The
+        memory stays valid for as long as owner is held, however long the
+        input lasts.  Otherwise (the input is a stream or a bare memory
+        range, or the data isn't aligned to the given boundary), return 0
+        without skipping; the data needs to be copied. */
+    const char * borrow(size_t size, size_t alignment,
+                        std::shared_ptr<const void> & owner);
+
 private:
     size_t offset_;       ///< Offset of start from archive start
     const char * pos_;    ///< Position in memory region
@@ -253,12 +262,7 @@ public:
         compact_size_t sz(*this);
 
         std::vector<T, A> v;
-        v.reserve(sz);
-        for (unsigned i = 0;  i < sz;  ++i) {
-            T t;
-            *this >> t;
-            v.push_back(t);
-        }
+        load_elements(v, sz, Array_Serialization<T>());
         vec.swap(v);
     }
 
@@ -337,20 +341,37 @@ public:
 
         arr.resize(sizes);
 
-        size_t ne = arr.num_elements();
-        T * el = arr.data();
-        for (unsigned i = 0;  i < ne;  ++i, ++el)
-            *this >> *el;
+        load_array(arr.data(), arr.num_elements());
     }
 
     void load_binary(void * address, size_t size)
     {
-        must_have(size);
+        if (avail() < size) {
+            load_binary_chunked(address, size);
+            return;
+        }
         std::copy(pos(), pos() + size,
                   reinterpret_cast<char *>(address));
         skip(size);
     }
 
+    /** Skip the padding written by portable_bin_oarchive::save_padding(). */
+    void skip_padding()
+    {
+        unsigned char padding;
+        load(padding);
+        skip(padding);
+    }
+
+    /** Load an array of n values that were saved with save_array() or one
+        at a time.  Fixed size values are copied all at once, and compactly
+        encoded ones decoded in bulk. */
+    template<typename T>
+    void load_array(T * values, size_t n)
+    {
+        load_array(values, n, Fixed_Size_Serialization<T>());
+    }
+
     // Anything with a serialize() method gets to be serialized
     template<typename T>
     void load(T & obj,
@@ -366,6 +387,61 @@ public:
         obj.reconstitute(*this);
     }
 #endif
+
+private:
+    /** Load data that isn't all available yet, a buffer at a time, so that
+        a stream source doesn't need to hold all of it at once. */
+    void load_binary_chunked(void * address, size_t size);
+
+    template<typename T>
+    void load_array(T * values, size_t n, boost::false_type)
+    {
+        load_compact_array(values, n, Compact_Serialization<T>());
+    }
+
+    template<typename T>
+    void load_compact_array(T * values, size_t n, boost::false_type)
+    {
+        for (size_t i = 0;  i < n;  ++i)
+            *this >> values[i];
+    }
+
+    template<typename T>
+    void load_compact_array(T * values, size_t n, boost::true_type)
+    {
+        decode_compact_array(*this, values, n);
+    }
+
+    template<typename T>
+    void load_array(T * values, size_t n, boost::true_type)
+    {
+        load_binary(values, n * sizeof(T));
+        convert_serialization_order(values, n);
+    }
+
+    template<class T, class A>
+    void load_elements(std::vector<T, A> & v, size_t n, boost::false_type)
+    {
+        v.reserve(n);
+        for (unsigned i = 0;  i < n;  ++i) {
+            T t;
+            *this >> t;
+            v.push_back(t);
+        }
+    }
+
+    template<class T, class A>
+    void load_elements(std::vector<T, A> & v, size_t n, boost::true_type)
+    {
+        // Grow the vector a buffer at a time, so that a corrupt size will
+        // run out of data before it runs out of memory
+        enum { CHUNK_ELEMENTS = 1 << 20 };
+        for (size_t i0 = 0;  i0 < n;  i0 += CHUNK_ELEMENTS) {
+            size_t nc = std::min<size_t>(CHUNK_ELEMENTS, n - i0);
+            v.resize(i0 + nc);
+            load_array(&v[i0], nc);
+        }
+    }
 };
 
 } // namespace DB
@@ -47,6 +47,17 @@ portable_bin_oarchive::portable_bin_oarchive(const std::string & filename)
 {
 }
 
+portable_bin_oarchive::
+portable_bin_oarchive(const std::string & filename,
+                      const std::string & compression,
+                      int compressionLevel)
+    : stream(new filter_ostream(filename, std::ios_base::out, compression,
+                                compressionLevel)),
+      owned_stream(stream),
+      offset_(0)
+{
+}
+
 portable_bin_oarchive::portable_bin_oarchive(std::ostream & stream)
     : stream(&stream), offset_(0)
 {
@@ -59,6 +70,16 @@ void portable_bin_oarchive::open(const std::string & filename)
     offset_ = 0;
 }
 
+void portable_bin_oarchive::open(const std::string & filename,
+                                 const std::string & compression,
+                                 int compressionLevel)
+{
+    stream = new filter_ostream(filename, std::ios_base::out, compression,
+                                compressionLevel);
+    owned_stream.reset(stream);
+    offset_ = 0;
+}
+
 void portable_bin_oarchive::open(std::ostream & stream)
 {
     this->stream = &stream;
@@ -62,7 +62,18 @@ public:
     portable_bin_oarchive(const std::string & filename);
     portable_bin_oarchive(std::ostream & stream);
 
+    /** Write to the given file with the given compression (as for
+        filter_ostream: "gz", "bz2", "xz", "zstd", "lz4", "none", or ""
+        to choose from the extension) and compression level (-1 for the
+        compression's default). */
+    portable_bin_oarchive(const std::string & filename,
+                          const std::string & compression,
+                          int compressionLevel = -1);
+
     void open(const std::string & filename);
+    void open(const std::string & filename,
+              const std::string & compression,
+              int compressionLevel = -1);
     void open(std::ostream & stream);
 
     void save(unsigned char x)
@@ -194,8 +205,7 @@ public:
     {
         compact_size_t size(vec.size());
         size.serialize(*this);
-        for (unsigned i = 0;  i < vec.size();  ++i)
-            *this << vec[i];
+        save_elements(vec, Array_Serialization<T>());
     }
 
     template<class K, class V, class L, class A>
@@ -243,10 +253,8 @@ public:
             dim.serialize(*this);
         }
 
-        size_t ne = arr.num_elements();
-        const T * el = arr.data();
-        for (unsigned i = 0;  i < ne;  ++i, ++el)
-            *this << *el;
+        save_array(arr.data(), arr.num_elements(),
+                   Fixed_Size_Serialization<T>());
     }
 
     template<typename T1, typename T2>
@@ -268,6 +276,18 @@ public:
             throw Exception("Error writing to stream");
     }
 
+    /** Write the number of bytes of padding needed to bring the offset
+        after it to a multiple of the given alignment (at most 256), and
+        then the padding.  Read back with skip_padding(). */
+    void save_padding(size_t alignment)
+    {
+        unsigned char padding = (alignment - (offset_ + 1) % alignment)
+            % alignment;
+        save(padding);
+        char zeros[256] = { 0 };
+        save_binary(zeros, padding);
+    }
+
     /** Warning: doesn't do byte order conversions or anything like that. */
     template<typename T>
     void save_binary(const T & val)
@@ -293,10 +313,77 @@ public:
 
     size_t offset() const { return offset_; }
 
+    /** Save an array of n values, with the same result as saving each of
+        them in turn.  Fixed size values are written all at once (or in
+        blocks, if they need converting to serialization order), and
+        compactly encoded ones are encoded in bulk. */
+    template<typename T>
+    void save_array(const T * values, size_t n)
+    {
+        save_array(values, n, Fixed_Size_Serialization<T>());
+    }
+
 private:
+    template<typename T>
+    void save_array(const T * values, size_t n, boost::false_type)
+    {
+        save_compact_array(values, n, Compact_Serialization<T>());
+    }
+
+    template<typename T>
+    void save_compact_array(const T * values, size_t n, boost::false_type)
+    {
+        for (size_t i = 0;  i < n;  ++i)
+            *this << values[i];
+    }
+
+    template<typename T>
+    void save_compact_array(const T * values, size_t n, boost::true_type)
+    {
+        encode_compact_array(*this, values, n);
+    }
+
+    template<typename T>
+    void save_array(const T * values, size_t n, boost::true_type)
+    {
+        if (JML_NATIVE_IS_SERIALIZATION_ORDER) {
+            save_binary(values, n * sizeof(T));
+            return;
+        }
+
+        enum { BLOCK_SIZE = 4096 };
+        T block[BLOCK_SIZE];
+        for (size_t i0 = 0;  i0 < n;  i0 += BLOCK_SIZE) {
+            size_t nb = std::min<size_t>(BLOCK_SIZE, n - i0);
+            std::copy(values + i0, values + i0 + nb, block);
+            convert_serialization_order(block, nb);
+            save_binary(block, nb * sizeof(T));
+        }
+    }
+
+    // Elements of a vector; vector<bool> doesn't have an array of them
+    template<class T, class A>
+    void save_elements(const std::vector<T, A> & vec, boost::false_type)
+    {
+        for (unsigned i = 0;  i < vec.size();  ++i)
+            *this << vec[i];
+    }
+
+    template<class T, class A>
+    void save_elements(const std::vector<T, A> & vec, boost::true_type)
+    {
+        if (!vec.empty())
+            save_array(&vec[0], vec.size());
+    }
+
     std::ostream * stream;
     std::shared_ptr<std::ostream> owned_stream;
     size_t offset_;
+
+protected:
+    /** Count offsets from the given one, for an archive that will be
+        written at that offset within another. */
+    void set_offset(size_t offset) { offset_ = offset; }
 };
 
 
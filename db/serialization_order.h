@@ -26,7 +26,10 @@
 #define __db__serialization_order_h__
 
 #include <stdint.h>
+#include <stddef.h>
+#include <string.h>
 #include "jml/compiler/compiler.h"
+#include <boost/type_traits/integral_constant.hpp>
 
 namespace ML {
 namespace DB {
@@ -113,6 +116,84 @@ JML_ALWAYS_INLINE int64_t serialization_order(int64_t val)
     return val;
 }
 
+/** Is serialization order the same as the native order for all types?  If
+    so, arrays of fixed size values can be copied to and from an archive
+    as they are.
+*/
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+# define JML_NATIVE_IS_SERIALIZATION_ORDER 0
+#else
+# define JML_NATIVE_IS_SERIALIZATION_ORDER 1
+#endif
+
+/** Types that are serialized as their value in serialization order, in
+    sizeof(T) bytes.  Arrays of them can be serialized in bulk.  (The long
+    types are stored as variable length integers, and bool isn't
+    guaranteed to be one byte).
+*/
+template<typename T>
+struct Fixed_Size_Serialization : boost::false_type {
+};
+
+template<> struct Fixed_Size_Serialization<char> : boost::true_type {};
+template<> struct Fixed_Size_Serialization<signed char> : boost::true_type {};
+template<> struct Fixed_Size_Serialization<unsigned char>
+    : boost::true_type {};
+template<> struct Fixed_Size_Serialization<signed short>
+    : boost::integral_constant<bool, sizeof(short) == 2> {};
+template<> struct Fixed_Size_Serialization<unsigned short>
+    : boost::integral_constant<bool, sizeof(short) == 2> {};
+template<> struct Fixed_Size_Serialization<signed int>
+    : boost::integral_constant<bool, sizeof(int) == 4> {};
+template<> struct Fixed_Size_Serialization<unsigned int>
+    : boost::integral_constant<bool, sizeof(int) == 4> {};
+template<> struct Fixed_Size_Serialization<float> : boost::true_type {};
+template<> struct Fixed_Size_Serialization<double> : boost::true_type {};
+
+/** Types that are serialized as a compact_size_t or compact_int_t.  Arrays
+    of them can be encoded and decoded in bulk. */
+template<typename T>
+struct Compact_Serialization : boost::false_type {
+};
+
+template<> struct Compact_Serialization<unsigned long> : boost::true_type {};
+template<> struct Compact_Serialization<unsigned long long>
+    : boost::true_type {};
+template<> struct Compact_Serialization<signed long> : boost::true_type {};
+template<> struct Compact_Serialization<signed long long>
+    : boost::true_type {};
+
+/** Types that arrays of can be serialized in bulk, one way or the other. */
+template<typename T>
+struct Array_Serialization
+    : boost::integral_constant<bool, Fixed_Size_Serialization<T>::value
+                                     || Compact_Serialization<T>::value> {
+};
+
+template<size_t Size> struct Order_Int;
+template<> struct Order_Int<1> { typedef uint8_t type; };
+template<> struct Order_Int<2> { typedef uint16_t type; };
+template<> struct Order_Int<4> { typedef uint32_t type; };
+template<> struct Order_Int<8> { typedef uint64_t type; };
+
+/** Convert an array of n fixed size values from native to serialization
+    order (or back; the conversion is its own inverse), as the
+    serialization of each one would.  Does nothing where the orders are the
+    same. */
+template<typename T>
+void convert_serialization_order(T * values, size_t n)
+{
+    if (JML_NATIVE_IS_SERIALIZATION_ORDER) return;
+
+    typedef typename Order_Int<sizeof(T)>::type Int;
+    for (size_t i = 0;  i < n;  ++i) {
+        Int x;
+        memcpy(&x, values + i, sizeof(T));
+        x = serialization_order(x);
+        memcpy(values + i, &x, sizeof(T));
+    }
+}
+
 } // namespace DB
 } // namespace ML
 
@@ -138,3 +138,123 @@ BOOST_AUTO_TEST_CASE( test2 )
     test_compact_int_type(0xffffffffffffffffULL);
 }
 
+
+/* Values of every length, mostly small as in real archives. */
+vector<uint64_t> test_values(size_t n)
+{
+    vector<uint64_t> result;
+    uint64_t x = 1;
+    for (size_t i = 0;  i < n;  ++i) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        if (i % 4 == 0) result.push_back(x >> (x % 64));
+        else result.push_back((x >> 40) % 100);
+    }
+    result.push_back(0);
+    result.push_back(0xffffffffffffffffULL);
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE( test_bulk_compatibility )
+{
+    vector<uint64_t> values = test_values(10000);
+
+    // One at a time
+    std::ostringstream os;
+    {
+        DB::Store_Writer store(os);
+        for (unsigned i = 0;  i < values.size();  ++i)
+            store << compact_size_t(values[i]);
+        for (unsigned i = 0;  i < values.size();  ++i)
+            store << compact_int_t(values[i]);
+    }
+    string expected = os.str();
+
+    // In bulk into memory
+    string encoded(values.size() * 18, '\0');
+    char * first = &encoded[0];
+    encode_compact_array(first, first + encoded.size(),
+                         &values[0], values.size());
+    encode_signed_compact_array(first, first + encoded.size(),
+                                (const int64_t *)&values[0], values.size());
+    encoded.resize(first - &encoded[0]);
+    BOOST_CHECK(encoded == expected);
+
+    // Not enough space
+    first = &encoded[0];
+    BOOST_CHECK_THROW(encode_compact_array(first, first + 100, &values[0],
+                                           values.size()),
+                      std::exception);
+
+    // In bulk into a store
+    std::ostringstream os2;
+    {
+        DB::Store_Writer store(os2);
+        encode_compact_array(store, (const unsigned long long *)&values[0],
+                             values.size());
+        encode_compact_array(store, (const signed long *)&values[0],
+                             values.size());
+    }
+    BOOST_CHECK(os2.str() == expected);
+
+    // Back out of memory
+    vector<uint64_t> decoded(values.size());
+    vector<int64_t> decoded_signed(values.size());
+    const char * p = expected.c_str(), * e = p + expected.size();
+    decode_compact_array(p, e, &decoded[0], decoded.size());
+    decode_signed_compact_array(p, e, &decoded_signed[0], decoded.size());
+    BOOST_CHECK_EQUAL(p, e);
+    BOOST_CHECK(decoded == values);
+    BOOST_CHECK(vector<uint64_t>(decoded_signed.begin(), decoded_signed.end())
+                == values);
+
+    // Truncated
+    p = expected.c_str();
+    BOOST_CHECK_THROW(decode_compact_array(p, p + 1000, &decoded[0],
+                                           decoded.size()),
+                      std::exception);
+    BOOST_CHECK_EQUAL(p, expected.c_str());
+
+    // Back out of a stream, whose buffer boundaries fall within values
+    std::istringstream is(expected);
+    DB::Store_Reader store(is);
+    vector<unsigned long> decoded2(values.size());
+    vector<signed long long> decoded_signed2(values.size());
+    decode_compact_array(store, &decoded2[0], decoded2.size());
+    decode_compact_array(store, &decoded_signed2[0], decoded2.size());
+    BOOST_CHECK(vector<uint64_t>(decoded2.begin(), decoded2.end()) == values);
+    BOOST_CHECK(vector<uint64_t>(decoded_signed2.begin(),
+                                 decoded_signed2.end()) == values);
+    BOOST_CHECK_THROW(decode_compact_array(store, &decoded2[0], 1),
+                      std::exception);
+}
+
+BOOST_AUTO_TEST_CASE( test_archive_vectors )
+{
+    vector<uint64_t> values = test_values(5000);
+    vector<unsigned long> v1(values.begin(), values.end());
+    vector<signed long long> v2(values.begin(), values.end());
+
+    std::ostringstream os, os2;
+    {
+        DB::Store_Writer store(os);
+        store << v1 << v2;
+    }
+    {
+        DB::Store_Writer store(os2);
+        store << compact_size_t(v1.size());
+        for (unsigned i = 0;  i < v1.size();  ++i)
+            store << v1[i];
+        store << compact_size_t(v2.size());
+        for (unsigned i = 0;  i < v2.size();  ++i)
+            store << v2[i];
+    }
+    BOOST_CHECK(os.str() == os2.str());
+
+    string saved = os.str();
+    DB::Store_Reader store(saved.c_str(), saved.size());
+    vector<unsigned long> r1;
+    vector<signed long long> r2;
+    store >> r1 >> r2;
+    BOOST_CHECK(r1 == v1);
+    BOOST_CHECK(r2 == v2);
+}
@@ -0,0 +1,115 @@
+/* mapped_array_test.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Test for arrays used in place from a memory mapped archive.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/db/mapped_array.h"
+#include "jml/utils/file_functions.h"
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+#include <unistd.h>
+
+using namespace ML;
+using namespace ML::DB;
+using namespace std;
+
+using boost::unit_test::test_suite;
+
+BOOST_AUTO_TEST_CASE( test_mapped_array )
+{
+    vector<float> values;
+    for (unsigned i = 0;  i < 10000;  ++i)
+        values.push_back(i * 0.5);
+
+    Mapped_Array<float> array(values);
+    BOOST_CHECK(!array.mapped());
+    BOOST_CHECK_EQUAL(array.size(), values.size());
+
+    string filename = format("/tmp/jml_mapped_array_test.%d", getpid());
+
+    {
+        Store_Writer store(filename);
+        // Something of an odd length first, so that the array needs padding
+        store << string("hello") << array << Mapped_Array<float>()
+              << string("END");
+    }
+
+    Mapped_Array<float> from_file;
+
+    {
+        Store_Reader store(filename);
+        string s1, s2;
+        Mapped_Array<float> empty;
+        store >> s1 >> from_file >> empty >> s2;
+        BOOST_CHECK_EQUAL(s1, "hello");
+        BOOST_CHECK_EQUAL(s2, "END");
+        BOOST_CHECK(empty.empty());
+    }
+
+    // Still there after the reader has gone
+    BOOST_CHECK(from_file.mapped());
+    BOOST_CHECK_EQUAL((size_t)from_file.data() % Mapped_Array<float>::ALIGNMENT,
+                      0);
+    BOOST_CHECK(std::equal(values.begin(), values.end(), from_file.begin()));
+
+    // Copies share the mapping
+    Mapped_Array<float> copy = from_file;
+    BOOST_CHECK(copy.mapped());
+    BOOST_CHECK_EQUAL(copy.data(), from_file.data());
+
+    // Another reader of the same file uses the same mapping
+    {
+        Store_Reader store(filename);
+        string s1;
+        Mapped_Array<float> again;
+        store >> s1 >> again;
+        BOOST_CHECK_EQUAL(again.data(), from_file.data());
+    }
+
+    // A stream can't be borrowed from, so the values are copied
+    {
+        ostringstream stream_out;
+        {
+            Store_Writer store(stream_out);
+            store << array;
+        }
+
+        istringstream stream_in(stream_out.str());
+        Store_Reader store(stream_in);
+        Mapped_Array<float> copied;
+        store >> copied;
+        BOOST_CHECK(!copied.mapped());
+        BOOST_CHECK(std::equal(values.begin(), values.end(), copied.begin()));
+
+        Mapped_Array<float> copy2 = copied;
+        BOOST_CHECK(copy2.data() != copied.data());
+        BOOST_CHECK(std::equal(values.begin(), values.end(), copy2.begin()));
+    }
+
+    delete_file(filename);
+
+    // A compressed backup file is decompressed rather than mapped
+    string backup = filename + ".gz~";
+    {
+        Store_Writer store(backup);
+        store << string("hello") << array;
+    }
+
+    {
+        Store_Reader store(backup);
+        string s1;
+        Mapped_Array<float> decompressed;
+        store >> s1 >> decompressed;
+        BOOST_CHECK_EQUAL(s1, "hello");
+        BOOST_CHECK(!decompressed.mapped());
+        BOOST_CHECK(std::equal(values.begin(), values.end(),
+                               decompressed.begin()));
+    }
+
+    delete_file(backup);
+}
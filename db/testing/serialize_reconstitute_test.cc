@@ -140,3 +140,65 @@ BOOST_AUTO_TEST_CASE( test_distribution )
     dist.push_back(2.0);
     test_serialize_reconstitute(dist);
 }
+
+BOOST_AUTO_TEST_CASE( test_bulk_arrays )
+{
+    // Big enough to need several reads from a stream
+    vector<float> floats;
+    vector<double> doubles;
+    vector<int> ints;
+    vector<unsigned short> shorts;
+    for (unsigned i = 0;  i < 100000;  ++i) {
+        floats.push_back(i * 0.25 - 1000);
+        doubles.push_back(1.0 / (i + 1));
+        ints.push_back(i * 7919 - 1000000);
+        shorts.push_back(i * 31);
+    }
+
+    // (distributions so that the test can print them)
+    test_serialize_reconstitute(distribution<float>(floats));
+    test_serialize_reconstitute(distribution<double>(doubles));
+    test_serialize_reconstitute(distribution<int>(ints));
+    test_serialize_reconstitute(distribution<unsigned short>(shorts));
+
+    boost::multi_array<double, 2> A(boost::extents[300][200]);
+    for (unsigned i = 0;  i < 300;  ++i)
+        for (unsigned j = 0;  j < 200;  ++j)
+            A[i][j] = i * 0.5 - j;
+    test_serialize_reconstitute(A);
+
+    // Same bytes as saving one element at a time
+    ostringstream bulk_out, single_out;
+    {
+        DB::Store_Writer bulk(bulk_out), single(single_out);
+        bulk << floats;
+        single << compact_size_t(floats.size());
+        for (unsigned i = 0;  i < floats.size();  ++i)
+            single << floats[i];
+    }
+
+    BOOST_CHECK(bulk_out.str() == single_out.str());
+
+    // Loading from a buffer rather than a stream
+    string data = bulk_out.str();
+    {
+        DB::Store_Reader reader(data.c_str(), data.size());
+        vector<float> loaded;
+        reader >> loaded;
+        BOOST_CHECK(loaded == floats);
+    }
+
+    // Truncated data
+    {
+        DB::Store_Reader reader(data.c_str(), data.size() - 1);
+        vector<float> loaded;
+        BOOST_CHECK_THROW(reader >> loaded, ML::Exception);
+    }
+
+    {
+        istringstream stream_in(data.substr(0, data.size() - 1));
+        DB::Store_Reader reader(stream_in);
+        vector<float> loaded;
+        BOOST_CHECK_THROW(reader >> loaded, ML::Exception);
+    }
+}
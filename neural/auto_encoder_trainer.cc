@@ -19,6 +19,9 @@
 #include "auto_encoder_stack.h"
 #include "jml/utils/check_not_nan.h"
 #include "jml/stats/distribution_ops.h"
+#include "minibatch_feeder.h"
+#include "layer_output_cache.h"
+#include <boost/thread/thread.hpp>
 
 
 using namespace std;
@@ -54,6 +57,9 @@ defaults()
     weight_decay_l1 = 0.0;
     weight_decay_l2 = 0.0;
     dump_testing_output = 0;
+    cache_layer_outputs = false;
+    cache_half_precision = false;
+    pipeline_stack_backprop = false;
 }
 
 void
@@ -74,6 +80,9 @@ configure(const std::string & name, const Configuration & config)
     config.get(weight_decay_l1, "weight_decay_l1");
     config.get(weight_decay_l2, "weight_decay_l2");
     config.get(dump_testing_output, "dump_testing_output");
+    config.get(cache_layer_outputs, "cache_layer_outputs");
+    config.get(cache_half_precision, "cache_half_precision");
+    config.get(pipeline_stack_backprop, "pipeline_stack_backprop");
 }
 
 template<typename Float>
@@ -238,7 +247,7 @@ train_iter(Auto_Encoder & encoder,
     int ni JML_UNUSED = encoder.inputs();
     int no JML_UNUSED = encoder.outputs();
 
-    int microbatch_size = minibatch_size / (num_threads() * 4);
+    int microbatch_size = std::max(minibatch_size / (num_threads() * 4), 1);
             
     Lock update_lock;
 
@@ -335,7 +344,7 @@ train_iter(Auto_Encoder & encoder,
     int ni JML_UNUSED = encoder.inputs();
     int no JML_UNUSED = encoder.outputs();
 
-    int microbatch_size = minibatch_size / (num_threads() * 4);
+    int microbatch_size = std::max(minibatch_size / (num_threads() * 4), 1);
             
     Lock update_lock;
 
@@ -414,76 +423,162 @@ train_iter(Auto_Encoder & encoder,
     return make_pair(sqrt(total_mse_exact / nx2), sqrt(total_mse_noisy / nx2));
 }
 
-void
+std::pair<double, double>
 Auto_Encoder_Trainer::
-train(Auto_Encoder & encoder,
-      const std::vector<distribution<float> > & training_data,
-      const std::vector<distribution<float> > & testing_data,
-      Thread_Context & thread_context,
-      int niter) const
+train_iter(Auto_Encoder & encoder,
+           Minibatch_Feeder & feeder,
+           Thread_Context & thread_context,
+           double learning_rate) const
 {
-    if (niter == -1) niter = this->niter;
+    Worker_Task & worker = thread_context.worker();
 
-    double learning_rate = this->learning_rate;
-    
-    int nx = training_data.size();
-    int nxt = testing_data.size();
+    int microbatch_size
+        = std::max(feeder.minibatch_size() / (num_threads() * 4), 1);
+            
+    Lock update_lock;
 
-    if (verbosity == 2)
-        cerr << "iter      lr  -- inst train--  ---- train ----  ---- test -----\n"
-             << "----  ------    exact   noisy    exact   noisy    exact   noisy\n";
-    
-    Parameters_Copy<float> learning_rates;
+    double total_mse_exact = 0.0, total_mse_noisy = 0.0;
 
-    for (unsigned iter = 0;  iter < niter;  ++iter) {
+    // The examples in a minibatch are already in order
+    vector<int> examples;
 
-        if (verbosity >= 2)
-            cerr << format("%4d", iter) << flush;
+    size_t nx2 = 0;
 
-        if (iter % 5 == 0 && !individual_learning_rates) {
-#if 0
-            learning_rate
-                = calc_learning_rate(encoder, training_data, thread_context);
-            //cerr << "optimal learning rate calculated was " << learning_rate
-            //     << endl;
-
-            learning_rate /= 3.0 * nx * sample_proportion;
-
-            cerr << "calculated learning rate: " << learning_rate
-                 << " heuristic learning rate: "
-                 << (0.75 / (nx * sample_proportion))
-                 << " ratio "
-                 << (learning_rate / (0.75 / (nx * sample_proportion)))
-                 << endl;
-#endif
+    // The reading threads decode the next minibatches whilst we train on
+    // this one
+    feeder.start_epoch(sample_proportion, randomize_order,
+                       thread_context.random());
 
-            learning_rate = this->learning_rate / (nx * sample_proportion);
+    while (std::shared_ptr<Minibatch> batch = feeder.next()) {
+        int nb = batch->size;
+        nx2 += nb;
+
+        Parameters_Copy<double> updates(encoder.parameters(), 0.0);
+                
+        // Now, submit it as jobs to the worker task to be done
+        // multithreaded
+        int group;
+        {
+            int parent = -1;  // no parent group
+            group = worker.get_group(NO_JOB, "dump user results task",
+                                     parent);
+                    
+            // Make sure the group gets unlocked once we've populated
+            // everything
+            Call_Guard guard(boost::bind(&Worker_Task::unlock_group,
+                                         boost::ref(worker),
+                                         group));
+                    
+            for (unsigned x2 = 0;  x2 < nb;  x2 += microbatch_size) {
+                        
+                Train_Examples_Job job(*this,
+                                       encoder,
+                                       batch->data,
+                                       x2,
+                                       min<int>(nb, x2 + microbatch_size),
+                                       examples,
+                                       thread_context,
+                                       thread_context.random(),
+                                       updates,
+                                       update_lock,
+                                       total_mse_exact,
+                                       total_mse_noisy,
+                                       0 /* progress */);
 
-            //cerr << "learning_rate = " << learning_rate << " nx = " << nx
-            //     << endl;
+                // Send it to a thread to be processed
+                worker.add(job, "blend job", group);
+            }
         }
-        else if (iter % 5 == 0 && individual_learning_rates) {
+                
+        worker.run_until_finished(group);
+
+        feeder.recycle(batch);
+
+        encoder.parameters().update(updates, -learning_rate);
+    }
+
+    if (nx2 == 0)
+        throw Exception("Auto_Encoder_Trainer::train_iter(): "
+                        "no examples in epoch");
+
+    return make_pair(sqrt(total_mse_exact / nx2), sqrt(total_mse_noisy / nx2));
+}
+
+namespace {
+
+/** The iterations of training shared by both versions of train().  The
+    training data comes either from memory or through the feeder.  In
+    memory, it's also used to calculate individual learning rates and to
+    re-test on the training set, neither of which can be done when it's
+    streamed.
+*/
+void train_epochs(const Auto_Encoder_Trainer & trainer,
+                  Auto_Encoder & encoder,
+                  Minibatch_Feeder * feeder,
+                  const std::vector<distribution<float> > * training_data,
+                  const std::vector<distribution<float> > & testing_data,
+                  Thread_Context & thread_context,
+                  int niter)
+{
+    int verbosity = trainer.verbosity;
+    int test_every = trainer.test_every;
+
+    if (niter == -1) niter = trainer.niter;
+
+    if (trainer.individual_learning_rates && !training_data)
+        throw Exception("Auto_Encoder_Trainer::train(): individual learning "
+                        "rates need the training data in memory");
+
+    if (feeder && feeder->inputs() != encoder.inputs())
+        throw Exception("Auto_Encoder_Trainer::train(): training data has "
+                        "wrong number of inputs");
+
+    int nx = (feeder ? feeder->size() : training_data->size());
+    int nxt = testing_data.size();
+
+    if (nx == 0)
+        throw Exception("can't train on no data");
+
+    double learning_rate
+        = trainer.learning_rate / (nx * trainer.sample_proportion);
+
+    Parameters_Copy<float> learning_rates;
+
+    if (verbosity == 2 && training_data)
+        cerr << "iter      lr  -- inst train--  ---- train ----  ---- test -----\n"
+             << "----  ------    exact   noisy    exact   noisy    exact   noisy\n";
+    else if (verbosity == 2)
+        cerr << "iter      lr  -- inst train--  ---- test -----\n"
+             << "----  ------    exact   noisy    exact   noisy\n";
+    
+    for (unsigned iter = 0;  iter < niter;  ++iter) {
+
+        if (iter % 5 == 0 && trainer.individual_learning_rates)
             learning_rates
-                = calc_learning_rates(encoder, training_data, thread_context);
-        }
+                = trainer.calc_learning_rates(encoder, *training_data,
+                                              thread_context);
 
         if (verbosity >= 3)
             cerr << "iter " << iter << " training on " << nx << " examples"
                  << endl;
         else if (verbosity >= 2)
-            cerr << format("  %6.4f", learning_rate) << flush;
+            cerr << format("%4d  %6.4f", iter, learning_rate) << flush;
         Timer timer;
         
         double train_error_exact, train_error_noisy;
 
-        if (!individual_learning_rates)
+        if (trainer.individual_learning_rates)
+            boost::tie(train_error_exact, train_error_noisy)
+                = trainer.train_iter(encoder, *training_data, thread_context,
+                                     learning_rates);
+        else if (feeder)
             boost::tie(train_error_exact, train_error_noisy)
-                = train_iter(encoder, training_data, thread_context,
-                             learning_rate);
-        else 
+                = trainer.train_iter(encoder, *feeder, thread_context,
+                                     learning_rate);
+        else
             boost::tie(train_error_exact, train_error_noisy)
-                = train_iter(encoder, training_data, thread_context,
-                             learning_rates);
+                = trainer.train_iter(encoder, *training_data, thread_context,
+                                     learning_rate);
         
         if (verbosity >= 3) {
             cerr << "rmse of iteration: exact " << train_error_exact
@@ -497,51 +592,93 @@ train(Auto_Encoder & encoder,
         
         if (iter % test_every == (test_every - 1)
             || iter == niter - 1) {
-            timer.restart();
 
-            double train_error_exact = 0.0, train_error_noisy = 0.0;
+            // When the training set is streamed it's too big to test on
+            // again; the moving estimate from the iteration above has to do
+            if (training_data) {
+                timer.restart();
+
+                double train_error_exact = 0.0, train_error_noisy = 0.0;
             
-            if (verbosity >= 3)
-                cerr << "testing on " << nxt << " examples"
-                     << endl;
+                if (verbosity >= 3)
+                    cerr << "testing on " << nx << " training examples"
+                         << endl;
             
-            boost::tie(train_error_exact, train_error_noisy)
-                = test(encoder, training_data, thread_context);
+                boost::tie(train_error_exact, train_error_noisy)
+                    = trainer.test(encoder, *training_data, thread_context);
             
-            if (verbosity >= 3) {
-                cerr << "training rmse of iteration: exact "
-                     << train_error_exact << " noisy " << train_error_noisy
-                     << endl;
-                cerr << timer.elapsed() << endl;
+                if (verbosity >= 3) {
+                    cerr << "training rmse of iteration: exact "
+                         << train_error_exact << " noisy "
+                         << train_error_noisy << endl;
+                    cerr << timer.elapsed() << endl;
+                }
+                else if (verbosity == 2)
+                    cerr << format("  %7.5f %7.5f",
+                                   train_error_exact, train_error_noisy);
             }
-            else if (verbosity == 2)
-                cerr << format("  %7.5f %7.5f",
-                               train_error_exact, train_error_noisy);
 
-            double test_error_exact = 0.0, test_error_noisy = 0.0;
+            if (nxt != 0) {
+                timer.restart();
+
+                double test_error_exact = 0.0, test_error_noisy = 0.0;
             
-            if (verbosity >= 3)
-                cerr << "testing on " << nxt << " examples"
-                     << endl;
+                if (verbosity >= 3)
+                    cerr << "testing on " << nxt << " examples"
+                         << endl;
             
-            boost::tie(test_error_exact, test_error_noisy)
-                = test(encoder, testing_data, thread_context);
+                boost::tie(test_error_exact, test_error_noisy)
+                    = trainer.test(encoder, testing_data, thread_context);
             
-            if (verbosity >= 3) {
-                cerr << "testing rmse of iteration: exact "
-                     << test_error_exact << " noisy " << test_error_noisy
-                     << endl;
-                cerr << timer.elapsed() << endl;
+                if (verbosity >= 3) {
+                    cerr << "testing rmse of iteration: exact "
+                         << test_error_exact << " noisy " << test_error_noisy
+                         << endl;
+                    cerr << timer.elapsed() << endl;
+                }
+                else if (verbosity == 2)
+                    cerr << format("  %7.5f %7.5f",
+                                   test_error_exact, test_error_noisy);
             }
-            else if (verbosity == 2)
-                cerr << format("  %7.5f %7.5f",
-                               test_error_exact, test_error_noisy);
         }
         
         if (verbosity == 2) cerr << endl;
     }
 }
 
+} // file scope
+
+void
+Auto_Encoder_Trainer::
+train(Auto_Encoder & encoder,
+      const std::vector<distribution<float> > & training_data,
+      const std::vector<distribution<float> > & testing_data,
+      Thread_Context & thread_context,
+      int niter) const
+{
+    for (unsigned i = 0;  i < training_data.size();  ++i)
+        if (training_data[i].size() != encoder.inputs())
+            throw Exception("Auto_Encoder_Trainer::train(): training data "
+                            "has wrong number of inputs");
+
+    // The minibatches are made from a permutation of the indexes of the
+    // examples, so that they are neither copied nor handed between threads
+    train_epochs(*this, encoder, 0, &training_data, testing_data,
+                 thread_context, niter);
+}
+
+void
+Auto_Encoder_Trainer::
+train(Auto_Encoder & encoder,
+      Minibatch_Feeder & training_data,
+      const std::vector<distribution<float> > & testing_data,
+      Thread_Context & thread_context,
+      int niter) const
+{
+    train_epochs(*this, encoder, &training_data, 0, testing_data,
+                 thread_context, niter);
+}
+
 double
 Auto_Encoder_Trainer::
 calc_learning_rate(const Auto_Encoder & layer,
@@ -747,6 +884,64 @@ calc_learning_rates(const Auto_Encoder & layer,
     return result;
 }
 
+namespace {
+
+/** Runs the whole-stack backprop that follows the training of a layer.
+    Used both inline and, when pipelined, in its own thread. */
+struct Fine_Tune_Stack_Job {
+
+    const Auto_Encoder_Trainer & trainer;
+    Auto_Encoder_Stack & stack;
+    const vector<distribution<float> > & training_data;
+    const vector<distribution<float> > & testing_data;
+    Thread_Context context;
+    std::string & error;
+
+    Fine_Tune_Stack_Job(const Auto_Encoder_Trainer & trainer,
+                        Auto_Encoder_Stack & stack,
+                        const vector<distribution<float> > & training_data,
+                        const vector<distribution<float> > & testing_data,
+                        const Thread_Context & context,
+                        int random_seed,
+                        std::string & error)
+        : trainer(trainer), stack(stack), training_data(training_data),
+          testing_data(testing_data), context(context), error(error)
+    {
+        this->context.seed(random_seed);
+    }
+
+    void operator () ()
+    {
+        try {
+            if (trainer.verbosity >= 3)
+                cerr << "calculating whole stack testing performance on "
+                     << testing_data.size() << " examples" << endl;
+
+            if (trainer.verbosity >= 1) {
+                double test_error_exact = 0.0, test_error_noisy = 0.0;
+                boost::tie(test_error_exact, test_error_noisy)
+                    = trainer.test(stack, testing_data, context);
+
+                cerr << "testing rmse of stack: exact "
+                     << test_error_exact << " noisy " << test_error_noisy
+                     << endl;
+
+                cerr << endl << endl << "training whole stack backprop"
+                     << endl;
+            }
+
+            trainer.train(stack, training_data, testing_data, context,
+                          trainer.stack_backprop_iter);
+        } catch (const std::exception & exc) {
+            error = exc.what();
+        } catch (...) {
+            error = "unknown exception";
+        }
+    }
+};
+
+} // file scope
+
 void
 Auto_Encoder_Trainer::
 train_stack(Auto_Encoder_Stack & stack,
@@ -760,59 +955,68 @@ train_stack(Auto_Encoder_Stack & stack,
     if (nx == 0)
         throw Exception("can't train on no data");
 
+    if (cache_layer_outputs && individual_learning_rates)
+        throw Exception("Auto_Encoder_Trainer::train_stack(): individual "
+                        "learning rates can't be used with cached layer "
+                        "outputs");
+
     int nlayers = stack.size();
 
-    vector<distribution<float> > layer_train = training_data;
+    // Inputs of the current layer.  The first layer uses training_data
+    // directly; the ones above use layer_train or, if we're caching, the
+    // train_cache.
+    vector<distribution<float> > layer_train;
+    std::shared_ptr<Layer_Output_Cache> train_cache;
     vector<distribution<float> > layer_test = testing_data;
 
-    // Learning rate is per-example
-    double learning_rate = this->learning_rate / nx;
+    bool pipeline = pipeline_stack_backprop && stack_backprop_iter > 0;
 
-    // Compensate for the example proportion
-    learning_rate /= sample_proportion;
+    // Background thread running the previous layer's fine tuning
+    std::shared_ptr<boost::thread> fine_tuner;
+    std::string fine_tune_error;
 
     Auto_Encoder_Stack test_stack("test");
 
+    // Never leave the thread running on the stack if we exit early
+    Call_Guard join_guard([&] () { if (fine_tuner) fine_tuner->join(); });
+
     for (unsigned layer_num = 0;  layer_num < nlayers;  ++layer_num) {
         cerr << endl << endl << endl << "--------- LAYER " << layer_num
              << " ---------" << endl << endl;
 
         Auto_Encoder & layer = stack[layer_num];
 
-        vector<distribution<float> > next_layer_train, next_layer_test;
-
         int ni = layer.inputs();
 
-        if (ni != layer_train[0].size())
+        int layer_ni = (layer_num == 0 ? training_data[0].size()
+                        : (train_cache ? train_cache->width()
+                           : layer_train[0].size()));
+        if (ni != layer_ni)
             throw Exception("ni is wrong");
 
-        train(layer, layer_train, layer_test, thread_context, niter);
-
-        next_layer_train.resize(nx);
-        next_layer_test.resize(nxt);
-
-        // Add it to the testing stack so that we can test up to here
-        test_stack.add(make_unowned_sp(layer));
-
-        if (stack_backprop_iter > 0 && layer_num != 0) {
-
-            // Test the layer stack
-            if (verbosity >= 3)
-                cerr << "calculating whole stack testing performance on "
-                     << nxt << " examples" << endl;
-            
-            if (verbosity >= 1) {
-                double test_error_exact = 0.0, test_error_noisy = 0.0;
-                boost::tie(test_error_exact, test_error_noisy)
-                    = test(test_stack, testing_data, thread_context);
-                
-                cerr << "testing rmse of stack: exact "
-                     << test_error_exact << " noisy " << test_error_noisy
-                     << endl;
-                
-                cerr << endl << endl << "training whole stack backprop" << endl;
-                train(test_stack, training_data, testing_data, thread_context,
-                      stack_backprop_iter);
+        if (layer_num == 0)
+            train(layer, training_data, layer_test, thread_context, niter);
+        else if (train_cache) {
+            vector<std::shared_ptr<Example_Source> > sources(1, train_cache);
+            Minibatch_Feeder feeder(sources, minibatch_size);
+            train(layer, feeder, layer_test, thread_context, niter);
+        }
+        else train(layer, layer_train, layer_test, thread_context, niter);
+
+        bool fine_tune = stack_backprop_iter > 0 && layer_num != 0;
+
+        if (!pipeline) {
+            // Add it to the testing stack so that we can test up to here
+            test_stack.add(make_unowned_sp(layer));
+
+            if (fine_tune) {
+                Fine_Tune_Stack_Job job(*this, test_stack, training_data,
+                                        testing_data, thread_context,
+                                        thread_context.random(),
+                                        fine_tune_error);
+                job();
+                if (fine_tune_error != "")
+                    throw Exception(fine_tune_error);
             }
         }
 
@@ -822,9 +1026,33 @@ train_stack(Auto_Encoder_Stack & stack,
             cerr << "calculating next layer training inputs on "
                  << nx << " examples" << endl;
         double train_error_exact = 0.0, train_error_noisy = 0.0;
-        boost::tie(train_error_exact, train_error_noisy)
-            = test_and_update(layer, layer_train, next_layer_train,
-                              thread_context);
+
+        if (cache_layer_outputs) {
+            std::shared_ptr<Layer_Output_Cache> next_cache
+                (new Layer_Output_Cache(nx, layer.outputs(),
+                                        cache_half_precision));
+            if (layer_num == 0)
+                boost::tie(train_error_exact, train_error_noisy)
+                    = test_and_update(layer, training_data, *next_cache,
+                                      thread_context);
+            else boost::tie(train_error_exact, train_error_noisy)
+                     = test_and_update(layer, *train_cache, *next_cache,
+                                       thread_context);
+
+            if (verbosity >= 3)
+                cerr << "cached next layer inputs in "
+                     << next_cache->memusage() << " bytes" << endl;
+
+            train_cache = next_cache;
+        }
+        else {
+            vector<distribution<float> > next_layer_train(nx);
+            boost::tie(train_error_exact, train_error_noisy)
+                = test_and_update(layer,
+                                  layer_num == 0 ? training_data : layer_train,
+                                  next_layer_train, thread_context);
+            layer_train.swap(next_layer_train);
+        }
         
         if (verbosity >= 2)
             cerr << "training rmse of layer: exact "
@@ -834,6 +1062,7 @@ train_stack(Auto_Encoder_Stack & stack,
         if (verbosity >= 3)
             cerr << "calculating next layer testing inputs on "
                  << nxt << " examples" << endl;
+        vector<distribution<float> > next_layer_test(nxt);
         double test_error_exact = 0.0, test_error_noisy = 0.0;
         boost::tie(test_error_exact, test_error_noisy)
             = test_and_update(layer, layer_test, next_layer_test,
@@ -844,9 +1073,32 @@ train_stack(Auto_Encoder_Stack & stack,
                  << test_error_exact << " noisy " << test_error_noisy
                  << endl;
 
-        layer_train.swap(next_layer_train);
         layer_test.swap(next_layer_test);
 
+        if (pipeline) {
+            // The layers below may only be touched once the previous fine
+            // tuning has finished
+            if (fine_tuner) {
+                fine_tuner->join();
+                fine_tuner.reset();
+                if (fine_tune_error != "")
+                    throw Exception(fine_tune_error);
+            }
+
+            test_stack.add(make_unowned_sp(layer));
+
+            if (fine_tune) {
+                // Fine tune in the background while the next layer trains
+                // from the inputs that we just calculated
+                Fine_Tune_Stack_Job job(*this, test_stack, training_data,
+                                        testing_data, thread_context,
+                                        thread_context.random(),
+                                        fine_tune_error);
+                fine_tuner.reset(new boost::thread(job));
+                continue;
+            }
+        }
+
         // Test the layer stack
         if (verbosity >= 3)
             cerr << "calculating whole stack testing performance on "
@@ -861,6 +1113,23 @@ train_stack(Auto_Encoder_Stack & stack,
                  << endl;
         }
     }
+
+    if (fine_tuner) {
+        fine_tuner->join();
+        fine_tuner.reset();
+        if (fine_tune_error != "")
+            throw Exception(fine_tune_error);
+
+        if (verbosity >= 1) {
+            double test_error_exact = 0.0, test_error_noisy = 0.0;
+            boost::tie(test_error_exact, test_error_noisy)
+                = test(test_stack, testing_data, thread_context);
+
+            cerr << "testing rmse of stack: exact "
+                 << test_error_exact << " noisy " << test_error_noisy
+                 << endl;
+        }
+    }
 }
 
 
@@ -879,8 +1148,10 @@ struct Test_Examples_Job {
 
     const Auto_Encoder_Trainer & trainer;
     const Auto_Encoder & layer;
-    const vector<distribution<float> > & data_in;
-    vector<distribution<float> > & data_out;
+    const vector<distribution<float> > * data_in;
+    const Layer_Output_Cache * cache_in;
+    vector<distribution<float> > * data_out;
+    Layer_Output_Cache * cache_out;
     int first;
     int last;
     const Thread_Context & context;
@@ -890,10 +1161,15 @@ struct Test_Examples_Job {
     double & error_noisy;
     boost::progress_display * progress;
 
+    /** The inputs come from either data_in or cache_in, and the outputs
+        (if wanted) go to either data_out or cache_out; the others are
+        null. */
     Test_Examples_Job(const Auto_Encoder_Trainer & trainer,
                       const Auto_Encoder & layer,
-                      const vector<distribution<float> > & data_in,
-                      vector<distribution<float> > & data_out,
+                      const vector<distribution<float> > * data_in,
+                      const Layer_Output_Cache * cache_in,
+                      vector<distribution<float> > * data_out,
+                      Layer_Output_Cache * cache_out,
                       int first, int last,
                       const Thread_Context & context,
                       int random_seed,
@@ -901,7 +1177,8 @@ struct Test_Examples_Job {
                       double & error_exact,
                       double & error_noisy,
                       boost::progress_display * progress)
-        : trainer(trainer), layer(layer), data_in(data_in), data_out(data_out),
+        : trainer(trainer), layer(layer), data_in(data_in),
+          cache_in(cache_in), data_out(data_out), cache_out(cache_out),
           first(first), last(last),
           context(context), random_seed(random_seed),
           update_lock(update_lock),
@@ -922,7 +1199,8 @@ struct Test_Examples_Job {
             int no JML_UNUSED = layer.outputs();
 
             // Present this input
-            distribution<float> model_input(data_in[x]);
+            distribution<float> model_input
+                = (cache_in ? cache_in->row(x) : (*data_in)[x]);
             
             distribution<bool> was_cleared;
 
@@ -953,8 +1231,10 @@ struct Test_Examples_Job {
             distribution<float> hidden_rep2
                 = layer.apply(model_input);
 
-            if (!data_out.empty())
-                data_out.at(x) = hidden_rep2.cast<float>();
+            if (cache_out)
+                cache_out->set_row(x, hidden_rep2);
+            else if (data_out && !data_out->empty())
+                data_out->at(x) = hidden_rep2.cast<float>();
             
             // Reconstruct the input
             distribution<float> reconstructed_input
@@ -993,23 +1273,24 @@ struct Test_Examples_Job {
     }
 };
 
-} // file scope
-
+/** Runs the testing jobs over all of the examples, in parallel. */
 std::pair<double, double>
-Auto_Encoder_Trainer::
-test_and_update(const Auto_Encoder & encoder,
-                const std::vector<distribution<float> > & data_in,
-                std::vector<distribution<float> > & data_out,
-                Thread_Context & thread_context) const
+run_test_jobs(const Auto_Encoder_Trainer & trainer,
+              const Auto_Encoder & encoder,
+              int nx,
+              const std::vector<distribution<float> > * data_in,
+              const Layer_Output_Cache * cache_in,
+              std::vector<distribution<float> > * data_out,
+              Layer_Output_Cache * cache_out,
+              Thread_Context & thread_context)
 {
     Lock update_lock;
     double error_exact = 0.0;
     double error_noisy = 0.0;
 
-    int nx = data_in.size();
-
     std::auto_ptr<boost::progress_display> progress;
-    if (verbosity >= 3) progress.reset(new boost::progress_display(nx, cerr));
+    if (trainer.verbosity >= 3)
+        progress.reset(new boost::progress_display(nx, cerr));
 
     Worker_Task & worker = thread_context.worker();
             
@@ -1028,11 +1309,12 @@ test_and_update(const Auto_Encoder & encoder,
                                      group));
         
         // 20 jobs per CPU
-        int batch_size = nx / (num_threads() * 20);
+        int batch_size = std::max(nx / (num_threads() * 20), 1);
         
         for (unsigned x = 0; x < nx;  x += batch_size) {
             
-            Test_Examples_Job job(*this, encoder, data_in, data_out,
+            Test_Examples_Job job(trainer, encoder,
+                                  data_in, cache_in, data_out, cache_out,
                                   x, min<int>(x + batch_size, nx),
                                   thread_context,
                                   thread_context.random(),
@@ -1050,6 +1332,56 @@ test_and_update(const Auto_Encoder & encoder,
     return make_pair(sqrt(error_exact / nx),
                      sqrt(error_noisy / nx));
 }
+
+void check_cache_out(const Auto_Encoder & encoder, int nx,
+                     const Layer_Output_Cache & cache)
+{
+    if (cache.size() != nx || cache.width() != encoder.outputs())
+        throw Exception(format("Auto_Encoder_Trainer::test_and_update(): "
+                               "output cache is %zdx%d but needs to be "
+                               "%dx%d", cache.size(), cache.width(),
+                               nx, encoder.outputs()));
+}
+
+} // file scope
+
+std::pair<double, double>
+Auto_Encoder_Trainer::
+test_and_update(const Auto_Encoder & encoder,
+                const std::vector<distribution<float> > & data_in,
+                std::vector<distribution<float> > & data_out,
+                Thread_Context & thread_context) const
+{
+    return run_test_jobs(*this, encoder, data_in.size(), &data_in, 0,
+                         &data_out, 0, thread_context);
+}
+
+std::pair<double, double>
+Auto_Encoder_Trainer::
+test_and_update(const Auto_Encoder & encoder,
+                const std::vector<distribution<float> > & data_in,
+                Layer_Output_Cache & data_out,
+                Thread_Context & thread_context) const
+{
+    check_cache_out(encoder, data_in.size(), data_out);
+    return run_test_jobs(*this, encoder, data_in.size(), &data_in, 0,
+                         0, &data_out, thread_context);
+}
+
+std::pair<double, double>
+Auto_Encoder_Trainer::
+test_and_update(const Auto_Encoder & encoder,
+                const Layer_Output_Cache & data_in,
+                Layer_Output_Cache & data_out,
+                Thread_Context & thread_context) const
+{
+    if (data_in.width() != encoder.inputs())
+        throw Exception("Auto_Encoder_Trainer::test_and_update(): input "
+                        "cache has wrong width");
+    check_cache_out(encoder, data_in.size(), data_out);
+    return run_test_jobs(*this, encoder, data_in.size(), 0, &data_in,
+                         0, &data_out, thread_context);
+}
     
 } // namespace ML
 
@@ -19,6 +19,8 @@ namespace ML {
 
 
 struct Configuration;
+struct Minibatch_Feeder;
+struct Layer_Output_Cache;
 
 
 /*****************************************************************************/
@@ -49,6 +51,9 @@ struct Auto_Encoder_Trainer {
     float weight_decay_l1;
     float weight_decay_l2;
     int dump_testing_output;
+    bool cache_layer_outputs;
+    bool cache_half_precision;
+    bool pipeline_stack_backprop;
 
     /** Add noise to the distribution, according to the noise parameters that
         have been set above. */
@@ -81,6 +86,15 @@ struct Auto_Encoder_Trainer {
                Thread_Context & thread_context,
                const Parameters_Copy<float> & learning_rates) const;
 
+    /** Trains a single iteration on minibatches streamed from the given
+        feeder, which determines the minibatch size.  The learning rate is
+        per example. */
+    std::pair<double, double>
+    train_iter(Auto_Encoder & encoder,
+               Minibatch_Feeder & feeder,
+               Thread_Context & thread_context,
+               double learning_rate) const;
+
     /** Calculate the optimal learning rate for the given training data */
     double
     calc_learning_rate(const Auto_Encoder & layer,
@@ -92,15 +106,40 @@ struct Auto_Encoder_Trainer {
                         const std::vector<distribution<float> > & training_data,
                         Thread_Context & thread_context) const;
 
+    /** Train on a dataset that is held in memory, with minibatches made
+        from a permutation of the example indexes.  It can also be used for
+        individual learning rates and to test on the training set. */
     void
     train(Auto_Encoder & encoder,
           const std::vector<distribution<float> > & training_data,
           const std::vector<distribution<float> > & testing_data,
           Thread_Context & thread_context,
           int niter = -1) const;
+
+    /** Train on a dataset that is streamed from disk, for when it is too
+        large to fit in memory.  Individual learning rates are not
+        supported. */
+    void
+    train(Auto_Encoder & encoder,
+          Minibatch_Feeder & training_data,
+          const std::vector<distribution<float> > & testing_data,
+          Thread_Context & thread_context,
+          int niter = -1) const;
     
     /** Trains an auto-encoder stack in a greedy manner by training one layer
-        at a time. */
+        at a time.
+
+        If cache_layer_outputs is set, then the output of each layer over
+        the training set is kept in a compact Layer_Output_Cache (in half
+        precision if cache_half_precision is set) and the layer above is
+        trained by streaming minibatches from it.
+
+        If pipeline_stack_backprop is set, then the whole-stack backprop
+        that follows each layer (stack_backprop_iter) runs in a separate
+        thread while the next layer is being trained.  The next layer then
+        learns from the representation before that fine tuning rather than
+        after it.
+    */
     void train_stack(Auto_Encoder_Stack & stack,
                      const std::vector<distribution<float> > & training_data,
                      const std::vector<distribution<float> > & testing_data,
@@ -116,6 +155,23 @@ struct Auto_Encoder_Trainer {
                     std::vector<distribution<float> > & data_out,
                     Thread_Context & thread_context) const;
 
+    /** Same as above, but writes the hidden representations into the given
+        cache, which must already be initialized with one row per example
+        and the encoder's number of outputs as its width. */
+    std::pair<double, double>
+    test_and_update(const Auto_Encoder & encoder,
+                    const std::vector<distribution<float> > & data_in,
+                    Layer_Output_Cache & data_out,
+                    Thread_Context & thread_context) const;
+
+    /** Same as above, but reads the inputs from a cache (for a layer above
+        the first). */
+    std::pair<double, double>
+    test_and_update(const Auto_Encoder & encoder,
+                    const Layer_Output_Cache & data_in,
+                    Layer_Output_Cache & data_out,
+                    Thread_Context & thread_context) const;
+
     /** Tests on the given dataset, returning the exact and noisy RMSE. */
     std::pair<double, double>
     test(const Auto_Encoder & encoder,
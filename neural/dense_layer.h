@@ -97,6 +97,18 @@ struct Dense_Layer : public Layer {
 
     using Layer::apply;
 
+    /** Apply to a block of rows.  Each weight row is streamed over several
+        examples at once, so that the weight matrix is read once per group
+        of rows rather than once per row.  The results are identical to
+        those of apply(). */
+    virtual void apply_block(const float * input, float * output,
+                             size_t n) const;
+    virtual void apply_block(const double * input, double * output,
+                             size_t n) const;
+
+    template<class F>
+    void apply_block(const F * input, F * output, size_t n) const;
+
 
     /*************************************************************************/
     /* ACTIVATION                                                            */
@@ -117,6 +129,48 @@ struct Dense_Layer : public Layer {
     distribution<double> activation(const distribution<double> & input) const;
 
 
+    /*************************************************************************/
+    /* SPARSE INPUT                                                          */
+    /*************************************************************************/
+
+    /* For very wide, mostly zero inputs (eg, bags of words), the input can
+       be given as n (index, value) pairs.  Inputs that aren't mentioned are
+       zero.  Only the weight rows of the inputs that are mentioned are
+       touched, so the cost is proportional to n rather than to inputs().
+       A NaN value is treated according to missing_values, as for a dense
+       input. */
+
+    void apply_sparse(const int * indexes, const float * values, size_t n,
+                      float * output) const;
+    void apply_sparse(const int * indexes, const double * values, size_t n,
+                      double * output) const;
+
+    template<class F>
+    void activation_sparse(const int * indexes, const F * values, size_t n,
+                           F * activation) const;
+
+    /** Backpropagate the output errors for a sparse input.  Only the
+        bias and the weight rows of the active inputs are updated, via
+        Matrix_Parameter::update_row(), and no input errors are calculated
+        (this is meant for the first layer).
+
+        The gradient may be shared between several threads if its locking
+        policy has been set (see Parameter_Value::set_locking()); it may also
+        be the layer's own parameters, in which case the example_weight
+        should include the negative learning rate. */
+    void bprop_sparse(const int * indexes, const float * values, size_t n,
+                      const float * outputs, const float * output_errors,
+                      Parameters & gradient, double example_weight) const;
+    void bprop_sparse(const int * indexes, const double * values, size_t n,
+                      const double * outputs, const double * output_errors,
+                      Parameters & gradient, double example_weight) const;
+
+    template<class F>
+    void bprop_sparse(const int * indexes, const F * values, size_t n,
+                      const F * outputs, const F * output_errors,
+                      Parameters & gradient, double example_weight) const;
+
+
     /*************************************************************************/
     /* FPROP                                                                 */
     /*************************************************************************/
@@ -246,6 +300,13 @@ struct Dense_Layer : public Layer {
     }
 
 private:
+    /** Find the weight row and the input value to use for input i, which
+        has the given value, taking care of the missing value policy.
+        Returns false if the input doesn't contribute to the activation. */
+    template<class F>
+    bool input_weights(int i, F value,
+                       double & input, const Float * & w) const;
+
     struct RegisterMe;
     static RegisterMe register_me;
 };
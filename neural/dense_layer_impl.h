@@ -326,6 +326,91 @@ apply(const double * input,
     transfer_function->transfer(act, output, no);
 }
 
+template<typename Float>
+template<class F>
+void
+Dense_Layer<Float>::
+apply_block(const F * input, F * output, size_t n) const
+{
+    int ni = inputs(), no = outputs();
+
+    // Keep the accumulators for a group of rows small enough to stay in
+    // the cache whilst each weight row is streamed over them.
+    int rows_per_pass = std::max(1, 4096 / std::max(no, 1));
+    double accum[rows_per_pass * no];
+
+    for (size_t r0 = 0;  r0 < n;  r0 += rows_per_pass) {
+        int nr = std::min<size_t>(rows_per_pass, n - r0);
+        const F * block_input = input + r0 * ni;
+        F * block_output = output + r0 * no;
+
+        for (unsigned r = 0;  r < nr;  ++r)
+            std::copy(bias.begin(), bias.end(), accum + r * no);
+
+        for (unsigned i = 0;  i < ni;  ++i) {
+            for (unsigned r = 0;  r < nr;  ++r) {
+                const Float * w;
+                double in;
+                if (!input_weights(i, block_input[r * ni + i], in, w))
+                    continue;
+                SIMD::vec_add(accum + r * no, in, w, accum + r * no, no);
+            }
+        }
+
+        for (unsigned r = 0;  r < nr;  ++r) {
+            F * o = block_output + r * no;
+            std::copy(accum + r * no, accum + (r + 1) * no, o);
+            transfer_function->transfer(o, o, no);
+        }
+    }
+}
+
+template<typename Float>
+void
+Dense_Layer<Float>::
+apply_block(const float * input, float * output, size_t n) const
+{
+    apply_block<float>(input, output, n);
+}
+
+template<typename Float>
+void
+Dense_Layer<Float>::
+apply_block(const double * input, double * output, size_t n) const
+{
+    apply_block<double>(input, output, n);
+}
+
+template<typename Float>
+template<class F>
+bool
+Dense_Layer<Float>::
+input_weights(int i, F value, double & input, const Float * & w) const
+{
+    if (!isnan(value)) {
+        input = value;
+        w = &weights[i][0];
+        return true;
+    }
+
+    switch (missing_values) {
+    case MV_NONE:
+        throw Exception("missing value with MV_NONE");
+        
+    case MV_ZERO:
+        return false;  // no need to calculate, since weight is zero
+        
+    case MV_INPUT:
+        input = missing_replacements[i];  w = &weights[i][0];  return true;
+        
+    case MV_DENSE:
+        input = 1.0;  w = &missing_activations[i][0];  return true;
+        
+    default:
+        throw Exception("unknown missing values");
+    }
+}
+
 template<typename Float>
 template<class F>
 void
@@ -340,30 +425,8 @@ activation(const F * inputs, F * activations) const
     for (unsigned i = 0;  i < ni;  ++i) {
         const Float * w;
         double input;
-        if (!isnan(inputs[i])) {
-            input = inputs[i];
-            w = &weights[i][0];
-        }
-        else {
-            switch (missing_values) {
-            case MV_NONE:
-                throw Exception("missing value with MV_NONE");
-
-            case MV_ZERO:
-                continue;  // no need to calculate, since weight is zero
-                input = 0.0;  w = &weights[i][0];  break;
-
-            case MV_INPUT:
-                input = missing_replacements[i];  w = &weights[i][0];  break;
-
-            case MV_DENSE:
-                input = 1.0;  w = &missing_activations[i][0];  break;
-
-            default:
-                throw Exception("unknown missing values");
-            }
-        }
-
+        if (!input_weights(i, inputs[i], input, w))
+            continue;
         SIMD::vec_add(accum, input, w, accum, no);
     }
     
@@ -662,6 +725,128 @@ bbprop(const double * inputs,
                           example_weight);
 }
 
+template<typename Float>
+template<class F>
+void
+Dense_Layer<Float>::
+activation_sparse(const int * indexes, const F * values, size_t n,
+                  F * activations) const
+{
+    int ni = inputs(), no = outputs();
+
+    double accum[no];  // Accumulate in double precision to improve rounding
+    std::copy(bias.begin(), bias.end(), accum);
+
+    for (unsigned j = 0;  j < n;  ++j) {
+        int i = indexes[j];
+        if (i < 0 || i >= ni)
+            throw Exception(format("Dense_Layer::activation_sparse(): "
+                                   "index %d out of range", i));
+        const Float * w;
+        double input;
+        if (!input_weights(i, values[j], input, w))
+            continue;
+        SIMD::vec_add(accum, input, w, accum, no);
+    }
+    
+    std::copy(accum, accum + no, activations);
+}
+
+template<typename Float>
+void
+Dense_Layer<Float>::
+apply_sparse(const int * indexes, const float * values, size_t n,
+             float * output) const
+{
+    activation_sparse(indexes, values, n, output);
+    transfer_function->transfer(output, output, outputs());
+}
+
+template<typename Float>
+void
+Dense_Layer<Float>::
+apply_sparse(const int * indexes, const double * values, size_t n,
+             double * output) const
+{
+    activation_sparse(indexes, values, n, output);
+    transfer_function->transfer(output, output, outputs());
+}
+
+template<typename Float>
+template<class F>
+void
+Dense_Layer<Float>::
+bprop_sparse(const int * indexes, const F * values, size_t n,
+             const F * outputs, const F * output_errors,
+             Parameters & gradient, double example_weight) const
+{
+    int ni = this->inputs(), no = this->outputs();
+
+    // Differentiate the output function
+    F derivs[no];
+    transfer_function->derivative(outputs, derivs, no);
+
+    // Bias updates are simply derivs in multiplied by transfer deriv
+    F dbias[no];
+    SIMD::vec_prod(derivs, &output_errors[0], dbias, no);
+    gradient.vector(1, "bias").update(dbias, example_weight);
+
+    Matrix_Parameter & dweights = gradient.matrix(0, "weights");
+
+    for (unsigned j = 0;  j < n;  ++j) {
+        int i = indexes[j];
+        if (i < 0 || i >= ni)
+            throw Exception(format("Dense_Layer::bprop_sparse(): "
+                                   "index %d out of range", i));
+        F value = values[j];
+
+        if (!isnan(value)) {
+            if (value == 0.0) continue;
+            dweights.update_row(i, dbias, value * example_weight);
+        }
+        else if (missing_values == MV_NONE)
+            throw Exception("MV_NONE but missing value");
+        else if (missing_values == MV_ZERO) {
+            // No update as everything is multiplied by zero
+        }
+        else if (missing_values == MV_DENSE) {
+            gradient.matrix(3, "missing_activations")
+                .update_row(i, dbias, example_weight);
+        }
+        else if (missing_values == MV_INPUT) {
+            dweights.update_row(i, dbias,
+                                missing_replacements[i] * example_weight);
+            gradient.vector(2, "missing_replacements")
+                .update_element(i,
+                                (example_weight
+                                 * SIMD::vec_dotprod_dp(&weights[i][0], dbias,
+                                                        no)));
+        }
+    }
+}
+
+template<typename Float>
+void
+Dense_Layer<Float>::
+bprop_sparse(const int * indexes, const float * values, size_t n,
+             const float * outputs, const float * output_errors,
+             Parameters & gradient, double example_weight) const
+{
+    bprop_sparse<float>(indexes, values, n, outputs, output_errors,
+                        gradient, example_weight);
+}
+
+template<typename Float>
+void
+Dense_Layer<Float>::
+bprop_sparse(const int * indexes, const double * values, size_t n,
+             const double * outputs, const double * output_errors,
+             Parameters & gradient, double example_weight) const
+{
+    bprop_sparse<double>(indexes, values, n, outputs, output_errors,
+                         gradient, example_weight);
+}
+
 namespace {
 
 template<typename Float>
@@ -14,6 +14,8 @@
 #include <boost/bind.hpp>
 #include "jml/arch/timers.h"
 #include "jml/stats/auc.h"
+#include "minibatch_feeder.h"
+#include <functional>
 
 using namespace std;
 
@@ -203,6 +205,85 @@ struct Train_Examples_Job {
     }
 };
 
+/** Train a single minibatch consisting of examples[first] to
+    examples[last - 1], split into microbatches that are run in parallel,
+    and apply the resulting update to the layer's parameters. */
+void train_minibatch(const Discriminative_Trainer & trainer,
+                     const std::vector<const float *> & data,
+                     const std::vector<Label> & labels,
+                     const std::vector<float> & weights,
+                     const Output_Encoder & output_encoder,
+                     Thread_Context & thread_context,
+                     const vector<int> & examples,
+                     int first, int last,
+                     int microbatch_size,
+                     vector<float> & outputs,
+                     double & total_mse,
+                     Lock & update_lock,
+                     boost::progress_display * progress,
+                     int verbosity,
+                     float learning_rate)
+{
+    Worker_Task & worker = thread_context.worker();
+
+    Parameters_Copy<double> updates(*trainer.layer);
+    updates.fill(0.0);
+
+    // Now, submit it as jobs to the worker task to be done
+    // multithreaded
+    int group;
+    {
+        int parent = -1;  // no parent group
+        group = worker.get_group(NO_JOB, "dump user results task",
+                                 parent);
+                    
+        // Make sure the group gets unlocked once we've populated
+        // everything
+        Call_Guard guard(boost::bind(&Worker_Task::unlock_group,
+                                     boost::ref(worker),
+                                     group));
+                    
+        for (unsigned x2 = first;  x2 < last;  x2 += microbatch_size) {
+                
+            Train_Examples_Job
+                job(trainer,
+                    data,
+                    labels,
+                    weights,
+                    output_encoder,
+                    thread_context,
+                    examples,
+                    x2,
+                    min<int>(last, x2 + microbatch_size),
+                    updates,
+                    outputs,
+                    total_mse,
+                    update_lock,
+                    progress,
+                    verbosity);
+
+            // Send it to a thread to be processed
+            worker.add(job, "backprop job", group);
+        }
+    }
+        
+    worker.run_until_finished(group);
+
+    //cerr << "finished minibatch: updates = " << updates.values
+    //     << " learning_rate = " << learning_rate << endl;
+
+    //cerr << "applying minibatch updates" << endl;
+        
+    //cerr << "updates.values = " << updates.values << endl;
+    //cerr << "learning_rate = " << learning_rate << endl;
+
+    trainer.layer->parameters().update(updates, -learning_rate);
+
+    //cerr << "final value = "
+    //     << Parameters_Copy<double>(trainer.layer->parameters()).values
+    //     << endl;
+}
+
 } // file scope
 
 std::pair<double, double>
@@ -240,8 +321,6 @@ train_iter(const std::vector<const float *> & data,
            float sample_proportion,
            bool randomize_order) const
 {
-    Worker_Task & worker = thread_context.worker();
-
     int nx = data.size();
 
     int microbatch_size = std::max(minibatch_size / (num_threads() * 4), 1);
@@ -271,67 +350,11 @@ train_iter(const std::vector<const float *> & data,
     if (verbosity >= 3) progress.reset(new boost::progress_display(nx2, cerr));
 
     for (unsigned x = 0;  x < nx2;  x += minibatch_size) {
-                
-        Parameters_Copy<double> updates(*layer);
-        updates.fill(0.0);
-
-        // Now, submit it as jobs to the worker task to be done
-        // multithreaded
-        int group;
-        {
-            int parent = -1;  // no parent group
-            group = worker.get_group(NO_JOB, "dump user results task",
-                                     parent);
-                    
-            // Make sure the group gets unlocked once we've populated
-            // everything
-            Call_Guard guard(boost::bind(&Worker_Task::unlock_group,
-                                         boost::ref(worker),
-                                         group));
-                    
-                    
-            for (unsigned x2 = x;  x2 < nx2 && x2 < x + minibatch_size;
-                 x2 += microbatch_size) {
-                
-                Train_Examples_Job
-                    job(*this,
-                        data,
-                        labels,
-                        weights,
-                        output_encoder,
-                        thread_context,
-                        examples,
-                        x2,
-                        min<int>(nx2,
-                                 min(x + minibatch_size,
-                                     x2 + microbatch_size)),
-                        updates,
-                        outputs,
-                        total_mse,
-                        update_lock,
-                        progress.get(),
-                        verbosity);
-
-                // Send it to a thread to be processed
-                worker.add(job, "backprop job", group);
-            }
-        }
-        
-        worker.run_until_finished(group);
-
-        //cerr << "finished minibatch: updates = " << updates.values
-        //     << " learning_rate = " << learning_rate << endl;
-
-        //cerr << "applying minibatch updates" << endl;
-        
-        //cerr << "updates.values = " << updates.values << endl;
-        //cerr << "learning_rate = " << learning_rate << endl;
-
-        layer->parameters().update(updates, -learning_rate);
-
-        //cerr << "final value = "
-        //     << Parameters_Copy<double>(layer->parameters()).values
-        //     << endl;
+        train_minibatch(*this, data, labels, weights, output_encoder,
+                        thread_context, examples, x,
+                        min<int>(nx2, x + minibatch_size), microbatch_size,
+                        outputs, total_mse, update_lock, progress.get(),
+                        verbosity, learning_rate);
     }
 
     // TODO: calculate AUC score
@@ -348,17 +371,93 @@ train_iter(const std::vector<const float *> & data,
 
 std::pair<double, double>
 Discriminative_Trainer::
-train(const std::vector<distribution<float> > & training_data,
-      const std::vector<Label> & training_labels,
-      const std::vector<float> & training_weights,
-      const std::vector<distribution<float> > & testing_data,
-      const std::vector<Label> & testing_labels,
-      const std::vector<float> & testing_weights,
-      const Configuration & config,
-      ML::Thread_Context & thread_context) const
+train_iter(Minibatch_Feeder & feeder,
+           const Output_Encoder & output_encoder,
+           Thread_Context & thread_context,
+           float learning_rate,
+           int verbosity,
+           float sample_proportion,
+           bool randomize_order) const
+{
+    int microbatch_size
+        = std::max(feeder.minibatch_size() / (num_threads() * 4), 1);
+
+    Lock update_lock;
+
+    double total_mse = 0.0;
+
+    // Only the outputs and labels are kept for the AUC calculation
+    distribution<float> outputs;
+    distribution<float> test_labels;
+
+    vector<const float *> rows;
+    vector<int> examples;
+    vector<float> batch_outputs;
+
+    // The reading threads decode the next minibatches whilst we train on
+    // this one
+    feeder.start_epoch(sample_proportion, randomize_order,
+                       thread_context.random());
+
+    while (std::shared_ptr<Minibatch> batch = feeder.next()) {
+        int nb = batch->size;
+
+        rows.resize(nb);
+        examples.resize(nb);
+        batch_outputs.resize(nb);
+        for (unsigned i = 0;  i < nb;  ++i) {
+            rows[i] = &batch->data[i][0];
+            examples[i] = i;
+        }
+
+        train_minibatch(*this, rows, batch->labels, batch->weights,
+                        output_encoder, thread_context, examples, 0, nb,
+                        microbatch_size, batch_outputs, total_mse,
+                        update_lock, 0 /* progress */, verbosity,
+                        learning_rate);
+
+        for (unsigned i = 0;  i < nb;  ++i) {
+            outputs.push_back(batch_outputs[i]);
+            test_labels.push_back(batch->labels[i]);
+        }
+
+        feeder.recycle(batch);
+    }
+
+    int nx2 = outputs.size();
+    if (nx2 == 0)
+        throw Exception("Discriminative_Trainer::train_iter(): "
+                        "no examples in epoch");
+
+    float neg = 0.0, pos = 1.0;
+
+    double auc = calc_auc(outputs, test_labels, neg, pos);
+
+    return make_pair(sqrt(total_mse / nx2), auc);
+}
+
+namespace {
+
+/** Trains an epoch with the given output encoder, learning rate,
+    verbosity, sample proportion and order randomization, and returns the
+    training RMSE and AUC. */
+typedef std::function<std::pair<double, double>
+                      (const Output_Encoder &, float, int, float, bool)>
+Train_Epoch;
+
+/** The iterations of training shared by both versions of train(); only
+    the way that an epoch of nx examples is run differs between them. */
+std::pair<double, double>
+train_epochs(const Discriminative_Trainer & trainer,
+             const Train_Epoch & train_epoch,
+             int nx,
+             const std::vector<distribution<float> > & testing_data,
+             const std::vector<Label> & testing_labels,
+             const std::vector<float> & testing_weights,
+             const Configuration & config,
+             ML::Thread_Context & thread_context)
 {
     double learning_rate = 0.75;
-    int minibatch_size = 512;
     int niter = 50;
     int verbosity = 2;
 
@@ -367,22 +466,15 @@ train(const std::vector<distribution<float> > & training_data,
     int test_every = 1;
 
     Output_Encoder output_encoder;
-    output_encoder.configure(config, *layer);
+    output_encoder.configure(config, *trainer.layer);
 
     config.get(learning_rate, "learning_rate");
-    config.get(minibatch_size, "minibatch_size");
     config.get(niter, "niter");
     config.get(verbosity, "verbosity");
     config.get(randomize_order, "randomize_order");
     config.get(sample_proportion, "sample_proportion");
     config.get(test_every, "test_every");
 
-    int nx = training_data.size();
-
-    if (training_data.size() != training_labels.size())
-        throw Exception("label and example sizes don't match");
-
-
     int nxt = testing_data.size();
 
     if (nx == 0)
@@ -397,6 +489,9 @@ train(const std::vector<distribution<float> > & training_data,
     if (verbosity == 2)
         cerr << "iter  ---- train ----  ---- test -----\n"
              << "         rmse     auc     rmse     auc\n";
+
+    double train_error_rmse = 0.0, train_error_auc = 0.0;
+    double test_error_rmse = 0.0, test_error_auc = 0.0;
     
     for (unsigned iter = 0;  iter < niter;  ++iter) {
         if (verbosity >= 3)
@@ -406,13 +501,9 @@ train(const std::vector<distribution<float> > & training_data,
             cerr << format("%4d", iter) << flush;
         Timer timer;
 
-        double train_error_rmse, train_error_auc;
         boost::tie(train_error_rmse, train_error_auc)
-            = train_iter(training_data, training_labels, training_weights,
-                         output_encoder, thread_context,
-                         minibatch_size, learning_rate,
-                         verbosity, sample_proportion,
-                         randomize_order);
+            = train_epoch(output_encoder, learning_rate, verbosity,
+                          sample_proportion, randomize_order);
         
         if (verbosity >= 3) {
             cerr << "error of iteration: rmse " << train_error_rmse
@@ -424,18 +515,18 @@ train(const std::vector<distribution<float> > & training_data,
                            train_error_rmse, train_error_auc)
                  << flush;
         
-        if (iter % test_every == (test_every - 1)
-            || iter == niter - 1) {
+        if (nxt != 0
+            && (iter % test_every == (test_every - 1)
+                || iter == niter - 1)) {
             timer.restart();
-            double test_error_rmse = 0.0, test_error_auc = 0.0;
                 
             if (verbosity >= 3)
                 cerr << "testing on " << nxt << " examples"
                      << endl;
 
             boost::tie(test_error_rmse, test_error_auc)
-                = test(testing_data, testing_labels, testing_weights,
-                       output_encoder, thread_context, verbosity);
+                = trainer.test(testing_data, testing_labels, testing_weights,
+                               output_encoder, thread_context, verbosity);
             
             if (verbosity >= 3) {
                 cerr << "testing error of iteration: rmse "
@@ -451,8 +542,81 @@ train(const std::vector<distribution<float> > & training_data,
         if (verbosity == 2) cerr << endl;
     }
 
-    // TODO: return something
-    return make_pair(0.0, 0.0);
+    if (nxt == 0)
+        return make_pair(train_error_rmse, train_error_auc);
+    return make_pair(test_error_rmse, test_error_auc);
+}
+
+} // file scope
+
+std::pair<double, double>
+Discriminative_Trainer::
+train(const std::vector<distribution<float> > & training_data,
+      const std::vector<Label> & training_labels,
+      const std::vector<float> & training_weights,
+      const std::vector<distribution<float> > & testing_data,
+      const std::vector<Label> & testing_labels,
+      const std::vector<float> & testing_weights,
+      const Configuration & config,
+      ML::Thread_Context & thread_context) const
+{
+    int minibatch_size = 512;
+    config.get(minibatch_size, "minibatch_size");
+
+    if (training_data.size() != training_labels.size())
+        throw Exception("label and example sizes don't match");
+
+    int nx = training_data.size();
+
+    for (unsigned i = 0;  i < nx;  ++i)
+        if (training_data[i].size() != layer->inputs())
+            throw Exception("training data has wrong number of inputs");
+
+    // The minibatches are made from a permutation of the indexes of the
+    // examples, so that they are neither copied nor handed between threads
+    vector<const float *> data(nx);
+    for (unsigned i = 0;  i < nx;  ++i)
+        data[i] = &training_data[i][0];
+
+    Train_Epoch train_epoch
+        = [&] (const Output_Encoder & output_encoder, float learning_rate,
+               int verbosity, float sample_proportion, bool randomize_order)
+        {
+            return this->train_iter(data, training_labels, training_weights,
+                                    output_encoder, thread_context,
+                                    minibatch_size, learning_rate, verbosity,
+                                    sample_proportion, randomize_order);
+        };
+
+    return train_epochs(*this, train_epoch, nx, testing_data, testing_labels,
+                        testing_weights, config, thread_context);
+}
+
+std::pair<double, double>
+Discriminative_Trainer::
+train(Minibatch_Feeder & training_data,
+      const std::vector<distribution<float> > & testing_data,
+      const std::vector<Label> & testing_labels,
+      const std::vector<float> & testing_weights,
+      const Configuration & config,
+      ML::Thread_Context & thread_context) const
+{
+    if (training_data.inputs() != layer->inputs())
+        throw Exception("training data has wrong number of inputs");
+
+    // The minibatch size is fixed by the feeder
+    Train_Epoch train_epoch
+        = [&] (const Output_Encoder & output_encoder, float learning_rate,
+               int verbosity, float sample_proportion, bool randomize_order)
+        {
+            return this->train_iter(training_data, output_encoder,
+                                    thread_context, learning_rate, verbosity,
+                                    sample_proportion, randomize_order);
+        };
+
+    return train_epochs(*this, train_epoch, training_data.size(),
+                        testing_data, testing_labels, testing_weights,
+                        config, thread_context);
 }
 
 namespace {
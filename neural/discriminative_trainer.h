@@ -16,6 +16,8 @@
 
 namespace ML {
 
+struct Minibatch_Feeder;
+
 
 /*****************************************************************************/
 /* DISCRIMINATIVE_TRAINER                                                    */
@@ -74,6 +76,22 @@ public:
                float sample_proportion,
                bool randomize_order) const;
 
+    /** Train an iteration on minibatches streamed from the feeder.  The
+        learning rate is per example.  Only the outputs and labels of the
+        examples are kept in memory. */
+    std::pair<double, double>
+    train_iter(Minibatch_Feeder & feeder,
+               const Output_Encoder & encoder,
+               Thread_Context & thread_context,
+               float learning_rate,
+               int verbosity,
+               float sample_proportion,
+               bool randomize_order) const;
+
+    /** Train on a dataset that is held in memory, with minibatches made
+        from a permutation of the example indexes.  The minibatch_size
+        configuration option gives the size of the minibatches.  Returns
+        the same as the streaming version below. */
     std::pair<double, double>
     train(const std::vector<distribution<float> > & training_data,
           const std::vector<Label> & training_labels,
@@ -84,6 +102,18 @@ public:
           const Configuration & config,
           ML::Thread_Context & thread_context) const;
 
+    /** Train on a dataset that is streamed from disk, for when it is too
+        large to fit in memory.  The testing data is held in memory.
+        Returns the RMSE and AUC of the last test, or of the last training
+        iteration if there is no testing data. */
+    std::pair<double, double>
+    train(Minibatch_Feeder & training_data,
+          const std::vector<distribution<float> > & testing_data,
+          const std::vector<Label> & testing_labels,
+          const std::vector<float> & testing_weights,
+          const Configuration & config,
+          ML::Thread_Context & thread_context) const;
+
     std::pair<double, double>
     test(const std::vector<const float *> & data,
          const std::vector<Label> & labels,
@@ -189,6 +189,24 @@ apply(const distribution<double> & input,
     apply(&input[0], &output[0]);
 }
 
+void
+Layer::
+apply_block(const float * input, float * output, size_t n) const
+{
+    size_t ni = inputs(), no = outputs();
+    for (unsigned i = 0;  i < n;  ++i)
+        apply(input + i * ni, output + i * no);
+}
+
+void
+Layer::
+apply_block(const double * input, double * output, size_t n) const
+{
+    size_t ni = inputs(), no = outputs();
+    for (unsigned i = 0;  i < n;  ++i)
+        apply(input + i * ni, output + i * no);
+}
+
 #define CHECK_SIZE_OF(element, expected_size) \
     if (element.size() != expected_size) \
         throw Exception(format("%s: Input parameter %s of expected size " \
@@ -229,6 +229,26 @@ public:
     /** \copydoc apply */
     virtual void apply(const double * input, double * output) const = 0;
 
+    /** Apply the layer to a block of n examples at once.
+
+        \param input   Array of n rows of inputs() values, one row after the
+                       other
+        \param output  Array of n rows of outputs() values
+        \param n       Number of rows in the block
+
+        Unlike apply(), the input and output arrays <b>may not</b> overlap.
+
+        The default implementation calls apply() on each row.  Layers that
+        can share work between the rows of the block (for example by
+        streaming each weight row over all of the examples) should override
+        it. */
+    virtual void apply_block(const float * input, float * output,
+                             size_t n) const;
+
+    /** \copydoc apply_block */
+    virtual void apply_block(const double * input, double * output,
+                             size_t n) const;
+
     ///@}
 
 
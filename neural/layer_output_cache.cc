@@ -0,0 +1,238 @@
+/* layer_output_cache.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Compact cache of the outputs of a layer over a dataset.
+*/
+
+#include "layer_output_cache.h"
+#include "jml/arch/exception.h"
+#include "jml/utils/string_functions.h"
+#include <string.h>
+
+
+using namespace std;
+
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* HALF PRECISION                                                            */
+/*****************************************************************************/
+
+uint16_t float_to_half(float value)
+{
+    uint32_t x;
+    memcpy(&x, &value, sizeof(x));
+
+    uint32_t sign = (x >> 16) & 0x8000;
+    uint32_t mantissa = x & 0x007fffff;
+    int exponent = (x >> 23) & 0xff;
+
+    if (exponent == 0xff) {
+        // Infinity or NaN; keep NaN as a (quiet) NaN
+        if (mantissa == 0) return sign | 0x7c00;
+        return sign | 0x7e00 | (mantissa >> 13);
+    }
+
+    int e = exponent - 127 + 15;
+
+    if (e >= 0x1f) return sign | 0x7c00;  // overflow to infinity
+
+    if (e <= 0) {
+        // Subnormal in half precision (or too small, which gives zero)
+        if (e < -10) return sign;
+        mantissa |= 0x00800000;  // implicit leading bit
+        int shift = 14 - e;
+        uint32_t result = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1U << shift) - 1);
+        uint32_t halfway = 1U << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (result & 1)))
+            ++result;
+        return sign | result;
+    }
+
+    uint32_t result = sign | (e << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+
+    // A carry out of the mantissa correctly increments the exponent
+    if (remainder > 0x1000 || (remainder == 0x1000 && (result & 1)))
+        ++result;
+
+    return result;
+}
+
+float half_to_float(uint16_t value)
+{
+    uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    int exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+
+    uint32_t x;
+    if (exponent == 0x1f)
+        x = sign | 0x7f800000 | (mantissa << 13);
+    else if (exponent == 0) {
+        if (mantissa == 0) x = sign;
+        else {
+            // Subnormal; normalize it
+            exponent = 1;
+            while (!(mantissa & 0x400)) {
+                mantissa <<= 1;
+                --exponent;
+            }
+            mantissa &= 0x3ff;
+            x = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+        }
+    }
+    else x = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+
+    float result;
+    memcpy(&result, &x, sizeof(result));
+    return result;
+}
+
+
+/*****************************************************************************/
+/* LAYER_OUTPUT_CACHE                                                        */
+/*****************************************************************************/
+
+Layer_Output_Cache::
+Layer_Output_Cache()
+    : rows_(0), width_(0), half_precision_(false), read_pos_(0)
+{
+}
+
+Layer_Output_Cache::
+Layer_Output_Cache(size_t rows, int width, bool half_precision)
+    : rows_(0), width_(0), half_precision_(false), read_pos_(0)
+{
+    init(rows, width, half_precision);
+}
+
+void
+Layer_Output_Cache::
+init(size_t rows, int width, bool half_precision)
+{
+    if (width < 0)
+        throw Exception("Layer_Output_Cache: invalid width");
+
+    rows_ = rows;
+    width_ = width;
+    half_precision_ = half_precision;
+
+    // Make sure the memory is really freed if we change precision
+    vector<float>().swap(values_);
+    vector<uint16_t>().swap(half_values_);
+
+    if (half_precision) half_values_.resize(rows * width);
+    else values_.resize(rows * width);
+
+    order_.clear();
+    read_pos_ = 0;
+}
+
+size_t
+Layer_Output_Cache::
+memusage() const
+{
+    return values_.size() * sizeof(float)
+        + half_values_.size() * sizeof(uint16_t);
+}
+
+void
+Layer_Output_Cache::
+set_row(size_t row, const float * values)
+{
+    if (row >= rows_)
+        throw Exception(format("Layer_Output_Cache::set_row(): row %zd "
+                               "out of range", row));
+
+    if (half_precision_) {
+        uint16_t * out = &half_values_[row * width_];
+        for (unsigned i = 0;  i < width_;  ++i)
+            out[i] = float_to_half(values[i]);
+    }
+    else std::copy(values, values + width_, &values_[row * width_]);
+}
+
+void
+Layer_Output_Cache::
+set_row(size_t row, const distribution<float> & values)
+{
+    if (values.size() != width_)
+        throw Exception("Layer_Output_Cache::set_row(): wrong width");
+    set_row(row, &values[0]);
+}
+
+void
+Layer_Output_Cache::
+get_row(size_t row, float * values) const
+{
+    if (row >= rows_)
+        throw Exception(format("Layer_Output_Cache::get_row(): row %zd "
+                               "out of range", row));
+
+    if (half_precision_) {
+        const uint16_t * in = &half_values_[row * width_];
+        for (unsigned i = 0;  i < width_;  ++i)
+            values[i] = half_to_float(in[i]);
+    }
+    else {
+        const float * in = &values_[row * width_];
+        std::copy(in, in + width_, values);
+    }
+}
+
+distribution<float>
+Layer_Output_Cache::
+row(size_t row) const
+{
+    distribution<float> result(width_);
+    get_row(row, &result[0]);
+    return result;
+}
+
+int
+Layer_Output_Cache::
+inputs() const
+{
+    return width_;
+}
+
+size_t
+Layer_Output_Cache::
+size() const
+{
+    return rows_;
+}
+
+void
+Layer_Output_Cache::
+rewind()
+{
+    order_.resize(rows_);
+    for (unsigned i = 0;  i < rows_;  ++i)
+        order_[i] = i;
+
+    for (int i = rows_ - 1;  i > 0;  --i)
+        std::swap(order_[i], order_[rng_() % (i + 1)]);
+
+    read_pos_ = 0;
+}
+
+bool
+Layer_Output_Cache::
+read(distribution<float> & example, Label & label, float & weight)
+{
+    if (read_pos_ >= order_.size()) return false;
+
+    example.resize(width_);
+    get_row(order_[read_pos_++], &example[0]);
+    label = Label(0);
+    weight = 1.0;
+
+    return true;
+}
+
+} // namespace ML
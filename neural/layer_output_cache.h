@@ -0,0 +1,88 @@
+/* layer_output_cache.h                                            -*- C++ -*-
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Compact cache of the outputs of a layer over a dataset.
+*/
+
+#ifndef __jml__neural__layer_output_cache_h__
+#define __jml__neural__layer_output_cache_h__
+
+#include "minibatch_feeder.h"
+#include <boost/random/mersenne_twister.hpp>
+#include <stdint.h>
+
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* HALF PRECISION                                                            */
+/*****************************************************************************/
+
+/** Convert to and from IEEE 754 half precision (binary16), rounding to
+    nearest even.  Infinities and NaN (missing values) are preserved; values
+    too large to represent become infinite. */
+uint16_t float_to_half(float value);
+float half_to_float(uint16_t value);
+
+
+/*****************************************************************************/
+/* LAYER_OUTPUT_CACHE                                                        */
+/*****************************************************************************/
+
+/** Holds the output of a layer for each example of a dataset in one
+    contiguous matrix, in either single or half precision, so that the next
+    layer of a stack can be trained without the layers below it having to be
+    run again.  Half precision halves the memory again at the cost of about
+    three significant figures, which is plenty for tanh or sigmoid outputs.
+
+    The cache is also an Example_Source, so that a Minibatch_Feeder can
+    train from it.  Each epoch reads all of the rows, unlabelled, in a new
+    random order.
+*/
+
+struct Layer_Output_Cache : public Example_Source {
+
+    Layer_Output_Cache();
+
+    Layer_Output_Cache(size_t rows, int width, bool half_precision);
+
+    void init(size_t rows, int width, bool half_precision);
+
+    int width() const { return width_; }
+
+    bool half_precision() const { return half_precision_; }
+
+    /** Number of bytes used to store the values. */
+    size_t memusage() const;
+
+    void set_row(size_t row, const float * values);
+    void set_row(size_t row, const distribution<float> & values);
+
+    void get_row(size_t row, float * values) const;
+    distribution<float> row(size_t row) const;
+
+    /* Example_Source interface */
+    virtual int inputs() const;
+    virtual size_t size() const;
+    virtual void rewind();
+    virtual bool read(distribution<float> & example, Label & label,
+                      float & weight);
+
+private:
+    size_t rows_;
+    int width_;
+    bool half_precision_;
+    std::vector<float> values_;
+    std::vector<uint16_t> half_values_;
+
+    // State for reading it as an example source
+    std::vector<unsigned> order_;
+    size_t read_pos_;
+    boost::mt19937 rng_;
+};
+
+} // namespace ML
+
+#endif /* __jml__neural__layer_output_cache_h__ */
@@ -172,6 +172,25 @@ struct Layer_Stack : public Layer {
 
     using Layer::apply;
 
+    /** Return the number of elements of temporary space that apply_block()
+        needs to hold the intermediate results for a block of n rows. */
+    size_t apply_block_temporary_space_required(size_t n) const;
+
+    /** Apply the stack to a block of n rows, one layer at a time over the
+        whole block.  The temp_space array (of at least
+        apply_block_temporary_space_required(n) elements) holds the outputs
+        of the internal layers; it is provided by the caller so that it can
+        be reused from one block to the next. */
+    template<typename F>
+    void apply_block(const F * input, F * output, size_t n,
+                     F * temp_space, size_t temp_space_size) const;
+
+    /** Versions that allocate their own temporary space. */
+    virtual void apply_block(const float * input, float * output,
+                             size_t n) const;
+    virtual void apply_block(const double * input, double * output,
+                             size_t n) const;
+
 
     /*************************************************************************/
     /* FPROP                                                                 */
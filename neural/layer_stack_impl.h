@@ -308,6 +308,54 @@ apply(const double * input, double * output) const
     apply<double>(input, output);
 }
 
+template<class LayerT>
+size_t
+Layer_Stack<LayerT>::
+apply_block_temporary_space_required(size_t n) const
+{
+    // Two buffers that the internal layers alternate between
+    if (layers_.size() < 2) return 0;
+    return 2 * n * max_internal_width_;
+}
+
+template<class LayerT>
+template<typename F>
+void
+Layer_Stack<LayerT>::
+apply_block(const F * input, F * output, size_t n,
+            F * temp_space, size_t temp_space_size) const
+{
+    if (temp_space_size < apply_block_temporary_space_required(n))
+        throw Exception("Layer_Stack::apply_block(): not enough temp space");
+
+    F * tmp[2] = { temp_space, temp_space + n * max_internal_width_ };
+
+    for (unsigned l = 0;  l < layers_.size();  ++l) {
+        const F * i = (l == 0 ? input : tmp[(l - 1) % 2]);
+        F * o = (l == layers_.size() - 1 ? output : tmp[l % 2]);
+
+        layers_[l]->apply_block(i, o, n);
+    }
+}
+
+template<class LayerT>
+void
+Layer_Stack<LayerT>::
+apply_block(const float * input, float * output, size_t n) const
+{
+    std::vector<float> temp(apply_block_temporary_space_required(n));
+    apply_block<float>(input, output, n, temp.data(), temp.size());
+}
+
+template<class LayerT>
+void
+Layer_Stack<LayerT>::
+apply_block(const double * input, double * output, size_t n) const
+{
+    std::vector<double> temp(apply_block_temporary_space_required(n));
+    apply_block<double>(input, output, n, temp.data(), temp.size());
+}
+
 template<class LayerT>
 size_t
 Layer_Stack<LayerT>::
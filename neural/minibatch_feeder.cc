@@ -0,0 +1,373 @@
+/* minibatch_feeder.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Background streaming of minibatches for the neural network trainers.
+*/
+
+#include "minibatch_feeder.h"
+#include "jml/utils/file_functions.h"
+#include "jml/utils/guard.h"
+#include "jml/utils/string_functions.h"
+#include "jml/arch/exception.h"
+#include <boost/bind.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_01.hpp>
+#include <algorithm>
+
+
+using namespace std;
+
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* EXAMPLE_SOURCE                                                            */
+/*****************************************************************************/
+
+Example_Source::
+~Example_Source()
+{
+}
+
+
+/*****************************************************************************/
+/* FLOAT_MATRIX_SOURCE                                                       */
+/*****************************************************************************/
+
+Float_Matrix_Source::
+Float_Matrix_Source(const std::string & filename, int inputs,
+                    bool labelled, ssize_t num_examples)
+    : filename_(filename), stream_(0), inputs_(inputs), labelled_(labelled)
+{
+    if (inputs <= 0)
+        throw Exception("Float_Matrix_Source: need at least one input");
+
+    size_t row_bytes = (inputs + labelled) * sizeof(float);
+
+    if (num_examples != -1)
+        size_ = num_examples;
+    else if (compressionFromFilename(filename) != "") {
+        // No way to know how big it is without decompressing it
+        rewind();
+        distribution<float> example;
+        Label label;
+        float weight;
+        size_ = 0;
+        while (read(example, label, weight)) ++size_;
+    }
+    else {
+        size_t bytes = get_file_size(filename);
+        if (bytes % row_bytes != 0)
+            throw Exception("Float_Matrix_Source: file " + filename
+                            + " doesn't contain a whole number of rows");
+        size_ = bytes / row_bytes;
+    }
+
+    rewind();
+}
+
+Float_Matrix_Source::
+Float_Matrix_Source(std::istream & stream, int inputs,
+                    bool labelled, size_t num_examples)
+    : stream_(&stream), inputs_(inputs), labelled_(labelled),
+      size_(num_examples)
+{
+    if (inputs <= 0)
+        throw Exception("Float_Matrix_Source: need at least one input");
+}
+
+int
+Float_Matrix_Source::
+inputs() const
+{
+    return inputs_;
+}
+
+size_t
+Float_Matrix_Source::
+size() const
+{
+    return size_;
+}
+
+void
+Float_Matrix_Source::
+rewind()
+{
+    if (filename_ != "") {
+        // Re-opening works for compressed files as well
+        file_.reset(new filter_istream(filename_));
+        stream_ = file_.get();
+        return;
+    }
+
+    stream_->clear();
+    stream_->seekg(0);
+    if (!*stream_)
+        throw Exception("Float_Matrix_Source: couldn't rewind stream");
+}
+
+bool
+Float_Matrix_Source::
+read(distribution<float> & example, Label & label, float & weight)
+{
+    example.resize(inputs_);
+
+    float lab = 0.0;
+    if (labelled_) {
+        stream_->read((char *)&lab, sizeof(float));
+        if (stream_->gcount() == 0 && stream_->eof()) return false;
+    }
+
+    stream_->read((char *)&example[0], inputs_ * sizeof(float));
+
+    if (!labelled_ && stream_->gcount() == 0 && stream_->eof())
+        return false;
+    if (!*stream_)
+        throw Exception("Float_Matrix_Source: truncated row");
+
+    label = Label((int)lab);
+    weight = 1.0;
+
+    return true;
+}
+
+
+
+
+/*****************************************************************************/
+/* MINIBATCH                                                                 */
+/*****************************************************************************/
+
+void
+Minibatch::
+reserve(size_t n, int ni)
+{
+    if (data.size() < n) {
+        data.resize(n);
+        labels.resize(n);
+        weights.resize(n);
+    }
+
+    for (unsigned i = 0;  i < n;  ++i)
+        data[i].resize(ni);
+}
+
+
+/*****************************************************************************/
+/* MINIBATCH_FEEDER                                                          */
+/*****************************************************************************/
+
+Minibatch_Feeder::
+Minibatch_Feeder(const std::vector<std::shared_ptr<Example_Source> >
+                     & sources,
+                 int minibatch_size,
+                 int prefetch,
+                 int shuffle_window)
+    : sources_(sources), inputs_(0), minibatch_size_(minibatch_size),
+      shuffle_window_(std::max(shuffle_window, 1)),
+      sample_proportion_(1.0), randomize_order_(false),
+      // Room for the end of epoch marker of each source as well
+      queue_(std::max(prefetch, 1) + sources.size() + 1),
+      running_(0), shutdown_(false)
+{
+    if (sources.empty())
+        throw Exception("Minibatch_Feeder: no sources");
+    if (minibatch_size <= 0)
+        throw Exception("Minibatch_Feeder: invalid minibatch size");
+
+    inputs_ = sources[0]->inputs();
+    for (unsigned i = 1;  i < sources.size();  ++i)
+        if (sources[i]->inputs() != inputs_)
+            throw Exception(format("Minibatch_Feeder: source %d has %d "
+                                   "inputs but source 0 has %d",
+                                   i, sources[i]->inputs(), inputs_));
+}
+
+Minibatch_Feeder::
+~Minibatch_Feeder()
+{
+    try {
+        stop();
+    } catch (...) {
+    }
+}
+
+size_t
+Minibatch_Feeder::
+size() const
+{
+    size_t result = 0;
+    for (unsigned i = 0;  i < sources_.size();  ++i)
+        result += sources_[i]->size();
+    return result;
+}
+
+void
+Minibatch_Feeder::
+start_epoch(float sample_proportion, bool randomize_order,
+            uint32_t random_seed)
+{
+    stop();
+
+    sample_proportion_ = sample_proportion;
+    randomize_order_ = randomize_order;
+    shutdown_ = false;
+    error_ = "";
+    running_ = sources_.size();
+
+    // Each source gets a different but deterministic seed
+    boost::mt19937 rng(random_seed ? random_seed : 1);
+
+    for (unsigned i = 0;  i < sources_.size();  ++i)
+        threads_.create_thread(boost::bind(&Minibatch_Feeder::run_source,
+                                           this, i, rng()));
+}
+
+std::shared_ptr<Minibatch>
+Minibatch_Feeder::
+next()
+{
+    while (running_ > 0) {
+        std::shared_ptr<Minibatch> result = queue_.pop();
+        if (result) return result;
+
+        // End of epoch marker for one of the sources
+        --running_;
+    }
+
+    threads_.join_all();
+
+    {
+        Guard guard(lock_);
+        if (error_ != "")
+            throw Exception("Minibatch_Feeder: error reading source: "
+                            + error_);
+    }
+
+    return std::shared_ptr<Minibatch>();
+}
+
+void
+Minibatch_Feeder::
+recycle(const std::shared_ptr<Minibatch> & batch)
+{
+    if (!batch) return;
+    Guard guard(lock_);
+    free_.push_back(batch);
+}
+
+void
+Minibatch_Feeder::
+stop()
+{
+    shutdown_ = true;
+
+    // Drain the queue so that any reader blocked on a full queue can
+    // finish
+    while (running_ > 0) {
+        std::shared_ptr<Minibatch> batch = queue_.pop();
+        if (batch) recycle(batch);
+        else --running_;
+    }
+
+    threads_.join_all();
+}
+
+std::shared_ptr<Minibatch>
+Minibatch_Feeder::
+get_free()
+{
+    Guard guard(lock_);
+    if (free_.empty())
+        return std::shared_ptr<Minibatch>(new Minibatch());
+    std::shared_ptr<Minibatch> result = free_.back();
+    free_.pop_back();
+    return result;
+}
+
+void
+Minibatch_Feeder::
+run_source(int source_num, uint32_t random_seed)
+{
+    // Make sure that the consumer always gets our end of epoch marker
+    Call_Guard guard(boost::bind(&RingBufferSRMW<std::shared_ptr<Minibatch> >
+                                     ::push,
+                                 &queue_, std::shared_ptr<Minibatch>()));
+
+    try {
+        Example_Source & source = *sources_[source_num];
+
+        // Sampling and shuffling draw from the same stream
+        boost::mt19937 rng(random_seed ? random_seed : 1);
+        boost::uniform_01<boost::mt19937 &> uniform01(rng);
+
+        size_t window_size = (size_t)minibatch_size_ * shuffle_window_;
+
+        Minibatch window;
+        window.reserve(window_size, inputs_);
+
+        vector<int> order(window_size);
+
+        source.rewind();
+
+        bool finished = false;
+        while (!finished && !shutdown_) {
+
+            // 1.  Fill up the window
+            size_t n = 0;
+            while (n < window_size) {
+                if (!source.read(window.data[n], window.labels[n],
+                                 window.weights[n])) {
+                    finished = true;
+                    break;
+                }
+
+                // Randomly exclude some samples
+                if (sample_proportion_ < 1.0
+                    && uniform01() >= sample_proportion_)
+                    continue;
+
+                ++n;
+            }
+
+            // 2.  Shuffle it
+            for (unsigned i = 0;  i < n;  ++i)
+                order[i] = i;
+
+            if (randomize_order_) {
+                for (int i = n - 1;  i > 0;  --i)
+                    std::swap(order[i], order[rng() % (i + 1)]);
+            }
+
+            // 3.  Cut it into minibatches and send them off.  The example
+            //     vectors are swapped rather than copied.
+            for (unsigned x = 0;  x < n && !shutdown_;  x += minibatch_size_) {
+                size_t nb = std::min<size_t>(minibatch_size_, n - x);
+
+                std::shared_ptr<Minibatch> batch = get_free();
+                batch->reserve(nb, inputs_);
+                batch->size = nb;
+
+                for (unsigned i = 0;  i < nb;  ++i) {
+                    int ex = order[x + i];
+                    batch->data[i].swap(window.data[ex]);
+                    batch->labels[i] = window.labels[ex];
+                    batch->weights[i] = window.weights[ex];
+                }
+
+                queue_.push(batch);
+            }
+        }
+    } catch (const std::exception & exc) {
+        Guard guard(lock_);
+        error_ = exc.what();
+    } catch (...) {
+        Guard guard(lock_);
+        error_ = "unknown exception";
+    }
+}
+
+} // namespace ML
@@ -0,0 +1,203 @@
+/* minibatch_feeder.h                                              -*- C++ -*-
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Streams shuffled minibatches of training examples from disk, so that the
+   neural network trainers can work on datasets that don't fit in memory.
+*/
+
+#ifndef __jml__neural__minibatch_feeder_h__
+#define __jml__neural__minibatch_feeder_h__
+
+#include "jml/stats/distribution.h"
+#include "jml/boosting/label.h"
+#include "jml/utils/ring_buffer.h"
+#include "jml/utils/filter_streams.h"
+#include "jml/arch/threads.h"
+#include <boost/thread/thread.hpp>
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <string>
+
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* EXAMPLE_SOURCE                                                            */
+/*****************************************************************************/
+
+/** A source of training examples that can be read sequentially, once per
+    epoch.  Only one thread will ever read from a given source at a time.
+*/
+
+struct Example_Source {
+    virtual ~Example_Source();
+
+    /** Number of input values in each example. */
+    virtual int inputs() const = 0;
+
+    /** Number of examples in the source. */
+    virtual size_t size() const = 0;
+
+    /** Go back to the start of the examples. */
+    virtual void rewind() = 0;
+
+    /** Read the next example into the given location, resizing the input
+        vector if necessary.  Returns false once there are no more examples
+        to read. */
+    virtual bool read(distribution<float> & example, Label & label,
+                      float & weight) = 0;
+};
+
+
+/*****************************************************************************/
+/* FLOAT_MATRIX_SOURCE                                                       */
+/*****************************************************************************/
+
+/** Example source that reads a dense matrix of native 32 bit floats, one row
+    per example, from a file (possibly compressed; anything that a
+    filter_istream can open) or from a stream.
+
+    If the source is labelled, then the first column of each row holds the
+    (integer) label and the remaining inputs() columns the example; otherwise
+    all columns are inputs and the label is zero.  All weights are 1.
+*/
+
+struct Float_Matrix_Source : public Example_Source {
+
+    /** Read from the given file.  If the number of examples is unknown
+        (-1) then it is calculated from the size of the file, or by reading
+        it through once if it is compressed. */
+    Float_Matrix_Source(const std::string & filename, int inputs,
+                        bool labelled, ssize_t num_examples = -1);
+
+    /** Read from the given stream, which needs to be seekable in order for
+        more than one epoch to be read.  The number of examples needs to be
+        given. */
+    Float_Matrix_Source(std::istream & stream, int inputs,
+                        bool labelled, size_t num_examples);
+
+    virtual int inputs() const;
+    virtual size_t size() const;
+    virtual void rewind();
+    virtual bool read(distribution<float> & example, Label & label,
+                      float & weight);
+
+private:
+    std::string filename_;
+    std::shared_ptr<filter_istream> file_;
+    std::istream * stream_;
+    int inputs_;
+    bool labelled_;
+    size_t size_;
+};
+
+
+/*****************************************************************************/
+/* MINIBATCH                                                                 */
+/*****************************************************************************/
+
+/** A batch of examples.  The example vectors are kept allocated when the
+    minibatch is recycled, so reading the next epoch doesn't allocate. */
+
+struct Minibatch {
+    Minibatch()
+        : size(0)
+    {
+    }
+
+    size_t size;
+    std::vector<distribution<float> > data;
+    std::vector<Label> labels;
+    std::vector<float> weights;
+
+    /** Make room for n examples of ni inputs each. */
+    void reserve(size_t n, int ni);
+};
+
+
+/*****************************************************************************/
+/* MINIBATCH_FEEDER                                                          */
+/*****************************************************************************/
+
+/** Produces minibatches from a set of example sources in the background.
+
+    Each source is read by its own thread, which fills a window of
+    shuffle_window minibatches, shuffles the examples within it and then
+    pushes the minibatches onto a bounded queue of prefetch entries.  The
+    order of examples is therefore only randomized within a window of a
+    single source; sources should be pre-shuffled on disk if a global
+    randomization is required.
+
+    Usage:
+
+    feeder.start_epoch(...);
+    while (std::shared_ptr<Minibatch> batch = feeder.next()) {
+        ...
+        feeder.recycle(batch);
+    }
+*/
+
+struct Minibatch_Feeder {
+
+    Minibatch_Feeder(const std::vector<std::shared_ptr<Example_Source> >
+                         & sources,
+                     int minibatch_size,
+                     int prefetch = 8,
+                     int shuffle_window = 16);
+
+    ~Minibatch_Feeder();
+
+    /** Number of inputs in each example. */
+    int inputs() const { return inputs_; }
+
+    /** Total number of examples over all sources. */
+    size_t size() const;
+
+    int minibatch_size() const { return minibatch_size_; }
+
+    /** Start reading an epoch.  Each example is kept with probability
+        sample_proportion.  Any epoch in progress is abandoned. */
+    void start_epoch(float sample_proportion, bool randomize_order,
+                     uint32_t random_seed);
+
+    /** Return the next minibatch, or a null pointer once the epoch is
+        finished.  Rethrows any exception that occurred reading the
+        sources. */
+    std::shared_ptr<Minibatch> next();
+
+    /** Hand back a minibatch once it's been used so that its memory can be
+        reused. */
+    void recycle(const std::shared_ptr<Minibatch> & batch);
+
+    /** Abandon the current epoch, waiting for the reading threads to
+        finish. */
+    void stop();
+
+private:
+    std::vector<std::shared_ptr<Example_Source> > sources_;
+    int inputs_;
+    int minibatch_size_;
+    int shuffle_window_;
+
+    float sample_proportion_;
+    bool randomize_order_;
+
+    RingBufferSRMW<std::shared_ptr<Minibatch> > queue_;
+    boost::thread_group threads_;
+    int running_;           ///< Sources that haven't finished this epoch
+    std::atomic<bool> shutdown_;
+
+    Lock lock_;
+    std::vector<std::shared_ptr<Minibatch> > free_;
+    std::string error_;
+
+    std::shared_ptr<Minibatch> get_free();
+    void run_source(int source_num, uint32_t random_seed);
+};
+
+} // namespace ML
+
+#endif /* __jml__neural__minibatch_feeder_h__ */
@@ -18,7 +18,9 @@ LIBNEURAL_SOURCES := \
 	auto_encoder_trainer.cc \
 	reverse_layer_adaptor.cc \
 	reconstruct_layer_adaptor.cc \
-	output_encoder.cc
+	output_encoder.cc \
+	minibatch_feeder.cc \
+	layer_output_cache.cc
 
 LIBNEURAL_LINK :=	utils db algebra arch judy ACE boost_regex boost_thread boosting stats worker_task
 
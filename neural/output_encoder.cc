@@ -148,11 +148,21 @@ distribution<float>
 Output_Encoder::
 decode(const distribution<float> & encoded) const
 {
+    if (mode == REGRESSION)
+        return encoded;
+
     distribution<float> result(num_outputs);
+    decode(&encoded[0], &result[0]);
+    return result;
+}
 
+void
+Output_Encoder::
+decode(const float * encoded, float * result) const
+{
     switch (mode) {
     case REGRESSION:
-        result = encoded;
+        std::copy(encoded, encoded + num_outputs, result);
         break;
             
     case BINARY:
@@ -163,14 +173,11 @@ decode(const distribution<float> & encoded) const
     case MULTICLASS:
         for (unsigned i = 0;  i < num_outputs;  ++i)
             result[i] = decode_value(encoded[i]);
-        //cerr << "input " << encoded << " output " << result << endl;
         break;
             
     default:
         throw Exception("invalid output encoder class");
     }
-
-    return result;
 }
 
 double
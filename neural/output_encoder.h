@@ -55,6 +55,10 @@ struct Output_Encoder {
 
     distribution<float> decode(const distribution<float> & encoded) const;
 
+    /** Decode num_inputs encoded values into num_outputs decoded values
+        without allocating any memory. */
+    void decode(const float * encoded, float * decoded) const;
+
     /** For a classification problem, calculates the AUC metric. */
     double calc_auc(const std::vector<float> & outputs,
                     const std::vector<Label> & labels) const;
@@ -704,6 +704,15 @@ set(const Parameter_Value & other)
     }
 }
 
+void
+Parameters::
+set_locking(Locking_Policy policy)
+{
+    for (Params::iterator it = params.begin(), end = params.end();
+         it != end;  ++it)
+        it->set_locking(policy);
+}
+
 std::string
 Parameters::
 parameter_info(int index) const
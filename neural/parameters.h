@@ -105,6 +105,12 @@ struct Parameter_Value {
 
     virtual Parameter_Value * make_copy() const = 0;
 
+    /** Set how concurrent row and element updates (update_row(),
+        update_element() and the vector update()) are serialized, so that
+        several threads can accumulate into the same object.  Whole object
+        updates are never locked.  The default is LP_NONE. */
+    virtual void set_locking(Locking_Policy policy) = 0;
+
     // Change the name.  This might confuse the parent; should mostly be
     // used as part of the implementation.
     virtual void set_name(const std::string & name);
@@ -305,6 +311,9 @@ struct Parameters : public Parameter_Value {
     /** Set these parameters from another parameters object. */
     virtual void set(const Parameter_Value & other);
 
+    /** Set the locking policy of all of the parameters. */
+    virtual void set_locking(Locking_Policy policy);
+
     /** Describe what the parameter is (name, type, etc) */
     virtual std::string parameter_info(int index) const;
 
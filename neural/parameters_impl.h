@@ -10,6 +10,7 @@
 
 #include "parameters.h"
 #include "layer.h"
+#include "jml/arch/spinlock.h"
 
 namespace ML {
 
@@ -41,6 +42,68 @@ bool need_update(const F * vals, size_t size)
 } // file scope
 
 
+/*****************************************************************************/
+/* ROW_LOCKS                                                                 */
+/*****************************************************************************/
+
+/** Locks that serialize concurrent updates of the rows of a parameter
+    according to its locking policy.  LP_FINE uses a set of spinlocks that
+    is striped over the rows; LP_ATOMIC is currently implemented the same
+    way.  Copies share the same locks.
+*/
+
+struct Row_Locks {
+    Row_Locks()
+        : policy_(LP_NONE)
+    {
+    }
+
+    void set_policy(Locking_Policy policy, size_t rows)
+    {
+        size_t nlocks = 0;
+        if (policy == LP_COARSE) nlocks = 1;
+        else if (policy == LP_FINE || policy == LP_ATOMIC)
+            nlocks = std::max<size_t>(1, std::min<size_t>(rows, 1024));
+
+        policy_ = policy;
+        if (nlocks == 0) locks_.reset();
+        else locks_.reset(new std::vector<Spinlock>(nlocks));
+    }
+
+    Locking_Policy policy() const { return policy_; }
+
+    /** Return the lock to hold whilst updating the given row, or null if
+        no lock is needed. */
+    Spinlock * lock(size_t row) const
+    {
+        if (!locks_) return 0;
+        return &(*locks_)[row % locks_->size()];
+    }
+
+private:
+    Locking_Policy policy_;
+    std::shared_ptr<std::vector<Spinlock> > locks_;
+};
+
+/** Holds a row lock (if there is one) for its lifetime. */
+
+struct Row_Guard {
+    Row_Guard(Spinlock * lock)
+        : lock_(lock)
+    {
+        if (lock_) lock_->acquire();
+    }
+
+    ~Row_Guard()
+    {
+        if (lock_) lock_->release();
+    }
+
+private:
+    Spinlock * lock_;
+};
+
+
 /*****************************************************************************/
 /* VECTOR_REFT                                                               */
 /*****************************************************************************/
@@ -231,24 +294,28 @@ struct Vector_RefT : public Vector_Parameter {
 
     virtual void update(const float * x, float k)
     {
+        Row_Guard guard(locks_.lock(0));
         if (k != 0.0 && need_update(x, size_))
             SIMD::vec_add(array_, k, x, array_, size_);
     }
 
     virtual void update(const double * x, double k)
     {
+        Row_Guard guard(locks_.lock(0));
         if (k != 0.0 && need_update(x, size_))
             SIMD::vec_add(array_, k, x, array_, size_);
     }
 
     virtual void update_sqr(const float * x, float k)
     {
+        Row_Guard guard(locks_.lock(0));
         if (k != 0.0 && need_update(x, size_))
             SIMD::vec_add_sqr(array_, k, x, array_, size_);
     }
 
     virtual void update_sqr(const double * x, double k)
     {
+        Row_Guard guard(locks_.lock(0));
         if (k != 0.0 && need_update(x, size_))
             SIMD::vec_add_sqr(array_, k, x, array_, size_);
     }
@@ -269,6 +336,7 @@ struct Vector_RefT : public Vector_Parameter {
     {
         if (element < 0 || element >= size_)
             throw Exception("update_element(): out of range");
+        Row_Guard guard(locks_.lock(0));
         array_[element] += update_by;
     }
 
@@ -276,9 +344,15 @@ struct Vector_RefT : public Vector_Parameter {
     {
         if (element < 0 || element >= size_)
             throw Exception("update_element(): out of range");
+        Row_Guard guard(locks_.lock(0));
         array_[element] += update_by;
     }
 
+    virtual void set_locking(Locking_Policy policy)
+    {
+        locks_.set_policy(policy, 1);
+    }
+
     virtual Vector_RefT * make_copy() const
     {
         return new Vector_RefT(*this);
@@ -295,6 +369,7 @@ struct Vector_RefT : public Vector_Parameter {
 protected:
     Underlying * array_;
     size_t size_;
+    Row_Locks locks_;
     template<typename U> friend class Vector_RefT;
 };
 
@@ -516,6 +591,7 @@ struct Matrix_RefT : public Matrix_Parameter {
     {
         if (row < 0 || row >= size1_)
             throw Exception("update_row: invalid row");
+        Row_Guard guard(locks_.lock(row));
         if (k != 0.0 && need_update(x, size2_))
             SIMD::vec_add(array_ + (size2_ * row), k, x,
                           array_ + (size2_ * row), size2_);
@@ -525,6 +601,7 @@ struct Matrix_RefT : public Matrix_Parameter {
     {
         if (row < 0 || row >= size1_)
             throw Exception("update_row: invalid row");
+        Row_Guard guard(locks_.lock(row));
         if (k != 0.0 && need_update(x, size2_))
             SIMD::vec_add(array_ + (size2_ * row), k, x,
                           array_ + (size2_ * row), size2_);
@@ -534,6 +611,7 @@ struct Matrix_RefT : public Matrix_Parameter {
     {
         if (row < 0 || row >= size1_)
             throw Exception("update_row: invalid row");
+        Row_Guard guard(locks_.lock(row));
         if (k != 0.0 && need_update(x, size2_))
             SIMD::vec_add_sqr(array_ + (size2_ * row), k, x,
                               array_ + (size2_ * row), size2_);
@@ -543,11 +621,17 @@ struct Matrix_RefT : public Matrix_Parameter {
     {
         if (row < 0 || row >= size1_)
             throw Exception("update_row: invalid row");
+        Row_Guard guard(locks_.lock(row));
         if (k != 0.0 && need_update(x, size2_))
             SIMD::vec_add_sqr(array_ + (size2_ * row), k, x,
                               array_ + (size2_ * row), size2_);
     }
     
+    virtual void set_locking(Locking_Policy policy)
+    {
+        locks_.set_policy(policy, size1_);
+    }
+
     virtual Matrix_RefT * make_copy() const
     {
         return new Matrix_RefT(*this);
@@ -564,6 +648,7 @@ struct Matrix_RefT : public Matrix_Parameter {
 protected:
     Underlying * array_;
     size_t size1_, size2_;
+    Row_Locks locks_;
     template<typename U> friend class Matrix_RefT;
 };
 
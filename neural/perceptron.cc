@@ -29,7 +29,9 @@
 #include "jml/utils/guard.h"
 #include <boost/bind.hpp>
 #include "jml/arch/backtrace.h"
+#include "jml/arch/thread_specific.h"
 #include "dense_layer.h"
+#include <stdlib.h>
 
 using namespace std;
 using namespace DB;
@@ -54,6 +56,49 @@ struct Stats {
     }
 } stats;
 
+/** Number of examples that are run through the layers together. */
+enum { PREDICT_BLOCK_SIZE = 64 };
+
+/** Number of examples in each job submitted to the worker task. */
+enum { PREDICT_JOB_SIZE = 1024 };
+
+/** Scratch space for block prediction.  One of these is kept per thread and
+    grown as necessary, so that predicting over a dataset doesn't need to
+    allocate memory for each example. */
+struct Predict_Scratch {
+    Predict_Scratch()
+        : data(0), capacity(0)
+    {
+    }
+
+    ~Predict_Scratch()
+    {
+        free(data);
+    }
+
+    float * get(size_t n)
+    {
+        if (n <= capacity) return data;
+
+        free(data);
+        data = 0;
+        capacity = 0;
+
+        void * mem;
+        if (posix_memalign(&mem, 64, n * sizeof(float)))
+            throw Exception("Perceptron: couldn't allocate scratch space");
+
+        data = (float *)mem;
+        capacity = n;
+        return data;
+    }
+
+    float * data;
+    size_t capacity;
+};
+
+Thread_Specific<Predict_Scratch> predict_scratch;
+
 } // file scope
 
 
@@ -116,6 +161,17 @@ predict(const Feature_Set & fs) const
 {
     PROFILE_FUNCTION(t_predict);
 
+    if (sparse_input()) {
+        vector<int> indexes;
+        vector<float> values;
+        extract_sparse_features(fs, indexes, values);
+
+        distribution<float> result(this->output.num_outputs);
+        predict_sparse(indexes.data(), values.data(), indexes.size(),
+                       &result[0]);
+        return result;
+    }
+
     float input[layers.inputs()];
     extract_features(fs, input);
 
@@ -125,6 +181,338 @@ predict(const Feature_Set & fs) const
     return this->output.decode(output);
 }
 
+const Dense_Layer<float> *
+Perceptron::
+sparse_input() const
+{
+    if (layers.empty()) return 0;
+    const Dense_Layer<float> * result
+        = dynamic_cast<const Dense_Layer<float> *>(&layers[0]);
+    if (!result || result->missing_values != MV_ZERO) return 0;
+    return result;
+}
+
+void
+Perceptron::
+extract_sparse_features(const Feature_Set & fs,
+                        std::vector<int> & indexes,
+                        std::vector<float> & values) const
+{
+    for (Feature_Set::const_iterator it = fs.begin(), end = fs.end();
+         it != end;  ++it) {
+        vector<Feature>::const_iterator found
+            = std::lower_bound(features.begin(), features.end(),
+                               it.feature());
+        if (found == features.end() || *found != it.feature())
+            continue;
+        indexes.push_back(found - features.begin());
+        values.push_back(it.value());
+    }
+}
+
+void
+Perceptron::
+predict_sparse(const int * indexes, const float * values, size_t n,
+               float * outputs) const
+{
+    const Dense_Layer<float> * first = sparse_input();
+    if (!first)
+        throw Exception("Perceptron::predict_sparse(): first layer doesn't "
+                        "take sparse inputs");
+
+    // Only the first layer looks at the inputs; the ones above are small
+    size_t width = layers.max_width();
+    float buf1[width], buf2[width];
+    float * in = buf1, * out = buf2;
+
+    first->apply_sparse(indexes, values, n, in);
+
+    for (unsigned l = 1;  l < layers.size();  ++l) {
+        layers[l].apply(in, out);
+        std::swap(in, out);
+    }
+
+    this->output.decode(in, outputs);
+}
+
+size_t
+Perceptron::
+predict_block_temporary_space_required(size_t n) const
+{
+    return n * layers.outputs()
+        + layers.apply_block_temporary_space_required(n);
+}
+
+void
+Perceptron::
+predict_block(const float * inputs, size_t n, float * outputs,
+              float * temp_space, size_t temp_space_size) const
+{
+    size_t nenc = layers.outputs(), ndec = output.num_outputs;
+    if (temp_space_size < predict_block_temporary_space_required(n))
+        throw Exception("Perceptron::predict_block(): not enough temp space");
+
+    float * encoded = temp_space;
+    layers.apply_block(inputs, encoded, n,
+                       temp_space + n * nenc, temp_space_size - n * nenc);
+
+    for (unsigned i = 0;  i < n;  ++i)
+        output.decode(encoded + i * nenc, outputs + i * ndec);
+}
+
+namespace {
+
+/** Job to predict a range of examples of a dataset, PREDICT_BLOCK_SIZE
+    examples at a time. */
+struct Predict_Block_Job {
+
+    int x_start, x_end;
+    const Perceptron & perceptron;
+    const Training_Data & data;
+
+    Predict_Block_Job(int x_start, int x_end,
+                      const Perceptron & perceptron,
+                      const Training_Data & data)
+        : x_start(x_start), x_end(x_end),
+          perceptron(perceptron), data(data)
+    {
+    }
+
+    typedef void result_type;
+
+    template<class Output>
+    void run(Output output)
+    {
+        if (perceptron.sparse_input()) {
+            run_sparse(output);
+            return;
+        }
+
+        size_t nf = perceptron.features.size();
+        size_t no = perceptron.output.num_outputs;
+        size_t ntemp = perceptron
+            .predict_block_temporary_space_required(PREDICT_BLOCK_SIZE);
+
+        float * scratch = predict_scratch->get(PREDICT_BLOCK_SIZE * (nf + no)
+                                               + ntemp);
+        float * inputs = scratch;
+        float * outputs = inputs + PREDICT_BLOCK_SIZE * nf;
+        float * temp_space = outputs + PREDICT_BLOCK_SIZE * no;
+
+        for (int x0 = x_start;  x0 < x_end;  x0 += PREDICT_BLOCK_SIZE) {
+            int n = std::min<int>(PREDICT_BLOCK_SIZE, x_end - x0);
+
+            for (unsigned i = 0;  i < n;  ++i)
+                perceptron.extract_features(data[x0 + i], inputs + i * nf);
+
+            perceptron.predict_block(inputs, n, outputs, temp_space, ntemp);
+
+            for (unsigned i = 0;  i < n;  ++i)
+                output(x0 + i, outputs + i * no);
+        }
+    }
+
+    /** Examples are run one at a time through a first layer with sparse
+        inputs, so that only the weights of the features that are present
+        are read. */
+    template<class Output>
+    void run_sparse(Output output)
+    {
+        size_t no = perceptron.output.num_outputs;
+        float outputs[no];
+
+        vector<int> indexes;
+        vector<float> values;
+
+        for (int x = x_start;  x < x_end;  ++x) {
+            indexes.clear();
+            values.clear();
+            perceptron.extract_sparse_features(data[x], indexes, values);
+            perceptron.predict_sparse(indexes.data(), values.data(),
+                                      indexes.size(), outputs);
+            output(x, outputs);
+        }
+    }
+
+    void operator () (Classifier_Impl::Predict_All_Output_Func output)
+    {
+        run(output);
+    }
+
+    struct One_Label {
+        int label;
+        Classifier_Impl::Predict_One_Output_Func output;
+
+        void operator () (int x, const float * predictions) const
+        {
+            output(x, predictions[label]);
+        }
+    };
+
+    void operator () (int label,
+                      Classifier_Impl::Predict_One_Output_Func output)
+    {
+        One_Label one = { label, output };
+        run(one);
+    }
+};
+
+/** Job to predict a range of rows of a feature matrix, PREDICT_BLOCK_SIZE
+    rows at a time. */
+struct Predict_Matrix_Job {
+
+    int x_start, x_end;
+    const Perceptron & perceptron;
+    const boost::multi_array<float, 2> & inputs;
+    boost::multi_array<float, 2> & outputs;
+
+    Predict_Matrix_Job(int x_start, int x_end,
+                       const Perceptron & perceptron,
+                       const boost::multi_array<float, 2> & inputs,
+                       boost::multi_array<float, 2> & outputs)
+        : x_start(x_start), x_end(x_end), perceptron(perceptron),
+          inputs(inputs), outputs(outputs)
+    {
+    }
+
+    void operator () ()
+    {
+        size_t ntemp = perceptron
+            .predict_block_temporary_space_required(PREDICT_BLOCK_SIZE);
+        float * temp_space = predict_scratch->get(ntemp);
+
+        for (int x0 = x_start;  x0 < x_end;  x0 += PREDICT_BLOCK_SIZE) {
+            int n = std::min<int>(PREDICT_BLOCK_SIZE, x_end - x0);
+            perceptron.predict_block(&inputs[x0][0], n, &outputs[x0][0],
+                                     temp_space, ntemp);
+        }
+    }
+};
+
+} // file scope
+
+void
+Perceptron::
+predict(const Training_Data & data,
+        Predict_All_Output_Func output,
+        const Optimization_Info * opt_info) const
+{
+    PROFILE_FUNCTION(t_predict);
+
+    unsigned nx = data.example_count();
+
+    static Worker_Task & worker = Worker_Task::instance(num_threads() - 1);
+    
+    int group;
+    {
+        int parent = -1;  // no parent group
+        group = worker.get_group(NO_JOB,
+                                 format("perceptron predict group under %d",
+                                        parent),
+                                 parent);
+        Call_Guard guard(boost::bind(&Worker_Task::unlock_group,
+                                     boost::ref(worker),
+                                     group));
+        
+        for (unsigned x = 0;  x < nx;  x += PREDICT_JOB_SIZE)
+            worker.add(boost::bind(Predict_Block_Job
+                                   (x, std::min<unsigned>(x + PREDICT_JOB_SIZE,
+                                                          nx),
+                                    *this, data),
+                                   output),
+                       "perceptron predict job",
+                       group);
+    }
+
+    worker.run_until_finished(group);
+}
+
+void
+Perceptron::
+predict(const Training_Data & data,
+        int label,
+        Predict_One_Output_Func output,
+        const Optimization_Info * opt_info) const
+{
+    PROFILE_FUNCTION(t_predict);
+
+    if (label < 0 || label >= this->output.num_outputs)
+        throw Exception(format("Attempt to predict non-existent label: "
+                               "label = %d, label_count = %d", label,
+                               this->output.num_outputs));
+
+    unsigned nx = data.example_count();
+
+    static Worker_Task & worker = Worker_Task::instance(num_threads() - 1);
+    
+    int group;
+    {
+        int parent = -1;  // no parent group
+        group = worker.get_group(NO_JOB,
+                                 format("perceptron predict group under %d",
+                                        parent),
+                                 parent);
+        Call_Guard guard(boost::bind(&Worker_Task::unlock_group,
+                                     boost::ref(worker),
+                                     group));
+        
+        for (unsigned x = 0;  x < nx;  x += PREDICT_JOB_SIZE)
+            worker.add(boost::bind(Predict_Block_Job
+                                   (x, std::min<unsigned>(x + PREDICT_JOB_SIZE,
+                                                          nx),
+                                    *this, data),
+                                   label,
+                                   output),
+                       "perceptron predict job",
+                       group);
+    }
+
+    worker.run_until_finished(group);
+}
+
+boost::multi_array<float, 2>
+Perceptron::
+predict(const boost::multi_array<float, 2> & inputs) const
+{
+    PROFILE_FUNCTION(t_predict);
+
+    if (inputs.shape()[1] != features.size())
+        throw Exception(format("Perceptron::predict(): matrix has %zd "
+                               "columns but there are %zd features",
+                               inputs.shape()[1], features.size()));
+
+    unsigned nx = inputs.shape()[0];
+
+    boost::multi_array<float, 2>
+        result(boost::extents[nx][output.num_outputs]);
+
+    static Worker_Task & worker = Worker_Task::instance(num_threads() - 1);
+    
+    int group;
+    {
+        int parent = -1;  // no parent group
+        group = worker.get_group(NO_JOB,
+                                 format("perceptron predict group under %d",
+                                        parent),
+                                 parent);
+        Call_Guard guard(boost::bind(&Worker_Task::unlock_group,
+                                     boost::ref(worker),
+                                     group));
+        
+        for (unsigned x = 0;  x < nx;  x += PREDICT_JOB_SIZE)
+            worker.add(Predict_Matrix_Job(x,
+                                          std::min<unsigned>
+                                              (x + PREDICT_JOB_SIZE, nx),
+                                          *this, inputs, result),
+                       "perceptron predict job",
+                       group);
+    }
+
+    worker.run_until_finished(group);
+
+    return result;
+}
+
 std::string
 Perceptron::
 print() const
@@ -18,6 +18,7 @@
 #include "jml/utils/pair_utils.h"
 #include <boost/multi_array.hpp>
 #include <boost/shared_ptr.hpp>
+#include <limits>
 
 
 namespace ML {
@@ -25,6 +26,7 @@ namespace ML {
 
 class Label;
 class Thread_Context;
+template<typename Float> struct Dense_Layer;
 
 
 /*****************************************************************************/
@@ -94,6 +96,47 @@ public:
     /** Predict the score for all classes. */
     virtual distribution<float> predict(const Feature_Set & features) const;
 
+    /** Predict over an entire dataset.  The examples are split into blocks
+        which are run through the layers together on the worker threads,
+        using scratch space that is kept per thread, rather than being
+        predicted one by one. */
+    virtual void predict(const Training_Data & data,
+                         Predict_All_Output_Func output,
+                         const Optimization_Info * opt_info = 0) const;
+
+    virtual void predict(const Training_Data & data,
+                         int label,
+                         Predict_One_Output_Func output,
+                         const Optimization_Info * opt_info = 0) const;
+
+    /** Predict over a matrix of feature values, with one row per example
+        and one column per entry in features.  The result has one row per
+        example with the decoded output for each label. */
+    boost::multi_array<float, 2>
+    predict(const boost::multi_array<float, 2> & inputs) const;
+
+    /** Run n rows of extracted feature values through the network and
+        decode them into n rows of output.num_outputs values.  The
+        temp_space array must have at least
+        predict_block_temporary_space_required(n) elements. */
+    void predict_block(const float * inputs, size_t n, float * outputs,
+                       float * temp_space, size_t temp_space_size) const;
+
+    size_t predict_block_temporary_space_required(size_t n) const;
+
+    /** If the first layer can be given only the features that are present
+        in an example (a Dense_Layer<float> that treats missing values as
+        zero, as trained by the generator on sparse inputs), then return
+        it; otherwise return null.  Leaving a feature out is then the same
+        as giving it as missing, so the result doesn't change. */
+    const Dense_Layer<float> * sparse_input() const;
+
+    /** Run an example given as (index, value) pairs of our features
+        through the network and decode it into output.num_outputs values.
+        Only for when sparse_input() is non-null. */
+    void predict_sparse(const int * indexes, const float * values, size_t n,
+                        float * outputs) const;
+
     /** Apply the first layer to a dataset to decorrelate it. */
     boost::multi_array<float, 2> decorrelate(const Training_Data & data) const;
         
@@ -126,7 +169,9 @@ public:
        Features -> feature vector -> decorrelation -> layer1 -> (...) -> output
 
        Note that the decorrelation is simply an extra layer with the identity
-       function and no bias input.
+       function and no bias input.  A perceptron trained on sparse inputs
+       has no decorrelation; its first layer takes the features directly
+       and treats missing ones as zero.
     */
 
     /* Variables... */
@@ -142,27 +187,44 @@ public:
 
     size_t parameters() const;
 
+    /** Extract the values of our features from the feature set.  Features
+        that are missing are given a NaN value, which the first layer will
+        either reject (MV_NONE, as for the decorrelation layer) or treat as
+        a zero (MV_ZERO, for a first layer trained on sparse inputs). */
     template<class OutputIterator>
     void extract_features(const Feature_Set & fs, OutputIterator result) const
     {
         Feature_Set::const_iterator it = fs.begin(), end = fs.end();
         int i = 0, ni = features.size();
 
+        float NaN = std::numeric_limits<float>::quiet_NaN();
+
         for(; i < ni && it != end;  ++it) {
-            if (it.feature() == features[i]) {
+            while (i < ni && features[i] < it.feature()) {
+                *result++ = NaN;
+                ++i;
+            }
+
+            if (i == ni) break;
+            else if (it.feature() == features[i]) {
                 *result++ = it.value();
                 ++i;
             }
             else if (i != 0 && it.feature() == features[i - 1])
                 throw Exception("duplicate feature values");
-            else if (features[i] < it.feature())
-                throw Exception("feature missing value");
         }
 
-        if (i != ni)
-            throw Exception("feature missing value 2");
+        for (; i < ni;  ++i)
+            *result++ = NaN;
     }
 
+    /** Extract the features that are present in the feature set as
+        (index, value) pairs, appending them to the given vectors.  Features
+        that we don't use are skipped. */
+    void extract_sparse_features(const Feature_Set & fs,
+                                 std::vector<int> & indexes,
+                                 std::vector<float> & values) const;
+
 private:
     /** For reconstituting old classifiers only */
     Perceptron(const std::shared_ptr<const Feature_Space>
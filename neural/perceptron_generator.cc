@@ -29,6 +29,7 @@
 #include "jml/utils/pair_utils.h"
 #include "jml/neural/dense_layer.h"
 #include "discriminative_trainer.h"
+#include "jml/arch/threads.h"
 
 using namespace std;
 
@@ -98,6 +99,7 @@ configure(const Configuration & config)
     config.find(output_activation, "output_activation");
     config.find(do_decorrelate, "decorrelate");
     config.find(do_normalize, "normalize");
+    config.find(sparse, "sparse");
     config.find(target_value, "target_value");
 }
 
@@ -113,6 +115,7 @@ defaults()
     activation = output_activation = TF_TANH;
     do_decorrelate = true;
     do_normalize = true;
+    sparse = false;
     batch_size = 1024;
     target_value = 0.8;
 }
@@ -139,6 +142,9 @@ options() const
              "decorrelate the features before training")
         .add("normalize", do_normalize,
              "normalize to zero mean and unit std before training")
+        .add("sparse", sparse,
+             "train the first hidden layer on sparse inputs (missing "
+             "features are zero) with no decorrelation")
         .add("batch_size", batch_size, "0.0-1.0 or 1 - nvectors",
              "number of samples in each \"mini batch\" for stochastic")
         .add("target_value", target_value, "0.0-1.0", "the output for a 1 that we ask the network to provide");
@@ -154,6 +160,265 @@ init(std::shared_ptr<const Feature_Space> fs, Feature predicted)
     model = Perceptron(fs, predicted);
 }
 
+namespace {
+
+/** The examples of a dataset as (index, value) pairs over the features of a
+    perceptron, for a first layer that takes sparse inputs. */
+struct Sparse_Examples {
+    std::vector<int> indexes;
+    std::vector<float> values;
+    std::vector<size_t> offsets;  ///< Example x is offsets[x] to offsets[x + 1]
+
+    void init(const Perceptron & perceptron, const Training_Data & data)
+    {
+        size_t nx = data.example_count();
+
+        indexes.clear();
+        values.clear();
+        offsets.clear();
+        offsets.reserve(nx + 1);
+        offsets.push_back(0);
+
+        for (unsigned x = 0;  x < nx;  ++x) {
+            perceptron.extract_sparse_features(data[x], indexes, values);
+            offsets.push_back(indexes.size());
+        }
+    }
+
+    size_t size() const { return offsets.size() - 1; }
+
+    const int * example_indexes(int x) const
+    {
+        return indexes.data() + offsets[x];
+    }
+
+    const float * example_values(int x) const
+    {
+        return values.data() + offsets[x];
+    }
+
+    size_t example_size(int x) const { return offsets[x + 1] - offsets[x]; }
+};
+
+/** Runs examples first to last - 1 of a minibatch starting at example
+    minibatch_start through a network made of a first layer with sparse
+    inputs and the layers above it.  If upper_updates is non-null, then each
+    example is also backpropagated through the upper layers, with their
+    gradient accumulated locally and added to upper_updates; the hidden
+    outputs and errors of the first layer are kept in hidden and
+    hidden_errors (one row of nh per example of the minibatch) for the
+    Sparse_Update_Job. */
+struct Sparse_Examples_Job {
+    const Dense_Layer<float> & first_layer;
+    const Layer & upper;
+    const Sparse_Examples & examples;
+    const vector<Label> & labels;
+    const distribution<float> & weights;
+    const Output_Encoder & output_encoder;
+    int minibatch_start;
+    int first;
+    int last;
+    Parameters_Copy<double> * upper_updates;
+    vector<float> & hidden;
+    vector<float> & hidden_errors;
+    vector<float> & outputs;
+    double & total_mse;
+    Lock & update_lock;
+
+    void operator () () const
+    {
+        int nh = first_layer.outputs(), no = upper.outputs();
+
+        size_t temp_space_required = upper.fprop_temporary_space_required();
+        float temp_space[temp_space_required];
+
+        distribution<float> output(no);
+
+        std::unique_ptr<Parameters_Copy<double> > local_updates;
+        if (upper_updates)
+            local_updates.reset(new Parameters_Copy<double>(upper, 0.0));
+
+        double local_mse = 0.0;
+
+        for (unsigned x = first;  x < last;  ++x) {
+            float * ex_hidden = &hidden[(x - minibatch_start) * nh];
+
+            first_layer.apply_sparse(examples.example_indexes(x),
+                                     examples.example_values(x),
+                                     examples.example_size(x), ex_hidden);
+            upper.fprop(ex_hidden, temp_space, temp_space_required,
+                        &output[0]);
+
+            distribution<float> errors
+                = output_encoder.target(labels[x]) - output;
+            local_mse += errors.dotprod(errors);
+            outputs[x] = output[0];
+
+            float weight = weights[x];
+            if (!upper_updates || weight == 0.0) continue;
+
+            distribution<float> derrors = -2.0 * errors;
+
+            upper.bprop(ex_hidden, &output[0], temp_space,
+                        temp_space_required, &derrors[0],
+                        &hidden_errors[(x - minibatch_start) * nh],
+                        *local_updates, weight);
+        }
+
+        Guard guard(update_lock);
+        total_mse += local_mse;
+        if (upper_updates)
+            upper_updates->values += local_updates->values;
+    }
+};
+
+/** Updates the first layer for examples first to last - 1 of a minibatch,
+    once the Sparse_Examples_Job has calculated their hidden outputs and
+    errors.  The gradient goes straight into the layer's own parameters, so
+    that only the bias and the weight rows of the inputs that are present
+    are touched; the parameters need fine grained locking as the jobs of a
+    minibatch share them. */
+struct Sparse_Update_Job {
+    const Dense_Layer<float> & first_layer;
+    const Sparse_Examples & examples;
+    const distribution<float> & weights;
+    int minibatch_start;
+    int first;
+    int last;
+    const vector<float> & hidden;
+    const vector<float> & hidden_errors;
+    Parameters & parameters;
+    float learning_rate;
+
+    void operator () () const
+    {
+        int nh = first_layer.outputs();
+
+        for (unsigned x = first;  x < last;  ++x) {
+            float weight = weights[x];
+            if (weight == 0.0) continue;
+
+            first_layer.bprop_sparse(examples.example_indexes(x),
+                                     examples.example_values(x),
+                                     examples.example_size(x),
+                                     &hidden[(x - minibatch_start) * nh],
+                                     &hidden_errors[(x - minibatch_start) * nh],
+                                     parameters, -learning_rate * weight);
+        }
+    }
+};
+
+/** Run an iteration over the examples for a network whose first layer takes
+    sparse inputs, returning the RMSE and AUC in the same way as the
+    Discriminative_Trainer.  If train is true, then the parameters are
+    updated after each minibatch; otherwise the examples are only tested.
+
+    The upper layers are small, and so their gradient is accumulated in a
+    dense copy and applied at the end of each minibatch.  The first layer's
+    gradient is instead applied in a second pass over the minibatch (after
+    all of its forward passes, so that the minibatch still sees a single set
+    of weights), which only touches the rows of the active inputs. */
+std::pair<double, double>
+run_sparse_iter(Dense_Layer<float> & first_layer,
+                Layer & upper,
+                const Sparse_Examples & examples,
+                const vector<Label> & labels,
+                const distribution<float> & weights,
+                const Output_Encoder & output_encoder,
+                Thread_Context & context,
+                bool train,
+                int minibatch_size,
+                float learning_rate)
+{
+    Worker_Task & worker = context.worker();
+
+    int nx = examples.size();
+    if (!train || minibatch_size <= 0) minibatch_size = nx;
+
+    int microbatch_size = std::max(minibatch_size / (num_threads() * 4), 1);
+    int nh = first_layer.outputs();
+
+    Lock update_lock;
+    double total_mse = 0.0;
+    vector<float> outputs(nx);
+
+    // The hidden outputs and errors of the first layer for the current
+    // minibatch
+    vector<float> hidden(std::min(minibatch_size, nx) * nh);
+    vector<float> hidden_errors(train ? hidden.size() : 0);
+
+    std::unique_ptr<Parameters_Copy<double> > upper_updates;
+    if (train)
+        upper_updates.reset(new Parameters_Copy<double>(upper, 0.0));
+
+    Parameters & first_params = first_layer.parameters();
+    if (train) first_params.set_locking(LP_FINE);
+    Call_Guard locking_guard(boost::bind(&Parameters::set_locking,
+                                         boost::ref(first_params), LP_NONE),
+                             train);
+
+    for (unsigned x = 0;  x < nx;  x += minibatch_size) {
+        int last = min<int>(nx, x + minibatch_size);
+
+        int group;
+        {
+            int parent = -1;  // no parent group
+            group = worker.get_group(NO_JOB, "sparse perceptron minibatch",
+                                     parent);
+
+            // Make sure the group gets unlocked once we've populated
+            // everything
+            Call_Guard guard(boost::bind(&Worker_Task::unlock_group,
+                                         boost::ref(worker),
+                                         group));
+
+            for (unsigned x2 = x;  x2 < last;  x2 += microbatch_size) {
+                Sparse_Examples_Job job
+                    = { first_layer, upper, examples, labels, weights,
+                        output_encoder, (int)x, (int)x2,
+                        min<int>(last, x2 + microbatch_size),
+                        upper_updates.get(), hidden, hidden_errors,
+                        outputs, total_mse, update_lock };
+
+                worker.add(job, "sparse perceptron job", group);
+            }
+        }
+
+        worker.run_until_finished(group);
+
+        if (!train) continue;
+
+        {
+            int parent = -1;  // no parent group
+            group = worker.get_group(NO_JOB, "sparse perceptron update",
+                                     parent);
+
+            Call_Guard guard(boost::bind(&Worker_Task::unlock_group,
+                                         boost::ref(worker),
+                                         group));
+
+            for (unsigned x2 = x;  x2 < last;  x2 += microbatch_size) {
+                Sparse_Update_Job job
+                    = { first_layer, examples, weights, (int)x, (int)x2,
+                        min<int>(last, x2 + microbatch_size),
+                        hidden, hidden_errors, first_params, learning_rate };
+
+                worker.add(job, "sparse perceptron update job", group);
+            }
+        }
+
+        worker.run_until_finished(group);
+
+        upper.parameters().update(*upper_updates, -learning_rate);
+        upper_updates->fill(0.0);
+    }
+
+    return make_pair(sqrt(total_mse / nx),
+                     output_encoder.calc_auc(outputs, labels));
+}
+
+} // file scope
+
 std::shared_ptr<Classifier_Impl>
 Perceptron_Generator::
 generate(Thread_Context & context,
@@ -201,23 +466,33 @@ generate(Thread_Context & context,
     boost::multi_array<float, 2> decorrelated
         = init(training_set, features, arch, current, context);
 
-    size_t nx_validate
-        = (validate_is_train ? training_set : validation_set)
-        .example_count();
+    const Training_Data & validate_set
+        = validate_is_train ? training_set : validation_set;
+
+    size_t nx = training_set.example_count();
+    size_t nxv = validate_set.example_count();
+    size_t nf = current.features.size();
+    size_t nvalues = nx * nf;
 
-    boost::multi_array<float, 2> val_decorrelated
-        (boost::extents[nx_validate][decorrelated.shape()[1]]);
+    boost::multi_array<float, 2> val_decorrelated;
 
-    if (validate_is_train) val_decorrelated = decorrelated;
-    else val_decorrelated = current.decorrelate(validation_set);
+    // With sparse inputs, only the values that are present are kept
+    Sparse_Examples sparse_examples, val_sparse_examples;
 
-    size_t nx = decorrelated.shape()[0];
-    size_t nxv = val_decorrelated.shape()[0];
-    size_t nf = decorrelated.shape()[1];
+    if (sparse) {
+        sparse_examples.init(current, training_set);
+        val_sparse_examples.init(current, validate_set);
+        nvalues = sparse_examples.values.size();
+    }
+    else {
+        val_decorrelated.resize(boost::extents[nxv][nf]);
+        if (validate_is_train) val_decorrelated = decorrelated;
+        else val_decorrelated = current.decorrelate(validation_set);
+    }
 
     log("perceptron_generator", 1)
         << current.parameters() << " parameters, "
-        << nx << " examples, " << nx * nf << " training values" << endl;
+        << nx << " examples, " << nvalues << " training values" << endl;
     
     if (min_iter > max_iter)
         throw Exception("min_iter is greater than max_iter");
@@ -253,10 +528,20 @@ generate(Thread_Context & context,
             *= -1.0 * training_ex_weights.size() / training_ex_weights.total();
     }
 
-    // Create a layer stack without the decorrelation layer to be trained
+    // Create a layer stack without the first layer.  For dense inputs,
+    // that's the decorrelation layer, which isn't trained; for sparse
+    // inputs it's the first hidden layer, which is trained separately.
     Layer_Stack<Layer> train_stack;
     for (unsigned i = 1;  i < current.layers.size();  ++i)
         train_stack.add(current.layers.share(i));
+
+    Dense_Layer<float> * sparse_layer = 0;
+    if (sparse) {
+        sparse_layer = dynamic_cast<Dense_Layer<float> *>(&current.layers[0]);
+        if (!sparse_layer)
+            throw Exception("Perceptron_Generator: sparse input layer must be "
+                            "a Dense_Layer<float>");
+    }
     
     Discriminative_Trainer trainer;
     trainer.layer = &train_stack;
@@ -264,13 +549,17 @@ generate(Thread_Context & context,
     bool randomize = false;
     float sample_proportion = 1.0;
 
-    vector<const float *> examples(nx);
-    for (unsigned i = 0;  i < nx;  ++i)
-        examples[i] = &decorrelated[i][0];
+    vector<const float *> examples, val_examples;
+
+    if (!sparse) {
+        examples.resize(nx);
+        for (unsigned i = 0;  i < nx;  ++i)
+            examples[i] = &decorrelated[i][0];
 
-    vector<const float *> val_examples(nxv);
-    for (unsigned i = 0;  i < nxv;  ++i)
-        val_examples[i] = &val_decorrelated[i][0];
+        val_examples.resize(nxv);
+        for (unsigned i = 0;  i < nxv;  ++i)
+            val_examples[i] = &val_decorrelated[i][0];
+    }
     
     Output_Encoder & output_encoder = current.output;
     output_encoder.configure(model.feature_space()->info(model.predicted()),
@@ -289,17 +578,33 @@ generate(Thread_Context & context,
         {
             PROFILE_FUNCTION(t_train);
             
-            boost::tie(train_acc, train_rmse)
-                = trainer.train_iter(examples, labels, training_ex_weights,
-                                     output_encoder,
-                                     context, our_batch_size, learning_rate,
-                                     verbosity, sample_proportion, randomize);
+            if (sparse)
+                boost::tie(train_acc, train_rmse)
+                    = run_sparse_iter(*sparse_layer, train_stack,
+                                      sparse_examples, labels,
+                                      training_ex_weights, output_encoder,
+                                      context, true /* train */,
+                                      our_batch_size, learning_rate);
+            else
+                boost::tie(train_acc, train_rmse)
+                    = trainer.train_iter(examples, labels,
+                                         training_ex_weights, output_encoder,
+                                         context, our_batch_size,
+                                         learning_rate, verbosity,
+                                         sample_proportion, randomize);
         }
 
         if (validate_is_train) {
             validate_acc = train_acc;
             validate_rmse = train_rmse;
         }
+        else if (sparse) {
+            boost::tie(validate_acc, validate_rmse)
+                = run_sparse_iter(*sparse_layer, train_stack,
+                                  val_sparse_examples, val_labels,
+                                  validate_ex_weights, output_encoder,
+                                  context, false /* train */, 0, 0.0);
+        }
         else {
             boost::tie(validate_acc, validate_rmse)
                 = trainer.test(val_examples, val_labels, validate_ex_weights,
@@ -424,6 +729,49 @@ lower_inverse(const boost::multi_array<Float, 2> & A)
 
 } // file scope
 
+void
+Perceptron_Generator::
+select_sparse_features(const Training_Data & data,
+                       const std::vector<Feature> & possible_features,
+                       Perceptron & result) const
+{
+    const Dataset_Index & index = data.index();
+
+    vector<Feature> & features = result.features;
+    features.clear();
+
+    for (unsigned i = 0;  i < possible_features.size();  ++i) {
+        const Feature & feature = possible_features[i];
+
+        if (feature == result.predicted()) continue;  // don't use label as a feature!
+
+        if (index.count(feature) == 0) continue;
+        else if (!index.only_one(feature)) {
+            cerr << "feature " << i << " ("
+                 << result.feature_space()->print(feature)
+                 << ") skipped due to more than one value" << endl;
+            continue;
+        }
+        else {
+            float min, max;
+            boost::tie(min, max) = index.range(feature);
+            if (abs(min) > 1e10 || abs(max) > 1e10) {
+                cerr << "feature " << i << " ("
+                     << result.feature_space()->print(feature)
+                     << ") skipped as its range is too large: "
+                     << min << " to " << max << endl;
+                continue;
+            }
+        }
+        features.push_back(feature);
+    }
+
+    std::sort(features.begin(), features.end());
+
+    if (features.empty())
+        throw Exception("Perceptron_Generator: no usable sparse features");
+}
+
 /** Decorrelates the training data, returning a dense decorrelated dataset. */
 boost::multi_array<float, 2>
 Perceptron_Generator::
@@ -707,8 +1055,17 @@ init(const Training_Data & data,
 
     /* Find out about the output that we need (in particular, how many
        values it can have). */
+    if (sparse) {
+        if (architecture.empty())
+            throw Exception("Perceptron_Generator: sparse inputs need at "
+                            "least one hidden layer");
+        select_sparse_features(data, possible_features, result);
+        result.layers.clear();
+    }
+
     boost::multi_array<float, 2> decorrelated
-        = decorrelate(data, possible_features, result);
+        = (sparse ? boost::multi_array<float, 2>()
+           : decorrelate(data, possible_features, result));
 
     Feature_Info pred_info = model.feature_space()->info(model.predicted());
     int nout = pred_info.value_count();
@@ -716,8 +1073,11 @@ init(const Training_Data & data,
 
     int nunits = result.features.size();
 
-    cerr << "adding decorrelating input layer with " << nunits
-         << " linear units" << endl;
+    if (sparse)
+        cerr << "using " << nunits << " sparse inputs" << endl;
+    else
+        cerr << "adding decorrelating input layer with " << nunits
+             << " linear units" << endl;
 
     /* Add hidden layers with the specified sizes */
     for (unsigned i = 0;  i < architecture.size();  ++i) {
@@ -728,10 +1088,13 @@ init(const Training_Data & data,
              << units << " units and activation function "
              << activation << endl;
 
+        // Missing sparse inputs are zero
+        Missing_Values missing = (sparse && i == 0 ? MV_ZERO : MV_NONE);
+
         std::shared_ptr<Layer>
             layer(new Dense_Layer<float>(format("hidden%d", i),
                                          nunits, units, activation,
-                                         MV_NONE, context));
+                                         missing, context));
         result.add_layer(layer);
         nunits = units;
     }
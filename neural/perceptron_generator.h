@@ -63,6 +63,7 @@ public:
     Transfer_Function_Type activation, output_activation;
     bool do_decorrelate;
     bool do_normalize;
+    bool sparse;
     float batch_size;
     float target_value;
 
@@ -94,6 +95,15 @@ public:
                 const std::vector<Feature> & possible_features,
                 Perceptron & result) const;
     
+    /** Choose the features for a first layer that takes sparse inputs,
+        instead of decorrelating them.  Features may be missing from an
+        example (they are then zero) but may not occur more than once.  The
+        Features variable will be set up here, but no layers are added.
+    */
+    void select_sparse_features(const Training_Data & data,
+                                const std::vector<Feature> & possible_features,
+                                Perceptron & result) const;
+
     /** Decorrelate another training data object using the decorrelation
         already trained. */
     boost::multi_array<float, 2>
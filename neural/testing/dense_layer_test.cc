@@ -13,6 +13,7 @@
 #include <boost/test/unit_test.hpp>
 #include <boost/test/floating_point_comparison.hpp>
 #include <boost/multi_array.hpp>
+#include <boost/thread/thread.hpp>
 #include "jml/neural/dense_layer.h"
 #include "jml/utils/testing/serialize_reconstitute_include.h"
 #include "jml/utils/check_not_nan.h"
@@ -321,6 +322,159 @@ BOOST_AUTO_TEST_CASE( test_serialize_reconstitute_dense_layer_double )
     test_poly_serialize_reconstitute<Layer>(layer);
 }
 
+BOOST_AUTO_TEST_CASE( test_apply_block )
+{
+    Thread_Context context;
+
+    // Enough outputs that apply_block() needs more than one pass
+    int ni = 30, no = 300, nx = 50;
+
+    Dense_Layer<float> layer("test", ni, no, TF_TANH, MV_INPUT, context);
+
+    float NaN = numeric_limits<float>::quiet_NaN();
+
+    distribution<float> input(nx * ni);
+    for (unsigned i = 0;  i < input.size();  ++i)
+        input[i] = (i % 11 == 0 ? NaN : context.random01() - 0.5);
+
+    distribution<float> output(nx * no);
+    layer.apply_block(&input[0], &output[0], nx);
+
+    for (unsigned x = 0;  x < nx;  ++x) {
+        float expected[no];
+        layer.apply(&input[x * ni], expected);
+        for (unsigned o = 0;  o < no;  ++o)
+            BOOST_CHECK_EQUAL(output[x * no + o], expected[o]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_sparse_input )
+{
+    Thread_Context context;
+
+    int ni = 1000, no = 20, nactive = 30;
+
+    Dense_Layer<float> layer("test", ni, no, TF_TANH, MV_INPUT, context);
+
+    float NaN = numeric_limits<float>::quiet_NaN();
+
+    // Sorted indexes, so that the accumulation order is the same as for
+    // the dense version
+    vector<int> indexes;
+    vector<float> values;
+    distribution<float> dense(ni, 0.0);
+    for (unsigned i = 0;  i < ni && indexes.size() < nactive;  i += 1 + i % 7) {
+        float value = (indexes.size() % 9 == 0 ? NaN : context.random01());
+        indexes.push_back(i);
+        values.push_back(value);
+        dense[i] = value;
+    }
+
+    distribution<float> expected = layer.apply(dense);
+    distribution<float> output(no);
+    layer.apply_sparse(&indexes[0], &values[0], indexes.size(), &output[0]);
+
+    BOOST_CHECK_EQUAL_COLLECTIONS(output.begin(), output.end(),
+                                  expected.begin(), expected.end());
+
+    // The gradient should be the same as for the dense version
+    distribution<float> errors(no);
+    for (unsigned o = 0;  o < no;  ++o)
+        errors[o] = context.random01() - 0.5;
+
+    Parameters_Copy<double> gradient_dense(layer, 0.0);
+    layer.bprop(&dense[0], &output[0], 0, 0, &errors[0], 0,
+                gradient_dense, 1.0);
+
+    Parameters_Copy<double> gradient_sparse(layer, 0.0);
+    layer.bprop_sparse(&indexes[0], &values[0], indexes.size(),
+                       &output[0], &errors[0], gradient_sparse, 1.0);
+
+    BOOST_CHECK_EQUAL_COLLECTIONS(gradient_dense.values.begin(),
+                                  gradient_dense.values.end(),
+                                  gradient_sparse.values.begin(),
+                                  gradient_sparse.values.end());
+
+    int bad_index = ni;
+    float one = 1.0;
+    {
+        JML_TRACE_EXCEPTIONS(false);
+        BOOST_CHECK_THROW(layer.apply_sparse(&bad_index, &one, 1, &output[0]),
+                          ML::Exception);
+    }
+}
+
+namespace {
+
+struct Sparse_Bprop_Thread {
+    const Dense_Layer<float> & layer;
+    const vector<vector<int> > & indexes;
+    const vector<vector<float> > & values;
+    const distribution<float> & errors;
+    Parameters & gradient;
+    int first, step;
+
+    void operator () () const
+    {
+        int no = layer.outputs();
+        distribution<float> output(no);
+
+        for (unsigned x = first;  x < indexes.size();  x += step) {
+            layer.apply_sparse(&indexes[x][0], &values[x][0],
+                               indexes[x].size(), &output[0]);
+            layer.bprop_sparse(&indexes[x][0], &values[x][0],
+                               indexes[x].size(), &output[0], &errors[0],
+                               gradient, 1.0);
+        }
+    }
+};
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_sparse_bprop_shared_gradient )
+{
+    Thread_Context context;
+
+    int ni = 50, no = 10, nx = 2000, nthreads = 4;
+
+    Dense_Layer<float> layer("test", ni, no, TF_TANH, MV_ZERO, context);
+
+    // Lots of examples with overlapping active inputs, so that the threads
+    // contend for the same rows
+    vector<vector<int> > indexes(nx);
+    vector<vector<float> > values(nx);
+    for (unsigned x = 0;  x < nx;  ++x) {
+        for (unsigned i = x % 3;  i < ni;  i += 1 + x % 5) {
+            indexes[x].push_back(i);
+            values[x].push_back(context.random01());
+        }
+    }
+
+    distribution<float> errors(no);
+    for (unsigned o = 0;  o < no;  ++o)
+        errors[o] = context.random01() - 0.5;
+
+    Parameters_Copy<double> expected(layer, 0.0);
+    Sparse_Bprop_Thread single = { layer, indexes, values, errors,
+                                   expected, 0, 1 };
+    single();
+
+    Parameters_Copy<double> gradient(layer, 0.0);
+    gradient.set_locking(LP_FINE);
+
+    boost::thread_group threads;
+    for (unsigned i = 0;  i < nthreads;  ++i) {
+        Sparse_Bprop_Thread job = { layer, indexes, values, errors,
+                                    gradient, (int)i, nthreads };
+        threads.create_thread(job);
+    }
+    threads.join_all();
+
+    // Only the order of the additions differs
+    for (unsigned i = 0;  i < expected.values.size();  ++i)
+        BOOST_CHECK_CLOSE(gradient.values[i], expected.values[i], 1e-6);
+}
+
 BOOST_AUTO_TEST_CASE( test_single_precision_accuracy )
 {
     Thread_Context context;
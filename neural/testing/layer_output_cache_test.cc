@@ -0,0 +1,103 @@
+/* layer_output_cache_test.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Test of the layer output cache and half precision conversion.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <vector>
+#include <limits>
+#include <cmath>
+
+#include "jml/neural/layer_output_cache.h"
+
+using namespace ML;
+using namespace std;
+
+using boost::unit_test::test_suite;
+
+BOOST_AUTO_TEST_CASE( test_half_precision )
+{
+    // Exactly representable values come back unchanged
+    float exact[] = { 0.0, 1.0, -1.0, 0.5, 2048.0, -0.099975586,
+                      65504.0, 6.1035156e-05 /* smallest normal */,
+                      5.9604645e-08 /* smallest subnormal */ };
+    for (unsigned i = 0;  i < sizeof(exact) / sizeof(exact[0]);  ++i)
+        BOOST_CHECK_EQUAL(half_to_float(float_to_half(exact[i])), exact[i]);
+
+    // Round to nearest even
+    BOOST_CHECK_EQUAL(half_to_float(float_to_half(2049.0)), 2048.0);
+    BOOST_CHECK_EQUAL(half_to_float(float_to_half(2051.0)), 2052.0);
+    BOOST_CHECK_EQUAL(half_to_float(float_to_half(2049.5)), 2050.0);
+
+    // Relative error is small over the range of activations
+    for (float x = -1.0;  x <= 1.0;  x += 0.0137) {
+        float y = half_to_float(float_to_half(x));
+        BOOST_CHECK(fabs(x - y) <= fabs(x) / 2048.0 + 1e-7);
+    }
+
+    // Overflow, infinity, underflow and NaN
+    float inf = numeric_limits<float>::infinity();
+    BOOST_CHECK_EQUAL(half_to_float(float_to_half(1e6)), inf);
+    BOOST_CHECK_EQUAL(half_to_float(float_to_half(-inf)), -inf);
+    BOOST_CHECK_EQUAL(half_to_float(float_to_half(1e-10)), 0.0);
+    BOOST_CHECK(isnan(half_to_float(float_to_half(NAN))));
+}
+
+BOOST_AUTO_TEST_CASE( test_layer_output_cache )
+{
+    int nx = 100, width = 7;
+
+    for (unsigned half = 0;  half < 2;  ++half) {
+        Layer_Output_Cache cache(nx, width, half);
+
+        BOOST_CHECK_EQUAL(cache.size(), nx);
+        BOOST_CHECK_EQUAL(cache.inputs(), width);
+        BOOST_CHECK_EQUAL(cache.memusage(),
+                          nx * width * (half ? 2 : 4));
+
+        // Row x holds x + i / 8, which is exact in both precisions
+        for (unsigned x = 0;  x < nx;  ++x) {
+            distribution<float> row(width);
+            for (unsigned i = 0;  i < width;  ++i)
+                row[i] = x + i / 8.0;
+            cache.set_row(x, row);
+        }
+
+        BOOST_CHECK_EQUAL(cache.row(3)[5], 3.625);
+
+        // Read it as an example source; every row once, in a new order
+        // each time
+        vector<int> first_order;
+        for (unsigned epoch = 0;  epoch < 2;  ++epoch) {
+            cache.rewind();
+
+            vector<int> seen(nx), order;
+            distribution<float> example;
+            Label label;
+            float weight;
+            while (cache.read(example, label, weight)) {
+                BOOST_REQUIRE_EQUAL(example.size(), width);
+                int x = example[0];
+                BOOST_REQUIRE(x >= 0 && x < nx);
+                ++seen[x];
+                order.push_back(x);
+                for (unsigned i = 0;  i < width;  ++i)
+                    BOOST_CHECK_EQUAL(example[i], x + i / 8.0);
+                BOOST_CHECK_EQUAL(weight, 1.0);
+            }
+
+            for (unsigned x = 0;  x < nx;  ++x)
+                BOOST_CHECK_EQUAL(seen[x], 1);
+
+            if (epoch == 0) first_order = order;
+            else BOOST_CHECK(order != first_order);
+        }
+
+        BOOST_CHECK_THROW(cache.row(nx), std::exception);
+    }
+}
@@ -0,0 +1,186 @@
+/* minibatch_feeder_test.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Test of the streaming minibatch feeder.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+#include "jml/neural/minibatch_feeder.h"
+#include "jml/utils/filter_streams.h"
+#include "jml/arch/exception_handler.h"
+
+using namespace ML;
+using namespace std;
+
+using boost::unit_test::test_suite;
+
+namespace {
+
+struct FileCleanup {
+    FileCleanup(const string & filename)
+        : filename_(filename)
+    {
+    }
+
+    ~FileCleanup()
+    {
+        ::unlink(filename_.c_str());
+    }
+
+    string filename_;
+};
+
+const int ni = 5;
+
+/* Write nx labelled rows; row x has label x and inputs x * 10 + i. */
+void write_matrix(std::ostream & stream, int first, int nx)
+{
+    for (unsigned x = first;  x < first + nx;  ++x) {
+        float row[ni + 1];
+        row[0] = x;
+        for (unsigned i = 0;  i < ni;  ++i)
+            row[i + 1] = x * 10 + i;
+        stream.write((const char *)row, sizeof(row));
+    }
+}
+
+/* Read an epoch, checking each example is intact, and return how many times
+   each label was seen. */
+vector<int> read_epoch(Minibatch_Feeder & feeder, int nx,
+                       float sample_proportion, bool randomize)
+{
+    vector<int> seen(nx);
+
+    feeder.start_epoch(sample_proportion, randomize, 1234);
+
+    while (std::shared_ptr<Minibatch> batch = feeder.next()) {
+        BOOST_CHECK(batch->size > 0);
+        BOOST_CHECK(batch->size <= feeder.minibatch_size());
+
+        for (unsigned i = 0;  i < batch->size;  ++i) {
+            int x = batch->labels[i];
+            BOOST_REQUIRE(x >= 0 && x < nx);
+            ++seen[x];
+            BOOST_REQUIRE_EQUAL(batch->data[i].size(), ni);
+            for (unsigned j = 0;  j < ni;  ++j)
+                BOOST_CHECK_EQUAL(batch->data[i][j], x * 10 + j);
+            BOOST_CHECK_EQUAL(batch->weights[i], 1.0);
+        }
+
+        feeder.recycle(batch);
+    }
+
+    return seen;
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_minibatch_feeder )
+{
+    int nx = 1000;
+
+    string filename1 = "/tmp/jml_minibatch_feeder_test-1.gz";
+    string filename2 = "/tmp/jml_minibatch_feeder_test-2";
+    FileCleanup cleanup1(filename1), cleanup2(filename2);
+
+    // Half of it compressed and half of it not
+    {
+        filter_ostream stream1(filename1);
+        write_matrix(stream1, 0, nx / 2);
+        filter_ostream stream2(filename2);
+        write_matrix(stream2, nx / 2, nx / 2);
+    }
+
+    vector<std::shared_ptr<Example_Source> > sources;
+    sources.push_back(std::shared_ptr<Example_Source>
+                      (new Float_Matrix_Source(filename1, ni, true)));
+    sources.push_back(std::shared_ptr<Example_Source>
+                      (new Float_Matrix_Source(filename2, ni, true)));
+
+    BOOST_CHECK_EQUAL(sources[0]->size(), nx / 2);
+    BOOST_CHECK_EQUAL(sources[1]->size(), nx / 2);
+
+    Minibatch_Feeder feeder(sources, 7 /* minibatch size */,
+                            2 /* prefetch */, 3 /* shuffle window */);
+
+    BOOST_CHECK_EQUAL(feeder.size(), nx);
+    BOOST_CHECK_EQUAL(feeder.inputs(), ni);
+
+    // Every example exactly once per epoch, several epochs running
+    for (unsigned epoch = 0;  epoch < 3;  ++epoch) {
+        vector<int> seen = read_epoch(feeder, nx, 1.0, epoch != 0);
+        for (unsigned x = 0;  x < nx;  ++x)
+            BOOST_CHECK_EQUAL(seen[x], 1);
+    }
+
+    // Subsampling keeps about the right number, each at most once
+    {
+        vector<int> seen = read_epoch(feeder, nx, 0.5, true);
+        int total = 0;
+        for (unsigned x = 0;  x < nx;  ++x) {
+            BOOST_CHECK(seen[x] <= 1);
+            total += seen[x];
+        }
+        BOOST_CHECK(total > nx * 0.4);
+        BOOST_CHECK(total < nx * 0.6);
+    }
+
+    // Abandoning an epoch part way through, with the readers blocked on the
+    // full queue
+    feeder.start_epoch(1.0, true, 1);
+    feeder.recycle(feeder.next());
+    feeder.stop();
+
+    vector<int> seen = read_epoch(feeder, nx, 1.0, true);
+    for (unsigned x = 0;  x < nx;  ++x)
+        BOOST_CHECK_EQUAL(seen[x], 1);
+}
+
+BOOST_AUTO_TEST_CASE( test_minibatch_feeder_stream )
+{
+    int nx = 100;
+
+    std::stringstream stream;
+    write_matrix(stream, 0, nx);
+
+    vector<std::shared_ptr<Example_Source> > sources;
+    sources.push_back(std::shared_ptr<Example_Source>
+                      (new Float_Matrix_Source(stream, ni, true, nx)));
+
+    Minibatch_Feeder feeder(sources, 16);
+
+    for (unsigned epoch = 0;  epoch < 2;  ++epoch) {
+        vector<int> seen = read_epoch(feeder, nx, 1.0, true);
+        for (unsigned x = 0;  x < nx;  ++x)
+            BOOST_CHECK_EQUAL(seen[x], 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_minibatch_feeder_truncated )
+{
+    std::stringstream stream;
+    write_matrix(stream, 0, 10);
+    stream.write("abc", 3);
+
+    vector<std::shared_ptr<Example_Source> > sources;
+    sources.push_back(std::shared_ptr<Example_Source>
+                      (new Float_Matrix_Source(stream, ni, true, 11)));
+
+    Minibatch_Feeder feeder(sources, 4);
+    feeder.start_epoch(1.0, false, 1);
+
+    {
+        JML_TRACE_EXCEPTIONS(false);
+        BOOST_CHECK_THROW(while (feeder.next()) ;, std::exception);
+    }
+}
+
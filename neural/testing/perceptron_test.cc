@@ -20,6 +20,7 @@
 #include "jml/neural/perceptron_generator.h"
 #include "jml/boosting/training_data.h"
 #include "jml/boosting/dense_features.h"
+#include "jml/boosting/sparse_features.h"
 #include "jml/boosting/feature_info.h"
 #include "jml/boosting/training_index.h"
 #include "jml/utils/smart_ptr_utils.h"
@@ -155,6 +156,159 @@ BOOST_AUTO_TEST_CASE( test_perceptron_regression )
     BOOST_CHECK_EQUAL(accuracy, 1);
 }
 
+BOOST_AUTO_TEST_CASE( test_perceptron_predict_dataset )
+{
+    /* Check that predicting over a whole dataset in blocks gives the same
+       results as predicting one example at a time. */
+
+    Dense_Feature_Space fs;
+    fs.add_feature("LABEL", Feature_Info(BOOLEAN, false, true));
+    fs.add_feature("feature1", REAL);
+    fs.add_feature("feature2", REAL);
+
+    std::shared_ptr<Dense_Feature_Space> fsp(make_unowned_sp(fs));
+
+    Training_Data data(fsp);
+
+    int nx = 3000;  // several jobs and a partial block at the end
+
+    for (unsigned i = 0;  i < nx;  ++i) {
+        distribution<float> features;
+
+        features.push_back(i % 3  == 0);
+        features.push_back((i % 7) * 0.1);
+        features.push_back(i % 5  == 0);
+
+        data.add_example(fs.encode(features));
+    }
+
+    Configuration config;
+    config.parse_string(config_options, "inbuilt config file");
+
+    Perceptron_Generator generator;
+    generator.configure(config);
+    generator.init(fsp, fs.features()[0]);
+    generator.arch_str = "5";
+    generator.min_iter = 1;
+    generator.max_iter = 2;
+
+    distribution<float> training_weights(nx, 1);
+
+    vector<Feature> features = fs.features();
+    features.erase(features.begin(), features.begin() + 1);
+
+    Thread_Context context;
+
+    std::shared_ptr<Classifier_Impl> classifier
+        = generator.generate(context, data, training_weights, features);
+
+    const Perceptron & perceptron
+        = dynamic_cast<const Perceptron &>(*classifier);
+
+    int nl = perceptron.label_count();
+
+    boost::multi_array<float, 2> results(boost::extents[nx][nl]);
+    distribution<float> label1(nx);
+
+    struct Record {
+        static void all(boost::multi_array<float, 2> * results,
+                        int nl, int x, const float * predictions)
+        {
+            std::copy(predictions, predictions + nl, &(*results)[x][0]);
+        }
+
+        static void one(distribution<float> * results, int x, float pred)
+        {
+            (*results)[x] = pred;
+        }
+    };
+
+    perceptron.predict(data, boost::bind(&Record::all, &results, nl, _1, _2));
+    perceptron.predict(data, 1, boost::bind(&Record::one, &label1, _1, _2));
+
+    boost::multi_array<float, 2> inputs(boost::extents[nx][2]);
+    for (unsigned x = 0;  x < nx;  ++x)
+        perceptron.extract_features(data[x], &inputs[x][0]);
+
+    boost::multi_array<float, 2> matrix_results = perceptron.predict(inputs);
+
+    for (unsigned x = 0;  x < nx;  ++x) {
+        distribution<float> expected = perceptron.predict(data[x]);
+        BOOST_REQUIRE_EQUAL(expected.size(), nl);
+        for (unsigned l = 0;  l < nl;  ++l) {
+            BOOST_CHECK_EQUAL(results[x][l], expected[l]);
+            BOOST_CHECK_EQUAL(matrix_results[x][l], expected[l]);
+        }
+        BOOST_CHECK_EQUAL(label1[x], expected[1]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_perceptron_sparse )
+{
+    /* A bag of words: each example has a handful of the words, and is
+       positive if any of the first ten words is there.  Missing words are
+       zero. */
+
+    int nwords = 200;
+
+    std::shared_ptr<Sparse_Feature_Space>
+        fs(new Sparse_Feature_Space());
+    Feature label = fs->make_feature("LABEL", Feature_Info(BOOLEAN));
+    vector<Feature> words;
+    for (unsigned i = 0;  i < nwords;  ++i)
+        words.push_back(fs->make_feature(format("word%d", i), REAL));
+
+    Training_Data data(fs);
+
+    Mutable_Feature_Set features;
+    for (unsigned x = 0;  x < nfv;  ++x) {
+        features.clear();
+        // Three different words; half of the examples have a positive one
+        int w[3] = { x % 2 == 0 ? x % 10 : 10 + x % 90,
+                     100 + (x * 7) % 50,
+                     150 + (x * 13) % 50 };
+        bool positive = w[0] < 10;
+        for (unsigned j = 0;  j < 3;  ++j)
+            features.add(words[w[j]], 1.0);
+        features.add(label, positive);
+        features.sort();
+        data.add_example_copy(features);
+    }
+
+    Configuration config;
+    config.parse_string(config_options, "inbuilt config file");
+
+    Perceptron_Generator generator;
+    generator.configure(config);
+    generator.init(fs, label);
+    generator.sparse = true;
+    generator.arch_str = "5";
+    generator.verbosity = 0;
+
+    distribution<float> training_weights(nfv, 1);
+
+    vector<Feature> all_features = words;
+    all_features.push_back(label);
+
+    Thread_Context context;
+
+    std::shared_ptr<Classifier_Impl> classifier
+        = generator.generate(context, data, training_weights, all_features);
+
+    const Perceptron & perceptron
+        = dynamic_cast<const Perceptron &>(*classifier);
+
+    // No decorrelation layer; the words go straight into the hidden layer
+    BOOST_CHECK_EQUAL(perceptron.layers.size(), 2);
+    BOOST_CHECK_EQUAL(perceptron.layers[0].inputs(), perceptron.features.size());
+
+    float accuracy = classifier->accuracy(data).first;
+
+    cerr << "accuracy = " << accuracy << endl;
+
+    BOOST_CHECK_EQUAL(accuracy, 1);
+}
+
 #if 0
 
 BOOST_AUTO_TEST_CASE( test_perceptron_missing )
@@ -414,3 +414,85 @@ BOOST_AUTO_TEST_CASE( test_bbprop_tanh_double_none3 )
     bbprop_test_reconstruct<double>(layer, context, 3.0);
 }
 #endif
+
+/* Check that the fused Twoway_Layer::rbprop() gives the same gradient as
+   composing the generic inverse and forward backprops. */
+template<typename Float>
+void test_rbprop_equivalent(Transfer_Function_Type transfer,
+                            Missing_Values missing_values,
+                            double tolerance)
+{
+    Thread_Context context;
+    context.seed(12);
+    Twoway_Layer layer("test", 20, 15, transfer, missing_values, context);
+
+    // Non-trivial scales and replacements so that all terms contribute
+    for (unsigned i = 0;  i < layer.inputs();  ++i) {
+        layer.iscales[i] = 0.5 + context.random01();
+        layer.ibias[i] = 0.5 - context.random01();
+    }
+    for (unsigned o = 0;  o < layer.outputs();  ++o)
+        layer.oscales[o] = 0.5 + context.random01();
+    for (unsigned i = 0;  i < layer.forward.missing_replacements.size();  ++i)
+        layer.forward.missing_replacements[i] = 0.5 - context.random01();
+
+    int ni = layer.inputs();
+
+    distribution<Float> input(ni);
+    for (unsigned i = 0;  i < ni;  ++i)
+        input[i] = 0.5 - context.random01();
+
+    if (missing_values != MV_NONE)
+        for (unsigned i = 0;  i < ni;  i += 3)
+            input[i] = numeric_limits<float>::quiet_NaN();
+
+    size_t temp_space_size = layer.rfprop_temporary_space_required();
+    Float temp_space[temp_space_size];
+
+    distribution<Float> reconstruction(ni);
+    layer.rfprop(&input[0], temp_space, temp_space_size, &reconstruction[0]);
+
+    distribution<Float> errors(ni);
+    for (unsigned i = 0;  i < ni;  ++i)
+        errors[i] = 0.5 - context.random01();
+
+    Parameters_Copy<double> fused(layer, 0.0), generic(layer, 0.0);
+    distribution<Float> fused_input_errors(ni), generic_input_errors(ni);
+
+    layer.rbprop(&input[0], &reconstruction[0], temp_space, temp_space_size,
+                 &errors[0], &fused_input_errors[0], fused, 2.0);
+
+    layer.Auto_Encoder::rbprop(&input[0], &reconstruction[0],
+                               temp_space, temp_space_size,
+                               &errors[0], &generic_input_errors[0],
+                               generic, 2.0);
+
+    BOOST_REQUIRE_EQUAL(fused.values.size(), generic.values.size());
+
+    double scale = generic.values.two_norm();
+    BOOST_REQUIRE(scale > 0.0);
+
+    for (unsigned i = 0;  i < fused.values.size();  ++i)
+        BOOST_CHECK_SMALL(fused.values[i] - generic.values[i],
+                          scale * tolerance);
+
+    // The generic path doesn't propagate through missing inputs
+    for (unsigned i = 0;  i < ni;  ++i)
+        if (!isnan(input[i]))
+            BOOST_CHECK_SMALL((double)fused_input_errors[i]
+                              - generic_input_errors[i],
+                              scale * tolerance);
+}
+
+BOOST_AUTO_TEST_CASE( test_rbprop_fused_equivalent )
+{
+    Transfer_Function_Type transfers[] = { TF_IDENTITY, TF_TANH };
+    Missing_Values missing[] = { MV_NONE, MV_ZERO, MV_INPUT, MV_DENSE };
+
+    for (unsigned t = 0;  t < 2;  ++t) {
+        for (unsigned m = 0;  m < 4;  ++m) {
+            test_rbprop_equivalent<double>(transfers[t], missing[m], 1e-9);
+            test_rbprop_equivalent<float>(transfers[t], missing[m], 1e-5);
+        }
+    }
+}
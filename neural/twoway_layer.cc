@@ -732,169 +732,134 @@ rbprop(const F * inputs,
     if (temp_space_size != this->outputs() + fspace + ifspace)
         throw Exception("wrong temporary space size");
 
+    // The hidden representation
     const F * outputs = temp_space + fspace;
 
     typedef Twoway_Layer::Float LFloat;
 
-    int ni JML_UNUSED = this->inputs();
-    int no JML_UNUSED = this->outputs();
+    int ni = this->inputs();
+    int no = this->outputs();
 
-    distribution<F> noisy_input(inputs, inputs + ni);
-
-    // Apply the layer
-    distribution<F> hidden_rep(outputs, outputs + no);
-
-    CHECK_NOT_NAN(hidden_rep);
-            
-    // Reconstruct the input
-    distribution<F> denoised_input(reconstruction, reconstruction + ni);
+    CHECK_NOT_NAN_N(outputs, no);
+    CHECK_NOT_NAN_N(reconstruction, ni);
 
-    CHECK_NOT_NAN(denoised_input);
-            
-    // Error signal
-    distribution<F> diff(reconstruction_errors, reconstruction_errors + ni);
+    // This is the inner loop of auto-encoder training, so everything is done
+    // in stack arrays (no heap allocation) and the weight matrix, which is
+    // used in both directions, is only traversed twice: once to propagate the
+    // error back to the hidden layer, and once to write the weight updates.
     
     const boost::multi_array<LFloat, 2> & W = forward.weights;
 
-    const distribution<LFloat> & b JML_UNUSED = forward.bias;
-    const distribution<LFloat> & c JML_UNUSED = ibias;
-    const distribution<LFloat> & d JML_UNUSED = iscales;
-    const distribution<LFloat> & e JML_UNUSED = oscales;
+    const distribution<LFloat> & d = iscales;
+    const distribution<LFloat> & e = oscales;
 
-    distribution<F> c_updates
-        = diff * forward.transfer_function->derivative(denoised_input);
+    // Reconstruction bias updates
+    F c_updates[ni];
+    forward.transfer_function->derivative(reconstruction, c_updates, ni);
+    for (unsigned i = 0;  i < ni;  ++i)
+        c_updates[i] *= reconstruction_errors[i];
 
-    CHECK_NOT_NAN(c_updates);
+    CHECK_NOT_NAN_N((F *)c_updates, ni);
 
     gradient.vector(4, "ibias").update(c_updates, example_weight);
 
-    distribution<F> hidden_rep_e
-        = hidden_rep * e;
+    F hidden_rep_e[no];
+    SIMD::vec_prod(outputs, &e[0], hidden_rep_e, no);
 
-    distribution<F> d_updates(ni);
-    d_updates = multiply_r<F>(W, hidden_rep_e) * c_updates;
-
-    CHECK_NOT_NAN(d_updates);
-
-    gradient.vector(5, "iscales").update(d_updates, example_weight);
-
-    distribution<F> cupdates_d_W
-        = multiply_r<F>((c_updates * d), W);
-    
-    distribution<F> e_updates = cupdates_d_W * hidden_rep;
+    // First pass over W: the iscales updates need W * (h e), and the error
+    // at the hidden layer needs (c d)^T W.
+    F d_updates[ni];
+    double factor_totals_accum[no];
+    std::fill(factor_totals_accum, factor_totals_accum + no, 0.0);
 
-    gradient.vector(6, "oscales").update(e_updates, example_weight);
+    for (unsigned i = 0;  i < ni;  ++i) {
+        const LFloat * Wi = &W[i][0];
+        d_updates[i]
+            = c_updates[i] * SIMD::vec_dotprod_dp(Wi, hidden_rep_e, no);
+        SIMD::vec_add(factor_totals_accum, c_updates[i] * d[i], Wi,
+                      factor_totals_accum, no);
+    }
 
+    CHECK_NOT_NAN_N((F *)d_updates, ni);
 
-    CHECK_NOT_NAN(e_updates);
+    gradient.vector(5, "iscales").update(d_updates, example_weight);
 
-    distribution<F> hidden_deriv
-        = forward.transfer_function->derivative(hidden_rep);
+    F hidden_deriv[no];
+    forward.transfer_function->derivative(outputs, hidden_deriv, no);
 
-    CHECK_NOT_NAN(hidden_deriv);
+    CHECK_NOT_NAN_N((F *)hidden_deriv, no);
 
-    distribution<F> b_updates = cupdates_d_W * hidden_deriv * e;
+    F e_updates[no], factor_totals[no], b_updates[no];
+    for (unsigned o = 0;  o < no;  ++o) {
+        e_updates[o] = factor_totals_accum[o] * outputs[o];
+        factor_totals[o] = factor_totals_accum[o] * e[o];
+        b_updates[o] = factor_totals[o] * hidden_deriv[o];
+    }
 
-    CHECK_NOT_NAN(b_updates);
+    CHECK_NOT_NAN_N((F *)e_updates, no);
+    CHECK_NOT_NAN_N((F *)b_updates, no);
 
+    gradient.vector(6, "oscales").update(e_updates, example_weight);
     gradient.vector(1, "bias").update(b_updates, example_weight);
 
-    distribution<double> factor_totals_accum(no);
-
-    for (unsigned i = 0;  i < ni;  ++i)
-        SIMD::vec_add(&factor_totals_accum[0], c_updates[i] * d[i], &W[i][0],
-                      &factor_totals_accum[0], no);
+    // Second pass over W: weight updates, plus W * b for the input errors
+    // and the missing replacements
+    Matrix_Parameter & W_updates = gradient.matrix(0, "weights");
 
-    distribution<F> factor_totals
-        = factor_totals_accum.cast<F>() * e;
+    bool need_input_updates
+        = input_errors_out || forward.missing_values == MV_INPUT;
 
-    boost::multi_array<F, 2> W_updates;
-    vector<distribution<double> > missing_act_updates;
-
-    distribution<double> hidden_rep_ed(hidden_rep_e);
+    F cleared_value_updates[ni];
+    F W_updates_row[no];
 
     for (unsigned i = 0;  i < ni;  ++i) {
 
-        if (!isnan(noisy_input[i])) {
-            
-            F W_updates_row[no];
-            
+        F k = c_updates[i] * d[i];
+
+        if (!isnan(inputs[i])) {
             // We use the W value for both the input and the output, so we
             // need to accumulate it's total effect on the derivative
-            calc_W_updates(c_updates[i] * d[i],
-                           &hidden_rep_e[0],
-                           
-                           noisy_input[i],
-                           &factor_totals[0],
-                           &hidden_deriv[0],
-                           W_updates_row,
-                           no);
+            calc_W_updates(k, hidden_rep_e, inputs[i], factor_totals,
+                           hidden_deriv, W_updates_row, no);
             
-            CHECK_NOT_NAN_RANGE(&W_updates_row[0], &W_updates_row[0] + no);
+            CHECK_NOT_NAN_N((F *)W_updates_row, no);
 
-            gradient.matrix(0, "weights")
-                .update_row(i, W_updates_row, example_weight);
+            W_updates.update_row(i, W_updates_row, example_weight);
         }
         else if (forward.missing_values == MV_NONE)
             throw Exception("MV_NONE but missing value");
-        else if (forward.missing_values == MV_ZERO) {
-            gradient.matrix(0, "weights")
-                .update_row(i, hidden_rep_e,
-                            c_updates[i] * d[i] * example_weight);
-        }
+        else if (forward.missing_values == MV_ZERO)
+            W_updates.update_row(i, hidden_rep_e, k * example_weight);
         else if (forward.missing_values == MV_DENSE) {
-            // The weight updates are simpler, but we also have to calculate
-            // the missing activation updates
-            
-            // W value only used on the way out; simpler calculation
-            
-            gradient.matrix(0, "weights")
-                .update_row(i, hidden_rep_e,
-                            c_updates[i] * d[i] * example_weight);
-
-            distribution<F> mau_updates
-                = factor_totals * hidden_deriv;
-
+            // W value only used on the way out; simpler calculation.  The
+            // missing activation updates are factor_totals * hidden_deriv,
+            // which is b_updates.
+            W_updates.update_row(i, hidden_rep_e, k * example_weight);
             gradient.matrix(3, "missing_activations")
-                .update_row(i, mau_updates, example_weight);
+                .update_row(i, b_updates, example_weight);
         }
         else if (forward.missing_values == MV_INPUT) {
-
-            F W_updates_row[no];
+            calc_W_updates(k, hidden_rep_e,
+                           (F)forward.missing_replacements[i],
+                           factor_totals, hidden_deriv, W_updates_row, no);
             
-            // We use the W value for both the input and the output, so we
-            // need to accumulate it's total effect on the derivative
-            calc_W_updates(c_updates[i] * d[i],
-                           &hidden_rep_e[0],
-                           
-                           forward.missing_replacements[i],
-                           &factor_totals[0],
-                           &hidden_deriv[0],
-                           W_updates_row,
-                           no);
-            
-            CHECK_NOT_NAN_RANGE(&W_updates_row[0], &W_updates_row[0] + no);
+            CHECK_NOT_NAN_N((F *)W_updates_row, no);
 
-            gradient.matrix(0, "weights")
-                .update_row(i, W_updates_row, example_weight);
+            W_updates.update_row(i, W_updates_row, example_weight);
         }
         else throw Exception("unknown updates");
+
+        if (need_input_updates) {
+            F input_update = SIMD::vec_dotprod_dp(&W[i][0], b_updates, no);
+            cleared_value_updates[i] = isnan(inputs[i]) ? input_update : 0.0;
+            if (input_errors_out) input_errors_out[i] = input_update;
+        }
     }
 
-    distribution<F> cleared_value_updates(ni);
-    cleared_value_updates = isnan(noisy_input) * (W * b_updates);
-        
     if (forward.missing_values == MV_INPUT) {
         gradient.vector(2, "missing_replacements")
             .update(cleared_value_updates, example_weight);
     }
-
-
-    if (input_errors_out) {
-        distribution<F> input_updates(W * b_updates);
-        std::copy(input_updates.begin(), input_updates.end(),
-                  input_errors_out);
-    }
 }
     
 void
@@ -6,7 +6,9 @@
 */
 
 #include "auc.h"
+#include "jml/utils/parallel_sort.h"
 #include <algorithm>
+#include <cmath>
 
 
 using namespace std;
@@ -16,67 +18,220 @@ namespace ML {
 
 double do_calc_auc(std::vector<AUC_Entry> & entries)
 {
-    // 1.  Total number of positive and negative
-    int num_neg = 0, num_pos = 0;
+    // 1.  Entries with no weight don't count
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [] (const AUC_Entry & e)
+                                 {
+                                     return e.weight == 0.0;
+                                 }),
+                  entries.end());
+
+    // 2.  Total number of positive and negative
+    size_t num_neg = 0, num_pos = 0;
 
     for (unsigned i = 0;  i < entries.size();  ++i) {
-        if (entries[i].weight == 0.0) continue;
         if (entries[i].target == false) ++num_neg;
         else ++num_pos;
     }
 
-    // 2.  Sort
-    std::sort(entries.begin(), entries.end());
+    // 3.  Sort
+    parallel_sort(entries, std::less<AUC_Entry>());
     
-    // 3.  Get (x,y) points and calculate the AUC
-    int total_pos = 0, total_neg = 0;
+    // 4.  Get (x,y) points and calculate the AUC
+    size_t total_pos = 0, total_neg = 0;
 
-    float prevx = 0.0, prevy = 0.0;
+    double prevx = 0.0, prevy = 0.0;
 
-    double total_area = 0.0, total_weight = 0.0, current_weight = 0.0;
+    double total_area = 0.0;
 
     for (unsigned i = 0;  i < entries.size();  ++i) {
-        if (entries[i].weight > 0.0) {
-            if (entries[i].target == false) ++total_neg;
-            else ++total_pos;
-        }
-        
-        current_weight += entries[i].weight;
-        total_weight += entries[i].weight;
+        if (entries[i].target == false) ++total_neg;
+        else ++total_pos;
 
         if (i != entries.size() - 1
             && entries[i].model == entries[i + 1].model)
             continue;
         
-        if (entries[i].weight == 0.0) continue;
-
-        float x = total_pos * 1.0 / num_pos;
-        float y = total_neg * 1.0 / num_neg;
+        double x = total_pos * 1.0 / num_pos;
+        double y = total_neg * 1.0 / num_neg;
 
         double area = (x - prevx) * (y + prevy) * 0.5;
 
-        total_area += /* current_weight * */ area;
+        total_area += area;
 
         prevx = x;
         prevy = y;
-        current_weight = 0.0;
     }
 
     // TODO: get weighted working properly...
 
-    //cerr << "total_area = " << total_area << " total_weight = "
-    //     << total_weight << endl;
-
     if (total_pos != num_pos || total_neg != num_neg)
         throw Exception("bad total pos or total neg");
 
-    // 4.  Convert to gini
+    // 5.  Convert to gini
     //double gini = 2.0 * (total_area - 0.5);
 
-    // 5.  Final score is absolute value.  Since we want an error, we take
+    // 6.  Final score is absolute value.  Since we want an error, we take
     //     1.0 - the gini
     //return 1.0 - fabs(gini);
     return 1.0 - total_area;
 }
 
+
+/*****************************************************************************/
+/* AUC_HISTOGRAM                                                             */
+/*****************************************************************************/
+
+AUC_Histogram::
+AUC_Histogram(float min_value, float max_value, int num_buckets)
+    : min_value(min_value), max_value(max_value)
+{
+    if (num_buckets < 1)
+        throw Exception("AUC_Histogram: need at least one bucket");
+    if (!(max_value > min_value))
+        throw Exception("AUC_Histogram: empty range");
+
+    pos.resize(num_buckets);
+    neg.resize(num_buckets);
+}
+
+int
+AUC_Histogram::
+bucket(float model) const
+{
+    int n = pos.size();
+    if (!(model > min_value)) return 0;  // includes NaN
+    if (model >= max_value) return n - 1;
+    int result = (model - min_value) / (max_value - min_value) * n;
+    return std::min(std::max(result, 0), n - 1);
+}
+
+void
+AUC_Histogram::
+merge(const AUC_Histogram & other)
+{
+    if (other.min_value != min_value || other.max_value != max_value
+        || other.pos.size() != pos.size())
+        throw Exception("AUC_Histogram::merge(): buckets don't match");
+
+    for (unsigned i = 0;  i < pos.size();  ++i) {
+        pos[i] += other.pos[i];
+        neg[i] += other.neg[i];
+    }
+}
+
+double
+AUC_Histogram::
+auc() const
+{
+    double total_pos = 0.0, total_neg = 0.0, area = 0.0;
+
+    for (unsigned i = 0;  i < pos.size();  ++i) {
+        area += pos[i] * (total_neg + 0.5 * neg[i]);
+        total_pos += pos[i];
+        total_neg += neg[i];
+    }
+
+    return area / (total_pos * total_neg);
+}
+
+double
+AUC_Histogram::
+error_bound() const
+{
+    double total_pos = 0.0, total_neg = 0.0, tied = 0.0;
+
+    for (unsigned i = 0;  i < pos.size();  ++i) {
+        tied += pos[i] * neg[i];
+        total_pos += pos[i];
+        total_neg += neg[i];
+    }
+
+    return 0.5 * tied / (total_pos * total_neg);
+}
+
+
+/*****************************************************************************/
+/* PRECISION_AT_K                                                            */
+/*****************************************************************************/
+
+namespace {
+
+/** Is a kept in preference to b?  At the same output, negative entries are
+    kept before positive ones. */
+bool better(const AUC_Entry & a, const AUC_Entry & b)
+{
+    if (a.model != b.model) return a.model > b.model;
+    return !a.target && b.target;
+}
+
+} // file scope
+
+Precision_At_K::
+Precision_At_K(int k)
+    : k(k)
+{
+    if (k < 1)
+        throw Exception("Precision_At_K: k must be at least one");
+    top.reserve(k);
+}
+
+void
+Precision_At_K::
+add(float model, bool target, float weight)
+{
+    if (weight == 0.0) return;
+
+    AUC_Entry entry(model, target, weight);
+
+    // With better() as the comparison, the front of the heap is the entry
+    // that would be dropped first
+    if (top.size() < k) {
+        top.push_back(entry);
+        std::push_heap(top.begin(), top.end(), better);
+    }
+    else if (better(entry, top.front())) {
+        std::pop_heap(top.begin(), top.end(), better);
+        top.back() = entry;
+        std::push_heap(top.begin(), top.end(), better);
+    }
+}
+
+void
+Precision_At_K::
+merge(const Precision_At_K & other)
+{
+    if (other.k != k)
+        throw Exception("Precision_At_K::merge(): different k");
+
+    for (unsigned i = 0;  i < other.top.size();  ++i)
+        add(other.top[i].model, other.top[i].target, other.top[i].weight);
+}
+
+double
+Precision_At_K::
+precision() const
+{
+    double correct = 0.0, total = 0.0;
+    for (unsigned i = 0;  i < top.size();  ++i) {
+        if (top[i].target) correct += top[i].weight;
+        total += top[i].weight;
+    }
+    return (total == 0.0 ? 0.0 : correct / total);
+}
+
+
+/*****************************************************************************/
+/* LOG_LOSS                                                                  */
+/*****************************************************************************/
+
+void
+Log_Loss::
+add(float probability, bool target, float weight)
+{
+    double p = std::min(std::max<double>(probability, epsilon), 1.0 - epsilon);
+    total_loss -= weight * (target ? std::log(p) : std::log(1.0 - p));
+    total_weight += weight;
+}
+
 } // namespace ML
@@ -30,6 +30,14 @@ struct AUC_Entry {
     }
 };
 
+/** Calculate 1 - the area under the ROC curve of the entries, ie the
+    probability that a random negative entry has a higher model output than
+    a random positive one (with ties counting one half).  Entries with a
+    zero weight are removed; the others all count equally.
+
+    The entries are sorted in place with parallel_sort(), so big sets of
+    entries use all of the threads.
+*/
 double do_calc_auc(std::vector<AUC_Entry> & entries);
 
 
@@ -94,6 +102,114 @@ calc_auc(const std::vector<Float1> & outputs,
     return do_calc_auc(entries);
 }
 
+
+/*****************************************************************************/
+/* AUC_HISTOGRAM                                                             */
+/*****************************************************************************/
+
+/** Streaming approximation of the weighted AUC in fixed memory.  The model
+    outputs go into num_buckets equal width buckets over
+    [min_value, max_value] (those outside go into the end buckets), which
+    hold the weight of the positive and negative entries.  Pairs in the same
+    bucket are counted as ties, so auc() is within error_bound() of the
+    exact weighted AUC.
+
+    Histograms with the same buckets can be merged, so that each thread or
+    shard can add its entries to its own.
+*/
+struct AUC_Histogram {
+    AUC_Histogram(float min_value = 0.0, float max_value = 1.0,
+                  int num_buckets = 65536);
+
+    float min_value;
+    float max_value;
+    std::vector<double> pos;    ///< Weight of positive entries per bucket
+    std::vector<double> neg;    ///< Weight of negative entries per bucket
+
+    int bucket(float model) const;
+
+    void add(float model, bool target, float weight = 1.0)
+    {
+        if (weight == 0.0) return;
+        if (target) pos[bucket(model)] += weight;
+        else neg[bucket(model)] += weight;
+    }
+
+    /** Add in the entries of the other histogram, which must have the same
+        buckets. */
+    void merge(const AUC_Histogram & other);
+
+    /** The area under the ROC curve, ie the probability that a random
+        positive entry has a higher model output than a random negative
+        one (ties count one half).  Unlike do_calc_auc(), this is not
+        1 - the area. */
+    double auc() const;
+
+    /** Maximum difference between auc() and the exact value; half of the
+        proportion of the positive/negative pairs that share a bucket. */
+    double error_bound() const;
+};
+
+
+/*****************************************************************************/
+/* PRECISION_AT_K                                                            */
+/*****************************************************************************/
+
+/** Streaming precision of the k entries with the highest model outputs,
+    using O(k) memory.  Where entries at the boundary have the same output,
+    the negative ones are kept, so the result doesn't depend upon the order
+    in which entries are added or merged.
+*/
+struct Precision_At_K {
+    Precision_At_K(int k = 100);
+
+    int k;
+    std::vector<AUC_Entry> top;   ///< Heap with the lowest entry first
+
+    void add(float model, bool target, float weight = 1.0);
+
+    /** Add in the entries of the other one, which must have the same k. */
+    void merge(const Precision_At_K & other);
+
+    /** Weighted proportion of positive entries in the top k (or in all of
+        them if there are fewer than k). */
+    double precision() const;
+};
+
+
+/*****************************************************************************/
+/* LOG_LOSS                                                                  */
+/*****************************************************************************/
+
+/** Streaming weighted log loss (cross entropy) of probabilities.  The
+    probabilities are bounded to [epsilon, 1 - epsilon] so that the loss of
+    a confident mistake is finite.
+*/
+struct Log_Loss {
+    Log_Loss(double epsilon = 1e-15)
+        : total_loss(0.0), total_weight(0.0), epsilon(epsilon)
+    {
+    }
+
+    double total_loss;
+    double total_weight;
+    double epsilon;
+
+    void add(float probability, bool target, float weight = 1.0);
+
+    void merge(const Log_Loss & other)
+    {
+        total_loss += other.total_loss;
+        total_weight += other.total_weight;
+    }
+
+    /** Mean loss per unit of weight. */
+    double loss() const
+    {
+        return (total_weight == 0.0 ? 0.0 : total_loss / total_weight);
+    }
+};
+
 } // namespace ML
 
 #endif /* __jml__stats__auc_h__ */
@@ -46,6 +46,8 @@ inline void wrong_sizes_exception(const char * op, int size1, int size2)
 }
 
 
+template<class Expr> class Dist_Expr;
+
 template<typename F, class Underlying = std::vector<F> >
 class distribution : public Underlying {
     typedef Underlying parent;
@@ -87,6 +89,21 @@ public:
         return *this;
     }
 
+    /** Evaluate a lazy expression (see distribution_expr.h). */
+    template<class Expr>
+    distribution(const Dist_Expr<Expr> & expr)
+    {
+        expr.evaluate(*this);
+    }
+
+    template<class Expr>
+    distribution &
+    operator = (const Dist_Expr<Expr> & expr)
+    {
+        expr.evaluate(*this);
+        return *this;
+    }
+
 #if 0 // use fill instead
     distribution &
     operator = (const F & val)
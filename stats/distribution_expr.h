@@ -0,0 +1,340 @@
+/* distribution_expr.h                                             -*- C++ -*-
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Lazily evaluated element-wise expressions over distributions.
+*/
+
+#ifndef __stats__distribution_expr_h__
+#define __stats__distribution_expr_h__
+
+#include "distribution.h"
+#include "distribution_simd.h"
+#include <boost/utility/enable_if.hpp>
+#include <boost/type_traits/is_arithmetic.hpp>
+
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* DIST_EXPR                                                                 */
+/*****************************************************************************/
+
+/** An element-wise arithmetic expression over distributions, which isn't
+    evaluated until it is assigned to a distribution.  An expression is
+    started with lazy():
+
+        distribution<float> training_weights
+            = lazy(in_training) * example_weights * ex_weights;
+
+    Unlike the normal operators, which allocate and fill a temporary
+    distribution for each operation, the whole expression is evaluated in
+    one pass with a single allocation for the result (or none, when it is
+    assigned to an existing distribution of the right size).  The values
+    are calculated in blocks small enough to stay in the L1 cache, using
+    the SIMD kernels for float and double.
+
+    Only +, -, * and / are supported, between expressions, distributions
+    and scalars.  As in the normal operators, the value type of an
+    operation is that of its left hand side, and the sizes must match.
+
+    An expression refers to the distributions that it was made from, so it
+    must be evaluated before they go away; it shouldn't be stored.  A
+    distribution may be assigned an expression that uses it.
+*/
+template<class Expr>
+class Dist_Expr {
+public:
+    typedef typename Expr::value_type value_type;
+
+    enum { BLOCK_SIZE = 256 };
+
+    explicit Dist_Expr(const Expr & expr)
+        : expr(expr)
+    {
+    }
+
+    size_t size() const { return expr.size(); }
+
+    value_type operator [] (size_t i) const { return expr.at(i); }
+
+    /** Return a pointer to elements [i0, i0 + n) of the expression.  They
+        are either evaluated into the given buffer (which holds at least
+        n elements) or, for a distribution of contiguous values, pointed to
+        directly. */
+    const value_type *
+    block(size_t i0, size_t n, value_type * buffer) const
+    {
+        return expr.block(i0, n, buffer);
+    }
+
+    /** Evaluate the expression into the given distribution, which is
+        resized to fit. */
+    template<typename F, class Underlying>
+    void evaluate(distribution<F, Underlying> & result) const
+    {
+        size_t n = size();
+        result.resize(n);
+
+        // Each block is finished before it's written, so that the result
+        // can be one of the operands
+        value_type buffer[BLOCK_SIZE];
+        for (size_t i0 = 0;  i0 < n;  i0 += BLOCK_SIZE) {
+            size_t nb = std::min<size_t>(BLOCK_SIZE, n - i0);
+            const value_type * values = block(i0, nb, buffer);
+            std::copy(values, values + nb, result.begin() + i0);
+        }
+    }
+
+    /** Evaluate into a new distribution. */
+    distribution<value_type> eval() const
+    {
+        distribution<value_type> result;
+        evaluate(result);
+        return result;
+    }
+
+    Expr expr;
+};
+
+
+/*****************************************************************************/
+/* OPERANDS                                                                  */
+/*****************************************************************************/
+
+/** Pointer to the contiguous values of a distribution, or zero if they
+    can't be accessed that way. */
+template<typename F, class Underlying>
+const F * dist_expr_data(const distribution<F, Underlying> & dist)
+{
+    return 0;
+}
+
+template<class Alloc>
+const float *
+dist_expr_data(const distribution<float, std::vector<float, Alloc> > & dist)
+{
+    return dist.empty() ? 0 : &dist[0];
+}
+
+template<class Alloc>
+const double *
+dist_expr_data(const distribution<double, std::vector<double, Alloc> > & dist)
+{
+    return dist.empty() ? 0 : &dist[0];
+}
+
+/** A distribution used in an expression. */
+template<typename F, class Underlying>
+struct Dist_Ref {
+    typedef F value_type;
+
+    Dist_Ref(const distribution<F, Underlying> & dist)
+        : dist(&dist), data(dist_expr_data(dist))
+    {
+    }
+
+    size_t size() const { return dist->size(); }
+
+    F at(size_t i) const { return (*dist)[i]; }
+
+    const F * block(size_t i0, size_t n, F * buffer) const
+    {
+        if (data) return data + i0;
+        std::copy(dist->begin() + i0, dist->begin() + i0 + n, buffer);
+        return buffer;
+    }
+
+    const distribution<F, Underlying> * dist;
+    const F * data;
+};
+
+/** A scalar used in an expression, which stands for a distribution of the
+    given size with all elements equal to the value. */
+template<typename F>
+struct Dist_Scalar {
+    typedef F value_type;
+
+    Dist_Scalar(F value, size_t n)
+        : value(value), n(n)
+    {
+    }
+
+    size_t size() const { return n; }
+
+    F at(size_t i) const { return value; }
+
+    const F * block(size_t i0, size_t n, F * buffer) const
+    {
+        std::fill(buffer, buffer + n, value);
+        return buffer;
+    }
+
+    F value;
+    size_t n;
+};
+
+
+/*****************************************************************************/
+/* OPERATIONS                                                                */
+/*****************************************************************************/
+
+/* Each operation has a scalar version and a block version, r = x op y,
+   which is overloaded with the SIMD kernels where they exist.  The block
+   versions must allow r to be the same as x. */
+
+#define DIST_EXPR_OP(name, op) \
+struct name { \
+    static const char * symbol() { return #op; } \
+\
+    template<typename F1, typename F2> \
+    static F1 apply(F1 x, F2 y) \
+    { \
+        return x op y; \
+    } \
+\
+    template<typename F1, typename F2> \
+    static void apply(const F1 * x, const F2 * y, F1 * r, size_t n) \
+    { \
+        for (unsigned i = 0;  i < n;  ++i) \
+            r[i] = x[i] op y[i]; \
+    } \
+\
+    static void apply(const float * x, const float * y, float * r, size_t n); \
+    static void apply(const double * x, const double * y, double * r, \
+                      size_t n); \
+};
+
+DIST_EXPR_OP(Dist_Expr_Add, +);
+DIST_EXPR_OP(Dist_Expr_Sub, -);
+DIST_EXPR_OP(Dist_Expr_Mul, *);
+DIST_EXPR_OP(Dist_Expr_Div, /);
+#undef DIST_EXPR_OP
+
+#define DIST_EXPR_KERNEL(name, F, kernel) \
+inline void \
+name:: \
+apply(const F * x, const F * y, F * r, size_t n) \
+{ \
+    kernel; \
+}
+
+DIST_EXPR_KERNEL(Dist_Expr_Add, float, SIMD::vec_add(x, y, r, n));
+DIST_EXPR_KERNEL(Dist_Expr_Add, double, SIMD::vec_add(x, y, r, n));
+DIST_EXPR_KERNEL(Dist_Expr_Sub, float, SIMD::vec_minus(x, y, r, n));
+DIST_EXPR_KERNEL(Dist_Expr_Sub, double, SIMD::vec_minus(x, y, r, n));
+DIST_EXPR_KERNEL(Dist_Expr_Mul, float, SIMD::vec_prod(x, y, r, n));
+DIST_EXPR_KERNEL(Dist_Expr_Mul, double, SIMD::vec_prod(x, y, r, n));
+DIST_EXPR_KERNEL(Dist_Expr_Div, float,
+                 for (unsigned i = 0;  i < n;  ++i) r[i] = x[i] / y[i]);
+DIST_EXPR_KERNEL(Dist_Expr_Div, double,
+                 for (unsigned i = 0;  i < n;  ++i) r[i] = x[i] / y[i]);
+#undef DIST_EXPR_KERNEL
+
+/** The result of an operation between two expressions. */
+template<class Op, class Expr1, class Expr2>
+struct Dist_Binary {
+    typedef typename Expr1::value_type value_type;
+    typedef typename Expr2::value_type value_type2;
+
+    Dist_Binary(const Expr1 & expr1, const Expr2 & expr2)
+        : expr1(expr1), expr2(expr2)
+    {
+        if (expr1.size() != expr2.size())
+            wrong_sizes_exception(Op::symbol(), expr1.size(), expr2.size());
+    }
+
+    size_t size() const { return expr1.size(); }
+
+    value_type at(size_t i) const
+    {
+        return Op::apply(expr1.at(i), expr2.at(i));
+    }
+
+    const value_type * block(size_t i0, size_t n, value_type * buffer) const
+    {
+        value_type2 buffer2[Dist_Expr<Expr1>::BLOCK_SIZE];
+        const value_type * x = expr1.block(i0, n, buffer);
+        const value_type2 * y = expr2.block(i0, n, buffer2);
+        Op::apply(x, y, buffer, n);
+        return buffer;
+    }
+
+    Expr1 expr1;
+    Expr2 expr2;
+};
+
+
+/*****************************************************************************/
+/* OPERATORS                                                                 */
+/*****************************************************************************/
+
+/** Start a lazily evaluated expression from a distribution. */
+template<typename F, class Underlying>
+Dist_Expr<Dist_Ref<F, Underlying> >
+lazy(const distribution<F, Underlying> & dist)
+{
+    return Dist_Expr<Dist_Ref<F, Underlying> >(dist);
+}
+
+#define DIST_EXPR_OPERATOR(op, Op) \
+template<class Expr1, class Expr2> \
+Dist_Expr<Dist_Binary<Op, Expr1, Expr2> > \
+operator op (const Dist_Expr<Expr1> & e1, const Dist_Expr<Expr2> & e2) \
+{ \
+    typedef Dist_Binary<Op, Expr1, Expr2> Result; \
+    return Dist_Expr<Result>(Result(e1.expr, e2.expr)); \
+} \
+\
+template<class Expr, typename F, class Underlying> \
+Dist_Expr<Dist_Binary<Op, Expr, Dist_Ref<F, Underlying> > > \
+operator op (const Dist_Expr<Expr> & e, \
+             const distribution<F, Underlying> & d) \
+{ \
+    typedef Dist_Binary<Op, Expr, Dist_Ref<F, Underlying> > Result; \
+    return Dist_Expr<Result>(Result(e.expr, d)); \
+} \
+\
+template<typename F, class Underlying, class Expr> \
+Dist_Expr<Dist_Binary<Op, Dist_Ref<F, Underlying>, Expr> > \
+operator op (const distribution<F, Underlying> & d, \
+             const Dist_Expr<Expr> & e) \
+{ \
+    typedef Dist_Binary<Op, Dist_Ref<F, Underlying>, Expr> Result; \
+    return Dist_Expr<Result>(Result(d, e.expr)); \
+} \
+\
+template<class Expr, typename S> \
+typename boost::enable_if<boost::is_arithmetic<S>, \
+    Dist_Expr<Dist_Binary<Op, Expr, \
+                          Dist_Scalar<typename Expr::value_type> > > >::type \
+operator op (const Dist_Expr<Expr> & e, S val) \
+{ \
+    typedef Dist_Scalar<typename Expr::value_type> Scalar; \
+    typedef Dist_Binary<Op, Expr, Scalar> Result; \
+    return Dist_Expr<Result>(Result(e.expr, Scalar(val, e.size()))); \
+} \
+\
+template<typename S, class Expr> \
+typename boost::enable_if<boost::is_arithmetic<S>, \
+    Dist_Expr<Dist_Binary<Op, Dist_Scalar<typename Expr::value_type>, \
+                          Expr> > >::type \
+operator op (S val, const Dist_Expr<Expr> & e) \
+{ \
+    typedef Dist_Scalar<typename Expr::value_type> Scalar; \
+    typedef Dist_Binary<Op, Scalar, Expr> Result; \
+    return Dist_Expr<Result>(Result(Scalar(val, e.size()), e.expr)); \
+}
+
+DIST_EXPR_OPERATOR(+, Dist_Expr_Add);
+DIST_EXPR_OPERATOR(-, Dist_Expr_Sub);
+DIST_EXPR_OPERATOR(*, Dist_Expr_Mul);
+DIST_EXPR_OPERATOR(/, Dist_Expr_Div);
+#undef DIST_EXPR_OPERATOR
+
+
+} // namespace ML
+
+
+#endif /* __stats__distribution_expr_h__ */
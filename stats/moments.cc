@@ -0,0 +1,117 @@
+/* moments.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Streaming moments.
+*/
+
+#include "moments.h"
+#include "jml/arch/simd_vector.h"
+#include "jml/arch/exception.h"
+#include "jml/db/persistent.h"
+
+
+using namespace std;
+
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* MOMENTS                                                                   */
+/*****************************************************************************/
+
+namespace {
+
+/** Add the n values to the moments.  The values of each block are shifted
+    by the current mean (or the first value) before the sums are taken, so
+    that the sum of squares doesn't lose precision when the mean is large
+    compared to the spread. */
+template<typename Float>
+void add_block(Moments & moments, const Float * values, size_t n)
+{
+    enum { BLOCK = 256 };
+    double shifted[BLOCK];
+
+    for (size_t i0 = 0;  i0 < n;  i0 += BLOCK) {
+        size_t nb = std::min<size_t>(BLOCK, n - i0);
+        const Float * block = values + i0;
+
+        double shift = (moments.count == 0.0 ? block[0] : moments.mean);
+
+        Moments bm;
+        for (unsigned i = 0;  i < nb;  ++i) {
+            shifted[i] = block[i] - shift;
+            bm.min_value = std::min<double>(bm.min_value, block[i]);
+            bm.max_value = std::max<double>(bm.max_value, block[i]);
+        }
+
+        double sum = SIMD::vec_sum(shifted, nb);
+        double sum_sqr = SIMD::vec_dotprod_dp(shifted, shifted, nb);
+
+        bm.count = nb;
+        bm.mean = shift + sum / nb;
+        bm.m2 = std::max(0.0, sum_sqr - sum * sum / nb);
+
+        moments.merge(bm);
+    }
+}
+
+} // file scope
+
+void
+Moments::
+add(const float * values, size_t n)
+{
+    add_block(*this, values, n);
+}
+
+void
+Moments::
+add(const double * values, size_t n)
+{
+    add_block(*this, values, n);
+}
+
+void
+Moments::
+merge(const Moments & other)
+{
+    if (other.count == 0.0) return;
+    if (count == 0.0) {
+        *this = other;
+        return;
+    }
+
+    double total = count + other.count;
+    double delta = other.mean - mean;
+
+    mean += delta * other.count / total;
+    m2 += other.m2 + delta * delta * count * other.count / total;
+    count = total;
+    min_value = std::min(min_value, other.min_value);
+    max_value = std::max(max_value, other.max_value);
+}
+
+void
+Moments::
+serialize(DB::Store_Writer & store) const
+{
+    store << (char)1  // version
+          << count << mean << m2 << min_value << max_value;
+}
+
+void
+Moments::
+reconstitute(DB::Store_Reader & store)
+{
+    char version;
+    store >> version;
+    if (version != 1)
+        throw Exception("Moments::reconstitute(): unknown version");
+
+    store >> count >> mean >> m2 >> min_value >> max_value;
+}
+
+
+} // namespace ML
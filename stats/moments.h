@@ -25,6 +25,9 @@
 
 #include <limits>
 #include <cmath>
+#include <algorithm>
+#include <stddef.h>
+#include "jml/db/persistent_fwd.h"
 
 namespace ML {
 
@@ -64,6 +67,75 @@ double std_dev(Iterator first, Iterator last, double mean)
     return std::sqrt(total / (double)(count - 1));
 }
 
+
+/*****************************************************************************/
+/* MOMENTS                                                                   */
+/*****************************************************************************/
+
+/** Streaming mean, variance and range of a set of values, using Welford's
+    algorithm.  Two of them can be merged (with the formula of Chan, Golub
+    and LeVeque), so that each thread or shard can accumulate its own.
+    Weights are frequencies: adding a value with a weight of 2 is the same
+    as adding it twice.
+*/
+struct Moments {
+    Moments()
+        : count(0.0), mean(0.0), m2(0.0),
+          min_value(INFINITY), max_value(-INFINITY)
+    {
+    }
+
+    double count;       ///< Total weight of the values
+    double mean;        ///< Weighted mean of the values
+    double m2;          ///< Weighted sum of squared differences from the mean
+    double min_value;   ///< Lowest value (infinity if there are none)
+    double max_value;   ///< Highest value (-infinity if there are none)
+
+    void add(double value, double weight = 1.0)
+    {
+        if (weight == 0.0) return;
+        count += weight;
+        double delta = value - mean;
+        mean += delta * weight / count;
+        m2 += weight * delta * (value - mean);
+        min_value = std::min(min_value, value);
+        max_value = std::max(max_value, value);
+    }
+
+    /** Add n values, each with a weight of one.  The values are processed
+        in blocks with the SIMD functions, and each block is merged in. */
+    void add(const float * values, size_t n);
+    void add(const double * values, size_t n);
+
+    /** Add in the values of another set. */
+    void merge(const Moments & other);
+
+    /** Variance of the values (dividing by the count). */
+    double variance() const
+    {
+        if (count == 0.0) return std::numeric_limits<double>::quiet_NaN();
+        return m2 / count;
+    }
+
+    /** Unbiased estimate of the variance (dividing by the count - 1). */
+    double sample_variance() const
+    {
+        if (count <= 1.0) return std::numeric_limits<double>::quiet_NaN();
+        return m2 / (count - 1.0);
+    }
+
+    /** Standard deviation of the values (dividing by the count). */
+    double std_dev() const
+    {
+        return std::sqrt(variance());
+    }
+
+    void serialize(DB::Store_Writer & store) const;
+    void reconstitute(DB::Store_Reader & store);
+};
+
+IMPL_SERIALIZE_RECONSTITUTE(Moments);
+
 } // namespace ML
 
 
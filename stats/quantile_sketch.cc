@@ -0,0 +1,263 @@
+/* quantile_sketch.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Streaming quantile sketch.
+*/
+
+#include "quantile_sketch.h"
+#include "jml/arch/exception.h"
+#include "jml/db/persistent.h"
+#include "jml/db/compact_size_types.h"
+#include <algorithm>
+#include <cmath>
+
+
+using namespace std;
+
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* KLL_SKETCH                                                                */
+/*****************************************************************************/
+
+KLL_Sketch::
+KLL_Sketch(int k, uint64_t seed)
+    : k(k), n(0), size(0), max_size(0), rng_state(seed ? seed : 1),
+      min_(INFINITY), max_(-INFINITY), levels(1)
+{
+    if (k < 8)
+        throw Exception("KLL_Sketch: k must be at least 8");
+    update_sizes();
+}
+
+size_t
+KLL_Sketch::
+capacity(int level) const
+{
+    int depth = levels.size() - 1 - level;
+    return std::max<size_t>(2, ceil(k * pow(2.0 / 3.0, depth)));
+}
+
+void
+KLL_Sketch::
+update_sizes()
+{
+    size = max_size = 0;
+    for (unsigned h = 0;  h < levels.size();  ++h) {
+        size += levels[h].size();
+        max_size += capacity(h);
+    }
+}
+
+int
+KLL_Sketch::
+random_bit()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state >> 63;
+}
+
+void
+KLL_Sketch::
+compress()
+{
+    while (size >= max_size) {
+        // Lowest level that is full
+        unsigned h = 0;
+        while (levels[h].size() < capacity(h)) ++h;
+
+        if (h == levels.size() - 1) {
+            // Need a new level to promote into, which makes all of the
+            // others bigger
+            levels.push_back(vector<float>());
+            update_sizes();
+            if (size < max_size) break;
+        }
+
+        vector<float> & level = levels[h];
+        std::sort(level.begin(), level.end());
+
+        // An odd one out stays behind
+        size_t start = level.size() % 2;
+        int offset = random_bit();
+
+        vector<float> & up = levels[h + 1];
+        for (size_t i = start + offset;  i < level.size();  i += 2)
+            up.push_back(level[i]);
+
+        level.resize(start);
+
+        update_sizes();
+    }
+}
+
+void
+KLL_Sketch::
+add(float value)
+{
+    if (std::isnan(value))
+        throw Exception("KLL_Sketch::add(): NaN value");
+
+    levels[0].push_back(value);
+    ++n;
+    ++size;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+
+    if (size >= max_size) compress();
+}
+
+void
+KLL_Sketch::
+add(const float * values, size_t count)
+{
+    // Check them all first, so that nothing is added if one is bad
+    for (size_t i = 0;  i < count;  ++i)
+        if (std::isnan(values[i]))
+            throw Exception("KLL_Sketch::add(): NaN value");
+
+    while (count > 0) {
+        size_t nb = std::min<size_t>(count, max_size - size);
+
+        if (nb > 0) {
+            std::pair<const float *, const float *> range
+                = std::minmax_element(values, values + nb);
+            min_ = std::min(min_, *range.first);
+            max_ = std::max(max_, *range.second);
+        }
+
+        levels[0].insert(levels[0].end(), values, values + nb);
+        n += nb;
+        size += nb;
+        values += nb;
+        count -= nb;
+
+        compress();
+    }
+}
+
+void
+KLL_Sketch::
+merge(const KLL_Sketch & other)
+{
+    if (other.k != k)
+        throw Exception("KLL_Sketch::merge(): sketches have different k");
+
+    if (other.levels.size() > levels.size())
+        levels.resize(other.levels.size());
+
+    for (unsigned h = 0;  h < other.levels.size();  ++h)
+        levels[h].insert(levels[h].end(),
+                         other.levels[h].begin(), other.levels[h].end());
+
+    n += other.n;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+
+    update_sizes();
+    compress();
+}
+
+std::vector<std::pair<float, double> >
+KLL_Sketch::
+weighted_values() const
+{
+    vector<pair<float, double> > all;
+    all.reserve(size);
+    for (unsigned h = 0;  h < levels.size();  ++h) {
+        double weight = ldexp(1.0, h);
+        for (unsigned i = 0;  i < levels[h].size();  ++i)
+            all.push_back(make_pair(levels[h][i], weight));
+    }
+
+    std::sort(all.begin(), all.end());
+
+    vector<pair<float, double> > result;
+    for (unsigned i = 0;  i < all.size();  ++i) {
+        if (!result.empty() && result.back().first == all[i].first)
+            result.back().second += all[i].second;
+        else result.push_back(all[i]);
+    }
+
+    return result;
+}
+
+float
+KLL_Sketch::
+quantile(double q) const
+{
+    if (n == 0)
+        throw Exception("KLL_Sketch::quantile(): no values");
+    if (q <= 0.0) return min_;
+    if (q >= 1.0) return max_;
+
+    vector<pair<float, double> > values = weighted_values();
+
+    double target = q * n, total = 0.0;
+    for (unsigned i = 0;  i < values.size();  ++i) {
+        total += values[i].second;
+        if (total >= target) return values[i].first;
+    }
+
+    return max_;
+}
+
+double
+KLL_Sketch::
+rank(float value) const
+{
+    if (n == 0) return 0.0;
+
+    double total = 0.0;
+    for (unsigned h = 0;  h < levels.size();  ++h) {
+        double weight = ldexp(1.0, h);
+        for (unsigned i = 0;  i < levels[h].size();  ++i)
+            if (levels[h][i] <= value) total += weight;
+    }
+
+    return total / n;
+}
+
+void
+KLL_Sketch::
+serialize(DB::Store_Writer & store) const
+{
+    store << (char)1  // version
+          << DB::compact_size_t(k) << (unsigned long long)n
+          << (unsigned long long)rng_state << min_ << max_ << levels;
+}
+
+void
+KLL_Sketch::
+reconstitute(DB::Store_Reader & store)
+{
+    char version;
+    store >> version;
+    if (version != 1)
+        throw Exception("KLL_Sketch::reconstitute(): unknown version");
+
+    DB::compact_size_t new_k(store);
+    unsigned long long new_n, new_rng_state;
+    float new_min, new_max;
+    vector<vector<float> > new_levels;
+    store >> new_n >> new_rng_state >> new_min >> new_max >> new_levels;
+
+    if (new_levels.empty())
+        throw Exception("KLL_Sketch::reconstitute(): no levels");
+
+    k = new_k;
+    n = new_n;
+    rng_state = new_rng_state;
+    min_ = new_min;
+    max_ = new_max;
+    levels.swap(new_levels);
+    update_sizes();
+}
+
+
+} // namespace ML
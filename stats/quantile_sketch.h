@@ -0,0 +1,115 @@
+/* quantile_sketch.h                                               -*- C++ -*-
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Streaming quantile sketch.
+*/
+
+#ifndef __stats__quantile_sketch_h__
+#define __stats__quantile_sketch_h__
+
+
+#include "jml/db/persistent_fwd.h"
+#include <vector>
+#include <utility>
+#include <stdint.h>
+#include <stddef.h>
+
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* KLL_SKETCH                                                                */
+/*****************************************************************************/
+
+/** Approximate quantiles of a stream of values in O(k log(n / k)) memory,
+    using the sketch of
+
+    Z. Karnin, K. Lang, E. Liberty.  Optimal quantile approximation in
+    streams.  FOCS 2016.
+
+    The values are kept in a stack of compactors; each value at level h
+    stands for 2^h of the values that were added.  When a level is full it
+    is sorted and every other value (starting from a random one) is
+    promoted to the next level.  The error in the rank of a quantile is
+    about 1.7 / k of the count with high probability (about 1% for the
+    default k = 200), however many values are added.
+
+    Sketches with the same k can be merged, so that each thread or shard
+    can build its own.  The random choices come from a generator that is
+    part of the sketch, so the result only depends upon the seed and the
+    order in which values are added and merged.
+*/
+struct KLL_Sketch {
+    KLL_Sketch(int k = 200, uint64_t seed = 1);
+
+    /** Add a value.  NaN values aren't allowed. */
+    void add(float value);
+
+    /** Add n values.  The values are copied into the first level in
+        blocks, with a compaction between each.  If any of them is NaN,
+        none of them are added. */
+    void add(const float * values, size_t n);
+
+    /** Add in the values of the other sketch, which must have the same
+        k. */
+    void merge(const KLL_Sketch & other);
+
+    /** Number of values that have been added. */
+    uint64_t count() const { return n; }
+
+    /** Number of values retained in the sketch. */
+    size_t retained() const { return size; }
+
+    /** Smallest and largest values that were added (exactly). */
+    float min_value() const { return min_; }
+    float max_value() const { return max_; }
+
+    /** Approximate value with the given proportion (0 to 1) of the values
+        less than or equal to it. */
+    float quantile(double q) const;
+
+    /** Approximate proportion of the values that are less than or equal to
+        the given value. */
+    double rank(float value) const;
+
+    /** The retained values, sorted and with duplicates combined, each with
+        the number of added values that it stands for.  The weights add up
+        to count(). */
+    std::vector<std::pair<float, double> > weighted_values() const;
+
+    void serialize(DB::Store_Writer & store) const;
+    void reconstitute(DB::Store_Reader & store);
+
+    int k;
+
+private:
+    uint64_t n;                ///< Number of values added
+    size_t size;               ///< Number of values retained
+    size_t max_size;           ///< Total capacity of the levels
+    uint64_t rng_state;        ///< State of the random number generator
+    float min_, max_;
+    std::vector<std::vector<float> > levels;
+
+    /** Capacity of the given level; it shrinks geometrically below the
+        top level. */
+    size_t capacity(int level) const;
+
+    /** Recalculate size and max_size. */
+    void update_sizes();
+
+    /** Compact levels until the values fit in the sketch again. */
+    void compress();
+
+    /** Random bit, from a xorshift generator. */
+    int random_bit();
+};
+
+IMPL_SERIALIZE_RECONSTITUTE(KLL_Sketch);
+
+
+} // namespace ML
+
+
+#endif /* __stats__quantile_sketch_h__ */
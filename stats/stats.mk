@@ -1,10 +1,12 @@
 LIBSTATS_SOURCES := \
         distribution.cc \
-	auc.cc
+	auc.cc \
+	moments.cc \
+	quantile_sketch.cc
 
 $(eval $(call add_sources,$(LIBSTATS_SOURCES)))
 
-LIBSTATS_LINK :=	utils
+LIBSTATS_LINK :=	utils worker_task arch db
 
 $(eval $(call library,stats,$(LIBSTATS_SOURCES),$(LIBSTATS_LINK)))
 
@@ -12,9 +12,13 @@
 #include "jml/utils/environment.h"
 
 #include <boost/test/unit_test.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_01.hpp>
 #include <iostream>
+#include <cmath>
 
 #include "jml/stats/auc.h"
+#include "jml/utils/parallel_sort.h"
 
 using namespace ML;
 using namespace std;
@@ -24,3 +28,199 @@ using boost::unit_test::test_suite;
 BOOST_AUTO_TEST_CASE( test1 )
 {
 }
+
+namespace {
+
+/* Entries whose outputs take only 101 different values, so that there are
+   lots of ties, and which are positive more often for higher outputs. */
+vector<AUC_Entry> random_entries(int n, boost::mt19937 & rng)
+{
+    boost::uniform_01<boost::mt19937 &> rand01(rng);
+
+    vector<AUC_Entry> result;
+    for (unsigned i = 0;  i < n;  ++i) {
+        float model = round(rand01() * 100) / 100.0;
+        bool target = rand01() < 0.2 + 0.6 * model;
+        float weight = (i % 10 == 0 ? 0.0 : 1.0 + rand01());
+        result.push_back(AUC_Entry(model, target, weight));
+    }
+    return result;
+}
+
+/* Probability that a positive entry ranks above a negative one, by
+   comparing every pair of distinct outputs.  If weighted is false then all
+   entries with a non-zero weight count as one. */
+double brute_force_auc(const vector<AUC_Entry> & entries, bool weighted)
+{
+    double pos[101] = { 0 }, neg[101] = { 0 };
+    for (unsigned i = 0;  i < entries.size();  ++i) {
+        if (entries[i].weight == 0.0) continue;
+        int v = round(entries[i].model * 100);
+        double w = (weighted ? entries[i].weight : 1.0);
+        if (entries[i].target) pos[v] += w;
+        else neg[v] += w;
+    }
+
+    double correct = 0.0, total_pos = 0.0, total_neg = 0.0;
+    for (unsigned i = 0;  i <= 100;  ++i) {
+        total_pos += pos[i];
+        total_neg += neg[i];
+        for (unsigned j = 0;  j <= 100;  ++j) {
+            if (i > j) correct += pos[i] * neg[j];
+            else if (i == j) correct += 0.5 * pos[i] * neg[j];
+        }
+    }
+
+    return correct / (total_pos * total_neg);
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_exact_auc )
+{
+    vector<AUC_Entry> perfect;
+    perfect.push_back(AUC_Entry(0.1, false));
+    perfect.push_back(AUC_Entry(0.9, true));
+    perfect.push_back(AUC_Entry(0.5, false, 0.0));  // doesn't count
+    BOOST_CHECK_EQUAL(do_calc_auc(perfect), 0.0);
+
+    boost::mt19937 rng;
+    vector<AUC_Entry> entries = random_entries(200000, rng);
+    double expected = brute_force_auc(entries, false);
+
+    // The result doesn't depend upon the order of the entries
+    double auc1 = 1.0 - do_calc_auc(entries);
+    std::reverse(entries.begin(), entries.end());
+    double auc2 = 1.0 - do_calc_auc(entries);
+
+    BOOST_CHECK_CLOSE(auc1, expected, 1e-8);
+    BOOST_CHECK_EQUAL(auc1, auc2);
+}
+
+BOOST_AUTO_TEST_CASE( test_parallel_sort )
+{
+    boost::mt19937 rng;
+    boost::uniform_01<boost::mt19937 &> rand01(rng);
+
+    // Sizes that don't divide evenly, including more blocks than elements
+    // in some runs
+    int sizes[5] = { 0, 1, 100, 9999, 300001 };
+    for (unsigned s = 0;  s < 5;  ++s) {
+        vector<int> v;
+        for (unsigned i = 0;  i < sizes[s];  ++i)
+            v.push_back(rand01() * 1000);
+
+        vector<int> expected = v;
+        std::sort(expected.begin(), expected.end());
+
+        for (int blocks = 1;  blocks <= 9;  blocks += 2) {
+            vector<int> sorted = v;
+            parallel_sort(sorted, std::less<int>(), blocks, 1);
+            BOOST_CHECK(sorted == expected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_auc_histogram )
+{
+    boost::mt19937 rng;
+    vector<AUC_Entry> entries = random_entries(100000, rng);
+    double expected = brute_force_auc(entries, true);
+
+    // Each of the values is in its own bucket, so it's exact
+    AUC_Histogram exact(-0.005, 1.005, 101);
+    for (unsigned i = 0;  i < entries.size();  ++i)
+        exact.add(entries[i].model, entries[i].target, entries[i].weight);
+    BOOST_CHECK_CLOSE(exact.auc(), expected, 1e-8);
+
+    // With fewer buckets than values there is an error, but it's within
+    // the bound.  Split over shards and merged, the result is the same.
+    AUC_Histogram whole(0.0, 1.0, 10);
+    vector<AUC_Histogram> shards(7, AUC_Histogram(0.0, 1.0, 10));
+    for (unsigned i = 0;  i < entries.size();  ++i) {
+        whole.add(entries[i].model, entries[i].target, entries[i].weight);
+        shards[i % 7].add(entries[i].model, entries[i].target,
+                          entries[i].weight);
+    }
+
+    AUC_Histogram merged(0.0, 1.0, 10);
+    for (unsigned i = 0;  i < shards.size();  ++i)
+        merged.merge(shards[i]);
+
+    BOOST_CHECK_CLOSE(merged.auc(), whole.auc(), 1e-8);
+    BOOST_CHECK_CLOSE(merged.error_bound(), whole.error_bound(), 1e-8);
+
+    cerr << "histogram auc " << whole.auc() << " exact " << expected
+         << " bound " << whole.error_bound() << endl;
+    BOOST_CHECK(whole.error_bound() > 0.0);
+    BOOST_CHECK(abs(whole.auc() - expected) <= whole.error_bound());
+
+    BOOST_CHECK_THROW(merged.merge(AUC_Histogram(0.0, 1.0, 11)), Exception);
+}
+
+BOOST_AUTO_TEST_CASE( test_precision_at_k )
+{
+    boost::mt19937 rng;
+    vector<AUC_Entry> entries = random_entries(10000, rng);
+
+    // Break the ties so that the top k are well defined
+    for (unsigned i = 0;  i < entries.size();  ++i)
+        entries[i].model += i * 1e-7;
+
+    int k = 500;
+
+    vector<AUC_Entry> sorted;
+    for (unsigned i = 0;  i < entries.size();  ++i)
+        if (entries[i].weight != 0.0) sorted.push_back(entries[i]);
+    std::sort(sorted.begin(), sorted.end());
+    std::reverse(sorted.begin(), sorted.end());
+
+    double correct = 0.0, total = 0.0;
+    for (unsigned i = 0;  i < k;  ++i) {
+        if (sorted[i].target) correct += sorted[i].weight;
+        total += sorted[i].weight;
+    }
+
+    Precision_At_K whole(k);
+    vector<Precision_At_K> shards(3, Precision_At_K(k));
+    for (unsigned i = 0;  i < entries.size();  ++i) {
+        whole.add(entries[i].model, entries[i].target, entries[i].weight);
+        shards[i % 3].add(entries[i].model, entries[i].target,
+                          entries[i].weight);
+    }
+
+    Precision_At_K merged(k);
+    for (unsigned i = 0;  i < shards.size();  ++i)
+        merged.merge(shards[i]);
+
+    BOOST_CHECK_EQUAL(whole.top.size(), k);
+    BOOST_CHECK_CLOSE(whole.precision(), correct / total, 1e-8);
+    BOOST_CHECK_CLOSE(merged.precision(), correct / total, 1e-8);
+
+    // At the boundary, ties are broken against the positive entries
+    Precision_At_K ties(2);
+    ties.add(0.9, true);
+    ties.add(0.5, true);
+    ties.add(0.5, false);
+    BOOST_CHECK_EQUAL(ties.precision(), 0.5);
+}
+
+BOOST_AUTO_TEST_CASE( test_log_loss )
+{
+    Log_Loss loss1, loss2;
+    loss1.add(0.8, true);
+    loss1.add(0.4, false, 2.0);
+    loss2.add(0.1, true);
+    loss2.add(1.0, false);   // bounded; finite
+
+    Log_Loss merged;
+    merged.merge(loss1);
+    merged.merge(loss2);
+
+    double expected1 = -(log(0.8) + 2.0 * log(0.6)) / 3.0;
+    BOOST_CHECK_CLOSE(loss1.loss(), expected1, 1e-4);
+
+    BOOST_CHECK_EQUAL(merged.total_weight, 5.0);
+    BOOST_CHECK(std::isfinite(merged.loss()));
+    BOOST_CHECK(merged.loss() > loss1.loss());
+}
@@ -0,0 +1,77 @@
+/* distribution_expr_test.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Test for the lazily evaluated distribution expressions.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_01.hpp>
+#include <iostream>
+
+#include "jml/stats/distribution_expr.h"
+
+using namespace ML;
+using namespace std;
+
+using boost::unit_test::test_suite;
+
+template<typename F>
+distribution<F> random_dist(size_t n, boost::uniform_01<boost::mt19937> & rng)
+{
+    distribution<F> result(n);
+    for (unsigned i = 0;  i < n;  ++i)
+        result[i] = rng() + 0.5;
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE( test_distribution_expr )
+{
+    boost::mt19937 mt;
+    boost::uniform_01<boost::mt19937> rng(mt);
+
+    // Not a multiple of the block size
+    size_t n = 1000;
+
+    distribution<float> a = random_dist<float>(n, rng);
+    distribution<float> b = random_dist<float>(n, rng);
+    distribution<float> c = random_dist<float>(n, rng);
+    distribution<double> d = random_dist<double>(n, rng);
+
+    distribution<float> r1 = lazy(a) * b * c;
+    BOOST_CHECK(equivalent(r1, a * b * c));
+
+    distribution<float> r2 = (lazy(a) + b) / (lazy(c) - 2.0) * 3.0f;
+    distribution<float> e2 = (a + b) / (c - 2.0f) * 3.0f;
+    BOOST_CHECK_EQUAL(r2.size(), n);
+    for (unsigned i = 0;  i < n;  ++i)
+        BOOST_CHECK_CLOSE(r2[i], e2[i], 1e-4);
+
+    // Mixed types take the type of the left hand side
+    distribution<double> r3 = lazy(d) * a - 1.0;
+    for (unsigned i = 0;  i < n;  ++i)
+        BOOST_CHECK_EQUAL(r3[i], d[i] * a[i] - 1.0);
+
+    distribution<float> r4 = 1.0f - lazy(a) * d;
+    for (unsigned i = 0;  i < n;  ++i)
+        BOOST_CHECK_EQUAL(r4[i], 1.0f - (float)(a[i] * d[i]));
+
+    // Element access without evaluation
+    BOOST_CHECK_EQUAL((lazy(a) * b)[7], a[7] * b[7]);
+
+    // Assigning to one of the operands
+    distribution<float> r5 = a;
+    r5 = lazy(b) * r5 + r5;
+    for (unsigned i = 0;  i < n;  ++i)
+        BOOST_CHECK_EQUAL(r5[i], b[i] * a[i] + a[i]);
+
+    distribution<float> empty1, empty2;
+    BOOST_CHECK_EQUAL((lazy(empty1) * empty2).eval().size(), 0);
+
+    distribution<float> shorter(n - 1);
+    BOOST_CHECK_THROW(lazy(a) * shorter, ML::Exception);
+}
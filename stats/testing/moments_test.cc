@@ -0,0 +1,155 @@
+/* moments_test.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Test for the streaming moments and quantile sketch.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_01.hpp>
+#include <iostream>
+#include <sstream>
+#include <cmath>
+
+#include "jml/stats/moments.h"
+#include "jml/stats/quantile_sketch.h"
+#include "jml/db/persistent.h"
+
+using namespace ML;
+using namespace std;
+
+using boost::unit_test::test_suite;
+
+BOOST_AUTO_TEST_CASE( test_moments )
+{
+    boost::mt19937 rng;
+    boost::uniform_01<boost::mt19937> uniform(rng);
+
+    // Large offset compared to the spread, to check the precision
+    vector<double> values;
+    for (unsigned i = 0;  i < 10000;  ++i)
+        values.push_back(1e8 + uniform());
+
+    double mean = 0.0;
+    for (unsigned i = 0;  i < values.size();  ++i)
+        mean += values[i];
+    mean /= values.size();
+
+    double var = 0.0;
+    for (unsigned i = 0;  i < values.size();  ++i)
+        var += (values[i] - mean) * (values[i] - mean);
+    var /= values.size();
+
+    Moments scalar, batch, merged, part;
+    for (unsigned i = 0;  i < values.size();  ++i)
+        scalar.add(values[i]);
+
+    batch.add(&values[0], values.size());
+
+    merged.add(&values[0], 3000);
+    part.add(&values[3000], values.size() - 3000);
+    merged.merge(part);
+
+    Moments * all[3] = { &scalar, &batch, &merged };
+    for (unsigned i = 0;  i < 3;  ++i) {
+        BOOST_CHECK_EQUAL(all[i]->count, values.size());
+        BOOST_CHECK_CLOSE(all[i]->mean, mean, 1e-10);
+        BOOST_CHECK_CLOSE(all[i]->variance(), var, 1e-6);
+        BOOST_CHECK_EQUAL(all[i]->min_value,
+                          *std::min_element(values.begin(), values.end()));
+        BOOST_CHECK_EQUAL(all[i]->max_value,
+                          *std::max_element(values.begin(), values.end()));
+    }
+
+    ostringstream stream_out;
+    {
+        DB::Store_Writer writer(stream_out);
+        writer << batch;
+    }
+
+    istringstream stream_in(stream_out.str());
+    DB::Store_Reader reader(stream_in);
+    Moments reconstituted;
+    reader >> reconstituted;
+
+    BOOST_CHECK_EQUAL(reconstituted.count, batch.count);
+    BOOST_CHECK_EQUAL(reconstituted.mean, batch.mean);
+    BOOST_CHECK_EQUAL(reconstituted.m2, batch.m2);
+}
+
+BOOST_AUTO_TEST_CASE( test_kll_sketch )
+{
+    boost::mt19937 rng;
+    boost::uniform_01<boost::mt19937> uniform(rng);
+
+    size_t n = 1000000;
+    vector<float> values;
+    for (unsigned i = 0;  i < n;  ++i)
+        values.push_back(uniform());
+
+    KLL_Sketch sketch(200, 1), shard1(200, 2), shard2(200, 3);
+    sketch.add(&values[0], n);
+    shard1.add(&values[0], n / 3);
+    for (unsigned i = n / 3;  i < n;  ++i)
+        shard2.add(values[i]);
+    shard1.merge(shard2);
+
+    BOOST_CHECK_EQUAL(sketch.count(), n);
+    BOOST_CHECK_EQUAL(shard1.count(), n);
+    BOOST_CHECK_LT(sketch.retained(), 1000);
+
+    vector<float> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+
+    KLL_Sketch * sketches[2] = { &sketch, &shard1 };
+    for (unsigned s = 0;  s < 2;  ++s) {
+        for (double q = 0.1;  q < 0.95;  q += 0.1) {
+            float v = sketches[s]->quantile(q);
+            double true_rank
+                = (std::upper_bound(sorted.begin(), sorted.end(), v)
+                   - sorted.begin()) / (double)n;
+            BOOST_CHECK_SMALL(true_rank - q, 0.02);
+            BOOST_CHECK_SMALL(sketches[s]->rank(sorted[q * n]) - q, 0.02);
+        }
+
+        BOOST_CHECK_EQUAL(sketches[s]->min_value(), sorted.front());
+        BOOST_CHECK_EQUAL(sketches[s]->max_value(), sorted.back());
+
+        vector<pair<float, double> > weighted
+            = sketches[s]->weighted_values();
+        double total = 0.0;
+        for (unsigned i = 0;  i < weighted.size();  ++i)
+            total += weighted[i].second;
+        BOOST_CHECK_EQUAL(total, n);
+    }
+
+    ostringstream stream_out;
+    {
+        DB::Store_Writer writer(stream_out);
+        writer << sketch;
+    }
+
+    istringstream stream_in(stream_out.str());
+    DB::Store_Reader reader(stream_in);
+    KLL_Sketch reconstituted;
+    reader >> reconstituted;
+
+    BOOST_CHECK_EQUAL(reconstituted.count(), sketch.count());
+    BOOST_CHECK_EQUAL(reconstituted.retained(), sketch.retained());
+    BOOST_CHECK_EQUAL(reconstituted.quantile(0.5), sketch.quantile(0.5));
+
+    KLL_Sketch other_k(100);
+    BOOST_CHECK_THROW(sketch.merge(other_k), ML::Exception);
+    BOOST_CHECK_THROW(sketch.add(NAN), ML::Exception);
+
+    // A NaN in a later block leaves the sketch untouched
+    vector<float> with_nan = values;
+    with_nan.back() = NAN;
+    KLL_Sketch empty(200);
+    BOOST_CHECK_THROW(empty.add(&with_nan[0], n), ML::Exception);
+    BOOST_CHECK_EQUAL(empty.count(), 0);
+}
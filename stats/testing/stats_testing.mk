@@ -7,3 +7,5 @@
 $(eval $(call test,auc_test,stats arch,boost))
 $(eval $(call test,rmse_test,stats arch,boost))
 
+$(eval $(call test,moments_test,stats arch db,boost))
+$(eval $(call test,distribution_expr_test,stats arch,boost))
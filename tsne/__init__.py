@@ -9,6 +9,9 @@ def distances_to_probabilities(array, tolerance=1e-5, perplexity=30.0):
 def tsne_core(array, num_dims=2, **kwargs):
     return _tsne.tsne(array, num_dims, **kwargs)
 
+def tsne_sparse_core(X, num_dims=2, perplexity=30.0, **kwargs):
+    return _tsne.tsne_sparse(X, num_dims, perplexity, **kwargs)
+
 def pca(X, no_dims = 50):
     """Runs PCA on the NxD array X in order to reduce its dimensionality to no_dims dimensions."""
     
@@ -28,12 +31,15 @@ def pca(X, no_dims = 50):
 
 
 def tsne(X, num_dims = 2, initial_dims = 50, perplexity = 30.0, use_pca=True,
-         **kwargs):
+         barnes_hut=False, **kwargs):
     
     if use_pca:
         X = pca(X, initial_dims);
     (n, d) = X.shape;
 
+    if barnes_hut:
+        return tsne_sparse_core(X, num_dims, perplexity, **kwargs)
+
     D = vectors_to_distances(X)
 
     P = distances_to_probabilities(D, perplexity=perplexity)
@@ -21,6 +21,9 @@
 #include "jml/utils/parse_context.h"
 #include "jml/utils/filter_streams.h"
 #include "jml/utils/environment.h"
+#include <boost/random/normal_distribution.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/variate_generator.hpp>
 
 using namespace ML;
 using namespace std;
@@ -280,3 +283,227 @@ BOOST_AUTO_TEST_CASE( test_distance_to_probability_big )
     boost::multi_array<float, 2> reduction JML_UNUSED
         = tsne(probabilities, 2);
 }
+
+BOOST_AUTO_TEST_CASE( test_barnes_hut )
+{
+    // Three well separated gaussian clusters in 10 dimensions
+    int nc = 3, npc = 50, nd = 10;
+    int nx = nc * npc;
+
+    boost::mt19937 rng;
+    boost::normal_distribution<float> norm;
+    boost::variate_generator<boost::mt19937,
+                             boost::normal_distribution<float> >
+        randn(rng, norm);
+
+    boost::multi_array<float, 2> data(boost::extents[nx][nd]);
+    for (unsigned i = 0;  i < nx;  ++i)
+        for (unsigned j = 0;  j < nd;  ++j)
+            data[i][j] = randn() + (j == i / npc ? 20.0 : 0.0);
+
+    boost::multi_array<float, 2> distances
+        = vectors_to_distances(data);
+    boost::multi_array<float, 2> probabilities
+        = distances_to_probabilities(distances, 1e-5, 10.0);
+
+    TSNE_Sparse_Probs sparse = sparsify_probabilities(probabilities, 1e-6);
+    sparse.validate();
+    BOOST_CHECK_EQUAL(sparse.n, nx);
+    BOOST_CHECK(sparse.nnz() < nx * (nx - 1));
+
+    TSNE_Params params;
+    params.max_iter = 300;
+    params.theta = 0.5;
+    params.eta = 100;  // the default is too aggressive for so few points
+
+    boost::multi_array<float, 2> Y = tsne(sparse, 2, params);
+
+    BOOST_REQUIRE_EQUAL(Y.shape()[0], nx);
+    BOOST_REQUIRE_EQUAL(Y.shape()[1], 2);
+
+    // Points should be much closer to their own cluster than to the others
+    double within = 0.0, between = 0.0;
+    int nwithin = 0, nbetween = 0;
+    for (unsigned i = 0;  i < nx;  ++i) {
+        for (unsigned j = 0;  j < i;  ++j) {
+            double D = sqr(Y[i][0] - Y[j][0]) + sqr(Y[i][1] - Y[j][1]);
+            BOOST_REQUIRE(finite(D));
+            if (i / npc == j / npc) {
+                within += sqrt(D);
+                ++nwithin;
+            }
+            else {
+                between += sqrt(D);
+                ++nbetween;
+            }
+        }
+    }
+
+    within /= nwithin;
+    between /= nbetween;
+
+    cerr << "within " << within << " between " << between << endl;
+    BOOST_CHECK(between > 3.0 * within);
+
+    // Only low dimensional embeddings are supported
+    BOOST_CHECK_THROW(tsne(sparse, 4, params), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE( test_sparse_probabilities )
+{
+    int nx = 200, nd = 5;
+
+    boost::mt19937 rng;
+    boost::normal_distribution<float> norm;
+    boost::variate_generator<boost::mt19937,
+                             boost::normal_distribution<float> >
+        randn(rng, norm);
+
+    boost::multi_array<float, 2> data(boost::extents[nx][nd]);
+    for (unsigned i = 0;  i < nx;  ++i)
+        for (unsigned j = 0;  j < nd;  ++j)
+            data[i][j] = randn();
+
+    // With all of the points as neighbours, it should be the same as the
+    // dense version
+    boost::multi_array<float, 2> distances
+        = vectors_to_distances(data);
+    boost::multi_array<float, 2> probabilities
+        = distances_to_probabilities(distances, 1e-5, 10.0);
+
+    TSNE_Sparse_Probs all
+        = vectors_to_sparse_probabilities(data, 1e-5, 10.0, nx - 1);
+    all.validate();
+    BOOST_CHECK_EQUAL(all.nnz(), nx * (nx - 1));
+
+    for (unsigned i = 0;  i < nx;  ++i) {
+        for (size_t k = all.row_start[i];  k < all.row_start[i + 1];  ++k) {
+            int j = all.col[k];
+            float expected
+                = (probabilities[i][j] + probabilities[j][i]) / (2 * nx);
+            BOOST_CHECK_SMALL(all.val[k] - expected, 1e-6f);
+        }
+    }
+
+    // With the default number of neighbours, it's symmetric, sparse and
+    // still sums to one
+    TSNE_Sparse_Probs P = vectors_to_sparse_probabilities(data, 1e-5, 10.0);
+    P.validate();
+    BOOST_CHECK(P.nnz() <= 2 * 30 * nx);
+    BOOST_CHECK(P.nnz() >= 30 * nx);
+
+    double total = 0.0;
+    for (unsigned i = 0;  i < nx;  ++i) {
+        for (size_t k = P.row_start[i];  k < P.row_start[i + 1];  ++k) {
+            int j = P.col[k];
+            BOOST_CHECK(j != i);
+            total += P.val[k];
+
+            const int * row = &P.col[P.row_start[j]];
+            const int * row_end = &P.col[0] + P.row_start[j + 1];
+            const int * it = std::lower_bound(row, row_end, (int)i);
+            BOOST_REQUIRE(it != row_end && *it == i);
+            BOOST_CHECK_EQUAL(P.val[k], P.val[it - &P.col[0]]);
+        }
+    }
+
+    BOOST_CHECK_CLOSE(total, 1.0, 1e-3);
+
+    // The nearest neighbour of each point is always included
+    for (unsigned i = 0;  i < nx;  ++i) {
+        int best = -1;
+        for (unsigned j = 0;  j < nx;  ++j)
+            if (j != i && (best == -1 || distances[i][j] < distances[i][best]))
+                best = j;
+        BOOST_CHECK(std::binary_search(&P.col[0] + P.row_start[i],
+                                       &P.col[0] + P.row_start[i + 1],
+                                       best));
+    }
+
+    // Far apart points used to underflow the perplexity search; as only
+    // relative distances matter, scaling the data gives the same result
+    boost::multi_array<float, 2> scaled(boost::extents[nx][nd]);
+    for (unsigned i = 0;  i < nx;  ++i)
+        for (unsigned j = 0;  j < nd;  ++j)
+            scaled[i][j] = data[i][j] * 100.0;
+
+    TSNE_Sparse_Probs P2 = vectors_to_sparse_probabilities(scaled, 1e-5, 10.0);
+    P2.validate();
+    BOOST_REQUIRE(P2.col == P.col);
+    for (unsigned k = 0;  k < P.nnz();  ++k)
+        BOOST_CHECK_SMALL(P2.val[k] - P.val[k], 1e-6f);
+}
+
+BOOST_AUTO_TEST_CASE( test_embed_new )
+{
+    // Three well separated gaussian clusters in 10 dimensions
+    int nc = 3, npc = 60, nd = 10;
+    int nx = nc * npc;
+    int nnew = 15;
+
+    boost::mt19937 rng;
+    boost::normal_distribution<float> norm;
+    boost::variate_generator<boost::mt19937,
+                             boost::normal_distribution<float> >
+        randn(rng, norm);
+
+    boost::multi_array<float, 2> data(boost::extents[nx][nd]);
+    for (unsigned i = 0;  i < nx;  ++i)
+        for (unsigned j = 0;  j < nd;  ++j)
+            data[i][j] = randn() + (j == i % nc ? 20.0 : 0.0);
+
+    boost::multi_array<float, 2> data_new(boost::extents[nnew][nd]);
+    for (unsigned i = 0;  i < nnew;  ++i)
+        for (unsigned j = 0;  j < nd;  ++j)
+            data_new[i][j] = randn() + (j == i % nc ? 20.0 : 0.0);
+
+    TSNE_Params params;
+    params.max_iter = 300;
+    params.eta = 100;
+
+    boost::multi_array<float, 2> Y
+        = tsne(vectors_to_sparse_probabilities(data, 1e-5, 10.0), 2, params);
+
+    boost::multi_array<float, 2> centroids(boost::extents[nc][2]);
+    for (unsigned i = 0;  i < nx;  ++i)
+        for (unsigned j = 0;  j < 2;  ++j)
+            centroids[i % nc][j] += Y[i][j] / npc;
+
+    params.max_iter = 100;
+    boost::multi_array<float, 2> Y_new
+        = tsne_embed_new(data, Y, data_new, 10.0, params);
+
+    BOOST_REQUIRE_EQUAL(Y_new.shape()[0], nnew);
+    BOOST_REQUIRE_EQUAL(Y_new.shape()[1], 2);
+
+    // Each new point should end up closest to the centroid of its cluster
+    for (unsigned i = 0;  i < nnew;  ++i) {
+        int best = -1;
+        float best_dist = INFINITY;
+        for (unsigned c = 0;  c < nc;  ++c) {
+            float dist = sqr(Y_new[i][0] - centroids[c][0])
+                + sqr(Y_new[i][1] - centroids[c][1]);
+            BOOST_REQUIRE(finite(dist));
+            if (dist < best_dist) {
+                best = c;
+                best_dist = dist;
+            }
+        }
+        BOOST_CHECK_EQUAL(best, i % nc);
+    }
+
+    // Re-embedding the existing points should put them about where they
+    // were, relative to the size of the clusters
+    boost::multi_array<float, 2> Y_same
+        = tsne_embed_new(data, Y, data, 10.0, params);
+    double total_moved = 0.0, total_spread = 0.0;
+    for (unsigned i = 0;  i < nx;  ++i) {
+        total_moved += sqrt(sqr(Y_same[i][0] - Y[i][0])
+                            + sqr(Y_same[i][1] - Y[i][1]));
+        total_spread += sqrt(sqr(Y[i][0] - centroids[i % nc][0])
+                             + sqr(Y[i][1] - centroids[i % nc][1]));
+    }
+    cerr << "mean movement " << total_moved / nx
+         << " mean spread " << total_spread / nx << endl;
+    BOOST_CHECK(total_moved < 0.5 * total_spread);
+}
@@ -13,6 +13,7 @@
 #include "jml/arch/simd_vector.h"
 #include <boost/tuple/tuple.hpp>
 #include "jml/algebra/lapack.h"
+#include "jml/algebra/randomized_svd.h"
 #include <cmath>
 #include <boost/random/normal_distribution.hpp>
 #include <boost/random/mersenne_twister.hpp>
@@ -26,6 +27,8 @@
 #include "jml/utils/guard.h"
 #include <boost/bind.hpp>
 #include "jml/utils/environment.h"
+#include <algorithm>
+#include <queue>
 
 using namespace std;
 
@@ -437,6 +440,14 @@ pca(boost::multi_array<float, 2> & coords, int num_dims)
 
     if (ndr < num_dims)
         throw Exception("svd_reduction: num_dims not low enough");
+
+    // When we only want a few of the components, the randomized algorithm
+    // is much faster on big matrices
+    if (4 * (num_dims + 10) < nvalues) {
+        Randomized_SVD_Params params;
+        params.power_iterations = 4;
+        return randomized_svd(coords, num_dims, params).get<1>();
+    }
         
     distribution<float> svalues(nvalues);
     boost::multi_array<float, 2> lvectorsT(boost::extents[nvalues][nd]);
@@ -1173,4 +1184,1053 @@ tsne(const boost::multi_array<float, 2> & probs,
     return Y;
 }
 
+/*****************************************************************************/
+/* SPARSE (BARNES-HUT) T-SNE                                                 */
+/*****************************************************************************/
+
+void
+TSNE_Sparse_Probs::
+validate() const
+{
+    if (n < 0)
+        throw Exception("TSNE_Sparse_Probs: negative size");
+    if (row_start.size() != n + 1)
+        throw Exception("TSNE_Sparse_Probs: row_start has wrong size");
+    if (row_start[0] != 0 || row_start[n] != col.size())
+        throw Exception("TSNE_Sparse_Probs: row_start doesn't match entries");
+    if (val.size() != col.size())
+        throw Exception("TSNE_Sparse_Probs: col and val sizes don't match");
+    for (unsigned i = 0;  i < n;  ++i)
+        if (row_start[i + 1] < row_start[i])
+            throw Exception("TSNE_Sparse_Probs: row_start not increasing");
+    for (unsigned k = 0;  k < col.size();  ++k)
+        if (col[k] < 0 || col[k] >= n)
+            throw Exception("TSNE_Sparse_Probs: column out of range");
+}
+
+TSNE_Sparse_Probs
+sparsify_probabilities(const boost::multi_array<float, 2> & probs,
+                       float min_prob)
+{
+    int n = probs.shape()[0];
+    if (n != probs.shape()[1])
+        throw Exception("probabilities were the wrong shape");
+
+    TSNE_Sparse_Probs result;
+    result.n = n;
+    result.row_start.reserve(n + 1);
+    result.row_start.push_back(0);
+
+    for (unsigned i = 0;  i < n;  ++i) {
+        for (unsigned j = 0;  j < n;  ++j) {
+            if (i == j || probs[i][j] <= min_prob) continue;
+            result.col.push_back(j);
+            result.val.push_back(probs[i][j]);
+        }
+        result.row_start.push_back(result.col.size());
+    }
+
+    return result;
+}
+
+namespace {
+
+/** Run fn(i0, i1) over chunks of [0, n) in parallel, returning once they are
+    all finished. */
+void run_in_chunks(int n, int chunk_size,
+                   const boost::function<void (int, int)> & fn)
+{
+    Worker_Task & worker = Worker_Task::instance(num_threads() - 1);
+
+    int group;
+    {
+        int parent = -1;  // no parent group
+        group = worker.get_group(NO_JOB, "", parent);
+        Call_Guard guard(boost::bind(&Worker_Task::unlock_group,
+                                     boost::ref(worker),
+                                     group));
+        
+        for (int i = 0;  i < n;  i += chunk_size) {
+            int i0 = i;
+            int i1 = min(n, i + chunk_size);
+            worker.add(boost::bind(fn, i0, i1), "", group);
+        }
+    }
+
+    worker.run_until_finished(group);
+}
+
+/** Return P + P^T, with the entries of each row sorted by column and
+    duplicates merged. */
+TSNE_Sparse_Probs
+symmetrize(const TSNE_Sparse_Probs & P)
+{
+    int n = P.n;
+
+    // Transpose via a counting sort.  Rows of the transpose come out
+    // sorted by column as we scan the rows of P in order.
+    vector<size_t> tstart(n + 1, 0);
+    for (unsigned k = 0;  k < P.nnz();  ++k)
+        ++tstart[P.col[k] + 1];
+    for (unsigned i = 0;  i < n;  ++i)
+        tstart[i + 1] += tstart[i];
+
+    vector<int> tcol(P.nnz());
+    vector<float> tval(P.nnz());
+    {
+        vector<size_t> pos(tstart.begin(), tstart.end() - 1);
+        for (unsigned i = 0;  i < n;  ++i) {
+            for (size_t k = P.row_start[i];  k < P.row_start[i + 1];  ++k) {
+                size_t p = pos[P.col[k]]++;
+                tcol[p] = i;
+                tval[p] = P.val[k];
+            }
+        }
+    }
+
+    TSNE_Sparse_Probs result;
+    result.n = n;
+    result.row_start.reserve(n + 1);
+    result.row_start.push_back(0);
+    result.col.reserve(P.nnz() * 2);
+    result.val.reserve(P.nnz() * 2);
+
+    vector<pair<int, float> > row;
+
+    for (unsigned i = 0;  i < n;  ++i) {
+        row.clear();
+        for (size_t k = P.row_start[i];  k < P.row_start[i + 1];  ++k)
+            row.push_back(make_pair(P.col[k], P.val[k]));
+        std::sort(row.begin(), row.end());
+
+        // Merge with the (already sorted) row of the transpose
+        size_t a = 0, b = tstart[i], be = tstart[i + 1];
+        while (a < row.size() || b < be) {
+            int j;
+            float v = 0.0;
+            if (b == be || (a < row.size() && row[a].first < tcol[b]))
+                j = row[a].first;
+            else j = tcol[b];
+            while (a < row.size() && row[a].first == j)
+                v += row[a++].second;
+            while (b < be && tcol[b] == j)
+                v += tval[b++];
+            if (j == i) continue;  // no self-affinity
+            result.col.push_back(j);
+            result.val.push_back(v);
+        }
+
+        result.row_start.push_back(result.col.size());
+    }
+
+    return result;
+}
+
+/** Space partitioning tree over a set of points in 1 to 3 dimensions (a
+    quadtree in 2 dimensions and an octree in 3) which knows the centre of
+    mass and number of points in each cell.  Used to approximate the
+    repulsive forces in Barnes-Hut t-SNE.
+*/
+struct SP_Tree {
+
+    enum { MAX_DIMS = 3 };
+
+    struct Node {
+        float center[MAX_DIMS];  ///< Centre of the cell
+        float com[MAX_DIMS];     ///< Centre of mass of the points within
+        float half_width;        ///< Half the width of the (cubic) cell
+        int count;               ///< Number of points within the cell
+        int first_child;         ///< First of 2^d children, or -1 for a leaf
+        int point;               ///< For a leaf, a point within it or -1
+    };
+
+    SP_Tree(const boost::multi_array<float, 2> & Y, int n)
+        : Y(Y), d(Y.shape()[1]), nchildren(1 << d)
+    {
+        if (d < 1 || d > MAX_DIMS)
+            throw Exception("Barnes-Hut t-SNE only supports 1 to 3 "
+                            "dimensions");
+
+        float mins[MAX_DIMS], maxs[MAX_DIMS];
+        for (unsigned k = 0;  k < d;  ++k) {
+            mins[k] = INFINITY;
+            maxs[k] = -INFINITY;
+        }
+        for (unsigned i = 0;  i < n;  ++i) {
+            for (unsigned k = 0;  k < d;  ++k) {
+                mins[k] = std::min(mins[k], Y[i][k]);
+                maxs[k] = std::max(maxs[k], Y[i][k]);
+            }
+        }
+
+        Node root;
+        root.half_width = 0.0;
+        for (unsigned k = 0;  k < d;  ++k) {
+            root.center[k] = n ? 0.5f * (mins[k] + maxs[k]) : 0.0f;
+            root.com[k] = 0.0;
+            if (n) root.half_width = std::max(root.half_width,
+                                              0.5f * (maxs[k] - mins[k]));
+        }
+        // Make sure that everything is strictly inside
+        root.half_width = root.half_width * 1.0001f + 1e-5f;
+        root.count = 0;
+        root.first_child = -1;
+        root.point = -1;
+
+        // Below this, points are too close together to be worth
+        // separating and just share a leaf
+        min_half_width = root.half_width * 1e-6f;
+
+        nodes.reserve(2 * n + 1);
+        nodes.push_back(root);
+
+        for (unsigned i = 0;  i < n;  ++i)
+            insert(i);
+    }
+
+    const boost::multi_array<float, 2> & Y;
+    int d;
+    int nchildren;
+    float min_half_width;
+    std::vector<Node> nodes;
+
+    int child_for(const Node & node, const float * y) const
+    {
+        int result = 0;
+        for (unsigned k = 0;  k < d;  ++k)
+            if (y[k] >= node.center[k]) result |= (1 << k);
+        return result;
+    }
+
+    void split(int node_num)
+    {
+        int first_child = nodes.size();
+        for (unsigned c = 0;  c < nchildren;  ++c) {
+            const Node & parent = nodes[node_num];
+            Node child;
+            child.half_width = 0.5f * parent.half_width;
+            for (unsigned k = 0;  k < d;  ++k) {
+                child.center[k] = parent.center[k]
+                    + ((c & (1 << k)) ? child.half_width : -child.half_width);
+                child.com[k] = 0.0;
+            }
+            child.count = 0;
+            child.first_child = -1;
+            child.point = -1;
+            nodes.push_back(child);
+        }
+
+        // Move the existing point(s) down into their child
+        Node & node = nodes[node_num];
+        const float * y = &Y[node.point][0];
+        Node & child = nodes[first_child + child_for(node, y)];
+        child.point = node.point;
+        child.count = node.count - 1;  // it's already counted the new one
+        for (unsigned k = 0;  k < d;  ++k)
+            child.com[k] = y[k];
+
+        node.first_child = first_child;
+        node.point = -1;
+    }
+
+    void insert(int i)
+    {
+        const float * y = &Y[i][0];
+
+        int node_num = 0;
+        for (;;) {
+            Node & node = nodes[node_num];
+
+            // Update the centre of mass on the way down
+            node.count += 1;
+            for (unsigned k = 0;  k < d;  ++k)
+                node.com[k] += (y[k] - node.com[k]) / node.count;
+
+            if (node.first_child == -1) {
+                if (node.point == -1) {
+                    node.point = i;
+                    return;
+                }
+
+                // Duplicate points stay in the same leaf
+                if (node.half_width < min_half_width
+                    || std::equal(y, y + d, &Y[node.point][0]))
+                    return;
+
+                split(node_num);
+            }
+
+            const Node & parent = nodes[node_num];
+            node_num = parent.first_child + child_for(parent, y);
+        }
+    }
+
+    /** Accumulate the (unnormalized) repulsive force on the point y into
+        neg_f, and return its contribution to the normalization constant Z.
+        If y is itself one of the points of the tree, then self_in_tree
+        should be set so that it isn't counted. */
+    double repulsion(const float * y, float theta_sqr, bool self_in_tree,
+                     double * neg_f) const
+    {
+        double sum_q = 0.0;
+        repulsion(0, y, theta_sqr, self_in_tree, neg_f, sum_q);
+        return sum_q;
+    }
+
+    void repulsion(int node_num, const float * y, float theta_sqr,
+                   bool self_in_tree, double * neg_f, double & sum_q) const
+    {
+        const Node & node = nodes[node_num];
+        if (node.count == 0) return;
+
+        float D = 0.0f;
+        for (unsigned k = 0;  k < d;  ++k) {
+            float diff = y[k] - node.com[k];
+            D += diff * diff;
+        }
+
+        float width = 2.0f * node.half_width;
+
+        if (node.first_child == -1 || width * width < theta_sqr * D) {
+            int count = node.count;
+
+            // At zero distance, the cell contains our point itself
+            if (D == 0.0f && self_in_tree) count -= 1;
+
+            double q = 1.0 / (1.0 + D);
+            double mult = count * q;
+            sum_q += mult;
+            mult *= q;
+            for (unsigned k = 0;  k < d;  ++k)
+                neg_f[k] += mult * (y[k] - node.com[k]);
+            return;
+        }
+
+        for (unsigned c = 0;  c < nchildren;  ++c)
+            repulsion(node.first_child + c, y, theta_sqr, self_in_tree,
+                      neg_f, sum_q);
+    }
+};
+
+/** Calculate the attractive and (approximate) repulsive forces for rows
+    i0 to i1 of Y.  pos_f and neg_f receive the forces; sum_q[chunk] the
+    contribution of the rows to the normalization constant Z. */
+struct BH_Forces_Job {
+    const TSNE_Sparse_Probs & P;
+    const boost::multi_array<float, 2> & Y;
+    const SP_Tree & tree;
+    float theta;
+    boost::multi_array<float, 2> & pos_f;
+    boost::multi_array<float, 2> & neg_f;
+    std::vector<double> & sum_q;
+    int chunk_size;
+
+    BH_Forces_Job(const TSNE_Sparse_Probs & P,
+                  const boost::multi_array<float, 2> & Y,
+                  const SP_Tree & tree,
+                  float theta,
+                  boost::multi_array<float, 2> & pos_f,
+                  boost::multi_array<float, 2> & neg_f,
+                  std::vector<double> & sum_q,
+                  int chunk_size)
+        : P(P), Y(Y), tree(tree), theta(theta), pos_f(pos_f), neg_f(neg_f),
+          sum_q(sum_q), chunk_size(chunk_size)
+    {
+    }
+
+    void operator () (int i0, int i1) const
+    {
+        int d = Y.shape()[1];
+        float theta_sqr = theta * theta;
+        double total_q = 0.0;
+
+        for (unsigned i = i0;  i < i1;  ++i) {
+            const float * yi = &Y[i][0];
+
+            // Attractive forces over the non-zero P entries
+            double pos[SP_Tree::MAX_DIMS] = { 0.0, 0.0, 0.0 };
+            for (size_t k = P.row_start[i];  k < P.row_start[i + 1];  ++k) {
+                const float * yj = &Y[P.col[k]][0];
+                float D = 0.0f;
+                for (unsigned l = 0;  l < d;  ++l) {
+                    float diff = yi[l] - yj[l];
+                    D += diff * diff;
+                }
+                double mult = P.val[k] / (1.0 + D);
+                for (unsigned l = 0;  l < d;  ++l)
+                    pos[l] += mult * (yi[l] - yj[l]);
+            }
+
+            // Repulsive forces from the tree
+            double neg[SP_Tree::MAX_DIMS] = { 0.0, 0.0, 0.0 };
+            total_q += tree.repulsion(yi, theta_sqr, true /* self */, neg);
+
+            for (unsigned l = 0;  l < d;  ++l) {
+                pos_f[i][l] = pos[l];
+                neg_f[i][l] = neg[l];
+            }
+        }
+
+        sum_q[i0 / chunk_size] = total_q;
+    }
+};
+
+/** KL divergence of the sparse P from Q = (1 + D)^-1 / Z over the given
+    rows, ignoring the (small) contribution of the zero entries of P. */
+struct BH_Cost_Job {
+    const TSNE_Sparse_Probs & P;
+    const boost::multi_array<float, 2> & Y;
+    double sum_q;
+    float min_prob;
+    std::vector<double> & costs;
+    int chunk_size;
+
+    BH_Cost_Job(const TSNE_Sparse_Probs & P,
+                const boost::multi_array<float, 2> & Y,
+                double sum_q,
+                float min_prob,
+                std::vector<double> & costs,
+                int chunk_size)
+        : P(P), Y(Y), sum_q(sum_q), min_prob(min_prob), costs(costs),
+          chunk_size(chunk_size)
+    {
+    }
+
+    void operator () (int i0, int i1) const
+    {
+        int d = Y.shape()[1];
+        double cost = 0.0;
+        for (unsigned i = i0;  i < i1;  ++i) {
+            for (size_t k = P.row_start[i];  k < P.row_start[i + 1];  ++k) {
+                const float * yj = &Y[P.col[k]][0];
+                float D = 0.0f;
+                for (unsigned l = 0;  l < d;  ++l) {
+                    float diff = Y[i][l] - yj[l];
+                    D += diff * diff;
+                }
+                double p = P.val[k];
+                double q = std::max<double>(min_prob, 1.0 / ((1.0 + D) * sum_q));
+                if (p > 0.0) cost += p * log(p / q);
+            }
+        }
+        costs[i0 / chunk_size] = cost;
+    }
+};
+
+} // file scope
+
+boost::multi_array<float, 2>
+tsne(const TSNE_Sparse_Probs & probs,
+     int num_dims,
+     const TSNE_Params & params,
+     const TSNE_Callback & callback)
+{
+    probs.validate();
+
+    int n = probs.n;
+    int d = num_dims;
+
+    if (d < 1 || d > SP_Tree::MAX_DIMS)
+        throw Exception("Barnes-Hut t-SNE only supports 1 to 3 dimensions");
+
+    boost::mt19937 rng;
+    boost::normal_distribution<float> norm;
+
+    boost::variate_generator<boost::mt19937,
+                             boost::normal_distribution<float> >
+        randn(rng, norm);
+
+    boost::multi_array<float, 2> Y(boost::extents[n][d]);
+    for (unsigned i = 0;  i < n;  ++i)
+        for (unsigned j = 0;  j < d;  ++j)
+            Y[i][j] = 0.01 * randn();
+
+    // Symmetrize and probabilize P
+    TSNE_Sparse_Probs P = symmetrize(probs);
+
+    double sumP = 0.0;
+    for (unsigned k = 0;  k < P.nnz();  ++k)
+        sumP += P.val[k];
+
+    if (sumP <= 0.0)
+        throw Exception("tsne(): probabilities are all zero");
+
+    cerr << "sparse P has " << P.nnz() << " entries ("
+         << (n ? P.nnz() / n : 0) << " per row)" << endl;
+
+    // We boost it by 4 in early iterations to force the clusters to be
+    // spread apart
+    float pfactor = 4.0 / sumP;
+    for (unsigned k = 0;  k < P.nnz();  ++k)
+        P.val[k] *= pfactor;
+
+    Timer timer;
+
+    boost::multi_array<float, 2> pos_f(boost::extents[n][d]);
+    boost::multi_array<float, 2> neg_f(boost::extents[n][d]);
+
+    // Y delta
+    boost::multi_array<float, 2> dY(boost::extents[n][d]);
+
+    // Last change in Y; so that we can see if we're going in the same dir
+    boost::multi_array<float, 2> iY(boost::extents[n][d]);
+
+    // Per-variable factors to multiply the gradient by to improve convergence
+    boost::multi_array<float, 2> gains(boost::extents[n][d]);
+    std::fill(gains.data(), gains.data() + gains.num_elements(), 1.0f);
+
+    int chunk_size = 256;
+    int nchunks = (n + chunk_size - 1) / chunk_size;
+    vector<double> chunk_totals(nchunks);
+
+    if (callback
+        && !callback(-1, INFINITY, "init")) return Y;
+    
+    for (int iter = 0;  iter < params.max_iter;  ++iter) {
+
+        /*********************************************************************/
+        // Space partitioning tree over the current embedding
+
+        SP_Tree tree(Y, n);
+
+        if (callback
+            && !callback(iter, INFINITY, "tree")) return Y;
+
+
+        /*********************************************************************/
+        // Gradient
+        // dC/dy_i = 4 * (sum_j p_ij q_ij Z (y_i - y_j)
+        //                - sum_j q_ij^2 Z (y_i - y_j))
+        // where the second sum is approximated using the tree
+
+        run_in_chunks(n, chunk_size,
+                      BH_Forces_Job(P, Y, tree, params.theta, pos_f, neg_f,
+                                    chunk_totals, chunk_size));
+
+        double sum_q = 0.0;
+        for (unsigned c = 0;  c < nchunks;  ++c)
+            sum_q += chunk_totals[c];
+
+        float neg_factor = sum_q > 0.0 ? 1.0 / sum_q : 0.0;
+        for (unsigned i = 0;  i < n;  ++i)
+            for (unsigned k = 0;  k < d;  ++k)
+                dY[i][k] = 4.0f * (pos_f[i][k] - neg_f[i][k] * neg_factor);
+
+        // Do we calculate the cost?
+        bool calc_cost = (iter + 1) % 100 == 0 || iter == params.max_iter - 1;
+        double cost = INFINITY;
+
+        if (calc_cost) {
+            run_in_chunks(n, chunk_size,
+                          BH_Cost_Job(P, Y, sum_q, params.min_prob,
+                                      chunk_totals, chunk_size));
+            cost = 0.0;
+            for (unsigned c = 0;  c < nchunks;  ++c)
+                cost += chunk_totals[c];
+        }
+
+        if (callback
+            && !callback(iter, cost, "gradient")) return Y;
+
+
+        /*********************************************************************/
+        // Update
+
+        float momentum = (iter < 20
+                          ? params.initial_momentum
+                          : params.final_momentum);
+
+        tsne_update(Y, dY, iY, gains, iter == 0, momentum, params.eta,
+                    params.min_gain);
+
+        if (callback
+            && !callback(iter, INFINITY, "update")) return Y;
+
+
+        /*********************************************************************/
+        // Recenter about the origin
+
+        recenter_about_origin(Y);
+
+        if (callback
+            && !callback(iter, INFINITY, "recenter")) return Y;
+
+        if (calc_cost) {
+            cerr << format("iteration %4d cost %6.3f  ",
+                           iter + 1, cost)
+                 << timer.elapsed() << endl;
+            timer.restart();
+        }
+
+        // Stop lying about P values if we're finished
+        if (iter == 100) {
+            for (unsigned k = 0;  k < P.nnz();  ++k)
+                P.val[k] *= 0.25f;
+        }
+    }
+
+    return Y;
+}
+
+
+/*****************************************************************************/
+/* SPARSE INPUT PROBABILITIES                                                */
+/*****************************************************************************/
+
+namespace {
+
+/** Vantage point tree over the rows of a matrix, used to find the nearest
+    neighbours of each point in O(n log n) rather than O(n^2) time.
+
+    Each node holds a point and a radius; the points in its inside subtree
+    are no further than the radius from it and those in the outside subtree
+    are no closer.  The triangle inequality then allows most of the tree to
+    be skipped when searching.
+*/
+struct VP_Tree {
+
+    struct Node {
+        int point;
+        float radius;
+        int inside;    ///< Node number of the inside subtree or -1
+        int outside;   ///< Node number of the outside subtree or -1
+    };
+
+    VP_Tree(const boost::multi_array<float, 2> & X)
+        : X(X), d(X.shape()[1])
+    {
+        int n = X.shape()[0];
+        vector<pair<float, int> > items(n);
+        for (unsigned i = 0;  i < n;  ++i)
+            items[i] = make_pair(0.0f, i);
+
+        nodes.reserve(n);
+
+        boost::mt19937 rng;
+        root = build(items, 0, n, rng);
+    }
+
+    const boost::multi_array<float, 2> & X;
+    int d;
+    int root;
+    std::vector<Node> nodes;
+
+    float distance(int i, const float * y) const
+    {
+        const float * x = &X[i][0];
+        double total = 0.0;
+        for (unsigned k = 0;  k < d;  ++k) {
+            float diff = x[k] - y[k];
+            total += diff * diff;
+        }
+        return sqrt(total);
+    }
+
+    /** Build the tree over items[lo, hi), returning its node number. */
+    int build(vector<pair<float, int> > & items, int lo, int hi,
+              boost::mt19937 & rng)
+    {
+        if (lo == hi) return -1;
+
+        // Random vantage point, moved to the front
+        std::swap(items[lo], items[lo + rng() % (hi - lo)]);
+
+        int node_num = nodes.size();
+        Node node;
+        node.point = items[lo].second;
+        node.radius = 0.0;
+        node.inside = node.outside = -1;
+        nodes.push_back(node);
+
+        if (hi - lo == 1) return node_num;
+
+        const float * y = &X[node.point][0];
+        for (int i = lo + 1;  i < hi;  ++i)
+            items[i].first = distance(items[i].second, y);
+
+        // Split the rest at the median distance
+        int median = (lo + 1 + hi) / 2;
+        std::nth_element(items.begin() + lo + 1, items.begin() + median,
+                         items.begin() + hi);
+
+        float radius = items[median].first;
+        int inside = build(items, lo + 1, median, rng);
+        int outside = build(items, median, hi, rng);
+
+        nodes[node_num].radius = radius;
+        nodes[node_num].inside = inside;
+        nodes[node_num].outside = outside;
+
+        return node_num;
+    }
+
+    typedef std::priority_queue<pair<float, int> > Heap;
+
+    /** Find the k nearest neighbours of y, other than the point exclude.
+        They are returned in order of increasing distance. */
+    void search(const float * y, int exclude, int k,
+                vector<pair<float, int> > & result) const
+    {
+        Heap heap;
+        float tau = INFINITY;
+        search(root, y, exclude, k, heap, tau);
+
+        result.resize(heap.size());
+        for (int i = heap.size() - 1;  i >= 0;  --i) {
+            result[i] = heap.top();
+            heap.pop();
+        }
+    }
+
+    void search(int node_num, const float * y, int exclude, int k,
+                Heap & heap, float & tau) const
+    {
+        if (node_num == -1) return;
+
+        const Node & node = nodes[node_num];
+        float dist = distance(node.point, y);
+
+        if (node.point != exclude && dist < tau) {
+            heap.push(make_pair(dist, node.point));
+            if (heap.size() > k) heap.pop();
+            if (heap.size() == k) tau = heap.top().first;
+        }
+
+        // Search the side that we're on first, as it's most likely to
+        // shrink tau
+        if (dist < node.radius) {
+            if (dist - tau <= node.radius)
+                search(node.inside, y, exclude, k, heap, tau);
+            if (dist + tau >= node.radius)
+                search(node.outside, y, exclude, k, heap, tau);
+        }
+        else {
+            if (dist + tau >= node.radius)
+                search(node.outside, y, exclude, k, heap, tau);
+            if (dist - tau <= node.radius)
+                search(node.inside, y, exclude, k, heap, tau);
+        }
+    }
+};
+
+/** Find the neighbours of rows i0 to i1 of Q in the tree and convert their
+    distances into conditional probabilities with the given perplexity.
+    Each row has exactly k entries.  If Q is the matrix that the tree was
+    built over, then self_query should be set so that a point is not
+    considered to be its own neighbour. */
+struct Sparse_Probabilities_Job {
+    const boost::multi_array<float, 2> & Q;
+    const VP_Tree & tree;
+    bool self_query;
+    double tolerance;
+    double perplexity;
+    int k;
+    TSNE_Sparse_Probs & P;
+
+    Sparse_Probabilities_Job(const boost::multi_array<float, 2> & Q,
+                             const VP_Tree & tree,
+                             bool self_query,
+                             double tolerance,
+                             double perplexity,
+                             int k,
+                             TSNE_Sparse_Probs & P)
+        : Q(Q), tree(tree), self_query(self_query), tolerance(tolerance),
+          perplexity(perplexity), k(k), P(P)
+    {
+    }
+
+    void operator () (int i0, int i1) const
+    {
+        vector<pair<float, int> > neighbours;
+        distribution<float> D_row(k);
+
+        for (unsigned i = i0;  i < i1;  ++i) {
+            tree.search(&Q[i][0], self_query ? (int)i : -1, k, neighbours);
+            if (neighbours.size() != k)
+                throw Exception("VP_Tree returned the wrong number of "
+                                "neighbours");
+
+            // Squared distances, like vectors_to_distances.  Only their
+            // differences matter to the probabilities, so we measure them
+            // from the nearest neighbour: it then has weight exp(0) = 1 and
+            // the normalizer can't underflow to zero, whatever the scale of
+            // the distances.  Neighbours all at the same (eg, zero) distance
+            // correctly come out uniform.
+            float nearest = INFINITY;
+            for (unsigned j = 0;  j < k;  ++j)
+                nearest = std::min(nearest, neighbours[j].first);
+            for (unsigned j = 0;  j < k;  ++j)
+                D_row[j] = neighbours[j].first * neighbours[j].first
+                         - nearest * nearest;
+
+            distribution<float> P_row;
+            try {
+                P_row = binary_search_perplexity(D_row, perplexity, -1,
+                                                 tolerance).first;
+            } catch (const std::exception & exc) {
+                throw Exception("computing probabilities for row %d: %s",
+                                (int)i, exc.what());
+            }
+
+            size_t start = P.row_start[i];
+            for (unsigned j = 0;  j < k;  ++j) {
+                P.col[start + j] = neighbours[j].second;
+                P.val[start + j] = P_row[j];
+            }
+        }
+    }
+};
+
+/** Conditional probabilities p_j|i of the k nearest neighbours in the tree
+    of each of the rows of Q, with each row stored at i * k. */
+TSNE_Sparse_Probs
+neighbour_probabilities(const boost::multi_array<float, 2> & Q,
+                        const VP_Tree & tree,
+                        bool self_query,
+                        double tolerance,
+                        double perplexity,
+                        int k)
+{
+    int n = Q.shape()[0];
+
+    TSNE_Sparse_Probs P;
+    P.n = n;
+    P.row_start.resize(n + 1);
+    for (unsigned i = 0;  i <= n;  ++i)
+        P.row_start[i] = (size_t)i * k;
+    P.col.resize((size_t)n * k);
+    P.val.resize((size_t)n * k);
+
+    run_in_chunks(n, 64,
+                  Sparse_Probabilities_Job(Q, tree, self_query, tolerance,
+                                           perplexity, k, P));
+
+    return P;
+}
+
+} // file scope
+
+TSNE_Sparse_Probs
+vectors_to_sparse_probabilities(const boost::multi_array<float, 2> & X,
+                                double tolerance,
+                                double perplexity,
+                                int num_neighbours)
+{
+    int n = X.shape()[0];
+
+    int k = num_neighbours;
+    if (k == -1) k = (int)(3.0 * perplexity);
+    k = std::min(k, n - 1);
+
+    if (k <= 0 && n > 1)
+        throw Exception("vectors_to_sparse_probabilities: need at least one "
+                        "neighbour");
+    
+    VP_Tree tree(X);
+
+    // Conditional probabilities p_j|i over the neighbours of each point
+    TSNE_Sparse_Probs P
+        = neighbour_probabilities(X, tree, true /* self query */,
+                                  tolerance, perplexity, k);
+
+    // Symmetrize to get the joint probabilities
+    TSNE_Sparse_Probs result = symmetrize(P);
+
+    double total = 0.0;
+    for (unsigned i = 0;  i < result.nnz();  ++i)
+        total += result.val[i];
+    if (total > 0.0) {
+        float factor = 1.0 / total;
+        for (unsigned i = 0;  i < result.nnz();  ++i)
+            result.val[i] *= factor;
+    }
+
+    return result;
+}
+
+
+/*****************************************************************************/
+/* OUT OF SAMPLE EMBEDDING                                                   */
+/*****************************************************************************/
+
+namespace {
+
+/** Gradient of the cost of the new points i0 to i1, whose neighbours (with
+    conditional probabilities) amongst the fixed points are in P.  The
+    cost of each point is KL(P_i || Q_i), with Q_i its distribution over the
+    fixed points, and its repulsive forces come from the tree over them.
+    The result is scaled by 4 / n (n being the number of fixed points) to
+    make it about the same size as the gradient of the full problem, so that
+    the learning rate means the same thing.
+*/
+struct Embed_Gradient_Job {
+    const TSNE_Sparse_Probs & P;
+    const boost::multi_array<float, 2> & Y;
+    const boost::multi_array<float, 2> & Y_new;
+    const SP_Tree & tree;
+    float theta;
+    boost::multi_array<float, 2> & dY;
+    std::vector<double> & costs;
+    int chunk_size;
+
+    Embed_Gradient_Job(const TSNE_Sparse_Probs & P,
+                       const boost::multi_array<float, 2> & Y,
+                       const boost::multi_array<float, 2> & Y_new,
+                       const SP_Tree & tree,
+                       float theta,
+                       boost::multi_array<float, 2> & dY,
+                       std::vector<double> & costs,
+                       int chunk_size)
+        : P(P), Y(Y), Y_new(Y_new), tree(tree), theta(theta), dY(dY),
+          costs(costs), chunk_size(chunk_size)
+    {
+    }
+
+    void operator () (int i0, int i1) const
+    {
+        int n = Y.shape()[0];
+        int d = Y.shape()[1];
+        float theta_sqr = theta * theta;
+        double factor = 4.0 / n;
+        double cost = 0.0;
+
+        for (unsigned i = i0;  i < i1;  ++i) {
+            const float * yi = &Y_new[i][0];
+
+            double neg[SP_Tree::MAX_DIMS] = { 0.0, 0.0, 0.0 };
+            double sum_q = tree.repulsion(yi, theta_sqr, false /* self */, neg);
+            double norm = sum_q > 0.0 ? 1.0 / sum_q : 0.0;
+
+            double pos[SP_Tree::MAX_DIMS] = { 0.0, 0.0, 0.0 };
+            for (size_t k = P.row_start[i];  k < P.row_start[i + 1];  ++k) {
+                const float * yj = &Y[P.col[k]][0];
+                float D = 0.0f;
+                for (unsigned l = 0;  l < d;  ++l) {
+                    float diff = yi[l] - yj[l];
+                    D += diff * diff;
+                }
+                double w = 1.0 / (1.0 + D);
+                double mult = P.val[k] * w;
+                for (unsigned l = 0;  l < d;  ++l)
+                    pos[l] += mult * (yi[l] - yj[l]);
+
+                double p = P.val[k];
+                if (p > 0.0) cost += p * log(p / std::max(w * norm, 1e-12));
+            }
+
+            for (unsigned l = 0;  l < d;  ++l)
+                dY[i][l] = factor * (pos[l] - neg[l] * norm);
+        }
+
+        costs[i0 / chunk_size] = cost;
+    }
+};
+
+} // file scope
+
+boost::multi_array<float, 2>
+tsne_embed_new(const boost::multi_array<float, 2> & X,
+               const boost::multi_array<float, 2> & Y,
+               const boost::multi_array<float, 2> & X_new,
+               double perplexity,
+               const TSNE_Params & params,
+               const TSNE_Callback & callback)
+{
+    int n = X.shape()[0];
+    int m = X_new.shape()[0];
+    int d = Y.shape()[1];
+
+    if (Y.shape()[0] != n)
+        throw Exception("tsne_embed_new(): X and Y have different numbers "
+                        "of points");
+    if (X_new.shape()[1] != X.shape()[1])
+        throw Exception("tsne_embed_new(): X and X_new have different "
+                        "numbers of dimensions");
+    if (d < 1 || d > SP_Tree::MAX_DIMS)
+        throw Exception("tsne_embed_new(): only 1 to 3 dimensions are "
+                        "supported");
+    if (n == 0)
+        throw Exception("tsne_embed_new(): no existing points");
+
+    boost::multi_array<float, 2> Y_new(boost::extents[m][d]);
+    
+    if (callback
+        && !callback(-1, INFINITY, "init")) return Y_new;
+    
+    // Probabilities over the neighbours amongst the existing points
+    int k = std::min<int>(3.0 * perplexity, n);
+    if (k < 1) k = 1;
+
+    TSNE_Sparse_Probs P;
+    {
+        VP_Tree vp_tree(X);
+        P = neighbour_probabilities(X_new, vp_tree, false /* self query */,
+                                    1e-5 /* tolerance */, perplexity, k);
+    }
+
+    // Start at the weighted average of the neighbours
+    for (unsigned i = 0;  i < m;  ++i) {
+        for (size_t e = P.row_start[i];  e < P.row_start[i + 1];  ++e)
+            for (unsigned l = 0;  l < d;  ++l)
+                Y_new[i][l] += P.val[e] * Y[P.col[e]][l];
+    }
+
+    if (callback
+        && !callback(-1, INFINITY, "neighbours")) return Y_new;
+
+    // The existing points don't move, so neither does the tree
+    SP_Tree tree(Y, n);
+
+    boost::multi_array<float, 2> dY(boost::extents[m][d]);
+    boost::multi_array<float, 2> iY(boost::extents[m][d]);
+    boost::multi_array<float, 2> gains(boost::extents[m][d]);
+    std::fill(gains.data(), gains.data() + gains.num_elements(), 1.0f);
+
+    int chunk_size = 256;
+    int nchunks = (m + chunk_size - 1) / chunk_size;
+    vector<double> costs(nchunks);
+
+    Timer timer;
+
+    for (int iter = 0;  iter < params.max_iter;  ++iter) {
+
+        run_in_chunks(m, chunk_size,
+                      Embed_Gradient_Job(P, Y, Y_new, tree, params.theta, dY,
+                                         costs, chunk_size));
+
+        bool calc_cost = (iter + 1) % 100 == 0 || iter == params.max_iter - 1;
+        double cost = INFINITY;
+
+        if (calc_cost) {
+            cost = 0.0;
+            for (unsigned c = 0;  c < nchunks;  ++c)
+                cost += costs[c];
+            if (m) cost /= m;
+        }
+
+        if (callback
+            && !callback(iter, cost, "gradient")) return Y_new;
+
+        float momentum = (iter < 20
+                          ? params.initial_momentum
+                          : params.final_momentum);
+
+        tsne_update(Y_new, dY, iY, gains, iter == 0, momentum, params.eta,
+                    params.min_gain);
+
+        if (callback
+            && !callback(iter, INFINITY, "update")) return Y_new;
+
+        if (calc_cost) {
+            cerr << format("iteration %4d cost %6.3f  ",
+                           iter + 1, cost)
+                 << timer.elapsed() << endl;
+            timer.restart();
+        }
+    }
+
+    return Y_new;
+}
+
+
 } // namespace ML
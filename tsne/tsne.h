@@ -18,6 +18,7 @@
 #include "jml/stats/distribution.h"
 #include <boost/multi_array.hpp>
 #include <boost/function.hpp>
+#include <vector>
 
 namespace ML {
 
@@ -88,6 +89,10 @@ distances_to_probabilities(boost::multi_array<float, 2> & D,
     The num_dims parameter gives the preferred value of e; it is possible that
     the routine will return a smaller value of e than this (where the rank of
     X is lower than the requested e value).
+
+    When e is much smaller than d, the randomized SVD in
+    jml/algebra/randomized_svd.h is used, which is much faster for large
+    matrices.
 */
 boost::multi_array<float, 2>
 pca(boost::multi_array<float, 2> & coords, int num_dims = 50);
@@ -100,7 +105,8 @@ struct TSNE_Params {
           final_momentum(0.8),
           eta(500),
           min_gain(0.01),
-          min_prob(1e-12)
+          min_prob(1e-12),
+          theta(0.5)
     {
     }
 
@@ -110,6 +116,13 @@ struct TSNE_Params {
     double eta;
     double min_gain;
     double min_prob;
+
+    /** Accuracy of the Barnes-Hut approximation used by the sparse version
+        of tsne().  A cell of the space partitioning tree is summarized by
+        its centre of mass when its width divided by its distance from the
+        point is less than theta.  Zero gives the exact (but slow)
+        answer. */
+    double theta;
 };
 
 // Function that will be used as a callback to provide progress to a calling
@@ -129,6 +142,89 @@ tsne(const boost::multi_array<float, 2> & probs,
      const TSNE_Params & params = TSNE_Params(),
      const TSNE_Callback & callback = TSNE_Callback());
 
+/** A sparse (n x n) matrix of probabilities, in compressed sparse row
+    format.  The entries of row i are at indexes row_start[i] to
+    row_start[i + 1] - 1 of col (which gives the column number) and val
+    (which gives the probability).  Entries that are not present are zero.
+*/
+struct TSNE_Sparse_Probs {
+    TSNE_Sparse_Probs()
+        : n(0)
+    {
+    }
+
+    int n;
+    std::vector<size_t> row_start;
+    std::vector<int> col;
+    std::vector<float> val;
+
+    size_t nnz() const { return col.size(); }
+
+    /** Throw an exception if the structure is inconsistent. */
+    void validate() const;
+};
+
+/** Convert a dense matrix of probabilities into a sparse one, keeping only
+    the entries above min_prob. */
+TSNE_Sparse_Probs
+sparsify_probabilities(const boost::multi_array<float, 2> & probs,
+                       float min_prob = 0.0);
+
+/** Calculate the input probabilities for t-SNE directly from an (n x d)
+    matrix of vectors, without ever forming the (n x n) distance matrix.
+    Only the num_neighbours nearest neighbours of each point (found using a
+    vantage point tree) are considered, and the perplexity calibration is
+    done over those neighbours alone.  The default of -1 uses three times
+    the perplexity.
+
+    The result is symmetric and sums to one, ie it is the joint
+    probability (p_j|i + p_i|j) / 2n.
+*/
+TSNE_Sparse_Probs
+vectors_to_sparse_probabilities(const boost::multi_array<float, 2> & X,
+                                double tolerance = 1e-5,
+                                double perplexity = 30.0,
+                                int num_neighbours = -1);
+
+/** Barnes-Hut t-SNE.  Same as the dense version above, but the attractive
+    forces are calculated only over the non-zero entries of probs and the
+    repulsive forces are approximated using a quadtree (octree for three
+    dimensions) over the embedding, controlled by params.theta.  This takes
+    O(N log N) time and O(N) memory per iteration rather than O(N^2), which
+    makes millions of points possible.  Only 1 to 3 output dimensions are
+    supported.
+
+    L.J.P. van der Maaten.  Accelerating t-SNE using Tree-Based Algorithms.
+    Journal of Machine Learning Research 15(Oct):3221-3245, 2014.
+*/
+boost::multi_array<float, 2>
+tsne(const TSNE_Sparse_Probs & probs,
+     int num_dims = 2,
+     const TSNE_Params & params = TSNE_Params(),
+     const TSNE_Callback & callback = TSNE_Callback());
+
+/** Place new points into an existing embedding without re-running t-SNE
+    over the whole set.  X holds the input vectors that the embedding Y was
+    fitted on and X_new the input vectors of the new points.
+
+    The probabilities for each new point are calculated over its nearest
+    neighbours amongst the existing points (as in
+    vectors_to_sparse_probabilities()), and then only the new points are
+    optimized; the existing points stay fixed.  The new points don't
+    interact with each other, so this is only appropriate where they are a
+    small fraction of the total.  Each new point starts off at the weighted
+    average of its neighbours and there is no early exaggeration.
+
+    Returns the (n_new x num_dims) coordinates of the new points.
+*/
+boost::multi_array<float, 2>
+tsne_embed_new(const boost::multi_array<float, 2> & X,
+               const boost::multi_array<float, 2> & Y,
+               const boost::multi_array<float, 2> & X_new,
+               double perplexity = 30.0,
+               const TSNE_Params & params = TSNE_Params(),
+               const TSNE_Callback & callback = TSNE_Callback());
+
 
 } // namespace ML
 
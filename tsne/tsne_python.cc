@@ -403,6 +403,101 @@ tsne_tsne(PyObject *self, PyObject *args, PyObject * kwds)
     return result_array.release<PyObject>();
 }
 
+static PyObject *
+tsne_tsne_sparse(PyObject *self, PyObject *args, PyObject * kwds)
+{
+    PyObject * in_array;
+    TSNE_Params params;
+
+    int num_dims = 2;
+    double perplexity = 30.0;
+    double tolerance = 1e-5;
+    int num_neighbours = -1;
+
+    static const char * const kwlist[] =
+        { "array", "num_dims", "perplexity", "tolerance", "num_neighbours",
+          "max_iter", "initial_momentum", "final_momentum",
+          "eta", "min_gain", "min_prob", "theta", NULL };
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds,
+                                     "O!|iddiidddddd", (char **)kwlist,
+                                     &PyArray_Type, &in_array,
+                                     &num_dims,
+                                     &perplexity,
+                                     &tolerance,
+                                     &num_neighbours,
+                                     &params.max_iter,
+                                     &params.initial_momentum,
+                                     &params.final_momentum,
+                                     &params.eta,
+                                     &params.min_gain,
+                                     &params.min_prob,
+                                     &params.theta))
+        return NULL;
+
+    /* Convert the input array (of vectors) to a float array. */
+    PyArrayRef input_as_float32
+        = PyArray_FromAny(in_array,
+                          PyArray_DescrFromType(NPY_FLOAT32),
+                          2, 2,
+                          NPY_C_CONTIGUOUS | NPY_FORCECAST | NPY_ALIGNED,
+                          0);
+    if (!input_as_float32)
+        return NULL;
+    
+    int n = PyArray_DIM(input_as_float32, 0);
+    int d = PyArray_DIM(input_as_float32, 1);
+
+    /* Allocate an object (in memory) for the result */
+    npy_intp npy_shape[2] = { n, num_dims };
+    PyArrayRef result_array
+        = PyArray_SimpleNew(2 /* num dims */,
+                            npy_shape,
+                            NPY_FLOAT);
+    if (!result_array)
+        return NULL;
+    
+    try {
+        PyThreads threads(UNBLOCK);
+
+        /* Copy into a boost multi array (TODO: avoid this copy) */
+        boost::multi_array<float, 2> array(boost::extents[n][d]);
+
+        const float * data_in = (const float *)PyArray_DATA(input_as_float32);
+
+        std::copy(data_in, data_in + (n * d), array.data());
+
+        input_as_float32.release();
+
+        /* The (n x n) matrices are never formed */
+        TSNE_Sparse_Probs probs
+            = vectors_to_sparse_probabilities(array, tolerance, perplexity,
+                                              num_neighbours);
+
+        boost::multi_array<float, 2> result
+            = tsne(probs, num_dims, params,
+                   boost::bind(tsne_callback,
+                               threads.signals_before,
+                               _1, _2, _3));
+        
+        if (threads.interrupted())
+            throw Interrupt_Exception();
+
+        if (result.shape()[0] != n || result.shape()[1] != num_dims)
+            throw Exception("wrong shapes");
+        
+        float * data_out = (float *)PyArray_DATA(result_array);
+        
+        std::copy(result.data(), result.data() + n * num_dims, data_out);
+    } catch (const std::exception & exc) {
+        return to_python_exception(exc);
+    } catch (...) {
+        return to_python_exception();
+    }
+
+    return result_array.release<PyObject>();
+}
+
 static PyMethodDef TsneMethods[] = {
     {"vectors_to_distances",  tsne_vectors_to_distances, METH_VARARGS,
      "Convert an array of vectors in a coordinate space to a symmetric square"
@@ -412,6 +507,9 @@ static PyMethodDef TsneMethods[] = {
      "probabilities by modelling as gaussians."},
     {"tsne",  (PyCFunction)tsne_tsne, METH_VARARGS | METH_KEYWORDS,
      "reduce the (n x d) matrix to a (n x num_dims) matrix using t-SNE."},
+    {"tsne_sparse",  (PyCFunction)tsne_tsne_sparse, METH_VARARGS | METH_KEYWORDS,
+     "reduce the (n x d) matrix of vectors to a (n x num_dims) matrix using "
+     "Barnes-Hut t-SNE over the nearest neighbours of each point."},
     {NULL, NULL, 0, NULL}        /* Sentinel */
 };
 
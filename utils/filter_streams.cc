@@ -36,6 +36,10 @@
 #include <thread>
 #include <unordered_map>
 #include "lzma.h"
+#include "zstd.h"
+#include "lz4.h"
+#include "parallel_gzip.h"
+#include "worker_task.h"
 
 
 using namespace std;
@@ -60,6 +64,31 @@ getScheme(const std::string & uri)
     return make_pair(scheme, resource);
 }
 
+
+/*****************************************************************************/
+/* COMPRESSION                                                               */
+/*****************************************************************************/
+
+std::string
+compressionFromFilename(const std::string & filename)
+{
+    static const char * extensions[] = { "gz", "bz2", "xz", "zst", "lz4" };
+
+    // Backup files (with a trailing ~) are compressed like the original
+    string name = filename;
+    if (!name.empty() && name[name.size() - 1] == '~')
+        name.resize(name.size() - 1);
+
+    string::size_type dot = name.rfind('.');
+    if (dot == string::npos) return "";
+    string extension(name, dot + 1);
+
+    for (unsigned i = 0;  i < sizeof(extensions) / sizeof(extensions[0]);  ++i)
+        if (extension == extensions[i]) return extension;
+    return "";
+}
+
+
 /*****************************************************************************/
 /* FILTER_OSTREAM                                                            */
 /*****************************************************************************/
@@ -116,13 +145,6 @@ operator = (filter_ostream && other)
 
 namespace {
 
-bool ends_with(const std::string & str, const std::string & what)
-{
-    string::size_type result = str.rfind(what);
-    return result != string::npos
-        && result == str.size() - what.size();
-}
-
 void addCompression(streambuf & buf,
                     boost::iostreams::filtering_ostream & stream,
                     const std::string & resource,
@@ -131,9 +153,13 @@ void addCompression(streambuf & buf,
 {
     using namespace boost::iostreams;
 
-    if (compression == "gz" || compression == "gzip"
-        || (compression == ""
-            && (ends_with(resource, ".gz") || ends_with(resource, ".gz~")))) {
+    string comp = compression;
+    if (comp == "") comp = compressionFromFilename(resource);
+
+    if (comp == "pgz" || comp == "pgzip") {
+        stream.push(Parallel_Gzip_Compressor(compressionLevel));
+    }
+    else if (comp == "gz" || comp == "gzip") {
         gzip_compressor compressor;
         if (compressionLevel != -1) {
             compressor = gzip_compressor(compressionLevel);
@@ -141,25 +167,64 @@ void addCompression(streambuf & buf,
         compressor.write(buf, "", 0);
         stream.push(compressor);
     }
-    else if (compression == "bz2" || compression == "bzip2"
-        || (compression == ""
-            && (ends_with(resource, ".bz2") || ends_with(resource, ".bz2~")))) {
+    else if (comp == "bz2" || comp == "bzip2") {
         if (compressionLevel == -1)
             stream.push(bzip2_compressor());
         else stream.push(bzip2_compressor(compressionLevel));
     }
-    else if (compression == "lzma" || compression == "xz"
-        || (compression == ""
-            && (ends_with(resource, ".xz") || ends_with(resource, ".xz~")))) {
+    else if (comp == "pxz") {
+        lzma_params params;
+        if (compressionLevel != -1) params.level = compressionLevel;
+        params.threads = num_threads();
+        stream.push(lzma_compressor(params));
+    }
+    else if (comp == "lzma" || comp == "xz") {
         if (compressionLevel == -1)
             stream.push(lzma_compressor());
         else stream.push(lzma_compressor(compressionLevel));
     }
-    else if (compression != "" && compression != "none")
-        throw ML::Exception("unknown filter compression " + compression);
+    else if (comp == "zst" || comp == "zstd") {
+        // zstd's own threads compress blocks of the frame in parallel
+        stream.push(zstd_compressor(zstd_params(compressionLevel,
+                                                num_threads())));
+    }
+    else if (comp == "lz4") {
+        stream.push(lz4_compressor(lz4_params(compressionLevel)));
+    }
+    else if (comp != "" && comp != "none")
+        throw ML::Exception("unknown filter compression " + comp);
     
 }
 
+/** Source that returns the bytes that were already read from the start of
+    a streambuf, and then the rest of it. */
+struct Peeked_Source {
+    typedef char char_type;
+    typedef boost::iostreams::source_tag category;
+
+    Peeked_Source(std::streambuf * buf, const std::string & peeked)
+        : buf(buf), peeked(new std::string(peeked)), pos(new size_t(0))
+    {
+    }
+
+    std::streamsize read(char * s, std::streamsize n)
+    {
+        std::streamsize done = 0;
+        if (*pos < peeked->size()) {
+            done = std::min<size_t>(n, peeked->size() - *pos);
+            std::copy(peeked->data() + *pos, peeked->data() + *pos + done, s);
+            *pos += done;
+        }
+        if (done < n)
+            done += buf->sgetn(s + done, n - done);
+        return (done == 0 ? -1 : done);
+    }
+
+    std::streambuf * buf;
+    std::shared_ptr<std::string> peeked;
+    std::shared_ptr<size_t> pos;
+};
+
 } // file scope
 
 void
@@ -360,24 +425,38 @@ openFromStreambuf(std::streambuf * buf,
     unique_ptr<filtering_istream> new_stream
         (new filtering_istream());
 
-    bool gzip = (compression == "gz" || compression == "gzip"
-                 || (compression == ""
-                     && (ends_with(resource, ".gz")
-                         || ends_with(resource, ".gz~"))));
-    bool bzip2 = (compression == "bz2" || compression == "bzip2"
-                 || (compression == ""
-                     && (ends_with(resource, ".bz2")
-                         || ends_with(resource, ".bz2~"))));
-    bool lzma = (compression == "xz" || compression == "lzma"
-                 || (compression == ""
-                     && (ends_with(resource, ".xz")
-                         || ends_with(resource, ".xz~"))));
-
-    if (gzip) new_stream->push(gzip_decompressor());
-    if (bzip2) new_stream->push(bzip2_decompressor());
-    if (lzma) new_stream->push(lzma_decompressor());
-
-    new_stream->push(*buf);
+    string comp = compression;
+    if (comp == "") comp = compressionFromFilename(resource);
+
+    bool gzip = (comp == "gz" || comp == "gzip");
+    bool bzip2 = (comp == "bz2" || comp == "bzip2");
+    bool lzma = (comp == "xz" || comp == "lzma");
+    bool zstd = (comp == "zst" || comp == "zstd");
+    bool lz4 = (comp == "lz4");
+
+    if (gzip) {
+        // Files from the Parallel_Gzip_Compressor can be decompressed in
+        // parallel; we need to look at the header to know
+        std::string header(Parallel_Gzip_Decompressor::HEADER_LENGTH, 0);
+        header.resize(buf->sgetn(&header[0], header.size()));
+
+        if (Parallel_Gzip_Decompressor::is_parallel_gzip(header.data(),
+                                                         header.size()))
+            new_stream->push(Parallel_Gzip_Decompressor());
+        else new_stream->push(gzip_decompressor());
+        new_stream->push(Peeked_Source(buf, header));
+    }
+    else {
+        if (bzip2) new_stream->push(bzip2_decompressor());
+        if (lzma) {
+            lzma_params params;
+            params.threads = num_threads();
+            new_stream->push(lzma_decompressor(params));
+        }
+        if (zstd) new_stream->push(zstd_decompressor());
+        if (lz4) new_stream->push(lz4_decompressor());
+        new_stream->push(*buf);
+    }
 
     this->stream = std::move(new_stream);
     this->sink = std::move(sink);
@@ -26,10 +26,22 @@
 #include <iostream>
 #include <fstream>
 #include <memory>
+#include <string>
 
 namespace ML {
 
 
+/*****************************************************************************/
+/* COMPRESSION                                                               */
+/*****************************************************************************/
+
+/** Return the compression that the filter streams use by default for the
+    given file from its extension ("gz", "bz2", "xz", "zst" or "lz4",
+    optionally followed by a "~" as for a backup file), or "" if it isn't
+    compressed. */
+std::string compressionFromFilename(const std::string & filename);
+
+
 /*****************************************************************************/
 /* FILTER OSTREAM                                                            */
 /*****************************************************************************/
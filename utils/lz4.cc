@@ -0,0 +1,193 @@
+/* lz4.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Boost iostreams filters for lz4 compression.
+*/
+
+#include "lz4.h"
+#include <boost/iostreams/detail/ios.hpp>  // failure.
+#include <lz4frame.h>
+#include <string.h>
+
+
+using namespace std;
+
+
+namespace boost { namespace iostreams {
+
+namespace detail {
+
+namespace {
+
+/** Size of the input that we compress in one go.  LZ4F_compressUpdate
+    needs an output buffer big enough for the worst case, so we keep the
+    chunks small. */
+enum { CHUNK_SIZE = 65536 };
+
+size_t check_lz4(size_t code, const char * what)
+{
+    if (LZ4F_isError(code))
+        throw BOOST_IOSTREAMS_FAILURE(string("lz4: ") + what + ": "
+                                      + LZ4F_getErrorName(code));
+    return code;
+}
+
+} // file scope
+
+
+/*****************************************************************************/
+/* LZ4_COMPRESSOR_IMPL                                                       */
+/*****************************************************************************/
+
+lz4_compressor_impl::
+lz4_compressor_impl(const lz4_params & params)
+    : params_(params), cctx_(0), started_(false), ended_(false),
+      pending_pos_(0)
+{
+    LZ4F_cctx * cctx;
+    check_lz4(LZ4F_createCompressionContext(&cctx, LZ4F_VERSION),
+              "creating context");
+    cctx_ = cctx;
+}
+
+lz4_compressor_impl::
+~lz4_compressor_impl()
+{
+    LZ4F_freeCompressionContext((LZ4F_cctx *)cctx_);
+}
+
+bool
+lz4_compressor_impl::
+drain(char*& dest_begin, char* dest_end)
+{
+    size_t n = std::min<size_t>(pending_.size() - pending_pos_,
+                                dest_end - dest_begin);
+    memcpy(dest_begin, pending_.data() + pending_pos_, n);
+    dest_begin += n;
+    pending_pos_ += n;
+    return pending_pos_ == pending_.size();
+}
+
+bool
+lz4_compressor_impl::
+filter(const char*& src_begin, const char* src_end,
+       char*& dest_begin, char* dest_end, bool flush)
+{
+    LZ4F_cctx * cctx = (LZ4F_cctx *)cctx_;
+
+    LZ4F_preferences_t prefs;
+    memset(&prefs, 0, sizeof(prefs));
+    prefs.compressionLevel = (params_.level == -1 ? 0 : params_.level);
+
+    for (;;) {
+        if (!drain(dest_begin, dest_end))
+            return true;  // no more room
+
+        pending_pos_ = 0;
+
+        if (!started_) {
+            pending_.resize(LZ4F_HEADER_SIZE_MAX);
+            pending_.resize(check_lz4(LZ4F_compressBegin(cctx, &pending_[0],
+                                                         pending_.size(),
+                                                         &prefs),
+                                      "starting frame"));
+            started_ = true;
+        }
+        else if (src_begin != src_end) {
+            size_t n = std::min<size_t>(src_end - src_begin, CHUNK_SIZE);
+            pending_.resize(LZ4F_compressBound(n, &prefs));
+            pending_.resize(check_lz4(LZ4F_compressUpdate(cctx, &pending_[0],
+                                                          pending_.size(),
+                                                          src_begin, n, 0),
+                                      "compressing"));
+            src_begin += n;
+        }
+        else if (flush && !ended_) {
+            pending_.resize(LZ4F_compressBound(0, &prefs));
+            pending_.resize(check_lz4(LZ4F_compressEnd(cctx, &pending_[0],
+                                                       pending_.size(), 0),
+                                      "ending frame"));
+            ended_ = true;
+        }
+        else {
+            pending_.clear();
+            return !flush;
+        }
+    }
+}
+
+void
+lz4_compressor_impl::
+close()
+{
+    started_ = ended_ = false;
+    pending_.clear();
+    pending_pos_ = 0;
+}
+
+
+/*****************************************************************************/
+/* LZ4_DECOMPRESSOR_IMPL                                                     */
+/*****************************************************************************/
+
+lz4_decompressor_impl::
+lz4_decompressor_impl()
+    : dctx_(0), in_frame_(false)
+{
+    LZ4F_dctx * dctx;
+    check_lz4(LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION),
+              "creating context");
+    dctx_ = dctx;
+}
+
+lz4_decompressor_impl::
+~lz4_decompressor_impl()
+{
+    LZ4F_freeDecompressionContext((LZ4F_dctx *)dctx_);
+}
+
+bool
+lz4_decompressor_impl::
+filter(const char*& src_begin, const char* src_end,
+       char*& dest_begin, char* dest_end, bool flush)
+{
+    // Keep going while there is input (which may start another frame) or
+    // buffered output, and room to put it
+    while (dest_begin != dest_end && (src_begin != src_end || flush)) {
+        size_t src_size = src_end - src_begin;
+        size_t dest_size = dest_end - dest_begin;
+        size_t hint
+            = check_lz4(LZ4F_decompress((LZ4F_dctx *)dctx_,
+                                        dest_begin, &dest_size,
+                                        src_begin, &src_size, 0),
+                        "decompressing");
+        src_begin += src_size;
+        dest_begin += dest_size;
+
+        // Between frames, the hint is the size of the next header; only
+        // a call that did something tells us where we are
+        if (src_size == 0 && dest_size == 0) break;
+        in_frame_ = hint != 0;
+    }
+
+    if (flush && dest_begin != dest_end) {
+        // No more input, and everything has been written out
+        if (in_frame_)
+            throw BOOST_IOSTREAMS_FAILURE("lz4: truncated data");
+        return false;
+    }
+    return true;
+}
+
+void
+lz4_decompressor_impl::
+close()
+{
+    LZ4F_resetDecompressionContext((LZ4F_dctx *)dctx_);
+    in_frame_ = false;
+}
+
+} // namespace detail
+
+} } // End namespaces iostreams, boost.
@@ -0,0 +1,129 @@
+/* lz4.h                                                           -*- C++ -*-
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Boost iostreams filters for lz4 (frame format) compression, in the same
+   style as those in lzma.h.
+*/
+
+#ifndef __utils__lz4_h__
+#define __utils__lz4_h__
+
+#include <memory>
+#include <string>
+#include <boost/iostreams/constants.hpp>   // buffer size.
+#include <boost/iostreams/filter/symmetric.hpp>
+#include <boost/iostreams/pipeline.hpp>
+
+
+namespace boost { namespace iostreams {
+
+//
+// Class name: lz4_params.
+// Description: Parameters for lz4 compression.
+//
+struct lz4_params {
+
+    // Non-explicit constructor.  A level of -1 (or 0) is the fast default;
+    // 3 and above use the slower high compression mode (up to 12).
+    lz4_params( int level = -1 )
+        : level(level)
+        { }
+    int level;
+};
+
+namespace detail {
+
+class lz4_compressor_impl {
+public:
+    typedef char char_type;
+
+    lz4_compressor_impl(const lz4_params & params = lz4_params());
+    ~lz4_compressor_impl();
+
+    bool filter( const char*& src_begin, const char* src_end,
+                 char*& dest_begin, char* dest_end, bool flush );
+    void close();
+
+private:
+    lz4_params params_;
+    void * cctx_;
+    bool started_, ended_;
+    std::string pending_;       ///< Compressed data not yet written
+    size_t pending_pos_;
+
+    /** Copy as much of the pending data as fits; true if it all did. */
+    bool drain(char*& dest_begin, char* dest_end);
+};
+
+class lz4_decompressor_impl {
+public:
+    typedef char char_type;
+
+    lz4_decompressor_impl();
+    ~lz4_decompressor_impl();
+
+    bool filter( const char*& src_begin, const char* src_end,
+                 char*& dest_begin, char* dest_end, bool flush );
+    void close();
+
+private:
+    void * dctx_;
+    bool in_frame_;
+};
+
+} // namespace detail
+
+//
+// Template name: lz4_compressor
+// Description: Model of InputFilter and OutputFilter implementing
+//      compression using lz4.
+//
+template<typename Alloc = std::allocator<char> >
+struct basic_lz4_compressor
+    : symmetric_filter<detail::lz4_compressor_impl, Alloc>
+{
+private:
+    typedef detail::lz4_compressor_impl         impl_type;
+    typedef symmetric_filter<impl_type, Alloc>  base_type;
+public:
+    typedef typename base_type::char_type               char_type;
+    typedef typename base_type::category                category;
+    basic_lz4_compressor( const lz4_params& p = lz4_params(),
+                          int buffer_size = default_device_buffer_size)
+        : base_type(buffer_size, p)
+    {
+    }
+};
+BOOST_IOSTREAMS_PIPABLE(basic_lz4_compressor, 1)
+
+typedef basic_lz4_compressor<> lz4_compressor;
+
+//
+// Template name: lz4_decompressor
+// Description: Model of InputFilter and OutputFilter implementing
+//      decompression using lz4.  Concatenated frames are decompressed
+//      one after the other.
+//
+template<typename Alloc = std::allocator<char> >
+struct basic_lz4_decompressor
+    : symmetric_filter<detail::lz4_decompressor_impl, Alloc>
+{
+private:
+    typedef detail::lz4_decompressor_impl       impl_type;
+    typedef symmetric_filter<impl_type, Alloc>  base_type;
+public:
+    typedef typename base_type::char_type               char_type;
+    typedef typename base_type::category                category;
+    basic_lz4_decompressor(int buffer_size = default_device_buffer_size)
+        : base_type(buffer_size)
+    {
+    }
+};
+BOOST_IOSTREAMS_PIPABLE(basic_lz4_decompressor, 1)
+
+typedef basic_lz4_decompressor<> lz4_decompressor;
+
+} } // End namespaces iostreams, boost.
+
+#endif /* __utils__lz4_h__ */
@@ -21,6 +21,7 @@
 #include <boost/iostreams/filter/zlib.hpp> 
 #include <boost/lexical_cast.hpp>
 #include <lzma.h>
+#include <string.h>
 
 namespace boost { namespace iostreams {
 
@@ -103,9 +104,29 @@ lzma_base::lzma_base(bool compress, const lzma_params & params)
     stream_ = init;
     
     lzma_ret res;
-    if (compress_)
+    if (compress_ && params.threads > 1) {
+        lzma_mt mt;
+        memset(&mt, 0, sizeof(mt));
+        mt.threads = params.threads;
+        mt.block_size = 0;  // default: three times the dictionary size
+        mt.preset = params.level;
+        mt.check = (lzma_check)params.crc;
+        res = lzma_stream_encoder_mt(&stream_, &mt);
+    }
+    else if (compress_)
         res = lzma_easy_encoder(&stream_, params.level,
                                 (lzma_check)params.crc);
+#if LZMA_VERSION >= 50040002
+    else if (params.threads > 1) {
+        lzma_mt mt;
+        memset(&mt, 0, sizeof(mt));
+        mt.threads = params.threads;
+        // Falls back to one thread rather than use more than this
+        mt.memlimit_threading = (uint64_t)params.threads * 100 * 1024 * 1024;
+        mt.memlimit_stop = 100 * 1024 * 1024;
+        res = lzma_stream_decoder_mt(&stream_, &mt);
+    }
+#endif
     else
         res = lzma_stream_decoder(&stream_, 100 * 1024 * 1024, 0 /* flags */);
     
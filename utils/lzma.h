@@ -93,11 +93,17 @@ struct lzma_params {
 
     // Non-explicit constructor.
     lzma_params( int level           = lzma::default_compression,
-                 int crc             = lzma::default_crc)
-        : level(level), crc(crc)
+                 int crc             = lzma::default_crc,
+                 int threads         = 1)
+        : level(level), crc(crc), threads(threads)
         { }
     int level;
     int crc;
+
+    // More than one uses the multithreaded encoder (which splits the
+    // output into independently compressed blocks) or decoder (which
+    // decompresses those blocks in parallel).
+    int threads;
 };
 
 //
@@ -169,7 +175,7 @@ public:
 template<typename Alloc = std::allocator<char> >
 class lzma_decompressor_impl : public lzma_base {
 public:
-    lzma_decompressor_impl();
+    lzma_decompressor_impl(const lzma_params& = lzma_params());
     ~lzma_decompressor_impl();
     bool filter( const char*& begin_in, const char* end_in,
                  char*& begin_out, char* end_out, bool flush );
@@ -223,6 +229,8 @@ public:
     typedef typename base_type::char_type               char_type;
     typedef typename base_type::category                category;
     basic_lzma_decompressor(int buffer_size = default_device_buffer_size);
+    basic_lzma_decompressor(const lzma_params& p,
+                            int buffer_size = default_device_buffer_size);
     int total_out() {  return this->filter().total_out(); }
     bool eof() { return this->filter().eof(); }
 };
@@ -268,8 +276,8 @@ lzma_decompressor_impl<Alloc>::~lzma_decompressor_impl()
 }
 
 template<typename Alloc>
-lzma_decompressor_impl<Alloc>::lzma_decompressor_impl()
-    : lzma_base(false), eof_(false)
+lzma_decompressor_impl<Alloc>::lzma_decompressor_impl(const lzma_params& p)
+    : lzma_base(false, p), eof_(false)
 { 
 }
 
@@ -305,6 +313,11 @@ template<typename Alloc>
 basic_lzma_decompressor<Alloc>::basic_lzma_decompressor(int buffer_size)
     : base_type(buffer_size) { }
 
+template<typename Alloc>
+basic_lzma_decompressor<Alloc>::basic_lzma_decompressor
+(const lzma_params& p, int buffer_size)
+    : base_type(buffer_size, p) { }
+
 //----------------------------------------------------------------------------//
 
 } } // End namespaces iostreams, boost.
@@ -0,0 +1,333 @@
+/* parallel_gzip.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Block parallel gzip compression and decompression filters.
+*/
+
+#include "parallel_gzip.h"
+#include "jml/utils/worker_task.h"
+#include "jml/arch/exception.h"
+#include <zlib.h>
+#include <string.h>
+
+
+using namespace std;
+
+
+namespace ML {
+
+
+namespace {
+
+/* Header of each member:
+
+    0   1f 8b     magic
+    2   08        deflate
+    3   04        FLG.FEXTRA
+    4   00000000  no modification time
+    8   00        XFL
+    9   ff        unknown OS
+   10   0800      XLEN = 8
+   12   4a 4d     subfield "JM"
+   14   0400      subfield length 4
+   16   ........  total size of the member, including header and trailer
+
+   then the raw deflate data, the CRC32 and the size of the data (each four
+   bytes, little endian).
+*/
+
+const unsigned char MEMBER_HEADER[16] = {
+    0x1f, 0x8b, 0x08, 0x04, 0, 0, 0, 0, 0x00, 0xff, 8, 0, 'J', 'M', 4, 0
+};
+
+enum {
+    HEADER_LENGTH = Parallel_Gzip_Decompressor::HEADER_LENGTH,
+    TRAILER_LENGTH = 8
+};
+
+void put_le32(char * p, uint32_t val)
+{
+    for (unsigned i = 0;  i < 4;  ++i)
+        p[i] = (val >> (8 * i)) & 0xff;
+}
+
+uint32_t get_le32(const char * p)
+{
+    uint32_t result = 0;
+    for (unsigned i = 0;  i < 4;  ++i)
+        result |= uint32_t((unsigned char)p[i]) << (8 * i);
+    return result;
+}
+
+/** Compress a block into a complete member. */
+void compress_member(const string & block, string & member, int level)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // Negative window bits: raw deflate; we write the wrapper ourselves
+    int res = deflateInit2(&stream, level, Z_DEFLATED, -15, 8,
+                           Z_DEFAULT_STRATEGY);
+    if (res != Z_OK)
+        throw Exception("Parallel_Gzip_Compressor: deflateInit2: %d", res);
+
+    size_t bound = deflateBound(&stream, block.size());
+    member.resize(HEADER_LENGTH + bound + TRAILER_LENGTH);
+
+    stream.next_in = (Bytef *)block.data();
+    stream.avail_in = block.size();
+    stream.next_out = (Bytef *)&member[HEADER_LENGTH];
+    stream.avail_out = bound;
+
+    res = deflate(&stream, Z_FINISH);
+    size_t compressed = stream.total_out;
+    deflateEnd(&stream);
+
+    if (res != Z_STREAM_END)
+        throw Exception("Parallel_Gzip_Compressor: deflate: %d", res);
+
+    size_t total = HEADER_LENGTH + compressed + TRAILER_LENGTH;
+    member.resize(total);
+
+    memcpy(&member[0], MEMBER_HEADER, sizeof(MEMBER_HEADER));
+    put_le32(&member[16], total);
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, (const Bytef *)block.data(), block.size());
+    put_le32(&member[total - 8], crc);
+    put_le32(&member[total - 4], block.size());
+}
+
+/** Decompress a complete member. */
+void decompress_member(const string & member, string & output)
+{
+    const char * trailer = member.data() + member.size() - TRAILER_LENGTH;
+    uint32_t crc_expected = get_le32(trailer);
+    uint32_t size = get_le32(trailer + 4);
+
+    output.resize(size);
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    int res = inflateInit2(&stream, -15);
+    if (res != Z_OK)
+        throw Exception("Parallel_Gzip_Decompressor: inflateInit2: %d", res);
+
+    stream.next_in = (Bytef *)member.data() + HEADER_LENGTH;
+    stream.avail_in = member.size() - HEADER_LENGTH - TRAILER_LENGTH;
+    // zlib won't accept a null output buffer, even for an empty member
+    char dummy;
+    stream.next_out = (Bytef *)(size ? &output[0] : &dummy);
+    stream.avail_out = size;
+
+    res = inflate(&stream, Z_FINISH);
+    size_t decompressed = stream.total_out;
+    inflateEnd(&stream);
+
+    if (res != Z_STREAM_END || decompressed != size)
+        throw Exception("Parallel_Gzip_Decompressor: corrupt member");
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, (const Bytef *)output.data(), output.size());
+    if (crc != crc_expected)
+        throw Exception("Parallel_Gzip_Decompressor: CRC error");
+}
+
+int default_batch_size(int batch_size)
+{
+    if (batch_size > 0) return batch_size;
+    return std::max(2, 2 * num_threads());
+}
+
+} // file scope
+
+
+/*****************************************************************************/
+/* PARALLEL_GZIP_COMPRESSOR                                                  */
+/*****************************************************************************/
+
+struct Parallel_Gzip_Compressor::Itl {
+    Itl(int level, size_t block_size, int blocks_per_batch)
+        : level(level), block_size(block_size),
+          blocks_per_batch(blocks_per_batch), members_written(0)
+    {
+    }
+
+    int level;
+    size_t block_size;
+    int blocks_per_batch;
+    size_t members_written;
+    vector<string> blocks;    ///< Blocks of the current batch; last is open
+    vector<string> members;   ///< Compressed blocks
+};
+
+Parallel_Gzip_Compressor::
+Parallel_Gzip_Compressor(int level, size_t block_size, int blocks_per_batch)
+    : itl(new Itl(level, block_size, default_batch_size(blocks_per_batch)))
+{
+    if (level < -1 || level > 9)
+        throw Exception("Parallel_Gzip_Compressor: invalid level %d", level);
+    if (block_size == 0 || block_size > (1U << 30))
+        throw Exception("Parallel_Gzip_Compressor: invalid block size");
+}
+
+size_t
+Parallel_Gzip_Compressor::
+add(const char * s, size_t n)
+{
+    vector<string> & blocks = itl->blocks;
+    if (blocks.empty() || blocks.back().size() == itl->block_size) {
+        blocks.push_back(string());
+        blocks.back().reserve(itl->block_size);
+    }
+
+    string & block = blocks.back();
+    size_t nb = std::min(n, itl->block_size - block.size());
+    block.append(s, nb);
+    return nb;
+}
+
+bool
+Parallel_Gzip_Compressor::
+batch_full() const
+{
+    return itl->blocks.size() == (size_t)itl->blocks_per_batch
+        && itl->blocks.back().size() == itl->block_size;
+}
+
+void
+Parallel_Gzip_Compressor::
+finish()
+{
+    // An empty file still needs a member to be valid gzip
+    if (itl->blocks.empty() && itl->members_written == 0)
+        itl->blocks.push_back(string());
+}
+
+const std::vector<std::string> &
+Parallel_Gzip_Compressor::
+compress_batch()
+{
+    vector<string> & blocks = itl->blocks;
+    vector<string> & members = itl->members;
+    members.resize(blocks.size());
+
+    auto doBlock = [&] (int i)
+        {
+            compress_member(blocks[i], members[i], itl->level);
+        };
+
+    run_in_parallel(0, (int)blocks.size(), doBlock);
+
+    itl->members_written += blocks.size();
+    blocks.clear();
+    return members;
+}
+
+
+/*****************************************************************************/
+/* PARALLEL_GZIP_DECOMPRESSOR                                                */
+/*****************************************************************************/
+
+struct Parallel_Gzip_Decompressor::Itl {
+    Itl(int members_per_batch)
+        : members_per_batch(members_per_batch), current(0), pos(0)
+    {
+    }
+
+    int members_per_batch;
+    vector<string> members;   ///< Compressed members of the batch
+    vector<string> outputs;   ///< Decompressed members of the batch
+    size_t current;           ///< Output we're reading from
+    size_t pos;               ///< Position in current output
+};
+
+Parallel_Gzip_Decompressor::
+Parallel_Gzip_Decompressor(int members_per_batch)
+    : itl(new Itl(default_batch_size(members_per_batch)))
+{
+}
+
+bool
+Parallel_Gzip_Decompressor::
+is_parallel_gzip(const char * data, size_t length)
+{
+    return length >= HEADER_LENGTH
+        && memcmp(data, MEMBER_HEADER, sizeof(MEMBER_HEADER)) == 0;
+}
+
+bool
+Parallel_Gzip_Decompressor::
+available() const
+{
+    while (itl->current < itl->outputs.size()
+           && itl->pos == itl->outputs[itl->current].size()) {
+        ++itl->current;
+        itl->pos = 0;
+    }
+    return itl->current < itl->outputs.size();
+}
+
+size_t
+Parallel_Gzip_Decompressor::
+take(char * s, size_t n)
+{
+    if (!available()) return 0;
+    const string & output = itl->outputs[itl->current];
+    size_t nb = std::min(n, output.size() - itl->pos);
+    memcpy(s, output.data() + itl->pos, nb);
+    itl->pos += nb;
+    return nb;
+}
+
+std::vector<std::string> &
+Parallel_Gzip_Decompressor::
+start_batch()
+{
+    itl->members.resize(itl->members_per_batch);
+    return itl->members;
+}
+
+size_t
+Parallel_Gzip_Decompressor::
+member_size(const char * header, size_t length) const
+{
+    if (length < HEADER_LENGTH) truncated();
+    if (!is_parallel_gzip(header, length))
+        throw Exception("Parallel_Gzip_Decompressor: member doesn't have "
+                        "its size; not written by Parallel_Gzip_Compressor?");
+    size_t result = get_le32(header + 16);
+    if (result < HEADER_LENGTH + TRAILER_LENGTH)
+        throw Exception("Parallel_Gzip_Decompressor: invalid member size");
+    return result;
+}
+
+bool
+Parallel_Gzip_Decompressor::
+decompress_batch()
+{
+    vector<string> & members = itl->members;
+    vector<string> & outputs = itl->outputs;
+    outputs.resize(members.size());
+
+    auto doMember = [&] (int i)
+        {
+            decompress_member(members[i], outputs[i]);
+        };
+
+    run_in_parallel(0, (int)members.size(), doMember);
+
+    itl->current = 0;
+    itl->pos = 0;
+    return !members.empty();
+}
+
+void
+Parallel_Gzip_Decompressor::
+truncated() const
+{
+    throw Exception("Parallel_Gzip_Decompressor: truncated member");
+}
+
+
+} // namespace ML
@@ -0,0 +1,199 @@
+/* parallel_gzip.h                                                 -*- C++ -*-
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Block parallel gzip compression and decompression filters.
+*/
+
+#ifndef __utils__parallel_gzip_h__
+#define __utils__parallel_gzip_h__
+
+
+#include <boost/iostreams/categories.hpp>
+#include <boost/iostreams/operations.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace ML {
+
+
+/* The output is a series of gzip members, one for each block of input.
+   A gzip file with several members is standard (RFC 1952, section 2.2);
+   gunzip, zcat, pigz and boost's gzip_decompressor all read it as the
+   concatenation of the members.
+
+   Each member carries its own compressed size in an extra field (subfield
+   "JM"), which the tools ignore, so that a reader can find the members
+   without decompressing them and decompress several at once.  This is
+   the same idea as the BGZF format used for genomics data.
+*/
+
+
+/*****************************************************************************/
+/* PARALLEL_GZIP_COMPRESSOR                                                  */
+/*****************************************************************************/
+
+/** Output filter that splits the data into blocks, and compresses a batch
+    of them at a time on the worker task threads. */
+
+struct Parallel_Gzip_Compressor {
+    typedef char char_type;
+    struct category
+        : boost::iostreams::multichar_output_filter_tag,
+          boost::iostreams::closable_tag {
+    };
+
+    enum { DEFAULT_BLOCK_SIZE = 1024 * 1024 };
+
+    /** The level is that of zlib (0-9 or -1 for the default).  A batch of
+        blocks_per_batch blocks (by default, twice the number of threads)
+        is compressed at once. */
+    Parallel_Gzip_Compressor(int level = -1,
+                             size_t block_size = DEFAULT_BLOCK_SIZE,
+                             int blocks_per_batch = -1);
+
+    template<typename Sink>
+    std::streamsize write(Sink & sink, const char * s, std::streamsize n)
+    {
+        std::streamsize done = 0;
+        while (done < n) {
+            done += add(s + done, n - done);
+            if (batch_full()) write_batch(sink);
+        }
+        return n;
+    }
+
+    template<typename Sink>
+    void close(Sink & sink)
+    {
+        finish();
+        write_batch(sink);
+    }
+
+private:
+    struct Itl;
+    std::shared_ptr<Itl> itl;
+
+    /** Add as much of the data as fits in the current batch, and return
+        how much that was. */
+    size_t add(const char * s, size_t n);
+
+    bool batch_full() const;
+
+    /** Last block; make sure that there is at least one member. */
+    void finish();
+
+    /** Compress the blocks of the batch in parallel, and return the
+        members in order. */
+    const std::vector<std::string> & compress_batch();
+
+    template<typename Sink>
+    void write_batch(Sink & sink)
+    {
+        const std::vector<std::string> & members = compress_batch();
+        for (unsigned i = 0;  i < members.size();  ++i)
+            boost::iostreams::write(sink, members[i].data(),
+                                    members[i].size());
+    }
+};
+
+
+/*****************************************************************************/
+/* PARALLEL_GZIP_DECOMPRESSOR                                                */
+/*****************************************************************************/
+
+/** Input filter for the output of the Parallel_Gzip_Compressor, which
+    reads a batch of members at a time and decompresses them on the worker
+    task threads.  Every member must have its size; other gzip data needs
+    the normal gzip_decompressor (see is_parallel_gzip()). */
+
+struct Parallel_Gzip_Decompressor {
+    typedef char char_type;
+    typedef boost::iostreams::multichar_input_filter_tag category;
+
+    Parallel_Gzip_Decompressor(int members_per_batch = -1);
+
+    template<typename Source>
+    std::streamsize read(Source & src, char * s, std::streamsize n)
+    {
+        std::streamsize done = 0;
+        while (done < n) {
+            if (!available() && !read_batch(src)) break;
+            done += take(s + done, n - done);
+        }
+        return (done == 0 ? -1 : done);
+    }
+
+    /** Length of the header that is_parallel_gzip() needs to look at. */
+    enum { HEADER_LENGTH = 20 };
+
+    /** Does the data (which is the start of a file, of at least
+        HEADER_LENGTH bytes) look like a member written by the
+        Parallel_Gzip_Compressor? */
+    static bool is_parallel_gzip(const char * data, size_t length);
+
+private:
+    struct Itl;
+    std::shared_ptr<Itl> itl;
+
+    /** Is there any decompressed data left? */
+    bool available() const;
+
+    /** Take up to n bytes of decompressed data. */
+    size_t take(char * s, size_t n);
+
+    /** Read the batch's members into the input buffers, and decompress
+        them.  Returns false at the end of the data. */
+    template<typename Source>
+    bool read_batch(Source & src)
+    {
+        std::vector<std::string> & members = start_batch();
+        for (unsigned i = 0;  i < members.size();  ++i) {
+            std::string & member = members[i];
+            member.resize(HEADER_LENGTH);
+            size_t got = read_fully(src, &member[0], HEADER_LENGTH);
+            if (got == 0) {
+                members.resize(i);
+                break;
+            }
+            member.resize(member_size(member.data(), got));
+            read_fully(src, &member[HEADER_LENGTH],
+                       member.size() - HEADER_LENGTH,
+                       true /* must have all */);
+        }
+
+        return decompress_batch();
+    }
+
+    template<typename Source>
+    size_t read_fully(Source & src, char * s, size_t n, bool must = false)
+    {
+        size_t done = 0;
+        while (done < n) {
+            std::streamsize res = boost::iostreams::read(src, s + done,
+                                                         n - done);
+            if (res <= 0) break;
+            done += res;
+        }
+        if (must && done < n) truncated();
+        return done;
+    }
+
+    std::vector<std::string> & start_batch();
+
+    /** Total size of the member with the given header; throws if it's not
+        a parallel gzip member. */
+    size_t member_size(const char * header, size_t length) const;
+
+    bool decompress_batch();
+
+    void truncated() const;
+};
+
+
+} // namespace ML
+
+
+#endif /* __utils__parallel_gzip_h__ */
@@ -0,0 +1,150 @@
+/* parallel_sort.h                                                 -*- C++ -*-
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Multithreaded sort of a vector.
+*/
+
+#ifndef __utils__parallel_sort_h__
+#define __utils__parallel_sort_h__
+
+
+#include "jml/utils/worker_task.h"
+#include <algorithm>
+#include <vector>
+
+
+namespace ML {
+
+
+/** Sort the vector with the given comparison, using the worker task.
+    The vector is split into num_blocks (by default num_threads()) pieces
+    which are sorted at the same time, and then pairs of sorted runs are
+    merged until only one is left.  Each merge is itself split into
+    independent pieces by binary search, so that all of the threads are
+    busy until the end.
+
+    Small vectors (less than min_block_size elements per block) are
+    sorted with std::sort directly.  Like std::sort, the order of equal
+    elements is unspecified.  Needs a temporary copy of the vector.
+*/
+template<typename T, typename Alloc, typename Compare>
+void parallel_sort(std::vector<T, Alloc> & v, Compare cmp,
+                   int num_blocks = -1, size_t min_block_size = 16384)
+{
+    typedef typename std::vector<T, Alloc>::iterator It;
+
+    size_t n = v.size();
+    if (num_blocks == -1) num_blocks = num_threads();
+    num_blocks = std::min<size_t>(num_blocks,
+                                  n / std::max<size_t>(min_block_size, 1));
+
+    if (num_blocks <= 1) {
+        std::sort(v.begin(), v.end(), cmp);
+        return;
+    }
+
+    // Sorted runs are [bounds[i], bounds[i + 1])
+    std::vector<size_t> bounds;
+    for (unsigned i = 0;  i <= num_blocks;  ++i)
+        bounds.push_back(n * i / num_blocks);
+
+    auto sortBlock = [&] (int b)
+        {
+            std::sort(v.begin() + bounds[b], v.begin() + bounds[b + 1], cmp);
+        };
+
+    run_in_parallel(0, num_blocks, sortBlock);
+
+    std::vector<T, Alloc> buffer(n);
+    It src = v.begin(), dst = buffer.begin();
+
+    /* A piece of a merge: [first1, last1) and [first2, last2) of src are
+       merged into dst starting at out. */
+    struct Merge_Job {
+        size_t first1, last1, first2, last2, out;
+    };
+
+    while (bounds.size() > 2) {
+        std::vector<Merge_Job> jobs;
+        std::vector<size_t> new_bounds;
+
+        int nruns = bounds.size() - 1;
+
+        for (int r = 0;  r < nruns;  r += 2) {
+            new_bounds.push_back(bounds[r]);
+
+            if (r + 1 == nruns) {
+                // Odd one out; just copied across
+                Merge_Job job = { bounds[r], bounds[r + 1],
+                                  bounds[r + 1], bounds[r + 1], bounds[r] };
+                jobs.push_back(job);
+                continue;
+            }
+
+            size_t f1 = bounds[r], l1 = bounds[r + 1];
+            size_t f2 = bounds[r + 1], l2 = bounds[r + 2];
+
+            // Split into pieces at elements of the longer run.  Equal
+            // elements go first from the first run, as in std::merge.
+            int pieces = std::max(1, num_blocks / (nruns / 2));
+            size_t i0 = f1, j0 = f2;
+            for (int p = 1;  p <= pieces;  ++p) {
+                size_t i1, j1;
+                if (p == pieces) {
+                    i1 = l1;
+                    j1 = l2;
+                }
+                else if (l1 - f1 >= l2 - f2) {
+                    i1 = f1 + (l1 - f1) * p / pieces;
+                    j1 = std::lower_bound(src + f2, src + l2, src[i1], cmp)
+                        - src;
+                }
+                else {
+                    j1 = f2 + (l2 - f2) * p / pieces;
+                    i1 = std::upper_bound(src + f1, src + l1, src[j1], cmp)
+                        - src;
+                }
+
+                i1 = std::max(i1, i0);
+                j1 = std::max(j1, j0);
+
+                Merge_Job job = { i0, i1, j0, j1, i0 + (j0 - f2) };
+                jobs.push_back(job);
+
+                i0 = i1;
+                j0 = j1;
+            }
+        }
+
+        new_bounds.push_back(n);
+
+        auto doJob = [&] (int j)
+            {
+                const Merge_Job & job = jobs[j];
+                std::merge(src + job.first1, src + job.last1,
+                           src + job.first2, src + job.last2,
+                           dst + job.out, cmp);
+            };
+
+        run_in_parallel(0, (int)jobs.size(), doJob);
+
+        std::swap(src, dst);
+        bounds.swap(new_bounds);
+    }
+
+    if (src != v.begin())
+        v.swap(buffer);
+}
+
+template<typename T, typename Alloc>
+void parallel_sort(std::vector<T, Alloc> & v)
+{
+    parallel_sort(v, std::less<T>());
+}
+
+
+} // namespace ML
+
+
+#endif /* __utils__parallel_sort_h__ */
@@ -15,7 +15,12 @@
 #include "fast_int_parsing.h"
 #include "fast_float_parsing.h"
 #include "jml/utils/file_functions.h"
+#include "jml/utils/guard.h"
+#include "jml/utils/ring_buffer.h"
 #include <cassert>
+#include <atomic>
+#include <thread>
+#include <algorithm>
 #include <boost/scoped_array.hpp>
 
 
@@ -25,6 +30,120 @@ using namespace std;
 namespace ML {
 
 
+/*****************************************************************************/
+/* PARSE_CONTEXT::READ_AHEAD                                                 */
+/*****************************************************************************/
+
+/** A thread that reads chunks of the stream and pushes them onto a ring
+    buffer, from which read_new_buffer() takes them.  The chunks are
+    allocated with new[] and become the Parse_Context's buffers as they
+    are. */
+
+struct Parse_Context::Read_Ahead {
+
+    struct Chunk {
+        Chunk(char * data = 0, size_t size = 0)
+            : data(data), size(size)
+        {
+        }
+
+        char * data;   ///< Zero marks the end of the stream (or an error)
+        size_t size;
+    };
+
+    Read_Ahead(std::istream & stream, size_t chunk_size, int num_chunks)
+        : stream(stream), chunk_size(chunk_size), num_chunks(num_chunks),
+          queue(num_chunks + 1), queued(0), shutdown(false), finished(false)
+    {
+        thread = std::thread(&Read_Ahead::run, this);
+    }
+
+    ~Read_Ahead()
+    {
+        stop([] (const Chunk & chunk) { delete[] chunk.data; });
+    }
+
+    std::istream & stream;
+    size_t chunk_size;
+    int num_chunks;
+
+    RingBufferSRMW<Chunk> queue;
+    std::atomic<size_t> queued;  ///< Characters read but not yet taken
+    std::atomic<bool> shutdown;
+    bool finished;               ///< Have we seen the end of the stream?
+    std::string error;           ///< Set by the thread if reading failed
+    std::thread thread;
+
+    /** Take the next chunk, waiting until it's been read.  Returns false
+        at the end of the stream, with error set if it failed. */
+    bool next(Chunk & chunk)
+    {
+        if (finished) return false;
+
+        chunk = queue.pop();
+        if (!chunk.data) {
+            finished = true;
+            thread.join();
+            return false;
+        }
+
+        queued -= chunk.size;
+        return true;
+    }
+
+    /** Stop the thread, passing the chunks it already read to keep. */
+    template<typename Keep>
+    void stop(Keep keep)
+    {
+        shutdown = true;
+
+        // Drain the queue so that the thread can't be blocked on a full one
+        Chunk chunk;
+        while (next(chunk))
+            keep(chunk);
+
+        if (thread.joinable())
+            thread.join();
+    }
+
+    void run()
+    {
+        // Make sure that the consumer always gets our end marker
+        Call_Guard guard([&] () { queue.push(Chunk()); });
+
+        try {
+            while (!shutdown && !stream.eof()) {
+                if (stream.bad() || stream.fail())
+                    throw Exception("stream is bad/has failed 1");
+
+                std::unique_ptr<char[]> data(new char[chunk_size]);
+                stream.read(data.get(), chunk_size);
+                size_t read = stream.gcount();
+
+                if (stream.bad())
+                    throw Exception("stream is bad/has failed 2");
+                if (read == 0) break;
+
+                // A short read (normally the last one) gets a chunk of its
+                // own size, so that it doesn't hold on to the whole chunk
+                if (read < chunk_size) {
+                    std::unique_ptr<char[]> exact(new char[read]);
+                    std::copy(data.get(), data.get() + read, exact.get());
+                    data.swap(exact);
+                }
+
+                queued += read;
+                queue.push(Chunk(data.release(), read));
+            }
+        } catch (const std::exception & exc) {
+            error = exc.what();
+        } catch (...) {
+            error = "unknown exception";
+        }
+    }
+};
+
+
 /*****************************************************************************/
 /* PARSE_CONTEXT                                                             */
 /*****************************************************************************/
@@ -88,11 +207,15 @@ Parse_Context(const File_Read_Buffer & buf)
 
 Parse_Context::
 Parse_Context(const std::string & filename, std::istream & stream,
-              unsigned line, unsigned col, size_t chunk_size)
+              unsigned line, unsigned col, size_t chunk_size,
+              int readahead_chunks)
     : stream_(&stream), chunk_size_(chunk_size),
       first_token_(0), last_token_(0), filename_(filename), cur_(0), ebuf_(0),
       line_(line), col_(col), ofs_(0)
 {
+    if (readahead_chunks > 0)
+        set_readahead(readahead_chunks);
+
     current_ = read_new_buffer();
 
     if (current_ != buffers_.end()) {
@@ -110,6 +233,7 @@ void
 Parse_Context::
 init(const std::string & filename)
 {
+    read_ahead_.reset();
     stream_ = 0;
     chunk_size_ = 0;
     first_token_ = 0;
@@ -533,6 +657,20 @@ read_new_buffer()
 {
     if (!stream_) return buffers_.end();
 
+    if (read_ahead_) {
+        Read_Ahead::Chunk chunk;
+        if (!read_ahead_->next(chunk)) {
+            if (read_ahead_->error != "")
+                exception(read_ahead_->error);
+            return buffers_.end();
+        }
+
+        uint64_t last_ofs = (buffers_.empty() ? ofs_
+                             : buffers_.back().ofs + buffers_.back().size);
+        return buffers_.insert(buffers_.end(),
+                               Buffer(last_ofs, chunk.data, chunk.size, true));
+    }
+
     if (stream_->eof()) return buffers_.end();
 
     //cerr << "stream is OK" << endl;
@@ -584,7 +722,52 @@ set_chunk_size(size_t size)
 {
     if (size == 0)
         throw Exception("Parse_Context::chunk_size(): invalid chunk size");
+
+    // The read ahead thread needs to start again with the new size
+    int readahead = get_readahead();
+    stop_readahead();
     chunk_size_ = size;
+    if (readahead) set_readahead(readahead);
+}
+
+void
+Parse_Context::
+set_readahead(int num_chunks)
+{
+    if (num_chunks < 0)
+        throw Exception("Parse_Context::set_readahead(): invalid number of "
+                        "chunks");
+
+    stop_readahead();
+
+    if (num_chunks > 0 && stream_)
+        read_ahead_.reset(new Read_Ahead(*stream_, chunk_size_, num_chunks));
+}
+
+int
+Parse_Context::
+get_readahead() const
+{
+    return (read_ahead_ ? read_ahead_->num_chunks : 0);
+}
+
+void
+Parse_Context::
+stop_readahead()
+{
+    if (!read_ahead_) return;
+
+    // Anything already read goes on the end of our buffers
+    auto keep = [&] (const Read_Ahead::Chunk & chunk)
+        {
+            uint64_t last_ofs = (buffers_.empty() ? ofs_
+                                 : buffers_.back().ofs + buffers_.back().size);
+            buffers_.insert(buffers_.end(),
+                            Buffer(last_ofs, chunk.data, chunk.size, true));
+        };
+
+    read_ahead_->stop(keep);
+    read_ahead_.reset();
 }
 
 size_t
@@ -601,7 +784,9 @@ readahead_available() const
         in_future_buffers += it->size;
     }
 
-    return in_current_buffer + in_future_buffers;
+    size_t in_background = (read_ahead_ ? read_ahead_->queued.load() : 0);
+
+    return in_current_buffer + in_future_buffers + in_background;
 }
 
 size_t
@@ -30,6 +30,7 @@
 #include <string>
 #include <iostream>
 #include <list>
+#include <memory>
 #include <limits.h>
 #include <string.h>
 #include <stdint.h>
@@ -69,10 +70,15 @@ struct Parse_Context {
     /** Default chunk size. */
     enum { DEFAULT_CHUNK_SIZE = 65500 };
 
-    /** Initialize from an istream. */
+    /** Default number of chunks to read ahead (see set_readahead()). */
+    enum { DEFAULT_READAHEAD_CHUNKS = 16 };
+
+    /** Initialize from an istream.  If readahead_chunks is non-zero, the
+        stream is read in the background (see set_readahead()). */
     Parse_Context(const std::string & filename, std::istream & stream,
                   unsigned line = 1, unsigned col = 1,
-                  size_t chunk_size = DEFAULT_CHUNK_SIZE);
+                  size_t chunk_size = DEFAULT_CHUNK_SIZE,
+                  int readahead_chunks = 0);
 
     ~Parse_Context();
 
@@ -99,7 +105,20 @@ struct Parse_Context {
     /** Get the chunk size. */
     size_t get_chunk_size() const { return chunk_size_; }
 
-    /** How many characters are available to read ahead from? */
+    /** Read the stream in the background.  A thread reads up to num_chunks
+        chunks ahead of the parser into a ring buffer, so that reading
+        (for example, decompressing a filter_istream) and parsing happen
+        at the same time.  Zero turns it off again, keeping what was
+        already read.  Only useful when initialized from a stream, which
+        mustn't be used by anything else while reading ahead. */
+    void set_readahead(int num_chunks = DEFAULT_READAHEAD_CHUNKS);
+
+    /** Number of chunks read ahead in the background; zero if off. */
+    int get_readahead() const;
+
+    /** How many characters are available to read ahead from?  When
+        reading ahead, this includes those that have been read in the
+        background but not yet used. */
     size_t readahead_available() const;
 
     /** How many characters are buffered in total, both before and after
@@ -715,6 +734,13 @@ private:
     std::istream * stream_;   ///< Stream we read from; zero if none
     size_t chunk_size_;       ///< Size of chunks we read in
 
+    /** Background reading of the stream; defined in parse_context.cc. */
+    struct Read_Ahead;
+    std::shared_ptr<Read_Ahead> read_ahead_;  ///< Zero unless reading ahead
+
+    /** Stop reading ahead, keeping the chunks that were already read. */
+    void stop_readahead();
+
     Token * first_token_;     ///< The earliest token
     Token * last_token_;      ///< The latest token
 
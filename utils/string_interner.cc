@@ -0,0 +1,232 @@
+/* string_interner.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Implementation of the string interner.
+*/
+
+#include "string_interner.h"
+#include <functional>
+#include <mutex>
+
+
+using namespace std;
+
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* STRING_INTERNER                                                           */
+/*****************************************************************************/
+
+namespace {
+
+enum { INITIAL_CAPACITY = 16 };
+
+inline uint64_t hash_string(const std::string & str)
+{
+    return std::hash<std::string>()(str);
+}
+
+/** Slots hold the top half of the hash, so that most mismatches can be
+    rejected without looking at the string, and the id plus one, so that
+    zero means empty. */
+inline uint64_t make_slot(uint64_t hash, int id)
+{
+    return (hash & 0xffffffff00000000ULL) | uint32_t(id + 1);
+}
+
+inline bool slot_matches(uint64_t slot, uint64_t hash)
+{
+    return (slot >> 32) == (hash >> 32);
+}
+
+inline int slot_id(uint64_t slot)
+{
+    return uint32_t(slot) - 1;
+}
+
+} // file scope
+
+struct String_Interner::Table {
+    Table(size_t capacity)
+        : mask(capacity - 1), slots(new std::atomic<uint64_t>[capacity])
+    {
+        for (size_t i = 0;  i < capacity;  ++i)
+            slots[i] = 0;
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+    size_t mask;
+    std::unique_ptr<std::atomic<uint64_t>[]> slots;
+};
+
+String_Interner::
+String_Interner()
+    : table_(0), indexed_(0)
+{
+    clear();
+}
+
+String_Interner::
+String_Interner(const String_Interner & other)
+    : table_(0), indexed_(0)
+{
+    clear();
+    *this = other;
+}
+
+String_Interner::
+~String_Interner()
+{
+}
+
+String_Interner &
+String_Interner::
+operator = (const String_Interner & other)
+{
+    if (&other == this) return *this;
+    clear();
+    size_t n = other.size();
+    for (size_t i = 0;  i < n;  ++i)
+        append(other[i]);
+    return *this;
+}
+
+int
+String_Interner::
+intern(const std::string & str)
+{
+    uint64_t hash = hash_string(str);
+    int id = find(str, hash);
+    if (id != -1) return id;
+
+    std::lock_guard<Spinlock> guard(lock_);
+
+    // Someone may have beaten us to it
+    id = find(str, hash);
+    if (id != -1) return id;
+
+    return add(str, hash, true /* index */);
+}
+
+int
+String_Interner::
+append(const std::string & str)
+{
+    uint64_t hash = hash_string(str);
+    std::lock_guard<Spinlock> guard(lock_);
+
+    // A duplicate takes over the existing slot, so the last one wins
+    Table * table = table_.load(std::memory_order_relaxed);
+    for (size_t i = hash & table->mask;  ;  i = (i + 1) & table->mask) {
+        uint64_t slot = table->slots[i].load(std::memory_order_relaxed);
+        if (!slot) break;
+        if (slot_matches(slot, hash) && strings_[slot_id(slot)] == str) {
+            int id = add(str, hash, false /* index */);
+            table->slots[i].store(make_slot(hash, id),
+                                  std::memory_order_release);
+            return id;
+        }
+    }
+
+    return add(str, hash, true /* index */);
+}
+
+int
+String_Interner::
+lookup(const std::string & str) const
+{
+    return find(str, hash_string(str));
+}
+
+const std::string &
+String_Interner::
+at(int id) const
+{
+    if (id < 0 || id >= (int)size())
+        throw Exception("String_Interner::at(): id %d out of range", id);
+    return strings_[id];
+}
+
+std::vector<std::string>
+String_Interner::
+strings() const
+{
+    size_t n = size();
+    vector<string> result;
+    result.reserve(n);
+    for (size_t i = 0;  i < n;  ++i)
+        result.push_back(strings_[i]);
+    return result;
+}
+
+void
+String_Interner::
+clear()
+{
+    strings_.clear();
+    indexed_ = 0;
+    tables_.clear();
+    tables_.push_back(std::make_shared<Table>(INITIAL_CAPACITY));
+    table_ = tables_.back().get();
+}
+
+int
+String_Interner::
+find(const std::string & str, uint64_t hash) const
+{
+    const Table * table = table_.load(std::memory_order_acquire);
+
+    // Never full, so there is always an empty slot to stop us
+    for (size_t i = hash & table->mask;  ;  i = (i + 1) & table->mask) {
+        uint64_t slot = table->slots[i].load(std::memory_order_acquire);
+        if (!slot) return -1;
+        if (slot_matches(slot, hash)) {
+            int id = slot_id(slot);
+            if (strings_[id] == str) return id;
+        }
+    }
+}
+
+int
+String_Interner::
+add(const std::string & str, uint64_t hash, bool index)
+{
+    // Published before the slot, so readers that find it can use it
+    int id = strings_.size();
+    strings_.push_back(str);
+
+    if (!index) return id;
+
+    Table * table = table_.load(std::memory_order_relaxed);
+    if ((indexed_ + 1) * 2 > table->capacity()) {
+        // Rebuild a bigger one off to the side, then swap it in.  Readers
+        // may carry on with the old one, which stays consistent.
+        auto bigger = std::make_shared<Table>(table->capacity() * 2);
+        for (size_t i = 0;  i < table->capacity();  ++i) {
+            uint64_t slot = table->slots[i].load(std::memory_order_relaxed);
+            if (!slot) continue;
+            uint64_t h = hash_string(strings_[slot_id(slot)]);
+            size_t j = h & bigger->mask;
+            while (bigger->slots[j].load(std::memory_order_relaxed))
+                j = (j + 1) & bigger->mask;
+            bigger->slots[j].store(slot, std::memory_order_relaxed);
+        }
+        tables_.push_back(bigger);
+        table = bigger.get();
+        table_.store(table, std::memory_order_release);
+    }
+
+    size_t i = hash & table->mask;
+    while (table->slots[i].load(std::memory_order_relaxed))
+        i = (i + 1) & table->mask;
+    table->slots[i].store(make_slot(hash, id), std::memory_order_release);
+    ++indexed_;
+
+    return id;
+}
+
+} // namespace ML
@@ -0,0 +1,223 @@
+/* string_interner.h                                               -*- C++ -*-
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Concurrent table mapping strings (feature names, categorical values)
+   onto small, stable integer ids.
+*/
+
+#ifndef __utils__string_interner_h__
+#define __utils__string_interner_h__
+
+#include "jml/arch/spinlock.h"
+#include "jml/arch/exception.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <new>
+#include <stdint.h>
+
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* APPEND_ONLY_ARRAY                                                         */
+/*****************************************************************************/
+
+/** An array that can only grow at its end, and whose elements never move
+    once added.  Elements live in segments which double in size, so a
+    reference to an element stays valid until clear() is called.
+
+    Only one thread at a time may call push_back() (the caller provides the
+    locking), but any number of threads may concurrently read the elements
+    below size() without any locking at all.
+*/
+
+template<typename T>
+struct Append_Only_Array {
+
+    Append_Only_Array()
+        : size_(0)
+    {
+        for (unsigned i = 0;  i < NUM_SEGMENTS;  ++i)
+            segments_[i] = 0;
+    }
+
+    Append_Only_Array(const Append_Only_Array & other)
+        : size_(0)
+    {
+        for (unsigned i = 0;  i < NUM_SEGMENTS;  ++i)
+            segments_[i] = 0;
+        *this = other;
+    }
+
+    Append_Only_Array & operator = (const Append_Only_Array & other)
+    {
+        if (&other == this) return *this;
+        clear();
+        size_t n = other.size();
+        for (size_t i = 0;  i < n;  ++i)
+            push_back(other[i]);
+        return *this;
+    }
+
+    ~Append_Only_Array()
+    {
+        clear();
+    }
+
+    size_t size() const { return size_.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+
+    const T & operator [] (size_t index) const { return *element(index); }
+    T & operator [] (size_t index) { return *element(index); }
+
+    const T & at(size_t index) const
+    {
+        if (index >= size())
+            throw Exception("Append_Only_Array::at(): index out of range");
+        return *element(index);
+    }
+
+    T & at(size_t index)
+    {
+        if (index >= size())
+            throw Exception("Append_Only_Array::at(): index out of range");
+        return *element(index);
+    }
+
+    /** Add an element to the end.  Readers see it once size() includes
+        it. */
+    void push_back(const T & value)
+    {
+        size_t n = size_.load(std::memory_order_relaxed);
+        int segment;
+        size_t offset;
+        locate(n, segment, offset);
+
+        T * storage = segments_[segment].load(std::memory_order_relaxed);
+        if (!storage) {
+            storage = (T *)::operator new(sizeof(T) * segment_size(segment));
+            segments_[segment].store(storage, std::memory_order_release);
+        }
+
+        new (storage + offset) T(value);
+        size_.store(n + 1, std::memory_order_release);
+    }
+
+    /** Remove everything.  Not thread safe. */
+    void clear()
+    {
+        size_t n = size_.load(std::memory_order_relaxed);
+        for (size_t i = 0;  i < n;  ++i)
+            element(i)->~T();
+        size_.store(0, std::memory_order_relaxed);
+
+        for (unsigned i = 0;  i < NUM_SEGMENTS;  ++i) {
+            ::operator delete(segments_[i].load(std::memory_order_relaxed));
+            segments_[i] = 0;
+        }
+    }
+
+private:
+    enum {
+        FIRST_SEGMENT_BITS = 4,  ///< First segment holds 16 elements
+        NUM_SEGMENTS = 48
+    };
+
+    std::atomic<T *> segments_[NUM_SEGMENTS];
+    std::atomic<size_t> size_;
+
+    static size_t segment_size(int segment)
+    {
+        return size_t(1) << (segment + FIRST_SEGMENT_BITS);
+    }
+
+    static void locate(size_t index, int & segment, size_t & offset)
+    {
+        size_t biased = index + segment_size(0);
+        segment = (63 - __builtin_clzll(biased)) - FIRST_SEGMENT_BITS;
+        offset = biased - segment_size(segment);
+    }
+
+    T * element(size_t index) const
+    {
+        int segment;
+        size_t offset;
+        locate(index, segment, offset);
+        return segments_[segment].load(std::memory_order_acquire) + offset;
+    }
+};
+
+
+/*****************************************************************************/
+/* STRING_INTERNER                                                           */
+/*****************************************************************************/
+
+/** Maps strings onto ids, allocated densely from zero in the order in which
+    the strings are first seen.  An id, and the string it refers to, never
+    change once allocated.
+
+    This is made for loading data on many threads, where almost every string
+    has been seen before: looking up a string or an id never locks, and only
+    adding a new string takes a (short) lock.
+*/
+
+struct String_Interner {
+
+    String_Interner();
+    String_Interner(const String_Interner & other);
+    ~String_Interner();
+
+    String_Interner & operator = (const String_Interner & other);
+
+    /** Return the id of the given string, adding it if it isn't there
+        already.  Lock free when it is. */
+    int intern(const std::string & str);
+
+    /** Add the given string under a new id, even if it's already there
+        (in which case lookup() and intern() return the new id from then
+        on, so the last of any duplicates wins).  This is for reconstructing
+        lists that have duplicates in them. */
+    int append(const std::string & str);
+
+    /** Return the id of the given string, or -1 if it isn't there. */
+    int lookup(const std::string & str) const;
+
+    /** Return the string with the given id, which must exist. */
+    const std::string & operator [] (int id) const { return strings_[id]; }
+
+    /** Return the string with the given id, throwing if it doesn't exist. */
+    const std::string & at(int id) const;
+
+    size_t size() const { return strings_.size(); }
+    bool empty() const { return strings_.empty(); }
+
+    /** Return all strings, in order of their id. */
+    std::vector<std::string> strings() const;
+
+    /** Remove everything.  Not thread safe. */
+    void clear();
+
+private:
+    struct Table;
+
+    /** Open addressed hash table of (hash tag, id + 1) pairs.  It is
+        replaced by a bigger one when it gets half full; the old ones
+        stay alive until clear() as readers may still be using them. */
+    std::atomic<Table *> table_;
+    std::vector<std::shared_ptr<Table> > tables_;
+    size_t indexed_;  ///< Number of slots used in table_
+
+    Append_Only_Array<std::string> strings_;
+    mutable Spinlock lock_;
+
+    int find(const std::string & str, uint64_t hash) const;
+    int add(const std::string & str, uint64_t hash, bool index);
+};
+
+} // namespace ML
+
+#endif /* __utils__string_interner_h__ */
@@ -26,6 +26,7 @@
 #include "jml/utils/guard.h"
 #include "jml/arch/exception_handler.h"
 #include "jml/arch/demangle.h"
+#include "jml/arch/format.h"
 
 using namespace std;
 namespace fs = boost::filesystem;
@@ -171,6 +172,117 @@ BOOST_AUTO_TEST_CASE( test_compress_decompress_xz )
     test_compress_decompress(input_file, "xz", "xz", "xz -d");
 }
 
+BOOST_AUTO_TEST_CASE( test_parallel_compression )
+{
+    // Several blocks and batches, with an odd sized last block
+    string data;
+    for (unsigned i = 0;  data.size() < 5000000;  ++i)
+        data += format("line %d %d\n", i, i * i % 1001);
+
+    string input_file = "filter_streams_test-parallel";
+    Call_Guard guard(boost::bind(&::unlink, input_file.c_str()));
+    {
+        ofstream stream(input_file.c_str());
+        stream << data;
+    }
+
+    vector<pair<string, string> > formats = {
+        { "pgz", "gz" }, { "pxz", "xz" }
+    };
+
+    for (const auto & f: formats) {
+        const string & compression = f.first;
+        const string & extension = f.second;
+        string cmp = input_file + "." + extension;
+        string dec1 = input_file + ".1";
+        string dec2 = input_file + ".2";
+
+        Call_Guard guard1(boost::bind(&::unlink, cmp.c_str()));
+        {
+            filter_ostream stream(cmp, ios::out, compression);
+            stream << data;
+        }
+
+        // Stock tools read it
+        Call_Guard guard2(boost::bind(&::unlink, dec1.c_str()));
+        decompress_using_tool(cmp, dec1, extension == "gz"
+                              ? "gzip -d" : "xz -d");
+        assert_files_identical(input_file, dec1);
+
+        Call_Guard guard3(boost::bind(&::unlink, dec2.c_str()));
+        decompress_using_stream(cmp, dec2);
+        assert_files_identical(input_file, dec2);
+
+        filter_istream stream(cmp);
+        string read((istreambuf_iterator<char>(stream)),
+                    istreambuf_iterator<char>());
+        BOOST_CHECK(read == data);
+    }
+
+    // Empty data is still valid gzip
+    string empty = input_file + ".empty.gz";
+    Call_Guard guard4(boost::bind(&::unlink, empty.c_str()));
+    {
+        filter_ostream stream(empty, ios::out, "pgz");
+    }
+    system("gzip -t " + empty);
+    {
+        filter_istream stream(empty);
+        string read((istreambuf_iterator<char>(stream)),
+                    istreambuf_iterator<char>());
+        BOOST_CHECK_EQUAL(read, "");
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_zstd_lz4 )
+{
+    string data;
+    for (unsigned i = 0;  data.size() < 3000000;  ++i)
+        data += format("line %d %d\n", i, i * i % 1001);
+
+    // Extension, then explicit compression with levels
+    vector<pair<string, int> > formats = {
+        { "", -1 }, { "zstd", 1 }, { "zstd", 19 }, { "lz4", 9 }
+    };
+
+    for (string ext: { "zst", "lz4" }) {
+        for (const auto & f: formats) {
+            if (f.first != "" && ext.find(f.first.substr(0, 2)) != 0)
+                continue;
+
+            string filename = "filter_streams_test-levels." + ext;
+            FileCleanup cleanup(filename);
+            {
+                filter_ostream stream(filename, ios::out, f.first, f.second);
+                stream << data;
+            }
+            BOOST_CHECK(get_file_size(filename) < data.size() / 2);
+
+            filter_istream stream(filename);
+            string read((istreambuf_iterator<char>(stream)),
+                        istreambuf_iterator<char>());
+            BOOST_CHECK(read == data);
+        }
+
+        // Truncated data is an error, not a short read
+        string filename = "filter_streams_test-truncated." + ext;
+        FileCleanup cleanup(filename);
+        {
+            filter_ostream stream(filename);
+            stream << data;
+        }
+        BOOST_REQUIRE_EQUAL(truncate(filename.c_str(),
+                                     get_file_size(filename) / 2), 0);
+        {
+            JML_TRACE_EXCEPTIONS(false);
+            filter_istream stream(filename);
+            BOOST_CHECK_THROW(string((istreambuf_iterator<char>(stream)),
+                                     istreambuf_iterator<char>()),
+                              std::exception);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE( test_open_failure )
 {
     filter_ostream stream;
@@ -202,13 +314,28 @@ BOOST_AUTO_TEST_CASE( test_write_failure )
     }
 }
 
-/* ensures that empty gz/bzip2/xz streams have a valid header */
+BOOST_AUTO_TEST_CASE( test_compression_from_filename )
+{
+    BOOST_CHECK_EQUAL(compressionFromFilename("model.cls.gz"), "gz");
+    BOOST_CHECK_EQUAL(compressionFromFilename("model.cls.gz~"), "gz");
+    BOOST_CHECK_EQUAL(compressionFromFilename("data.bz2"), "bz2");
+    BOOST_CHECK_EQUAL(compressionFromFilename("data.xz~"), "xz");
+    BOOST_CHECK_EQUAL(compressionFromFilename("data.zst"), "zst");
+    BOOST_CHECK_EQUAL(compressionFromFilename("data.lz4~"), "lz4");
+    BOOST_CHECK_EQUAL(compressionFromFilename("model.cls"), "");
+    BOOST_CHECK_EQUAL(compressionFromFilename("model.cls~"), "");
+    BOOST_CHECK_EQUAL(compressionFromFilename("dir.gz/model"), "");
+    BOOST_CHECK_EQUAL(compressionFromFilename("model.gzip"), "");
+    BOOST_CHECK_EQUAL(compressionFromFilename(""), "");
+}
+
+/* ensures that empty gz/bzip2/xz/zstd/lz4 streams have a valid header */
 BOOST_AUTO_TEST_CASE( test_empty_gzip )
 {
     fs::create_directories("build/x86_64/tmp");
 
     string fileprefix("build/x86_64/tmp/empty.");
-    vector<string> exts = { "gz", "bz2", "xz" };
+    vector<string> exts = { "gz", "bz2", "xz", "zst", "lz4" };
 
     for (const auto & ext: exts) {
         string filename = fileprefix + ext;
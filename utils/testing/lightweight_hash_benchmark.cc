@@ -0,0 +1,68 @@
+/* lightweight_hash_benchmark.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Times lookups in a Lightweight_Hash against std::unordered_map.  This is
+   a program to run by hand rather than a test, as the numbers depend on
+   the machine and the build.
+*/
+
+#include "jml/utils/lightweight_hash.h"
+#include "jml/arch/timers.h"
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <stdint.h>
+#include <stdlib.h>
+
+using namespace ML;
+using namespace std;
+
+template<class Hash>
+double time_lookups(const vector<uint64_t> & keys,
+                    const vector<uint64_t> & lookups,
+                    size_t & found)
+{
+    Hash h;
+    for (unsigned i = 0;  i < keys.size();  ++i)
+        h[keys[i]] = i;
+
+    Timer timer;
+    found = 0;
+    for (unsigned j = 0;  j < 5000000 / keys.size();  ++j)
+        for (unsigned i = 0;  i < lookups.size();  ++i)
+            found += h.find(lookups[i]) != h.end();
+    return timer.elapsed_wall();
+}
+
+int main(int argc, char ** argv)
+{
+    // Half hits and half misses, as for feature lookup in sparse scoring
+    for (size_t nkeys: { 10000, 1000000 }) {
+        vector<uint64_t> keys, lookups;
+        for (unsigned i = 0;  i < nkeys;  ++i) {
+            keys.push_back(random() * 65536ULL + random() + 1);
+            lookups.push_back(keys.back());
+            lookups.push_back(random() * 65536ULL + random() + 1);
+        }
+        std::random_shuffle(lookups.begin(), lookups.end());
+
+        size_t found_lightweight, found_std;
+        double lightweight_time
+            = time_lookups<Lightweight_Hash<uint64_t, int> >
+            (keys, lookups, found_lightweight);
+        double std_time
+            = time_lookups<std::unordered_map<uint64_t, int> >
+            (keys, lookups, found_std);
+
+        cout << nkeys << " keys: Lightweight_Hash " << lightweight_time
+             << "s, std::unordered_map " << std_time << "s" << endl;
+
+        if (found_lightweight != found_std) {
+            cerr << "lookups disagree: " << found_lightweight << " vs "
+                 << found_std << endl;
+            return 1;
+        }
+    }
+}
@@ -413,6 +413,59 @@ BOOST_AUTO_TEST_CASE( test_big_chunk_size )
     BOOST_CHECK_EQUAL(context.get_offset(), s.size());
 }
 
+BOOST_AUTO_TEST_CASE( test_readahead )
+{
+    size_t NCHARS = 1024 * 1024;
+
+    string s(NCHARS, 0);
+    for (unsigned i = 0;  i < NCHARS;  ++i)
+        s[i] = i % 251;
+
+    int chunk_sizes[] = { 1, 7, 4096, 1024 * 1024 * 16 };
+    int nchunk_sizes = sizeof(chunk_sizes) / sizeof(chunk_sizes[0]);
+
+    for (unsigned i = 0;  i < nchunk_sizes;  ++i) {
+        istringstream stream(s);
+
+        Parse_Context context("test file", stream, 1, 1, chunk_sizes[i],
+                              Parse_Context::DEFAULT_READAHEAD_CHUNKS);
+        BOOST_CHECK_EQUAL(context.get_readahead(),
+                          Parse_Context::DEFAULT_READAHEAD_CHUNKS);
+        BOOST_CHECK(context.readahead_available() > 0);
+
+        size_t n = 0;
+        bool ok = true;
+        while (context && ok) {
+            // Turn it off and on again, and change the chunk size, part
+            // way through
+            if (n == NCHARS / 4) context.set_readahead(0);
+            if (n == NCHARS / 2) context.set_readahead(3);
+            if (n == 3 * NCHARS / 4) context.set_chunk_size(100);
+
+            // Going back over chunk boundaries
+            if (n % 1000 == 0) {
+                Parse_Context::Revert_Token token(context);
+                for (unsigned j = 0;  j < 300 && context;  ++j)
+                    ++context;
+            }
+
+            ok = s[n] == *context++;
+            ++n;
+        }
+
+        BOOST_CHECK(ok);
+        BOOST_CHECK_EQUAL(n, NCHARS);
+        BOOST_CHECK_EQUAL(context.readahead_available(), 0);
+    }
+
+    // Stopping before the end doesn't wait for the rest
+    {
+        istringstream stream(s);
+        Parse_Context context("test file", stream, 1, 1, 1, 2);
+        BOOST_CHECK_EQUAL(*context, s[0]);
+    }
+}
+
 BOOST_AUTO_TEST_CASE( test_chunking_stream1 )
 {
     // Make some random records in a string
@@ -0,0 +1,125 @@
+/* string_interner_test.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Test of the string interner.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/utils/string_interner.h"
+#include "jml/arch/format.h"
+#include <boost/test/unit_test.hpp>
+#include <thread>
+#include <iostream>
+
+
+using namespace ML;
+using namespace std;
+
+using boost::unit_test::test_suite;
+
+BOOST_AUTO_TEST_CASE( test_append_only_array )
+{
+    Append_Only_Array<string> array;
+    BOOST_CHECK(array.empty());
+
+    array.push_back("hello");
+    const string * first = &array[0];
+
+    for (unsigned i = 1;  i < 10000;  ++i)
+        array.push_back(format("%d", i));
+
+    BOOST_CHECK_EQUAL(array.size(), 10000);
+    BOOST_CHECK_EQUAL(&array[0], first);
+    BOOST_CHECK_EQUAL(array[0], "hello");
+    for (unsigned i = 1;  i < 10000;  ++i)
+        BOOST_REQUIRE_EQUAL(array[i], format("%d", i));
+
+    BOOST_CHECK_THROW(array.at(10000), std::exception);
+
+    Append_Only_Array<string> copy = array;
+    BOOST_CHECK_EQUAL(copy.size(), 10000);
+    BOOST_CHECK_EQUAL(copy[9999], "9999");
+
+    array.clear();
+    BOOST_CHECK(array.empty());
+    BOOST_CHECK_EQUAL(copy[0], "hello");
+}
+
+BOOST_AUTO_TEST_CASE( test_interner )
+{
+    String_Interner interner;
+    BOOST_CHECK_EQUAL(interner.lookup("hello"), -1);
+
+    BOOST_CHECK_EQUAL(interner.intern("hello"), 0);
+    BOOST_CHECK_EQUAL(interner.intern("world"), 1);
+    BOOST_CHECK_EQUAL(interner.intern("hello"), 0);
+    BOOST_CHECK_EQUAL(interner.intern(""), 2);
+    BOOST_CHECK_EQUAL(interner.lookup("world"), 1);
+    BOOST_CHECK_EQUAL(interner.lookup(""), 2);
+    BOOST_CHECK_EQUAL(interner[1], "world");
+    BOOST_CHECK_THROW(interner.at(3), std::exception);
+
+    // Appending a duplicate gives a new id, which lookups then find
+    BOOST_CHECK_EQUAL(interner.append("hello"), 3);
+    BOOST_CHECK_EQUAL(interner.lookup("hello"), 3);
+    BOOST_CHECK_EQUAL(interner.intern("hello"), 3);
+    BOOST_CHECK_EQUAL(interner[0], "hello");
+    BOOST_CHECK_EQUAL(interner[3], "hello");
+    BOOST_CHECK_EQUAL(interner.size(), 4);
+
+    // Ids and references survive the table growing
+    const string * world = &interner[1];
+    for (unsigned i = 0;  i < 100000;  ++i)
+        BOOST_REQUIRE_EQUAL(interner.intern(format("string %d", i)), i + 4);
+    BOOST_CHECK_EQUAL(&interner[1], world);
+    BOOST_CHECK_EQUAL(interner.lookup("world"), 1);
+    BOOST_CHECK_EQUAL(interner.lookup("hello"), 3);
+
+    String_Interner copy = interner;
+    BOOST_CHECK_EQUAL(copy.size(), interner.size());
+    BOOST_CHECK_EQUAL(copy.lookup("string 99999"), 100003);
+    BOOST_CHECK_EQUAL(copy.lookup("hello"), 3);
+    BOOST_CHECK(copy.strings() == interner.strings());
+
+    interner.clear();
+    BOOST_CHECK_EQUAL(interner.size(), 0);
+    BOOST_CHECK_EQUAL(interner.lookup("hello"), -1);
+    BOOST_CHECK_EQUAL(interner.intern("world"), 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_interner_threads )
+{
+    // Each thread interns the same strings in a different order, so they
+    // race to add them; all must agree on the ids at the end
+    String_Interner interner;
+    int num_threads = 8, num_strings = 20000;
+
+    vector<vector<int> > ids(num_threads, vector<int>(num_strings));
+
+    auto run_thread = [&] (int thread)
+        {
+            for (int i = 0;  i < num_strings;  ++i) {
+                int s = (i * 7919 + thread * 104729) % num_strings;
+                ids[thread][s] = interner.intern(format("value %d", s));
+                if (interner[ids[thread][s]] != format("value %d", s))
+                    throw Exception("wrong string for id");
+            }
+        };
+
+    vector<std::thread> threads;
+    for (int i = 0;  i < num_threads;  ++i)
+        threads.emplace_back(run_thread, i);
+    for (auto & t: threads)
+        t.join();
+
+    BOOST_CHECK_EQUAL(interner.size(), num_strings);
+    for (int s = 0;  s < num_strings;  ++s) {
+        int id = interner.lookup(format("value %d", s));
+        BOOST_REQUIRE_NE(id, -1);
+        for (int t = 0;  t < num_threads;  ++t)
+            BOOST_REQUIRE_EQUAL(ids[t][s], id);
+    }
+}
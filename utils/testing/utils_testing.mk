@@ -4,6 +4,8 @@ $(eval $(call test,environment_test,utils arch,boost))
 $(eval $(call test,compact_vector_test,arch,boost))
 $(eval $(call test,circular_buffer_test,arch,boost))
 $(eval $(call test,lightweight_hash_test,arch utils,boost))
+$(eval $(call program,lightweight_hash_benchmark,arch utils))
+$(eval $(call test,string_interner_test,arch utils pthread,boost))
 $(eval $(call test,filter_streams_test,arch utils boost_filesystem boost_system,boost))
 $(eval $(call test,csv_parsing_test,arch utils,boost))
 
@@ -10,13 +10,17 @@ LIBUTILS_SOURCES := \
 	exc_assert.cc \
 	hex_dump.cc \
 	lzma.cc \
+	zstd.cc \
+	lz4.cc \
+	parallel_gzip.cc \
 	floating_point.cc \
 	json_parsing.cc \
 	rng.cc \
 	hash.cc \
+	string_interner.cc \
 	abort.cc
 
-LIBUTILS_LINK :=	ACE arch boost_iostreams lzma boost_thread cryptopp
+LIBUTILS_LINK :=	ACE arch boost_iostreams lzma z zstd lz4 boost_thread cryptopp worker_task
 
 $(eval $(call library,utils,$(LIBUTILS_SOURCES),$(LIBUTILS_LINK)))
 
@@ -0,0 +1,152 @@
+/* zstd.cc
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Boost iostreams filters for zstd compression.
+*/
+
+#include "zstd.h"
+#include <boost/iostreams/detail/ios.hpp>  // failure.
+#include <zstd.h>
+
+
+using namespace std;
+
+
+namespace boost { namespace iostreams {
+
+namespace detail {
+
+namespace {
+
+size_t check_zstd(size_t code, const char * what)
+{
+    if (ZSTD_isError(code))
+        throw BOOST_IOSTREAMS_FAILURE(string("zstd: ") + what + ": "
+                                      + ZSTD_getErrorName(code));
+    return code;
+}
+
+} // file scope
+
+
+/*****************************************************************************/
+/* ZSTD_COMPRESSOR_IMPL                                                      */
+/*****************************************************************************/
+
+zstd_compressor_impl::
+zstd_compressor_impl(const zstd_params & params)
+    : params_(params), cctx_(ZSTD_createCCtx())
+{
+    if (!cctx_)
+        throw std::bad_alloc();
+
+    ZSTD_CCtx * cctx = (ZSTD_CCtx *)cctx_;
+    int level = (params.level == -1 ? ZSTD_CLEVEL_DEFAULT : params.level);
+    check_zstd(ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level),
+               "setting compression level");
+
+    // A library built without threads can't do it; we just go serially
+    if (params.threads > 1)
+        ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, params.threads);
+}
+
+zstd_compressor_impl::
+~zstd_compressor_impl()
+{
+    ZSTD_freeCCtx((ZSTD_CCtx *)cctx_);
+}
+
+bool
+zstd_compressor_impl::
+filter(const char*& src_begin, const char* src_end,
+       char*& dest_begin, char* dest_end, bool flush)
+{
+    ZSTD_inBuffer in = { src_begin, size_t(src_end - src_begin), 0 };
+    ZSTD_outBuffer out = { dest_begin, size_t(dest_end - dest_begin), 0 };
+
+    size_t remaining
+        = check_zstd(ZSTD_compressStream2((ZSTD_CCtx *)cctx_, &out, &in,
+                                          flush ? ZSTD_e_end
+                                                : ZSTD_e_continue),
+                     "compressing");
+
+    src_begin += in.pos;
+    dest_begin += out.pos;
+
+    // When flushing, we're done once the whole frame has been written
+    return !flush || remaining != 0;
+}
+
+void
+zstd_compressor_impl::
+close()
+{
+    ZSTD_CCtx_reset((ZSTD_CCtx *)cctx_, ZSTD_reset_session_only);
+}
+
+
+/*****************************************************************************/
+/* ZSTD_DECOMPRESSOR_IMPL                                                    */
+/*****************************************************************************/
+
+zstd_decompressor_impl::
+zstd_decompressor_impl()
+    : dctx_(ZSTD_createDCtx()), in_frame_(false)
+{
+    if (!dctx_)
+        throw std::bad_alloc();
+}
+
+zstd_decompressor_impl::
+~zstd_decompressor_impl()
+{
+    ZSTD_freeDCtx((ZSTD_DCtx *)dctx_);
+}
+
+bool
+zstd_decompressor_impl::
+filter(const char*& src_begin, const char* src_end,
+       char*& dest_begin, char* dest_end, bool flush)
+{
+    ZSTD_inBuffer in = { src_begin, size_t(src_end - src_begin), 0 };
+    ZSTD_outBuffer out = { dest_begin, size_t(dest_end - dest_begin), 0 };
+
+    // Keep going while there is input (which may start another frame) or
+    // buffered output, and room to put it
+    while (out.pos < out.size && (in.pos < in.size || flush)) {
+        size_t in_before = in.pos, out_before = out.pos;
+        size_t hint
+            = check_zstd(ZSTD_decompressStream((ZSTD_DCtx *)dctx_, &out, &in),
+                         "decompressing");
+
+        // Between frames, the hint is the size of the next header; only
+        // a call that did something tells us where we are
+        if (in.pos != in_before || out.pos != out_before)
+            in_frame_ = hint != 0;
+        if (in.pos == in.size && out.pos < out.size) break;
+    }
+
+    src_begin += in.pos;
+    dest_begin += out.pos;
+
+    if (flush && out.pos < out.size) {
+        // No more input, and everything has been written out
+        if (in_frame_)
+            throw BOOST_IOSTREAMS_FAILURE("zstd: truncated data");
+        return false;
+    }
+    return true;
+}
+
+void
+zstd_decompressor_impl::
+close()
+{
+    ZSTD_DCtx_reset((ZSTD_DCtx *)dctx_, ZSTD_reset_session_only);
+    in_frame_ = false;
+}
+
+} // namespace detail
+
+} } // End namespaces iostreams, boost.
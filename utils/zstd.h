@@ -0,0 +1,126 @@
+/* zstd.h                                                          -*- C++ -*-
+   agent, 18 October 2026
+   Copyright (c) 2026 agent.  All rights reserved.
+
+   Boost iostreams filters for zstd compression, in the same style as
+   those in lzma.h.
+*/
+
+#ifndef __utils__zstd_h__
+#define __utils__zstd_h__
+
+#include <memory>
+#include <boost/iostreams/constants.hpp>   // buffer size.
+#include <boost/iostreams/filter/symmetric.hpp>
+#include <boost/iostreams/pipeline.hpp>
+
+
+namespace boost { namespace iostreams {
+
+//
+// Class name: zstd_params.
+// Description: Parameters for zstd compression.
+//
+struct zstd_params {
+
+    // Non-explicit constructor.  A level of -1 is zstd's default (3);
+    // levels go from 1 (fastest) to 19 (or 22 with more memory).
+    zstd_params( int level = -1, int threads = 1 )
+        : level(level), threads(threads)
+        { }
+    int level;
+
+    // More than one compresses blocks of the input in parallel with zstd's
+    // own worker threads.  The output is a standard zstd frame.
+    int threads;
+};
+
+namespace detail {
+
+class zstd_compressor_impl {
+public:
+    typedef char char_type;
+
+    zstd_compressor_impl(const zstd_params & params = zstd_params());
+    ~zstd_compressor_impl();
+
+    bool filter( const char*& src_begin, const char* src_end,
+                 char*& dest_begin, char* dest_end, bool flush );
+    void close();
+
+private:
+    zstd_params params_;
+    void * cctx_;
+};
+
+class zstd_decompressor_impl {
+public:
+    typedef char char_type;
+
+    zstd_decompressor_impl();
+    ~zstd_decompressor_impl();
+
+    bool filter( const char*& src_begin, const char* src_end,
+                 char*& dest_begin, char* dest_end, bool flush );
+    void close();
+
+private:
+    void * dctx_;
+    bool in_frame_;
+};
+
+} // namespace detail
+
+//
+// Template name: zstd_compressor
+// Description: Model of InputFilter and OutputFilter implementing
+//      compression using zstd.
+//
+template<typename Alloc = std::allocator<char> >
+struct basic_zstd_compressor
+    : symmetric_filter<detail::zstd_compressor_impl, Alloc>
+{
+private:
+    typedef detail::zstd_compressor_impl        impl_type;
+    typedef symmetric_filter<impl_type, Alloc>  base_type;
+public:
+    typedef typename base_type::char_type               char_type;
+    typedef typename base_type::category                category;
+    basic_zstd_compressor( const zstd_params& p = zstd_params(),
+                           int buffer_size = default_device_buffer_size)
+        : base_type(buffer_size, p)
+    {
+    }
+};
+BOOST_IOSTREAMS_PIPABLE(basic_zstd_compressor, 1)
+
+typedef basic_zstd_compressor<> zstd_compressor;
+
+//
+// Template name: zstd_decompressor
+// Description: Model of InputFilter and OutputFilter implementing
+//      decompression using zstd.  Concatenated frames are decompressed
+//      one after the other.
+//
+template<typename Alloc = std::allocator<char> >
+struct basic_zstd_decompressor
+    : symmetric_filter<detail::zstd_decompressor_impl, Alloc>
+{
+private:
+    typedef detail::zstd_decompressor_impl      impl_type;
+    typedef symmetric_filter<impl_type, Alloc>  base_type;
+public:
+    typedef typename base_type::char_type               char_type;
+    typedef typename base_type::category                category;
+    basic_zstd_decompressor(int buffer_size = default_device_buffer_size)
+        : base_type(buffer_size)
+    {
+    }
+};
+BOOST_IOSTREAMS_PIPABLE(basic_zstd_decompressor, 1)
+
+typedef basic_zstd_decompressor<> zstd_decompressor;
+
+} } // End namespaces iostreams, boost.
+
+#endif /* __utils__zstd_h__ */